@@ -0,0 +1,55 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.text
+	.syntax unified
+
+/*
+	parameters:
+	r0 - block table in, address/size word pairs
+	r1 - block count
+	r2 - result bitmap out, bit set for each blank block
+	r3 - erased word
+*/
+
+	.text
+	.arm
+
+	mov	r7, #1
+check_block:
+	ldmia	r0!, {r4, r5}
+loop:
+	cmp	r5, #0
+	beq	blank
+	ldr	r6, [r4], #4
+	sub	r5, r5, #4
+	cmp	r6, r3
+	beq	loop
+	b	next
+blank:
+	ldr	r6, [r2]
+	orr	r6, r6, r7
+	str	r6, [r2]
+next:
+	movs	r7, r7, lsl #1
+	addeq	r2, r2, #4
+	moveq	r7, #1
+	subs	r1, r1, #1
+	bne	check_block
+	bkpt	#0
+
+	.end
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.text
+	.syntax unified
+
+/*
+	parameters:
+	r0 - block table in, address/size word pairs
+	r1 - block count
+	r2 - result bitmap out, bit set for each blank block
+	r3 - erased word
+*/
+
+	.text
+	.syntax unified
+	.cpu cortex-m0
+	.thumb
+	.thumb_func
+
+	.align	2
+
+	movs	r7, #1
+check_block:
+	ldmia	r0!, {r4, r5}
+loop:
+	cmp	r5, #0
+	beq	blank
+	ldmia	r4!, {r6}
+	subs	r5, #4
+	cmp	r6, r3
+	beq	loop
+	b	next
+blank:
+	ldr	r6, [r2]
+	orrs	r6, r7
+	str	r6, [r2]
+next:
+	lsls	r7, r7, #1
+	bne	no_wrap
+	adds	r2, #4
+	movs	r7, #1
+no_wrap:
+	subs	r1, #1
+	bne	check_block
+	bkpt	#0
+
+	.end
@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.global main
+	.text
+	.set noreorder
+
+/* params:
+ * $a0 block table in, address/size word pairs
+ * $a1 block count
+ * $a2 result bitmap out, bit set for each blank block
+ * $a3 erased word
+ * vars
+ * $t0 address
+ * $t1 bytes left in the block
+ * $t4 bit of the current block
+ * temps:
+ * $t2
+ */
+
+.ent main
+main:
+	addiu	$t4, $zero, 1
+
+check_block:
+	lw		$t0, 0($a0)		/* block address */
+	lw		$t1, 4($a0)		/* block size */
+	addiu	$a0, $a0, 8
+
+loop:
+	beq		$t1, $zero, blank	/* whole block compared */
+	nop
+	lw		$t2, 0($t0)
+	addiu	$t0, $t0, 4
+	beq		$t2, $a3, loop
+	addiu	$t1, $t1, -4
+	b		next
+	nop
+
+blank:
+	lw		$t2, 0($a2)
+	or		$t2, $t2, $t4
+	sw		$t2, 0($a2)
+
+next:
+	sll		$t4, $t4, 1
+	bne		$t4, $zero, no_wrap	/* bitmap word not full */
+	nop
+	addiu	$a2, $a2, 4
+	addiu	$t4, $zero, 1
+
+no_wrap:
+	addiu	$a1, $a1, -1
+	bne		$a1, $zero, check_block	/* all blocks processed */
+	nop
+
+wait:
+	sdbbp
+
+.end main
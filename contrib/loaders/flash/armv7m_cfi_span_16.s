@@ -57,8 +57,8 @@ busy:
 	eor		r7, r5, r6
 	ands	r7, r4, r7
 	beq		cont			/* b if DQ7 == Data7 */
-	ands	r6, r6, r4, lsr #2
-	beq		busy			/* b if DQ5 low */
+	ands	r6, r6, r7, lsr #2
+	beq		busy			/* b if DQ5 low in the busy lanes */
 	ldrh	r6, [r1]
 	eor		r7, r5, r6
 	ands	r7, r4, r7
@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2005, 2007 by Dominic Rath                              *
+ *   Dominic.Rath@gmx.de                                                   *
+ *   Copyright (C) 2010 Spencer Oliver                                     *
+ *   spen@spen-soft.co.uk                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.text
+	.syntax unified
+	.arch armv7-m
+	.thumb
+	.thumb_func
+
+	.align 2
+
+/* input parameters - */
+/*	R0 = source address */
+/*	R1 = destination address (out: start of the failing buffer) */
+/*	R2 = number of writes */
+/*	R3 = write buffer size, in writes, a power of two */
+/*	R4 = constant to mask DQ7 bits (also used for DQ5 and DQ1 with shift) */
+/*	R12 = "write to buffer" command */
+/* output parameters - */
+/*	R5 = 0x80 ok 0x00 bad */
+/* temp registers - */
+/*	R6 = value read from flash to test status */
+/*	R7 = write pointer */
+/*	R14 = lanes still busy */
+/* unlock registers - */
+/*  R8 = unlock1_addr */
+/*  R9 = unlock1_cmd */
+/*  R10 = unlock2_addr */
+/*  R11 = unlock2_cmd */
+
+code:
+	sub		r6, r3, #1
+	and		r6, r6, r1, lsr #1
+	sub		r6, r3, r6		/* writes up to the end of the buffer */
+	cmp		r6, r2
+	it		hi
+	movhi	r6, r2
+	sub		r2, r2, r6
+	strh	r9, [r8]
+	strh	r11, [r10]
+	strh	r12, [r1]
+	sub		r7, r6, #1
+	lsr		r5, r4, #7
+	mul		r14, r7, r5		/* count - 1, in every chip's lane */
+	strh	r14, [r1]
+	mov		r7, r1
+copy:
+	ldrh	r5, [r0], #2
+	strh	r5, [r7], #2
+	subs	r6, r6, #1
+	bne		copy
+	add		r6, r12, r4, lsr #5	/* "program buffer to flash" */
+	strh	r6, [r1]
+busy:
+	ldrh	r6, [r7, #-2]
+	eor		r14, r6, r5
+	ands	r14, r14, r4
+	beq		cont			/* b if DQ7 == Data7 in every lane */
+	tst		r6, r14, lsr #2
+	it		eq
+	tsteq	r6, r14, lsr #6
+	beq		busy			/* b if DQ5 and DQ1 low in the busy lanes */
+	ldrh	r6, [r7, #-2]
+	eor		r6, r6, r5
+	ands	r6, r6, r4
+	beq		cont			/* b if DQ7 == Data7 in every lane */
+	mov		r5, #0			/* 0x0 - return 0x00, error */
+	b		done
+cont:
+	mov		r1, r7
+	cmp		r2, #0
+	bne		code
+	mov		r5, #128		/* 0x80 */
+done:
+	bkpt	#0
+	nop
+
+	.end
@@ -28,14 +28,149 @@
 #include "arm_io.h"
 #include <helper/binarybuffer.h>
 #include <target/arm.h>
+#include <target/armv7m.h>
 #include <target/algorithm.h>
 
+/**
+ * @file
+ * Moving NAND data through a small loop running on the target.
+ *
+ * The loop copies between a buffer in a working area and the NAND data
+ * register, so a page costs one bulk transfer over the debug link plus
+ * a short algorithm run instead of a JTAG access per byte or word.  It
+ * is assembled for the core (ARM state on ARM7/ARM9 style cores, Thumb-2
+ * on ARMv7-M) and for the NAND bus and data register widths.
+ *
+ * When the core isn't supported or there's no room in the working area
+ * the functions return ERROR_NAND_NO_BUFFER, and the generic NAND code
+ * falls back to moving data one word at a time.
+ */
+
+/* largest loop, in bytes */
+#define ARM_NAND_CODE_SIZE	20
+
+static unsigned arm_nand_width(unsigned width, unsigned dflt)
+{
+	return width ? width : dflt;
+}
+
+/**
+ * Assembles the copy loop for the current core and widths, in target
+ * endianness.  On entry r0 is the destination, r1 the source and r2 the
+ * length in bytes; one of the first two is the data register.
+ *
+ * @param nand Pointer to the arm_nand_data struct that defines the I/O
+ * @param op The direction of the copy
+ * @param code Where to store the code, ARM_NAND_CODE_SIZE bytes
+ * @param code_size Where to store the size of the code
+ * @param thumb Whether the code runs on an ARMv7-M core
+ * @return ERROR_OK, or ERROR_NAND_NO_BUFFER if the loop can't be used
+ */
+static int arm_nand_code(struct arm_nand_data *nand, enum arm_nand_op op,
+		uint8_t *code, unsigned *code_size, bool *thumb)
+{
+	struct target *target = nand->target;
+	unsigned bus = arm_nand_width(nand->bus_width, 8);
+	unsigned reg = arm_nand_width(nand->reg_width, bus);
+	int b = bus == 16, r = reg == 8 ? 0 : reg == 16 ? 1 : 2;
+
+	if ((bus != 8 && bus != 16) || (reg != 8 && reg != 16 && reg != 32)) {
+		LOG_ERROR("BUG: unsupported NAND access width %u/%u", bus, reg);
+		return ERROR_NAND_NO_BUFFER;
+	}
+
+	if (is_armv7m(target_to_armv7m(target))) {
+		/* Thumb-2, halfwords */
+		static const uint16_t load_post[2][2] = {
+			{ 0xf811, 0x3b01 },	/* ldrb.w r3, [r1], #1 */
+			{ 0xf831, 0x3b02 },	/* ldrh.w r3, [r1], #2 */
+		};
+		static const uint16_t store_reg[3] = {
+			0x7003,			/* strb   r3, [r0]     */
+			0x8003,			/* strh   r3, [r0]     */
+			0x6003,			/* str    r3, [r0]     */
+		};
+		static const uint16_t load_reg[3] = {
+			0x780b,			/* ldrb   r3, [r1]     */
+			0x880b,			/* ldrh   r3, [r1]     */
+			0x680b,			/* ldr    r3, [r1]     */
+		};
+		static const uint16_t store_post[2][2] = {
+			{ 0xf800, 0x3b01 },	/* strb.w r3, [r0], #1 */
+			{ 0xf820, 0x3b02 },	/* strh.w r3, [r0], #2 */
+		};
+		uint16_t loop[6];
+
+		if (op == ARM_NAND_WRITE) {
+			loop[0] = load_post[b][0];
+			loop[1] = load_post[b][1];
+			loop[2] = store_reg[r];
+		} else {
+			loop[0] = load_reg[r];
+			loop[1] = store_post[b][0];
+			loop[2] = store_post[b][1];
+		}
+		loop[3] = b ? 0x3a02 : 0x3a01;	/* subs   r2, #1 or #2 */
+		loop[4] = 0xd1fa;		/* bne    loop         */
+		loop[5] = 0xbe00;		/* bkpt   #0           */
+
+		for (unsigned i = 0; i < ARRAY_SIZE(loop); i++)
+			target_buffer_set_u16(target, code + 2 * i, loop[i]);
+		*code_size = sizeof(loop);
+		*thumb = true;
+	} else if (is_arm(target_to_arm(target))) {
+		static const uint32_t load_post[2] = {
+			0xe4d13001,	/* ldrb  r3, [r1], #1 */
+			0xe0d130b2,	/* ldrh  r3, [r1], #2 */
+		};
+		static const uint32_t store_reg[3] = {
+			0xe5c03000,	/* strb  r3, [r0]     */
+			0xe1c030b0,	/* strh  r3, [r0]     */
+			0xe5803000,	/* str   r3, [r0]     */
+		};
+		static const uint32_t load_reg[3] = {
+			0xe5d13000,	/* ldrb  r3, [r1]     */
+			0xe1d130b0,	/* ldrh  r3, [r1]     */
+			0xe5913000,	/* ldr   r3, [r1]     */
+		};
+		static const uint32_t store_post[2] = {
+			0xe4c03001,	/* strb  r3, [r0], #1 */
+			0xe0c030b2,	/* strh  r3, [r0], #2 */
+		};
+		uint32_t loop[5];
+
+		if (op == ARM_NAND_WRITE) {
+			loop[0] = load_post[b];
+			loop[1] = store_reg[r];
+		} else {
+			loop[0] = load_reg[r];
+			loop[1] = store_post[b];
+		}
+		loop[2] = b ? 0xe2522002 : 0xe2522001;	/* subs  r2, r2, #1 or #2 */
+		loop[3] = 0x1afffffb;			/* bne   loop         */
+
+		/* exit: ARMv4 needs hardware breakpoint */
+		loop[4] = 0xe1200070;			/* bkpt  #0           */
+
+		for (unsigned i = 0; i < ARRAY_SIZE(loop); i++)
+			target_buffer_set_u32(target, code + 4 * i, loop[i]);
+		*code_size = sizeof(loop);
+		*thumb = false;
+	} else {
+		LOG_DEBUG("no hosted NAND I/O on %s cores", target_type_name(target));
+		return ERROR_NAND_NO_BUFFER;
+	}
+
+	return ERROR_OK;
+}
+
 /**
  * Copies code to a working area.  This will allocate room for the code plus the
- * additional amount requested if the working area pointer is null.
+ * additional amount requested if the working area pointer is null, or if the
+ * area there is too small.
  *
  * @param target Pointer to the target to copy code to
- * @param code Pointer to the code area to be copied
+ * @param code Pointer to the code, in target endianness
  * @param code_size Size of the code being copied
  * @param additional Size of the additional area to be allocated in addition to
  *                   code
@@ -43,18 +178,17 @@
  * @return Success or failure of the operation
  */
 static int arm_code_to_working_area(struct target *target,
-	const uint32_t *code, unsigned code_size,
+	const uint8_t *code, unsigned code_size,
 	unsigned additional, struct working_area **area)
 {
-	uint8_t code_buf[code_size];
-	unsigned i;
 	int retval;
 	unsigned size = code_size + additional;
 
-	/* REVISIT this assumes size doesn't ever change.
-	 * That's usually correct; but there are boards with
-	 * both large and small page chips, where it won't be...
-	 */
+	/* boards can have both large and small page chips */
+	if (*area && (*area)->size < size) {
+		target_free_working_area(target, *area);
+		*area = NULL;
+	}
 
 	/* make sure we have a working area */
 	if (NULL == *area) {
@@ -65,107 +199,129 @@ static int arm_code_to_working_area(struct target *target,
 		}
 	}
 
-	/* buffer code in target endianness */
-	for (i = 0; i < code_size / 4; i++)
-		target_buffer_set_u32(target, code_buf + i * 4, code[i]);
-
 	/* copy code to work area */
 	retval = target_write_memory(target, (*area)->address,
-			4, code_size / 4, code_buf);
+			4, code_size / 4, code);
 
 	return retval;
 }
 
-/**
- * ARM-specific bulk write from buffer to address of 8-bit wide NAND.
- * For now this only supports ARMv4 and ARMv5 cores.
- *
- * Enhancements to target_run_algorithm() could enable:
- *   - ARMv6 and ARMv7 cores in ARM mode
- *
- * Different code fragments could handle:
- *   - Thumb2 cores like Cortex-M (needs different byteswapping)
- *   - 16-bit wide data (needs different setup too)
- *
- * @param nand Pointer to the arm_nand_data struct that defines the I/O
- * @param data Pointer to the data to be copied to flash
- * @param size Size of the data being copied
- * @return Success or failure of the operation
- */
-int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
+/* load the loop for @a op if needed, and run it over @a size bytes */
+static int arm_nand_run(struct arm_nand_data *nand, enum arm_nand_op op,
+		uint8_t *data, uint32_t size)
 {
 	struct target *target = nand->target;
-	struct arm_algorithm algo;
-	struct arm *arm = target->arch_info;
+	struct arm_algorithm armv4_5_algo;
+	struct armv7m_algorithm armv7m_algo;
+	void *arm_algo;
 	struct reg_param reg_params[3];
+	uint8_t code[ARM_NAND_CODE_SIZE];
+	unsigned code_size;
 	uint32_t target_buf;
 	uint32_t exit_var = 0;
+	bool thumb;
 	int retval;
 
-	/* Inputs:
-	 *  r0	NAND data address (byte wide)
-	 *  r1	buffer address
-	 *  r2	buffer length
-	 */
-	static const uint32_t code[] = {
-		0xe4d13001,	/* s: ldrb  r3, [r1], #1 */
-		0xe5c03000,	/*    strb  r3, [r0]     */
-		0xe2522001,	/*    subs  r2, r2, #1   */
-		0x1afffffb,	/*    bne   s            */
+	retval = arm_nand_code(nand, op, code, &code_size, &thumb);
+	if (retval != ERROR_OK)
+		return retval;
 
-		/* exit: ARMv4 needs hardware breakpoint */
-		0xe1200070,	/* e: bkpt  #0           */
-	};
+	if (size == 0)
+		return ERROR_OK;
+	if (arm_nand_width(nand->bus_width, 8) == 16 && (size & 1))
+		return ERROR_NAND_NO_BUFFER;
 
-	if (nand->op != ARM_NAND_WRITE || !nand->copy_area) {
-		retval = arm_code_to_working_area(target, code, sizeof(code),
+	if (nand->chunk_size < size)
+		nand->chunk_size = size;
+
+	/* create the copy area if not yet available */
+	if (nand->op != op || !nand->copy_area
+			|| nand->copy_area->size < code_size + size) {
+		retval = arm_code_to_working_area(target, code, code_size,
 				nand->chunk_size, &nand->copy_area);
-		if (retval != ERROR_OK)
+		if (retval != ERROR_OK) {
+			nand->op = ARM_NAND_NONE;
 			return retval;
+		}
 	}
 
-	nand->op = ARM_NAND_WRITE;
+	nand->op = op;
+	target_buf = nand->copy_area->address + code_size;
 
 	/* copy data to work area */
-	target_buf = nand->copy_area->address + sizeof(code);
-	retval = target_bulk_write_memory(target, target_buf, size / 4, data);
-	if (retval == ERROR_OK && (size & 3) != 0)
-		retval = target_write_memory(target,
-				target_buf + (size & ~3),
-				1, size & 3, data + (size & ~3));
-	if (retval != ERROR_OK)
-		return retval;
+	if (op == ARM_NAND_WRITE) {
+		retval = target_bulk_write_memory(target, target_buf, size / 4, data);
+		if (retval == ERROR_OK && (size & 3) != 0)
+			retval = target_write_memory(target,
+					target_buf + (size & ~3),
+					1, size & 3, data + (size & ~3));
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	/* set up algorithm and parameters */
-	algo.common_magic = ARM_COMMON_MAGIC;
-	algo.core_mode = ARM_MODE_SVC;
-	algo.core_state = ARM_STATE_ARM;
+	if (thumb) {
+		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
+		armv7m_algo.core_mode = ARM_MODE_THREAD;
+		arm_algo = &armv7m_algo;
+	} else {
+		armv4_5_algo.common_magic = ARM_COMMON_MAGIC;
+		armv4_5_algo.core_mode = ARM_MODE_SVC;
+		armv4_5_algo.core_state = ARM_STATE_ARM;
+		arm_algo = &armv4_5_algo;
+
+		/* armv4 must exit using a hardware breakpoint */
+		if (target_to_arm(target)->is_armv4)
+			exit_var = nand->copy_area->address + code_size - 4;
+	}
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN);
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN);
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN);
 
-	buf_set_u32(reg_params[0].value, 0, 32, nand->data);
-	buf_set_u32(reg_params[1].value, 0, 32, target_buf);
+	buf_set_u32(reg_params[0].value, 0, 32,
+			op == ARM_NAND_WRITE ? nand->data : target_buf);
+	buf_set_u32(reg_params[1].value, 0, 32,
+			op == ARM_NAND_WRITE ? target_buf : nand->data);
 	buf_set_u32(reg_params[2].value, 0, 32, size);
 
-	/* armv4 must exit using a hardware breakpoint */
-	if (arm->is_armv4)
-		exit_var = nand->copy_area->address + sizeof(code) - 4;
-
-	/* use alg to write data from work area to NAND chip */
+	/* use alg to move data between work area and NAND chip */
 	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
-			nand->copy_area->address, exit_var, 1000, &algo);
+			nand->copy_area->address, exit_var, 1000, arm_algo);
 	if (retval != ERROR_OK)
-		LOG_ERROR("error executing hosted NAND write");
+		LOG_ERROR("error executing hosted NAND %s",
+			op == ARM_NAND_WRITE ? "write" : "read");
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
+	/* read from work area to the host's memory */
+	if (retval == ERROR_OK && op == ARM_NAND_READ)
+		retval = target_read_buffer(target, target_buf, size, data);
+
 	return retval;
 }
 
+/**
+ * Bulk write from buffer to the data register of a NAND controller, using
+ * a loop running on the target.  ARMv4 and ARMv5 cores run it in ARM state
+ * and ARMv7-M cores in Thumb state.
+ *
+ * Enhancements to target_run_algorithm() could enable:
+ *   - ARMv6 and ARMv7-A/R cores in ARM mode
+ *
+ * @param nand Pointer to the arm_nand_data struct that defines the I/O
+ * @param data Pointer to the data to be copied to flash
+ * @param size Size of the data being copied
+ * @return Success or failure of the operation; ERROR_NAND_NO_BUFFER when
+ *	the data has to be written some other way
+ */
+int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
+{
+	return arm_nand_run(nand, ARM_NAND_WRITE, data, size);
+}
+
 /**
  * Uses an on-chip algorithm for an ARM device to read from a NAND device and
  * store the data into the host machine's memory.
@@ -173,73 +329,24 @@ int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
  * @param nand Pointer to the arm_nand_data struct that defines the I/O
  * @param data Pointer to the data buffer to store the read data
  * @param size Amount of data to be stored to the buffer.
- * @return Success or failure of the operation
+ * @return Success or failure of the operation; ERROR_NAND_NO_BUFFER when
+ *	the data has to be read some other way
  */
 int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 {
-	struct target *target = nand->target;
-	struct arm_algorithm algo;
-	struct arm *arm = target->arch_info;
-	struct reg_param reg_params[3];
-	uint32_t target_buf;
-	uint32_t exit_var = 0;
-	int retval;
-
-	/* Inputs:
-	 *  r0	buffer address
-	 *  r1	NAND data address (byte wide)
-	 *  r2	buffer length
-	 */
-	static const uint32_t code[] = {
-		0xe5d13000,	/* s: ldrb  r3, [r1]     */
-		0xe4c03001,	/*    strb  r3, [r0], #1 */
-		0xe2522001,	/*    subs  r2, r2, #1   */
-		0x1afffffb,	/*    bne   s            */
-
-		/* exit: ARMv4 needs hardware breakpoint */
-		0xe1200070,	/* e: bkpt  #0           */
-	};
-
-	/* create the copy area if not yet available */
-	if (nand->op != ARM_NAND_READ || !nand->copy_area) {
-		retval = arm_code_to_working_area(target, code, sizeof(code),
-				nand->chunk_size, &nand->copy_area);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-
-	nand->op = ARM_NAND_READ;
-	target_buf = nand->copy_area->address + sizeof(code);
-
-	/* set up algorithm and parameters */
-	algo.common_magic = ARM_COMMON_MAGIC;
-	algo.core_mode = ARM_MODE_SVC;
-	algo.core_state = ARM_STATE_ARM;
-
-	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN);
-	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN);
-	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN);
-
-	buf_set_u32(reg_params[0].value, 0, 32, target_buf);
-	buf_set_u32(reg_params[1].value, 0, 32, nand->data);
-	buf_set_u32(reg_params[2].value, 0, 32, size);
-
-	/* armv4 must exit using a hardware breakpoint */
-	if (arm->is_armv4)
-		exit_var = nand->copy_area->address + sizeof(code) - 4;
-
-	/* use alg to write data from NAND chip to work area */
-	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
-			nand->copy_area->address, exit_var, 1000, &algo);
-	if (retval != ERROR_OK)
-		LOG_ERROR("error executing hosted NAND read");
-
-	destroy_reg_param(&reg_params[0]);
-	destroy_reg_param(&reg_params[1]);
-	destroy_reg_param(&reg_params[2]);
-
-	/* read from work area to the host's memory */
-	retval = target_read_buffer(target, target_buf, size, data);
+	return arm_nand_run(nand, ARM_NAND_READ, data, size);
+}
 
-	return retval;
+/**
+ * Frees the copy area, for drivers that need the working area for
+ * something else, or before the arm_nand_data struct goes away.
+ *
+ * @param nand Pointer to the arm_nand_data struct that defines the I/O
+ */
+void arm_nand_release(struct arm_nand_data *nand)
+{
+	if (nand->copy_area)
+		target_free_working_area(nand->target, nand->copy_area);
+	nand->copy_area = NULL;
+	nand->op = ARM_NAND_NONE;
 }
@@ -48,10 +48,19 @@ struct arm_nand_data {
 	/** Last operation executed using this struct. */
 	enum arm_nand_op op;
 
-	/* currently implicit:  data width == 8 bits (not 16) */
+	/** NAND bus width in bits, 8 or 16; zero means 8. */
+	unsigned bus_width;
+
+	/**
+	 * Width in bits of the accesses to the data register, 8, 16 or 32,
+	 * for controllers that need wider accesses than the NAND bus;
+	 * zero means the bus width.
+	 */
+	unsigned reg_width;
 };
 
 int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size);
 int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size);
+void arm_nand_release(struct arm_nand_data *nand);
 
 #endif	/* __ARM_NANDIO_H */
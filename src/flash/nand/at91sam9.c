@@ -703,6 +703,14 @@ static const struct command_registration at91sam9_command_handler[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+static void at91sam9_free_driver_priv(struct nand_device *nand)
+{
+	struct at91sam9_nand *info = nand->controller_priv;
+
+	arm_nand_release(&info->io);
+	free(info);
+}
+
 /**
  * Structure representing the AT91SAM9 NAND controller.
  */
@@ -721,4 +729,5 @@ struct nand_flash_controller at91sam9_nand_controller = {
 	.write_block_data = at91sam9_write_block_data,
 	.read_page = at91sam9_read_page,
 	.write_page = at91sam9_write_page,
+	.free_driver_priv = at91sam9_free_driver_priv,
 };
@@ -0,0 +1,268 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <helper/fileio.h>
+#include <target/image.h>
+
+/**
+ * @file
+ * Keeping the bad block table of a NAND device in a host file.
+ *
+ * Finding the bad blocks means reading the OOB of every block, which
+ * takes minutes on large devices.  The table can be saved to a file and
+ * loaded again later; it is tied to the device by its IDs and geometry,
+ * and a checksum catches damaged files.  Since another chip of the same
+ * type has the same IDs, the markers of a few blocks are read back when
+ * loading: good blocks must still read good, and some of the bad ones
+ * must still read bad (their markers may have been erased since).
+ *
+ * Blocks whose marker page is written with OOB data go back to unknown,
+ * so only they are checked again.  Blocks that fail to erase or program
+ * are retired: they are kept bad, and no rescan clears them again.
+ * Nothing marks them bad on the chip, so they are saved in a state of
+ * their own and not sampled when loading.
+ *
+ * The file holds a header of little endian 32-bit words, followed by a
+ * byte per block: 0 for good, 1 for bad, 2 for retired, 0xff for not
+ * known.
+ */
+
+#define NAND_BBT_MAGIC		"OpenOCD NAND BBT"
+#define NAND_BBT_VERSION	1
+#define NAND_BBT_HEADER_WORDS	7
+#define NAND_BBT_HEADER_SIZE	(16 + 4 * NAND_BBT_HEADER_WORDS)
+
+/* file state of blocks that failed to erase or program */
+#define NAND_BBT_RETIRED	2
+
+/* blocks of each kind read back when loading */
+#define NAND_BBT_SAMPLES	8
+
+static void nand_bbt_header(struct nand_device *nand, uint8_t *header,
+		uint32_t checksum)
+{
+	uint32_t words[NAND_BBT_HEADER_WORDS] = {
+		NAND_BBT_VERSION,
+		nand->manufacturer->id,
+		nand->device->id,
+		nand->page_size,
+		nand->erase_size,
+		nand->num_blocks,
+		checksum,
+	};
+
+	memcpy(header, NAND_BBT_MAGIC, 16);
+	for (int i = 0; i < NAND_BBT_HEADER_WORDS; i++)
+		h_u32_to_le(header + 16 + 4 * i, words[i]);
+}
+
+int nand_bbt_save(struct nand_device *nand, const char *filename)
+{
+	uint8_t header[NAND_BBT_HEADER_SIZE];
+	struct fileio fileio;
+	uint8_t *table;
+	uint32_t checksum;
+	size_t size_written;
+	int retval, retvaltemp;
+
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	table = malloc(nand->num_blocks);
+	if (table == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (int i = 0; i < nand->num_blocks; i++)
+		table[i] = nand->blocks[i].is_retired ? NAND_BBT_RETIRED
+			: nand->blocks[i].is_bad;
+
+	retval = image_calculate_checksum(table, nand->num_blocks, &checksum);
+	if (retval != ERROR_OK) {
+		free(table);
+		return retval;
+	}
+	nand_bbt_header(nand, header, checksum);
+
+	retval = fileio_open(&fileio, filename, FILEIO_WRITE, FILEIO_BINARY);
+	if (retval != ERROR_OK) {
+		free(table);
+		return retval;
+	}
+
+	retval = fileio_write(&fileio, sizeof(header), header, &size_written);
+	if (retval == ERROR_OK)
+		retval = fileio_write(&fileio, nand->num_blocks, table, &size_written);
+	free(table);
+
+	retvaltemp = fileio_close(&fileio);
+	if (retval == ERROR_OK)
+		retval = retvaltemp;
+	if (retval != ERROR_OK)
+		return retval;
+
+	nand->bbt_dirty = false;
+	LOG_DEBUG("saved bad block table of %s to %s", nand->name, filename);
+
+	return ERROR_OK;
+}
+
+/* read the file into @a table, checking it belongs to this device */
+static int nand_bbt_read(struct nand_device *nand, const char *filename,
+		uint8_t *table)
+{
+	uint8_t header[NAND_BBT_HEADER_SIZE], expected[NAND_BBT_HEADER_SIZE];
+	struct fileio fileio;
+	size_t size_read = 0;
+	uint32_t checksum;
+	int retval;
+
+	retval = fileio_open(&fileio, filename, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_read(&fileio, sizeof(header), header, &size_read);
+	if (retval == ERROR_OK && size_read == sizeof(header))
+		retval = fileio_read(&fileio, nand->num_blocks, table, &size_read);
+	fileio_close(&fileio);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* everything but the checksum must match this device */
+	nand_bbt_header(nand, expected, le_to_h_u32(header + NAND_BBT_HEADER_SIZE - 4));
+	if (size_read != (size_t)nand->num_blocks
+			|| memcmp(header, expected, sizeof(header)) != 0) {
+		LOG_ERROR("%s doesn't hold a bad block table of a %s device",
+			filename, nand->device->name);
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	retval = image_calculate_checksum(table, nand->num_blocks, &checksum);
+	if (retval != ERROR_OK)
+		return retval;
+	if (checksum != le_to_h_u32(header + NAND_BBT_HEADER_SIZE - 4)) {
+		LOG_ERROR("bad block table in %s is damaged", filename);
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	return ERROR_OK;
+}
+
+/* read back the markers of a few blocks of the given state, spread out */
+static int nand_bbt_sample(struct nand_device *nand, const uint8_t *table,
+		uint8_t state, unsigned *sampled, unsigned *matched)
+{
+	int count = 0;
+
+	for (int i = 0; i < nand->num_blocks; i++)
+		count += table[i] == state;
+
+	for (int i = 0, seen = 0; i < nand->num_blocks && *sampled < NAND_BBT_SAMPLES; i++) {
+		int is_bad, retval;
+
+		if (table[i] != state)
+			continue;
+		/* the seen'th of count blocks; take every count/SAMPLES'th */
+		if ((seen++ * NAND_BBT_SAMPLES) % count >= NAND_BBT_SAMPLES)
+			continue;
+
+		retval = nand_read_bad_block_marker(nand, i, &is_bad);
+		if (retval != ERROR_OK)
+			return retval;
+		(*sampled)++;
+		if (is_bad == state)
+			(*matched)++;
+	}
+
+	return ERROR_OK;
+}
+
+int nand_bbt_load(struct nand_device *nand, const char *filename)
+{
+	unsigned good = 0, good_ok = 0, bad = 0, bad_ok = 0, known = 0;
+	uint8_t *table;
+	int retval;
+
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	table = malloc(nand->num_blocks);
+	if (table == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = nand_bbt_read(nand, filename, table);
+	if (retval == ERROR_OK)
+		retval = nand_bbt_sample(nand, table, 0, &good, &good_ok);
+	if (retval == ERROR_OK)
+		retval = nand_bbt_sample(nand, table, 1, &bad, &bad_ok);
+	if (retval != ERROR_OK) {
+		free(table);
+		return retval;
+	}
+
+	if (good_ok != good || (bad && !bad_ok)) {
+		LOG_ERROR("bad block table in %s doesn't match the markers of %s",
+			filename, nand->name);
+		free(table);
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	for (int i = 0; i < nand->num_blocks; i++) {
+		nand->blocks[i].is_retired = table[i] == NAND_BBT_RETIRED;
+		if (nand->blocks[i].is_retired) {
+			nand->blocks[i].is_bad = 1;
+			known++;
+		} else if (table[i] <= 1) {
+			nand->blocks[i].is_bad = table[i];
+			known++;
+		} else
+			nand->blocks[i].is_bad = -1;
+	}
+	nand->bbt_dirty = false;
+	free(table);
+
+	LOG_INFO("loaded bad block table of %s from %s: %u of %d blocks known",
+		nand->name, filename, known, nand->num_blocks);
+
+	return ERROR_OK;
+}
+
+int nand_bbt_sync(struct nand_device *nand)
+{
+	if (!nand->bbt_file || !nand->bbt_dirty || !nand->device)
+		return ERROR_OK;
+
+	return nand_bbt_save(nand, nand->bbt_file);
+}
+
+void nand_bbt_page_written(struct nand_device *nand, uint32_t page)
+{
+	uint32_t pages_per_block = nand->erase_size / nand->page_size;
+	struct nand_block *block = &nand->blocks[page / pages_per_block];
+
+	if (page % pages_per_block == 0 && block->is_bad == 0) {
+		block->is_bad = -1;
+		nand->bbt_dirty = true;
+	}
+}
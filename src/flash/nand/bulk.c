@@ -0,0 +1,322 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+
+/**
+ * @file
+ * Writing many consecutive NAND pages.
+ *
+ * When pages go through the generic command/address/data interface,
+ * the program command of a page is not waited for until the next page
+ * is started, so reading the file and computing ECC overlap with the
+ * device programming.  Large page chips with a cache register can get
+ * the data of a page while the previous one is programmed, using the
+ * cache program command for all but the last page of a block; that is
+ * enabled per device with "nand cache_program".
+ *
+ * Optionally bad blocks are skipped, looking them up as they are
+ * reached.  The pages written to the current block are then kept, so
+ * that if programming fails the block can be marked bad and its pages
+ * written again to the next good block.
+ */
+
+static uint32_t nand_pages_per_block(struct nand_device *nand)
+{
+	return nand->erase_size / nand->page_size;
+}
+
+int nand_skip_bad_blocks(struct nand_device *nand, uint32_t *page,
+		unsigned *skipped)
+{
+	uint32_t ppb = nand_pages_per_block(nand);
+	int block = *page / ppb;
+
+	for (; block < nand->num_blocks; block++) {
+		if (nand->blocks[block].is_bad == -1) {
+			int retval = nand_build_bbt(nand, block, block);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		if (nand->blocks[block].is_bad != 1)
+			return ERROR_OK;
+
+		LOG_INFO("skipping bad block %d", block);
+		*page = (block + 1) * ppb;
+		if (skipped)
+			(*skipped)++;
+	}
+
+	LOG_ERROR("no good blocks left on NAND device %s", nand->name);
+	return ERROR_NAND_OPERATION_FAILED;
+}
+
+/* poll the status register until one of the bits in @a ready is set */
+static int nand_bulk_wait(struct nand_device *nand, uint8_t ready, uint8_t *status)
+{
+	int timeout = 100;
+
+	if (nand->controller->nand_ready && !nand->controller->nand_ready(nand, 100))
+		return ERROR_NAND_OPERATION_TIMEOUT;
+
+	nand->controller->command(nand, NAND_CMD_STATUS);
+	for (;;) {
+		if (nand->device->options & NAND_BUSWIDTH_16) {
+			uint16_t data;
+			nand->controller->read_data(nand, &data);
+			*status = data & 0xff;
+		} else
+			nand->controller->read_data(nand, status);
+
+		if (*status & ready)
+			return ERROR_OK;
+		if (timeout-- == 0)
+			return ERROR_NAND_OPERATION_TIMEOUT;
+		alive_sleep(1);
+	}
+}
+
+/* wait for the last program command, and check how it went */
+static int nand_bulk_complete(struct nand_bulk_write *w)
+{
+	struct nand_device *nand = w->nand;
+	uint8_t status, ready, fail;
+	int retval;
+
+	if (!w->busy)
+		return ERROR_OK;
+	w->busy = false;
+
+	/* after a cache program only the cache needs to be free;
+	 * bit 1 then tells how the page before it went */
+	if (w->caching) {
+		ready = NAND_STATUS_READY;
+		fail = NAND_STATUS_FAIL_N1;
+	} else if (w->cache_used) {
+		ready = NAND_STATUS_TRUE_READY;
+		fail = NAND_STATUS_FAIL | NAND_STATUS_FAIL_N1;
+	} else {
+		ready = NAND_STATUS_READY;
+		fail = NAND_STATUS_FAIL;
+	}
+
+	retval = nand_bulk_wait(nand, ready, &status);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("timeout programming NAND page");
+		return retval;
+	}
+	if (!w->caching)
+		w->cache_used = false;
+
+	if (status & fail) {
+		LOG_WARNING("programming NAND block %" PRIu32 " failed, status: 0x%2.2x",
+			w->block_first / nand_pages_per_block(nand), status);
+		w->caching = false;
+		w->cache_used = false;
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	return ERROR_OK;
+}
+
+/* start programming one page; @a last ends a run of cache programs */
+static int nand_bulk_program(struct nand_bulk_write *w, uint32_t page,
+		uint8_t *data, uint8_t *oob, bool last)
+{
+	struct nand_device *nand = w->nand;
+	uint32_t block = page / nand_pages_per_block(nand);
+	int retval;
+
+	retval = nand_bulk_complete(w);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (nand->blocks[block].is_erased == 1)
+		nand->blocks[block].is_erased = 0;
+	if (oob)
+		nand_bbt_page_written(nand, page);
+
+	if (!w->pipelined)
+		return nand_write_page(nand, page, data, w->data_size, oob, w->oob_size);
+
+	retval = nand_page_address(nand, page, NAND_CMD_SEQIN, !data);
+	if (retval == ERROR_OK && data)
+		retval = nand_write_data_page(nand, data, w->data_size);
+	if (retval == ERROR_OK && oob)
+		retval = nand_write_data_page(nand, oob, w->oob_size);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Unable to write data to NAND device");
+		return retval;
+	}
+
+	w->caching = w->cache && !last;
+	if (w->caching)
+		w->cache_used = true;
+	nand->controller->command(nand,
+			w->caching ? NAND_CMD_CACHEDPROG : NAND_CMD_PAGEPROG);
+	w->busy = true;
+
+	return ERROR_OK;
+}
+
+/* mark the current block bad and write its pages to the next good one */
+static int nand_bulk_remap(struct nand_bulk_write *w)
+{
+	struct nand_device *nand = w->nand;
+	uint32_t ppb = nand_pages_per_block(nand);
+	uint32_t size = w->data_size + w->oob_size;
+	int retval;
+
+	do {
+		uint32_t block = w->block_first / ppb;
+		uint32_t offset = w->block_first % ppb;
+		uint32_t page = (block + 1) * ppb;
+
+		nand->blocks[block].is_bad = 1;
+		nand->blocks[block].is_retired = true;
+		nand->bbt_dirty = true;
+		w->remapped++;
+
+		retval = nand_skip_bad_blocks(nand, &page, &w->skipped);
+		if (retval != ERROR_OK)
+			return retval;
+		w->block_first = page + offset;
+		LOG_INFO("writing pages of bad block %" PRIu32 " to block %" PRIu32,
+			block, page / ppb);
+
+		for (uint32_t i = 0; i < w->buffered && retval == ERROR_OK; i++) {
+			uint8_t *p = w->buffer + i * size;
+
+			retval = nand_bulk_program(w, w->block_first + i,
+					w->data_size ? p : NULL,
+					w->oob_size ? p + w->data_size : NULL,
+					i == w->buffered - 1);
+		}
+		if (retval == ERROR_OK)
+			retval = nand_bulk_complete(w);
+	} while (retval == ERROR_NAND_OPERATION_FAILED);
+
+	w->page = w->block_first + w->buffered;
+
+	return retval;
+}
+
+int nand_bulk_write_start(struct nand_bulk_write *w, struct nand_device *nand,
+		uint32_t page, uint32_t data_size, uint32_t oob_size, bool skip_bad)
+{
+	memset(w, 0, sizeof(*w));
+
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	w->nand = nand;
+	w->page = page;
+	w->data_size = data_size;
+	w->oob_size = oob_size;
+	w->skip_bad = skip_bad;
+
+	/* drivers with their own page writes are left to do them */
+	w->pipelined = nand->use_raw || nand->controller->write_page == NULL;
+	/* the ID tables claim a cache register for every large page chip,
+	 * so only use it when asked to */
+	w->cache = w->pipelined && data_size && nand->page_size > 512
+		&& nand->use_cache_program;
+
+	if (skip_bad) {
+		w->buffer = malloc(nand_pages_per_block(nand) * (data_size + oob_size));
+		if (w->buffer == NULL) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	LOG_DEBUG("writing NAND pages%s%s%s", w->pipelined ? ", pipelined" : "",
+		w->cache ? ", cache program" : "", skip_bad ? ", skipping bad blocks" : "");
+
+	return ERROR_OK;
+}
+
+int nand_bulk_write_page(struct nand_bulk_write *w, uint8_t *data, uint8_t *oob,
+		bool last)
+{
+	struct nand_device *nand = w->nand;
+	uint32_t ppb = nand_pages_per_block(nand);
+	uint32_t size = w->data_size + w->oob_size;
+	int retval;
+
+	if (w->page % ppb == 0 || !w->started) {
+		/* the block just written must be good before leaving it */
+		retval = nand_bulk_complete(w);
+		if (retval == ERROR_NAND_OPERATION_FAILED && w->skip_bad && w->started)
+			retval = nand_bulk_remap(w);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (w->skip_bad) {
+			retval = nand_skip_bad_blocks(nand, &w->page, &w->skipped);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		w->block_first = w->page;
+		w->buffered = 0;
+		w->started = true;
+	}
+
+	if (w->page >= (uint32_t)nand->num_blocks * ppb) {
+		LOG_ERROR("write goes beyond the end of NAND device %s", nand->name);
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	if (w->skip_bad) {
+		uint8_t *p = w->buffer + w->buffered * size;
+
+		if (data)
+			memcpy(p, data, w->data_size);
+		if (oob)
+			memcpy(p + w->data_size, oob, w->oob_size);
+		w->buffered++;
+	}
+
+	retval = nand_bulk_program(w, w->page, data, oob,
+			last || (w->page + 1) % ppb == 0);
+	if (retval == ERROR_NAND_OPERATION_FAILED && w->skip_bad)
+		return nand_bulk_remap(w);
+	if (retval != ERROR_OK)
+		return retval;
+
+	w->page++;
+
+	return ERROR_OK;
+}
+
+int nand_bulk_write_finish(struct nand_bulk_write *w)
+{
+	int retval;
+
+	retval = nand_bulk_complete(w);
+	if (retval == ERROR_NAND_OPERATION_FAILED && w->skip_bad)
+		retval = nand_bulk_remap(w);
+
+	free(w->buffer);
+	w->buffer = NULL;
+
+	return retval;
+}
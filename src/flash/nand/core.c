@@ -26,6 +26,7 @@
 #endif
 
 #include "imp.h"
+#include <helper/fileio.h>
 
 /* configured NAND devices and NAND Flash command handler */
 struct nand_device *nand_devices;
@@ -41,6 +42,28 @@ void nand_device_add(struct nand_device *c)
 		nand_devices = c;
 }
 
+void nand_device_free_all(void)
+{
+	struct nand_device *nand = nand_devices;
+
+	while (nand) {
+		struct nand_device *next = nand->next;
+
+		if (nand->controller->free_driver_priv)
+			nand->controller->free_driver_priv(nand);
+		else
+			free(nand->controller_priv);
+
+		free(nand->blocks);
+		free(nand->bbt_file);
+		free((void *)nand->name);
+		free(nand);
+
+		nand = next;
+	}
+	nand_devices = NULL;
+}
+
 
 /*	Chip ID list
  *
@@ -225,35 +248,53 @@ COMMAND_HELPER(nand_command_get_device, unsigned name_index,
 	return ERROR_OK;
 }
 
-int nand_build_bbt(struct nand_device *nand, int first, int last)
+int nand_read_bad_block_marker(struct nand_device *nand, int block, int *is_bad)
 {
-	uint32_t page;
-	int i;
 	int pages_per_block = (nand->erase_size / nand->page_size);
 	uint8_t oob[6];
 	int ret;
 
+	ret = nand_read_page(nand, block * pages_per_block, NULL, 0, oob, 6);
+	if (ret != ERROR_OK)
+		return ret;
+
+	*is_bad = ((nand->device->options & NAND_BUSWIDTH_16) && ((oob[0] & oob[1]) != 0xff))
+			|| (((nand->page_size == 512) && (oob[5] != 0xff)) ||
+			((nand->page_size == 2048) && (oob[0] != 0xff)));
+
+	return ERROR_OK;
+}
+
+int nand_build_bbt(struct nand_device *nand, int first, int last)
+{
+	int i;
+	int is_bad;
+	int ret;
+
 	if ((first < 0) || (first >= nand->num_blocks))
 		first = 0;
 
 	if ((last >= nand->num_blocks) || (last == -1))
 		last = nand->num_blocks - 1;
 
-	page = first * pages_per_block;
 	for (i = first; i <= last; i++) {
-		ret = nand_read_page(nand, page, NULL, 0, oob, 6);
+		/* blocks retired after failing to erase or program may have no
+		 * marker; they stay bad */
+		if (nand->blocks[i].is_retired) {
+			LOG_WARNING("bad block: %i (retired)", i);
+			continue;
+		}
+
+		ret = nand_read_bad_block_marker(nand, i, &is_bad);
 		if (ret != ERROR_OK)
 			return ret;
 
-		if (((nand->device->options & NAND_BUSWIDTH_16) && ((oob[0] & oob[1]) != 0xff))
-				|| (((nand->page_size == 512) && (oob[5] != 0xff)) ||
-				((nand->page_size == 2048) && (oob[0] != 0xff)))) {
+		if (is_bad)
 			LOG_WARNING("bad block: %i", i);
-			nand->blocks[i].is_bad = 1;
-		} else
-			nand->blocks[i].is_bad = 0;
-
-		page += pages_per_block;
+		if (nand->blocks[i].is_bad != is_bad) {
+			nand->blocks[i].is_bad = is_bad;
+			nand->bbt_dirty = true;
+		}
 	}
 
 	return ERROR_OK;
@@ -490,6 +531,14 @@ int nand_probe(struct nand_device *nand)
 		nand->blocks[i].offset = i * nand->erase_size;
 		nand->blocks[i].is_erased = -1;
 		nand->blocks[i].is_bad = -1;
+		nand->blocks[i].is_retired = false;
+	}
+	nand->bbt_dirty = false;
+
+	/* a saved table spares scanning the whole device again */
+	if (nand->bbt_file && fileio_exist(nand->bbt_file) == FILE_EXIST) {
+		if (nand_bbt_load(nand, nand->bbt_file) != ERROR_OK)
+			LOG_WARNING("not using the bad block table in %s", nand->bbt_file);
 	}
 
 	return ERROR_OK;
@@ -510,10 +559,11 @@ int nand_erase(struct nand_device *nand, int first_block, int last_block)
 
 	/* make sure we know if a block is bad before erasing it */
 	for (i = first_block; i <= last_block; i++) {
-		if (nand->blocks[i].is_bad == -1) {
-			nand_build_bbt(nand, i, last_block);
-			break;
-		}
+		if (nand->blocks[i].is_bad != -1)
+			continue;
+		retval = nand_build_bbt(nand, i, i);
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
 	for (i = first_block; i <= last_block; i++) {
@@ -568,6 +618,12 @@ int nand_erase(struct nand_device *nand, int first_block, int last_block)
 				? "bad " : "",
 				i, status);
 			/* continue; other blocks might still be erasable */
+			if (nand->blocks[i].is_bad != 1) {
+				nand->blocks[i].is_bad = 1;
+				nand->blocks[i].is_retired = true;
+				nand->bbt_dirty = true;
+			}
+			continue;
 		}
 
 		nand->blocks[i].is_erased = 1;
@@ -686,7 +742,7 @@ int nand_read_page(struct nand_device *nand, uint32_t page,
 		return nand->controller->read_page(nand, page, data, data_size, oob, oob_size);
 }
 
-int nand_page_command(struct nand_device *nand, uint32_t page,
+int nand_page_address(struct nand_device *nand, uint32_t page,
 	uint8_t cmd, bool oob_only)
 {
 	if (!nand->device)
@@ -739,6 +795,18 @@ int nand_page_command(struct nand_device *nand, uint32_t page,
 			nand->controller->command(nand, NAND_CMD_READSTART);
 	}
 
+	return ERROR_OK;
+}
+
+int nand_page_command(struct nand_device *nand, uint32_t page,
+	uint8_t cmd, bool oob_only)
+{
+	int retval;
+
+	retval = nand_page_address(nand, page, cmd, oob_only);
+	if (ERROR_OK != retval)
+		return retval;
+
 	if (nand->controller->nand_ready) {
 		if (!nand->controller->nand_ready(nand, 100))
 			return ERROR_NAND_OPERATION_TIMEOUT;
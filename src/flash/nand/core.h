@@ -43,6 +43,10 @@ struct nand_block {
 
 	/** True if the block is bad. */
 	int is_bad;
+
+	/** True if the block was marked bad after failing to erase or
+	 * program; it need not carry a bad block marker. */
+	bool is_retired;
 };
 
 struct nand_oobfree {
@@ -69,8 +73,14 @@ struct nand_device {
 	int page_size;
 	int erase_size;
 	int use_raw;
+	/** Use the cache program command for consecutive pages. */
+	bool use_cache_program;
 	int num_blocks;
 	struct nand_block *blocks;
+	/** File the bad block table is kept in between sessions, or NULL. */
+	char *bbt_file;
+	/** The bad block table changed since it was loaded or saved. */
+	bool bbt_dirty;
 	struct nand_device *next;
 };
 
@@ -188,6 +198,8 @@ enum oob_formats {
 	NAND_OOB_SW_ECC = 0x10,	/* when writing, use SW ECC (as opposed to no ECC) */
 	NAND_OOB_HW_ECC = 0x20,	/* when writing, use HW ECC (as opposed to no ECC) */
 	NAND_OOB_SW_ECC_KW = 0x40,	/* when writing, use Marvell's Kirkwood bootrom format */
+	NAND_OOB_SW_ECC_BCH4 = 0x80,	/* when writing, use 4-bit BCH SW ECC */
+	NAND_OOB_SW_ECC_BCH8 = 0x200,	/* when writing, use 8-bit BCH SW ECC */
 	NAND_OOB_JFFS2 = 0x100,	/* when writing, use JFFS2 OOB layout */
 	NAND_OOB_YAFFS2 = 0x100,/* when writing, use YAFFS2 OOB layout */
 };
@@ -195,8 +207,14 @@ enum oob_formats {
 
 struct nand_device *get_nand_device_by_num(int num);
 
+/** Frees all NAND devices, with the resources their drivers hold. */
+void nand_device_free_all(void);
+
 int nand_page_command(struct nand_device *nand, uint32_t page,
 		      uint8_t cmd, bool oob_only);
+/** Like nand_page_command(), without waiting for the device afterwards. */
+int nand_page_address(struct nand_device *nand, uint32_t page,
+		      uint8_t cmd, bool oob_only);
 
 int nand_read_data_page(struct nand_device *nand, uint8_t *data, uint32_t size);
 int nand_write_data_page(struct nand_device *nand,
@@ -213,9 +231,19 @@ int nand_read_status(struct nand_device *nand, uint8_t *status);
 
 int nand_calculate_ecc(struct nand_device *nand,
 		       const uint8_t *dat, uint8_t *ecc_code);
+int nand_correct_data(struct nand_device *nand, u_char *dat,
+		      u_char *read_ecc, u_char *calc_ecc);
 int nand_calculate_ecc_kw(struct nand_device *nand,
 			  const uint8_t *dat, uint8_t *ecc_code);
 
+/* bytes of BCH ECC per 512-byte block for 4 and 8 bit correction */
+#define NAND_BCH_ECC_BYTES(strength)	((13 * (strength) + 7) / 8)
+
+int nand_calculate_ecc_bch(struct nand_device *nand,
+			   const uint8_t *dat, uint8_t *ecc_code, int strength);
+int nand_correct_data_bch(struct nand_device *nand, uint8_t *dat,
+			  const uint8_t *read_ecc, int strength);
+
 int nand_register_commands(struct command_context *cmd_ctx);
 
 /** helper for parsing a nand device command argument string */
@@ -777,6 +777,14 @@ fail:
 	return ERROR_NAND_OPERATION_FAILED;
 }
 
+static void davinci_free_driver_priv(struct nand_device *nand)
+{
+	struct davinci_nand *info = nand->controller_priv;
+
+	arm_nand_release(&info->io);
+	free(info);
+}
+
 struct nand_flash_controller davinci_nand_controller = {
 	.name                   = "davinci",
 	.usage                  = "chip_addr hwecc_mode aemif_addr",
@@ -792,4 +800,5 @@ struct nand_flash_controller davinci_nand_controller = {
 	.write_block_data       = davinci_write_block_data,
 	.read_block_data        = davinci_read_block_data,
 	.nand_ready             = davinci_nand_ready,
+	.free_driver_priv       = davinci_free_driver_priv,
 };
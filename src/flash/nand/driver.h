@@ -79,6 +79,13 @@ struct nand_flash_controller {
 
 	/** Check if the NAND device is ready for more instructions with timeout. */
 	int (*nand_ready)(struct nand_device *nand, int timeout);
+
+	/**
+	 * Release the controller_priv of a device going away, with any
+	 * working areas it holds.  Optional; without it, controller_priv
+	 * is just freed.
+	 */
+	void (*free_driver_priv)(struct nand_device *nand);
 };
 
 #define NAND_DEVICE_COMMAND_HANDLER(name) static __NAND_DEVICE_COMMAND(name)
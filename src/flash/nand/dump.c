@@ -0,0 +1,270 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "fileio.h"
+
+/**
+ * @file
+ * Copying NAND pages to files.
+ *
+ * Pages are read straight into a chunk buffer and each file gets one
+ * write per chunk rather than one or two per page.  Reading and writing
+ * still take turns: the file writes are batched, not overlapped with
+ * the reads.  Page data and OOB either share a file or the OOB goes to
+ * a file of its own.
+ *
+ * With a software ECC format the ECC stored in the OOB is checked, and
+ * correctable errors are fixed in the data written.  That costs far
+ * less than reading the page does, so it is done as pages arrive.
+ *
+ * A dump can be resumed: the pages the files already hold completely
+ * are not read again, and the rest is written after them.
+ */
+
+/* bytes collected before the files are written */
+#define NAND_DUMP_CHUNK		(64 * 1024)
+
+static bool nand_dump_erased(const uint8_t *buf, uint32_t size)
+{
+	for (uint32_t i = 0; i < size; i++) {
+		if (buf[i] != 0xff)
+			return false;
+	}
+	return true;
+}
+
+/* check, and where possible correct, one page against its OOB */
+static void nand_dump_check_ecc(struct nand_device *nand,
+		struct nand_fileio_state *s, uint8_t *data, const uint8_t *oob,
+		uint32_t page, struct nand_dump_result *result)
+{
+	int step, ecc_bytes;
+	const uint8_t *ecc;
+
+	if (s->oob_format & NAND_OOB_SW_ECC) {
+		step = 256;
+		ecc_bytes = 3;
+		ecc = NULL;
+	} else if (s->oob_format & NAND_OOB_SW_ECC_KW) {
+		step = 512;
+		ecc_bytes = 10;
+		ecc = oob + s->oob_size - s->page_size / 512 * ecc_bytes;
+	} else {
+		step = 512;
+		ecc_bytes = NAND_BCH_ECC_BYTES(s->ecc_strength);
+		ecc = oob + s->oob_size - s->page_size / 512 * ecc_bytes;
+	}
+
+	for (uint32_t i = 0, j = 0; i < s->page_size; i += step, j++) {
+		uint8_t stored[16], calc[16];
+		int ret;
+
+		if (ecc)
+			memcpy(stored, ecc + j * ecc_bytes, ecc_bytes);
+		else {
+			for (int k = 0; k < ecc_bytes; k++)
+				stored[k] = oob[s->eccpos[j * ecc_bytes + k]];
+		}
+
+		/* nothing was ever written here */
+		if (nand_dump_erased(stored, ecc_bytes)
+				&& nand_dump_erased(data + i, step))
+			continue;
+
+		if (s->oob_format & NAND_OOB_SW_ECC) {
+			nand_calculate_ecc(nand, data + i, calc);
+			ret = nand_correct_data(nand, data + i, stored, calc);
+		} else if (s->oob_format & NAND_OOB_SW_ECC_KW) {
+			/* no correction for this code, only detection */
+			nand_calculate_ecc_kw(nand, data + i, calc);
+			ret = memcmp(stored, calc, ecc_bytes) ? -1 : 0;
+		} else
+			ret = nand_correct_data_bch(nand, data + i, stored, s->ecc_strength);
+
+		if (ret < 0) {
+			LOG_WARNING("uncorrectable ECC error in page %" PRIu32
+				", bytes %" PRIu32 "..%" PRIu32, page, i, i + step - 1);
+			result->failed++;
+		} else
+			result->corrected += ret;
+	}
+}
+
+static int nand_dump_flush(struct fileio *fileio, uint8_t *buffer,
+		uint32_t *used, struct nand_dump_result *result)
+{
+	size_t size_written;
+	int retval;
+
+	if (*used == 0)
+		return ERROR_OK;
+
+	retval = fileio_write(fileio, *used, buffer, &size_written);
+	if (retval == ERROR_OK && size_written != *used)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (retval != ERROR_OK) {
+		LOG_ERROR("couldn't write dump file");
+		return retval;
+	}
+
+	result->bytes += *used;
+	*used = 0;
+
+	return ERROR_OK;
+}
+
+/* pages the files hold completely, from their sizes */
+static int nand_dump_resume_point(struct nand_fileio_state *s,
+		uint32_t record, uint32_t *pages)
+{
+	int size, retval;
+
+	retval = fileio_size(&s->fileio, &size);
+	if (retval != ERROR_OK)
+		return retval;
+	*pages = size / record;
+
+	if (s->oob_split) {
+		retval = fileio_size(&s->oob_fileio, &size);
+		if (retval != ERROR_OK)
+			return retval;
+		if ((uint32_t)size / s->oob_size < *pages)
+			*pages = size / s->oob_size;
+	}
+
+	retval = fileio_seek(&s->fileio, *pages * record);
+	if (retval == ERROR_OK && s->oob_split)
+		retval = fileio_seek(&s->oob_fileio, *pages * s->oob_size);
+
+	return retval;
+}
+
+int nand_dump(struct nand_device *nand, struct nand_fileio_state *s,
+		struct nand_dump_result *result)
+{
+	bool raw_oob = s->oob_format & NAND_OOB_RAW;
+	bool check_ecc = s->page && s->oob_size && (s->oob_format & (NAND_OOB_SW_ECC
+			| NAND_OOB_SW_ECC_KW | NAND_OOB_SW_ECC_BCH4 | NAND_OOB_SW_ECC_BCH8));
+	uint32_t oob_record = raw_oob ? s->oob_size : 0;
+	uint32_t record = s->page_size + (s->oob_split ? 0 : oob_record);
+	uint32_t per_chunk, data_used = 0, oob_used = 0, skip = 0;
+	uint8_t *data_buf, *oob_buf = NULL;
+	bool first = true;
+	int retval = ERROR_OK;
+
+	memset(result, 0, sizeof(*result));
+
+	if (record == 0 || (s->oob_split && s->oob_size == 0))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	per_chunk = NAND_DUMP_CHUNK / record;
+	if (per_chunk == 0)
+		per_chunk = 1;
+
+	data_buf = malloc(per_chunk * record);
+	if (s->oob_split && data_buf)
+		oob_buf = malloc(per_chunk * s->oob_size);
+	if (data_buf == NULL || (s->oob_split && oob_buf == NULL)) {
+		LOG_ERROR("Out of memory");
+		free(data_buf);
+		return ERROR_FAIL;
+	}
+
+	if (s->resume) {
+		retval = nand_dump_resume_point(s, record, &skip);
+		if (retval == ERROR_OK && skip > s->size / nand->page_size) {
+			LOG_ERROR("the dump files are larger than the dump");
+			retval = ERROR_COMMAND_SYNTAX_ERROR;
+		}
+		result->resumed = skip;
+		if (skip)
+			LOG_INFO("resuming dump after %" PRIu32 " pages", skip);
+	}
+
+	while (retval == ERROR_OK && s->size > 0) {
+		uint32_t page = s->address / nand->page_size;
+		uint8_t *data = NULL, *oob = NULL;
+
+		/* leave out the bad blocks nand write skipped */
+		if (s->skip_bad && (s->address % nand->erase_size == 0 || first)) {
+			unsigned skipped = 0;
+
+			retval = nand_skip_bad_blocks(nand, &page, &skipped);
+			if (retval != ERROR_OK)
+				break;
+			if (skip == 0)
+				result->skipped += skipped;
+			s->address = page * nand->page_size;
+		}
+		first = false;
+
+		if (skip) {
+			skip--;
+		} else {
+			if (s->page)
+				data = data_buf + data_used;
+			if (raw_oob)
+				oob = s->oob_split ? oob_buf + oob_used
+					: data_buf + data_used + s->page_size;
+			else if (check_ecc)
+				oob = s->oob;
+
+			retval = nand_read_page(nand, page, data, s->page_size,
+					oob, oob ? s->oob_size : 0);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("reading NAND flash page %" PRIu32 " failed", page);
+				break;
+			}
+			result->pages++;
+
+			if (check_ecc)
+				nand_dump_check_ecc(nand, s, data, oob, page, result);
+
+			data_used += record;
+			if (s->oob_split)
+				oob_used += s->oob_size;
+
+			if (data_used == per_chunk * record) {
+				retval = nand_dump_flush(&s->fileio, data_buf, &data_used, result);
+				if (retval == ERROR_OK && s->oob_split)
+					retval = nand_dump_flush(&s->oob_fileio, oob_buf,
+							&oob_used, result);
+				keep_alive();
+			}
+		}
+
+		s->size -= nand->page_size;
+		s->address += nand->page_size;
+	}
+
+	/* keep what was read, so the dump can be resumed */
+	if (nand_dump_flush(&s->fileio, data_buf, &data_used, result) != ERROR_OK
+			&& retval == ERROR_OK)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (s->oob_split && nand_dump_flush(&s->oob_fileio, oob_buf,
+			&oob_used, result) != ERROR_OK && retval == ERROR_OK)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+
+	free(data_buf);
+	free(oob_buf);
+
+	return retval;
+}
@@ -0,0 +1,342 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "core.h"
+
+/*****************************************************************************
+ * Binary BCH codes over GF(2^13) for 512-byte blocks, correcting 4 or 8 bit
+ * errors with 52 or 104 bits (7 or 13 bytes) of ECC.
+ *
+ * The data is taken as a polynomial over GF(2), the most significant bit of
+ * the first byte being the highest coefficient, and the ECC is the remainder
+ * of that polynomial times x^(13 * t) divided by the generator polynomial,
+ * stored most significant bit first.  The ECC is XORed with that of an
+ * erased block and inverted, so an erased page has an erased (all 0xff) ECC
+ * and reads back without errors.
+ *
+ * Encoding runs a byte at a time through a table of remainders.  Decoding
+ * takes the syndromes from the difference of the computed and stored
+ * remainders, finds the error locator polynomial with Berlekamp-Massey and
+ * its roots by trying every bit position of the block.
+ */
+#define BCH_M		13
+#define BCH_N		((1 << BCH_M) - 1)
+#define BCH_POLY	0x201b		/* x^13 + x^4 + x^3 + x + 1 */
+#define BCH_DATA_BITS	(512 * 8)
+#define BCH_MAX_T	8
+#define BCH_WORDS	4		/* 32-bit words holding a remainder */
+
+struct nand_bch_code {
+	int t;
+	int ecc_bits;
+	bool initialized;
+	/** remainders of each byte value, left aligned in BCH_WORDS words */
+	uint32_t table[256][BCH_WORDS];
+	/** what the remainder is XORed with before it is stored */
+	uint32_t mask[BCH_WORDS];
+};
+
+static uint16_t bch_exp[2 * BCH_N];
+static uint16_t bch_log[BCH_N + 1];
+static struct nand_bch_code bch_codes[2] = { { .t = 4 }, { .t = 8 } };
+
+static void bch_build_log_exp_table(void)
+{
+	int i, p_i = 1;
+
+	for (i = 0; i < BCH_N; i++) {
+		bch_exp[i] = p_i;
+		bch_exp[i + BCH_N] = p_i;
+		bch_log[p_i] = i;
+		p_i <<= 1;
+		if (p_i & (1 << BCH_M))
+			p_i ^= BCH_POLY;
+	}
+}
+
+static inline uint16_t bch_mul(uint16_t a, uint16_t b)
+{
+	if (a == 0 || b == 0)
+		return 0;
+	return bch_exp[bch_log[a] + bch_log[b]];
+}
+
+static inline uint16_t bch_div(uint16_t a, uint16_t b)
+{
+	if (a == 0)
+		return 0;
+	return bch_exp[bch_log[a] + BCH_N - bch_log[b]];
+}
+
+/* r = r * x^8, dropping what falls off the left */
+static inline void bch_shift8(uint32_t *r)
+{
+	for (int i = 0; i < BCH_WORDS - 1; i++)
+		r[i] = (r[i] << 8) | (r[i + 1] >> 24);
+	r[BCH_WORDS - 1] <<= 8;
+}
+
+static inline int bch_test_bit(const uint32_t *r, int bit)
+{
+	return (r[bit / 32] >> (31 - bit % 32)) & 1;
+}
+
+/* remainders of a block, left aligned */
+static void bch_remainder(const struct nand_bch_code *code,
+		const uint8_t *data, uint32_t *r)
+{
+	memset(r, 0, BCH_WORDS * sizeof(*r));
+	for (int i = 0; i < BCH_DATA_BITS / 8; i++) {
+		const uint32_t *t = code->table[(r[0] >> 24) ^ data[i]];
+
+		bch_shift8(r);
+		for (int j = 0; j < BCH_WORDS; j++)
+			r[j] ^= t[j];
+	}
+}
+
+static void bch_init_code(struct nand_bch_code *code)
+{
+	uint16_t g[BCH_MAX_T * BCH_M + 1];
+	uint32_t gen[BCH_WORDS];
+	bool root[BCH_N];
+	uint8_t erased[BCH_DATA_BITS / 8];
+	int deg = 0;
+
+	if (bch_exp[0] == 0)
+		bch_build_log_exp_table();
+
+	/* roots a^1 .. a^2t and their conjugates */
+	memset(root, 0, sizeof(root));
+	for (int i = 1; i <= 2 * code->t; i++) {
+		for (int e = i; !root[e]; e = (2 * e) % BCH_N)
+			root[e] = true;
+	}
+
+	/* g(x) = product of (x - a^e) over the roots; coefficients end up 0/1 */
+	g[0] = 1;
+	for (int e = 1; e < BCH_N; e++) {
+		if (!root[e])
+			continue;
+		g[deg + 1] = 0;
+		for (int i = deg + 1; i > 0; i--)
+			g[i] = g[i - 1] ^ bch_mul(g[i], bch_exp[e]);
+		g[0] = bch_mul(g[0], bch_exp[e]);
+		deg++;
+	}
+	code->ecc_bits = deg;
+
+	/* g without its x^deg term, left aligned: coefficient of x^(deg-1) first */
+	memset(gen, 0, sizeof(gen));
+	for (int i = 0; i < deg; i++) {
+		if (g[deg - 1 - i])
+			gen[i / 32] |= 1u << (31 - i % 32);
+	}
+
+	for (int b = 0; b < 256; b++) {
+		uint32_t *r = code->table[b];
+
+		memset(r, 0, BCH_WORDS * sizeof(*r));
+		for (int bit = 7; bit >= 0; bit--) {
+			int feedback = ((b >> bit) & 1) ^ (r[0] >> 31);
+
+			for (int j = 0; j < BCH_WORDS - 1; j++)
+				r[j] = (r[j] << 1) | (r[j + 1] >> 31);
+			r[BCH_WORDS - 1] <<= 1;
+			if (feedback) {
+				for (int j = 0; j < BCH_WORDS; j++)
+					r[j] ^= gen[j];
+			}
+		}
+	}
+
+	/* mask = remainder of an erased block, inverted */
+	memset(erased, 0xff, sizeof(erased));
+	bch_remainder(code, erased, code->mask);
+	for (int i = 0; i < deg; i++)
+		code->mask[i / 32] ^= 1u << (31 - i % 32);
+
+	code->initialized = true;
+}
+
+static struct nand_bch_code *bch_get_code(int strength)
+{
+	struct nand_bch_code *code;
+
+	if (strength == 4)
+		code = &bch_codes[0];
+	else if (strength == 8)
+		code = &bch_codes[1];
+	else
+		return NULL;
+
+	if (!code->initialized)
+		bch_init_code(code);
+	return code;
+}
+
+/*
+ * nand_calculate_ecc_bch - Calculate 7 or 13 bytes of ECC for a 512-byte block
+ */
+int nand_calculate_ecc_bch(struct nand_device *nand, const uint8_t *dat,
+		uint8_t *ecc_code, int strength)
+{
+	struct nand_bch_code *code = bch_get_code(strength);
+	uint32_t r[BCH_WORDS];
+	int bytes;
+
+	if (code == NULL)
+		return -1;
+
+	bch_remainder(code, dat, r);
+
+	bytes = NAND_BCH_ECC_BYTES(strength);
+	for (int i = 0; i < bytes; i++)
+		ecc_code[i] = (r[i / 4] ^ code->mask[i / 4]) >> (24 - 8 * (i % 4));
+	/* bits past the remainder stay erased */
+	ecc_code[bytes - 1] |= 0xff >> (code->ecc_bits % 8 ? code->ecc_bits % 8 : 8);
+
+	return 0;
+}
+
+/*
+ * Berlekamp-Massey: the error locator polynomial for syndromes s[1..2t],
+ * into lambda[0..t].  Returns its degree.
+ */
+static int bch_locator(int t, const uint16_t *s, uint16_t *lambda)
+{
+	uint16_t b[BCH_MAX_T + 2], tmp[BCH_MAX_T + 2];
+	uint16_t bd = 1;
+	int l = 0, m = 1;
+
+	memset(lambda, 0, (t + 1) * sizeof(*lambda));
+	memset(b, 0, sizeof(b));
+	lambda[0] = 1;
+	b[0] = 1;
+
+	for (int n = 0; n < 2 * t; n++) {
+		uint16_t d = s[n + 1];
+
+		for (int i = 1; i <= l; i++)
+			d ^= bch_mul(lambda[i], s[n + 1 - i]);
+
+		if (d == 0) {
+			m++;
+			continue;
+		}
+
+		uint16_t coef = bch_div(d, bd);
+
+		memcpy(tmp, lambda, (t + 1) * sizeof(*lambda));
+		for (int i = 0; i + m <= t; i++)
+			lambda[i + m] ^= bch_mul(coef, b[i]);
+
+		if (2 * l <= n) {
+			l = n + 1 - l;
+			memcpy(b, tmp, (t + 1) * sizeof(*tmp));
+			bd = d;
+			m = 1;
+		} else
+			m++;
+	}
+
+	return l;
+}
+
+/**
+ * nand_correct_data_bch - Detect and correct up to 4 or 8 bit errors in
+ * a 512-byte block
+ *
+ * @returns the number of bits corrected, or -1 if there are too many errors.
+ */
+int nand_correct_data_bch(struct nand_device *nand, uint8_t *dat,
+		const uint8_t *read_ecc, int strength)
+{
+	struct nand_bch_code *code = bch_get_code(strength);
+	uint32_t r[BCH_WORDS];
+	uint16_t s[2 * BCH_MAX_T + 1], lambda[BCH_MAX_T + 1];
+	int pos[BCH_MAX_T];
+	int bytes, nerr, found = 0;
+	bool dirty = false;
+
+	if (code == NULL)
+		return -1;
+
+	/* difference of computed and stored remainders */
+	bch_remainder(code, dat, r);
+	bytes = NAND_BCH_ECC_BYTES(strength);
+	for (int i = 0; i < bytes; i++) {
+		int shift = 24 - 8 * (i % 4);
+		uint8_t stored = read_ecc[i] ^ (uint8_t)(code->mask[i / 4] >> shift);
+
+		r[i / 4] ^= (uint32_t)stored << shift;
+	}
+	for (int i = code->ecc_bits; i < 32 * BCH_WORDS; i++)
+		r[i / 32] &= ~(1u << (31 - i % 32));
+	for (int i = 0; i < BCH_WORDS; i++)
+		dirty |= r[i] != 0;
+	if (!dirty)
+		return 0;
+
+	/* s[j] = r(a^j); bit i of the aligned remainder is x^(ecc_bits - 1 - i) */
+	memset(s, 0, sizeof(s));
+	for (int i = 0; i < code->ecc_bits; i++) {
+		int power = code->ecc_bits - 1 - i;
+
+		if (!bch_test_bit(r, i))
+			continue;
+		for (int j = 1; j <= 2 * code->t; j++)
+			s[j] ^= bch_exp[(j * power) % BCH_N];
+	}
+
+	nerr = bch_locator(code->t, s, lambda);
+	if (nerr > code->t)
+		return -1;
+
+	/* an error at x^p makes lambda(a^-p) zero */
+	for (int p = 0; p < code->ecc_bits + BCH_DATA_BITS && found < nerr; p++) {
+		uint16_t sum = lambda[0];
+		int inv = (BCH_N - p) % BCH_N;
+
+		for (int i = 1; i <= nerr; i++) {
+			if (lambda[i])
+				sum ^= bch_exp[bch_log[lambda[i]] + (inv * i) % BCH_N];
+		}
+		if (sum == 0)
+			pos[found++] = p;
+	}
+
+	/* fewer roots than the degree: more errors than can be located */
+	if (found != nerr)
+		return -1;
+
+	for (int i = 0; i < found; i++) {
+		int bit;
+
+		/* errors in the ECC bytes need no correction of the data */
+		if (pos[i] < code->ecc_bits)
+			continue;
+		bit = BCH_DATA_BITS - 1 - (pos[i] - code->ecc_bits);
+		dat[bit / 8] ^= 0x80 >> (bit % 8);
+	}
+
+	return nerr;
+}
@@ -44,6 +44,13 @@ static uint16_t gf_exp[1023 + 1023];
  */
 static uint16_t gf_log[1024];
 
+/*
+ * Row a holds the eight products of a with the generator polynomial
+ * coefficients, in the order they're folded into r7..r0 below.  Row 0
+ * is all zero, so the encoder needs no test for a zero feedback symbol.
+ */
+static uint16_t gf_gen_mul[1024][8];
+
 static void gf_build_log_exp_table(void)
 {
 	int i;
@@ -68,6 +75,19 @@ static void gf_build_log_exp_table(void)
 		if (p_i & (1 << 10))
 			p_i ^= MODPOLY;
 	}
+
+	for (i = 1; i < 1024; i++) {
+		uint16_t *t = gf_exp + gf_log[i];
+
+		gf_gen_mul[i][0] = t[0x21c];
+		gf_gen_mul[i][1] = t[0x181];
+		gf_gen_mul[i][2] = t[0x18e];
+		gf_gen_mul[i][3] = t[0x25f];
+		gf_gen_mul[i][4] = t[0x197];
+		gf_gen_mul[i][5] = t[0x193];
+		gf_gen_mul[i][6] = t[0x237];
+		gf_gen_mul[i][7] = t[0x024];
+	}
 }
 
 
@@ -98,6 +118,21 @@ static void gf_build_log_exp_table(void)
  * expects the ECC to be computed backward, i.e. from the last byte down
  * to the first one.
  */
+
+/* shift d into r0 and reduce by the generator polynomial */
+#define RS_STEP(d) \
+	do { \
+		const uint16_t *t = gf_gen_mul[r7]; \
+		r7 = r6 ^ t[0]; \
+		r6 = r5 ^ t[1]; \
+		r5 = r4 ^ t[2]; \
+		r4 = r3 ^ t[3]; \
+		r3 = r2 ^ t[4]; \
+		r2 = r1 ^ t[5]; \
+		r1 = r0 ^ t[6]; \
+		r0 = (d) ^ t[7]; \
+	} while (0)
+
 int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t *ecc)
 {
 	unsigned int r7, r6, r5, r4, r3, r2, r1, r0;
@@ -126,35 +161,10 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 	 * by eight zero bytes, while reducing the polynomial by the
 	 * generator polynomial in every step.
 	 */
-	for (i = 503; i >= -8; i--) {
-		unsigned int d;
-
-		d = 0;
-		if (i >= 0)
-			d = data[i];
-
-		if (r7) {
-			uint16_t *t = gf_exp + gf_log[r7];
-
-			r7 = r6 ^ t[0x21c];
-			r6 = r5 ^ t[0x181];
-			r5 = r4 ^ t[0x18e];
-			r4 = r3 ^ t[0x25f];
-			r3 = r2 ^ t[0x197];
-			r2 = r1 ^ t[0x193];
-			r1 = r0 ^ t[0x237];
-			r0 = d  ^ t[0x024];
-		} else {
-			r7 = r6;
-			r6 = r5;
-			r5 = r4;
-			r4 = r3;
-			r3 = r2;
-			r2 = r1;
-			r1 = r0;
-			r0 = d;
-		}
-	}
+	for (i = 503; i >= 0; i--)
+		RS_STEP(data[i]);
+	for (i = 0; i < 8; i++)
+		RS_STEP(0);
 
 	ecc[0] = r0;
 	ecc[1] = (r0 >> 8) | (r1 << 2);
@@ -0,0 +1,230 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <helper/time_support.h>
+
+/**
+ * @file
+ * Known answer checks and speed measurement of the software ECC codes.
+ *
+ * Each code is run over a few fixed blocks and the result compared
+ * with the ECC the original byte-at-a-time implementations computed;
+ * the correcting codes then get blocks with injected bit errors to
+ * repair.  Finally each encoder is timed over a buffer of random data.
+ */
+
+#define ECC_KAT_PATTERNS	4
+
+/* ECC of the patterns made by ecc_kat_pattern() */
+static const uint8_t ecc_kat_hamming[ECC_KAT_PATTERNS][3] = {
+	{ 0xff, 0xff, 0xff },
+	{ 0x99, 0x66, 0x6b },
+	{ 0xc3, 0xff, 0x03 },
+	{ 0x6a, 0x69, 0x9b },
+};
+
+static const uint8_t ecc_kat_kw[ECC_KAT_PATTERNS][10] = {
+	{ 0x3f, 0x27, 0x56, 0xf5, 0x29, 0xd8, 0x61, 0xd9, 0x9d, 0x14 },
+	{ 0x79, 0x5d, 0x80, 0x6b, 0x5e, 0x74, 0x93, 0x76, 0xab, 0x15 },
+	{ 0xa6, 0x0c, 0x76, 0x7b, 0xa8, 0xa1, 0x95, 0x76, 0x20, 0x2b },
+	{ 0x41, 0x02, 0xf4, 0xcd, 0xfa, 0xb9, 0x98, 0x53, 0xd4, 0x8a },
+};
+
+static const uint8_t ecc_kat_bch4[ECC_KAT_PATTERNS][7] = {
+	{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	{ 0x3e, 0x68, 0xa9, 0x20, 0xe8, 0x69, 0xef },
+	{ 0x70, 0xcf, 0x0b, 0xa9, 0xa1, 0x18, 0xcf },
+	{ 0xff, 0x1c, 0x15, 0xe9, 0xba, 0x30, 0x8f },
+};
+
+static const uint8_t ecc_kat_bch8[ECC_KAT_PATTERNS][13] = {
+	{ 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	{ 0x9f, 0xbd, 0x44, 0x24, 0x54, 0x0d, 0x28, 0x8d, 0xbf, 0x16, 0x1a, 0x76, 0x60 },
+	{ 0xe6, 0xec, 0x8c, 0x77, 0x77, 0xdc, 0x31, 0x61, 0xb9, 0xef, 0xa0, 0xa3, 0xec },
+	{ 0x16, 0x55, 0x7a, 0xa6, 0x4f, 0x02, 0x6a, 0x38, 0xd8, 0x36, 0xc4, 0xcb, 0xf9 },
+};
+
+static uint32_t ecc_random(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+/* erased, a single set bit, and two pseudo random blocks */
+static void ecc_kat_pattern(uint8_t *buf, unsigned len, unsigned kind)
+{
+	uint32_t seed = kind == 2 ? 1 : 0x12345678;
+
+	for (unsigned i = 0; i < len; i++) {
+		if (kind == 0)
+			buf[i] = 0xff;
+		else if (kind == 1)
+			buf[i] = i == 0x5a ? 0x10 : 0x00;
+		else
+			buf[i] = ecc_random(&seed);
+	}
+}
+
+static int ecc_kat_check(struct command_context *cmd_ctx, const char *name,
+		unsigned kind, const uint8_t *ecc, const uint8_t *expected, unsigned size)
+{
+	if (memcmp(ecc, expected, size) == 0)
+		return ERROR_OK;
+
+	command_print(cmd_ctx, "%s: wrong ECC for pattern %u", name, kind);
+	return ERROR_FAIL;
+}
+
+static int ecc_check_known_answers(struct command_context *cmd_ctx)
+{
+	uint8_t block[512], ecc[16];
+	int retval = ERROR_OK;
+
+	for (unsigned kind = 0; kind < ECC_KAT_PATTERNS; kind++) {
+		ecc_kat_pattern(block, 256, kind);
+		nand_calculate_ecc(NULL, block, ecc);
+		if (ecc_kat_check(cmd_ctx, "hamming", kind, ecc,
+				ecc_kat_hamming[kind], 3) != ERROR_OK)
+			retval = ERROR_FAIL;
+
+		ecc_kat_pattern(block, 512, kind);
+		nand_calculate_ecc_kw(NULL, block, ecc);
+		if (ecc_kat_check(cmd_ctx, "kw", kind, ecc,
+				ecc_kat_kw[kind], 10) != ERROR_OK)
+			retval = ERROR_FAIL;
+
+		nand_calculate_ecc_bch(NULL, block, ecc, 4);
+		if (ecc_kat_check(cmd_ctx, "bch4", kind, ecc,
+				ecc_kat_bch4[kind], NAND_BCH_ECC_BYTES(4)) != ERROR_OK)
+			retval = ERROR_FAIL;
+
+		nand_calculate_ecc_bch(NULL, block, ecc, 8);
+		if (ecc_kat_check(cmd_ctx, "bch8", kind, ecc,
+				ecc_kat_bch8[kind], NAND_BCH_ECC_BYTES(8)) != ERROR_OK)
+			retval = ERROR_FAIL;
+	}
+
+	return retval;
+}
+
+/* flip bits in random blocks and have them corrected */
+static int ecc_check_corrections(struct command_context *cmd_ctx, unsigned rounds)
+{
+	uint8_t block[512], orig[512], ecc[16], calc[16];
+	uint32_t seed = 42;
+	unsigned failed = 0;
+
+	for (unsigned n = 0; n < rounds; n++) {
+		unsigned bit;
+
+		for (unsigned i = 0; i < sizeof(block); i++)
+			orig[i] = block[i] = ecc_random(&seed);
+
+		nand_calculate_ecc(NULL, block, ecc);
+		bit = ecc_random(&seed) % (256 * 8);
+		block[bit / 8] ^= 1 << (bit % 8);
+		nand_calculate_ecc(NULL, block, calc);
+		if (nand_correct_data(NULL, block, ecc, calc) != 1
+				|| memcmp(block, orig, 256) != 0)
+			failed++;
+
+		for (int strength = 4; strength <= 8; strength += 4) {
+			int errors = 1 + n % strength;
+
+			memcpy(block, orig, sizeof(block));
+			nand_calculate_ecc_bch(NULL, block, ecc, strength);
+
+			/* distinct bits, one in each stretch of the block */
+			for (int e = 0; e < errors; e++) {
+				bit = (e * 4096 / errors + ecc_random(&seed) % (4096 / errors)) % 4096;
+				block[bit / 8] ^= 0x80 >> (bit % 8);
+			}
+
+			if (nand_correct_data_bch(NULL, block, ecc, strength) != errors
+					|| memcmp(block, orig, sizeof(block)) != 0)
+				failed++;
+		}
+	}
+
+	if (failed) {
+		command_print(cmd_ctx, "%u of %u corrections failed", failed, 3 * rounds);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static void ecc_benchmark(struct command_context *cmd_ctx, const char *name,
+		const uint8_t *buffer, size_t size, unsigned block, int strength)
+{
+	struct duration bench;
+	uint8_t ecc[16];
+
+	duration_start(&bench);
+	for (size_t i = 0; i + block <= size; i += block) {
+		if (strength == 0)
+			nand_calculate_ecc(NULL, buffer + i, ecc);
+		else if (strength < 0)
+			nand_calculate_ecc_kw(NULL, buffer + i, ecc);
+		else
+			nand_calculate_ecc_bch(NULL, buffer + i, ecc, strength);
+	}
+
+	if (duration_measure(&bench) == ERROR_OK)
+		command_print(cmd_ctx, "%-8s %zu KiB in %fs (%0.3f KiB/s)", name,
+			size / 1024, duration_elapsed(&bench), duration_kbps(&bench, size));
+}
+
+int nand_ecc_selftest(struct command_context *cmd_ctx, unsigned kib)
+{
+	size_t size = (size_t)kib * 1024;
+	uint8_t *buffer;
+	uint32_t seed = 7;
+	int retval;
+
+	retval = ecc_check_known_answers(cmd_ctx);
+	if (retval == ERROR_OK)
+		retval = ecc_check_corrections(cmd_ctx, 256);
+	if (retval != ERROR_OK)
+		return retval;
+	command_print(cmd_ctx, "software ECC known answers and corrections ok");
+
+	if (size == 0)
+		return ERROR_OK;
+
+	buffer = malloc(size);
+	if (buffer == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (size_t i = 0; i < size; i++)
+		buffer[i] = ecc_random(&seed);
+
+	ecc_benchmark(cmd_ctx, "hamming", buffer, size, 256, 0);
+	ecc_benchmark(cmd_ctx, "kw", buffer, size, 512, -1);
+	ecc_benchmark(cmd_ctx, "bch4", buffer, size, 512, 4);
+	ecc_benchmark(cmd_ctx, "bch8", buffer, size, 512, 8);
+
+	free(buffer);
+
+	return ERROR_OK;
+}
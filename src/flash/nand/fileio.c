@@ -68,7 +68,13 @@ int nand_fileio_start(struct command_context *cmd_ctx,
 	duration_start(&state->bench);
 
 	if (NULL != filename) {
-		int retval = fileio_open(&state->fileio, filename, filemode, FILEIO_BINARY);
+		int mode = filemode;
+
+		/* a dump being resumed keeps what the file holds */
+		if (state->resume && fileio_exist(filename) == FILE_EXIST)
+			mode = FILEIO_UPDATE;
+
+		int retval = fileio_open(&state->fileio, filename, mode, FILEIO_BINARY);
 		if (ERROR_OK != retval) {
 			const char *msg = (FILEIO_READ == filemode) ? "read" : "write";
 			command_print(cmd_ctx, "failed to open '%s' for %s access",
@@ -78,12 +84,37 @@ int nand_fileio_start(struct command_context *cmd_ctx,
 		state->file_opened = true;
 	}
 
+	if (NULL != filename && state->oob_split) {
+		char *oob_filename = alloc_printf("%s.oob", filename);
+		int mode = filemode;
+		int retval;
+
+		if (oob_filename == NULL) {
+			nand_fileio_cleanup(state);
+			return ERROR_FAIL;
+		}
+		if (state->resume && fileio_exist(oob_filename) == FILE_EXIST)
+			mode = FILEIO_UPDATE;
+
+		retval = fileio_open(&state->oob_fileio, oob_filename, mode, FILEIO_BINARY);
+		if (ERROR_OK != retval) {
+			command_print(cmd_ctx, "failed to open '%s' for write access",
+				oob_filename);
+			free(oob_filename);
+			nand_fileio_cleanup(state);
+			return retval;
+		}
+		free(oob_filename);
+		state->oob_file_opened = true;
+	}
+
 	if (!(state->oob_format & NAND_OOB_ONLY)) {
 		state->page_size = nand->page_size;
 		state->page = malloc(nand->page_size);
 	}
 
-	if (state->oob_format & (NAND_OOB_RAW | NAND_OOB_SW_ECC | NAND_OOB_SW_ECC_KW)) {
+	if (state->oob_format & (NAND_OOB_RAW | NAND_OOB_SW_ECC | NAND_OOB_SW_ECC_KW
+			| NAND_OOB_SW_ECC_BCH4 | NAND_OOB_SW_ECC_BCH8)) {
 		if (nand->page_size == 512) {
 			state->oob_size = 16;
 			state->eccpos = nand_oob_16.eccpos;
@@ -94,12 +125,33 @@ int nand_fileio_start(struct command_context *cmd_ctx,
 		state->oob = malloc(state->oob_size);
 	}
 
+	if (state->oob_format & (NAND_OOB_SW_ECC_BCH4 | NAND_OOB_SW_ECC_BCH8)) {
+		int strength = (state->oob_format & NAND_OOB_SW_ECC_BCH8) ? 8 : 4;
+		uint32_t ecc_size = nand->page_size / 512 * NAND_BCH_ECC_BYTES(strength);
+
+		/* leave the bad block marker alone */
+		if (state->oob_size < ecc_size
+				|| state->oob_size - ecc_size < (nand->page_size == 512 ? 6 : 2)) {
+			command_print(cmd_ctx, "%d-bit BCH ECC doesn't fit in the OOB area",
+				strength);
+			nand_fileio_cleanup(state);
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+		state->ecc_strength = strength;
+	}
+
 	return ERROR_OK;
 }
 int nand_fileio_cleanup(struct nand_fileio_state *state)
 {
-	if (state->file_opened)
+	if (state->file_opened) {
 		fileio_close(&state->fileio);
+		state->file_opened = false;
+	}
+	if (state->oob_file_opened) {
+		fileio_close(&state->oob_fileio);
+		state->oob_file_opened = false;
+	}
 
 	if (state->oob) {
 		free(state->oob);
@@ -156,12 +208,27 @@ COMMAND_HELPER(nand_fileio_parse_args, struct nand_fileio_state *state,
 				state->oob_format |= NAND_OOB_SW_ECC;
 			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc_kw"))
 				state->oob_format |= NAND_OOB_SW_ECC_KW;
+			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc_bch4"))
+				state->oob_format |= NAND_OOB_SW_ECC_BCH4;
+			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc_bch8"))
+				state->oob_format |= NAND_OOB_SW_ECC_BCH8;
+			else if (sw_ecc && !strcmp(CMD_ARGV[i], "skip_bad"))
+				state->skip_bad = true;
+			else if (filemode == FILEIO_WRITE && !strcmp(CMD_ARGV[i], "oob_split")) {
+				state->oob_format |= NAND_OOB_RAW;
+				state->oob_split = true;
+			} else if (filemode == FILEIO_WRITE && !strcmp(CMD_ARGV[i], "resume"))
+				state->resume = true;
 			else {
 				command_print(CMD_CTX, "unknown option: %s", CMD_ARGV[i]);
 				return ERROR_COMMAND_SYNTAX_ERROR;
 			}
 		}
 	}
+	if (state->oob_split && (state->oob_format & NAND_OOB_ONLY)) {
+		command_print(CMD_CTX, "oob_split needs page data as well");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
 
 	retval = nand_fileio_start(CMD_CTX, nand, CMD_ARGV[1], filemode, state);
 	if (ERROR_OK != retval)
@@ -218,6 +285,15 @@ int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s)
 			nand_calculate_ecc_kw(nand, s->page + i, ecc);
 			ecc += 10;
 		}
+	} else if (s->oob_format & (NAND_OOB_SW_ECC_BCH4 | NAND_OOB_SW_ECC_BCH8)) {
+		/* stored like the Kirkwood ECC, at the end of the OOB area */
+		int ecc_bytes = NAND_BCH_ECC_BYTES(s->ecc_strength);
+		uint8_t *ecc = s->oob + s->oob_size - s->page_size / 512 * ecc_bytes;
+		memset(s->oob, 0xff, s->oob_size);
+		for (uint32_t i = 0; i < s->page_size; i += 512) {
+			nand_calculate_ecc_bch(nand, s->page + i, ecc, s->ecc_strength);
+			ecc += ecc_bytes;
+		}
 	} else if (NULL != s->oob)   {
 		fileio_read(&s->fileio, s->oob_size, s->oob, &one_read);
 		if (one_read < s->oob_size)
@@ -35,9 +35,15 @@ struct nand_fileio_state {
 	uint32_t oob_size;
 
 	const int *eccpos;
+	int ecc_strength;	/**< bits corrected by the BCH SW ECC */
+	bool skip_bad;		/**< leave out bad blocks */
+	bool oob_split;		/**< OOB goes to a file of its own */
+	bool resume;		/**< continue a dump the files already hold part of */
 
 	bool file_opened;
 	struct fileio fileio;
+	bool oob_file_opened;
+	struct fileio oob_fileio;
 
 	struct duration bench;
 };
@@ -55,4 +61,17 @@ COMMAND_HELPER(nand_fileio_parse_args, struct nand_fileio_state *state,
 
 int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s);
 
+/** What nand_dump() did. */
+struct nand_dump_result {
+	uint32_t resumed;	/**< pages found in the files already */
+	uint32_t pages;		/**< pages read */
+	uint32_t bytes;		/**< bytes added to the files */
+	unsigned corrected;	/**< bits corrected by the software ECC */
+	unsigned failed;	/**< ECC blocks with errors that couldn't be corrected */
+	unsigned skipped;	/**< bad blocks left out */
+};
+
+int nand_dump(struct nand_device *nand, struct nand_fileio_state *s,
+		struct nand_dump_result *result);
+
 #endif	/* FLASH_NAND_FILEIO_H */
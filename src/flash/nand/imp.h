@@ -36,5 +36,54 @@ int nand_read_page(struct nand_device *nand, uint32_t page,
 int nand_probe(struct nand_device *nand);
 int nand_erase(struct nand_device *nand, int first_block, int last_block);
 int nand_build_bbt(struct nand_device *nand, int first, int last);
+/** Reads the factory bad block marker of @a block into @a is_bad. */
+int nand_read_bad_block_marker(struct nand_device *nand, int block, int *is_bad);
+
+/**
+ * Bad block tables saved on the host, see bbt.c.  nand_bbt_sync() saves
+ * the table to the file configured with "nand bbt file" if it changed.
+ */
+int nand_bbt_save(struct nand_device *nand, const char *filename);
+int nand_bbt_load(struct nand_device *nand, const char *filename);
+int nand_bbt_sync(struct nand_device *nand);
+/** Forgets the state of a block whose marker page got OOB data. */
+void nand_bbt_page_written(struct nand_device *nand, uint32_t page);
+
+int nand_ecc_selftest(struct command_context *cmd_ctx, unsigned kib);
+
+/**
+ * Moves @a page past any bad blocks, to the start of the next good block,
+ * checking blocks whose state isn't known yet.  @a skipped, if not NULL,
+ * is incremented for each block skipped.
+ */
+int nand_skip_bad_blocks(struct nand_device *nand, uint32_t *page,
+		unsigned *skipped);
+
+/** State of a write of consecutive NAND pages, see bulk.c. */
+struct nand_bulk_write {
+	struct nand_device *nand;
+	uint32_t page;		/**< next page to write */
+	uint32_t data_size;	/**< bytes of data per page, 0 for OOB only */
+	uint32_t oob_size;	/**< bytes of OOB per page, 0 for none */
+	bool skip_bad;
+	bool pipelined;		/**< programs overlap with preparing the next page */
+	bool cache;		/**< the device has a cache register to use */
+	bool caching;		/**< the last program was a cache program */
+	bool cache_used;	/**< cache programs are still in flight */
+	bool busy;		/**< a program hasn't been waited for yet */
+	bool started;
+	uint32_t block_first;	/**< first page written to the current block */
+	uint32_t buffered;	/**< pages written to the current block */
+	uint8_t *buffer;	/**< their data and OOB, if skipping bad blocks */
+	unsigned skipped;	/**< bad blocks skipped */
+	unsigned remapped;	/**< blocks that failed to program */
+};
+
+int nand_bulk_write_start(struct nand_bulk_write *w, struct nand_device *nand,
+		uint32_t page, uint32_t data_size, uint32_t oob_size, bool skip_bad);
+/** Writes the next page; @a last tells there are no more to come. */
+int nand_bulk_write_page(struct nand_bulk_write *w, uint8_t *data, uint8_t *oob,
+		bool last);
+int nand_bulk_write_finish(struct nand_bulk_write *w);
 
 #endif	/* FLASH_NAND_IMP_H */
@@ -62,6 +62,10 @@ NAND_DEVICE_COMMAND_HANDLER(lpc3180_nand_device_command)
 	lpc3180_info->sw_wp_lower_bound = 0x0;
 	lpc3180_info->sw_wp_upper_bound = 0x0;
 
+	memset(&lpc3180_info->io, 0, sizeof(lpc3180_info->io));
+	lpc3180_info->io.target = nand->target;
+	lpc3180_info->io.op = ARM_NAND_NONE;
+
 	return ERROR_OK;
 }
 
@@ -422,6 +426,57 @@ static int lpc3180_read_data(struct nand_device *nand, void *data)
 	return ERROR_OK;
 }
 
+/* set up the hosted loop for the data register of the selected controller */
+static int lpc3180_io_setup(struct nand_device *nand, enum arm_nand_op op)
+{
+	struct lpc3180_nand_controller *lpc3180_info = nand->controller_priv;
+	struct arm_nand_data *io = &lpc3180_info->io;
+
+	if (nand->target->state != TARGET_HALTED) {
+		LOG_ERROR("target must be halted to use LPC3180 NAND flash controller");
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	io->bus_width = nand->bus_width;
+	io->chunk_size = nand->page_size;
+	if (lpc3180_info->selected_controller == LPC3180_MLC_CONTROLLER) {
+		/* MLC_DATA: 32-bit writes, sized reads */
+		io->data = 0x200b0000;
+		io->reg_width = op == ARM_NAND_WRITE ? 32 : 0;
+	} else if (lpc3180_info->selected_controller == LPC3180_SLC_CONTROLLER) {
+		/* SLC_DATA: must use 32-bit access */
+		io->data = 0x20020000;
+		io->reg_width = 32;
+	} else
+		return ERROR_NAND_NO_BUFFER;
+
+	return ERROR_OK;
+}
+
+static int lpc3180_write_block_data(struct nand_device *nand, uint8_t *data, int size)
+{
+	struct lpc3180_nand_controller *lpc3180_info = nand->controller_priv;
+	int retval;
+
+	retval = lpc3180_io_setup(nand, ARM_NAND_WRITE);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return arm_nandwrite(&lpc3180_info->io, data, size);
+}
+
+static int lpc3180_read_block_data(struct nand_device *nand, uint8_t *data, int size)
+{
+	struct lpc3180_nand_controller *lpc3180_info = nand->controller_priv;
+	int retval;
+
+	retval = lpc3180_io_setup(nand, ARM_NAND_READ);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return arm_nandread(&lpc3180_info->io, data, size);
+}
+
 static int lpc3180_write_page(struct nand_device *nand,
 	uint32_t page,
 	uint8_t *data,
@@ -605,6 +660,8 @@ static int lpc3180_write_page(struct nand_device *nand,
 					"Reserve the physical target working area at word boundary");
 				return ERROR_FLASH_OPERATION_FAILED;
 			}
+			/* the DMA buffers take the whole working area */
+			arm_nand_release(&lpc3180_info->io);
 			if (target_alloc_working_area(target, target->working_area_size,
 				    &pworking_area) != ERROR_OK) {
 				LOG_ERROR("no working area specified, can't read LPC internal flash");
@@ -986,6 +1043,8 @@ static int lpc3180_read_page(struct nand_device *nand,
 					"Reserve the physical target working area at word boundary");
 				return ERROR_FLASH_OPERATION_FAILED;
 			}
+			/* the DMA buffers take the whole working area */
+			arm_nand_release(&lpc3180_info->io);
 			if (target_alloc_working_area(target, target->working_area_size,
 				    &pworking_area) != ERROR_OK) {
 				LOG_ERROR("no working area specified, can't read LPC internal flash");
@@ -1309,6 +1368,9 @@ COMMAND_HANDLER(handle_lpc3180_select_command)
 				lpc3180_info->is_bulk = 0;
 		} else
 			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		/* the hosted loop depends on the data register */
+		lpc3180_info->io.op = ARM_NAND_NONE;
 	}
 
 	if (lpc3180_info->selected_controller == LPC3180_MLC_CONTROLLER)
@@ -1345,6 +1407,14 @@ static const struct command_registration lpc3180_command_handler[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+static void lpc3180_free_driver_priv(struct nand_device *nand)
+{
+	struct lpc3180_nand_controller *info = nand->controller_priv;
+
+	arm_nand_release(&info->io);
+	free(info);
+}
+
 struct nand_flash_controller lpc3180_nand_controller = {
 	.name = "lpc3180",
 	.commands = lpc3180_command_handler,
@@ -1355,7 +1425,10 @@ struct nand_flash_controller lpc3180_nand_controller = {
 	.address = lpc3180_address,
 	.write_data = lpc3180_write_data,
 	.read_data = lpc3180_read_data,
+	.write_block_data = lpc3180_write_block_data,
+	.read_block_data = lpc3180_read_block_data,
 	.write_page = lpc3180_write_page,
 	.read_page = lpc3180_read_page,
 	.nand_ready = lpc3180_nand_ready,
+	.free_driver_priv = lpc3180_free_driver_priv,
 };
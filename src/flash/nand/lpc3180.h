@@ -21,6 +21,8 @@
 #ifndef LPC3180_NAND_CONTROLLER_H
 #define LPC3180_NAND_CONTROLLER_H
 
+#include "arm_io.h"
+
 enum lpc3180_selected_controller {
 	LPC3180_NO_CONTROLLER,
 	LPC3180_MLC_CONTROLLER,
@@ -34,6 +36,9 @@ struct lpc3180_nand_controller {
 	int sw_write_protection;
 	uint32_t sw_wp_lower_bound;
 	uint32_t sw_wp_upper_bound;
+
+	/* raw page data moved by code running on the target */
+	struct arm_nand_data io;
 };
 
 #endif	/*LPC3180_NAND_CONTROLLER_H */
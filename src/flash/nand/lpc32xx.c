@@ -37,8 +37,6 @@
 static int lpc32xx_reset(struct nand_device *nand);
 static int lpc32xx_controller_ready(struct nand_device *nand, int timeout);
 static int lpc32xx_tc_ready(struct nand_device *nand, int timeout);
-extern int nand_correct_data(struct nand_device *nand, u_char *dat,
-		u_char *read_ecc, u_char *calc_ecc);
 
 /* These are offset with the working area in IRAM when using DMA to
  * read/write data to the SLC controller.
@@ -97,6 +95,10 @@ NAND_DEVICE_COMMAND_HANDLER(lpc32xx_nand_device_command)
 	lpc32xx_info->sw_wp_lower_bound = 0x0;
 	lpc32xx_info->sw_wp_upper_bound = 0x0;
 
+	memset(&lpc32xx_info->io, 0, sizeof(lpc32xx_info->io));
+	lpc32xx_info->io.target = nand->target;
+	lpc32xx_info->io.op = ARM_NAND_NONE;
+
 	return ERROR_OK;
 }
 
@@ -589,6 +591,57 @@ static int lpc32xx_read_data(struct nand_device *nand, void *data)
 	return ERROR_OK;
 }
 
+/* set up the hosted loop for the data register of the selected controller */
+static int lpc32xx_io_setup(struct nand_device *nand, enum arm_nand_op op)
+{
+	struct lpc32xx_nand_controller *lpc32xx_info = nand->controller_priv;
+	struct arm_nand_data *io = &lpc32xx_info->io;
+
+	if (nand->target->state != TARGET_HALTED) {
+		LOG_ERROR("target must be halted to use LPC32xx NAND flash controller");
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	io->bus_width = nand->bus_width;
+	io->chunk_size = nand->page_size;
+	if (lpc32xx_info->selected_controller == LPC32xx_MLC_CONTROLLER) {
+		/* MLC_DATA: 32-bit writes, sized reads */
+		io->data = 0x200b0000;
+		io->reg_width = op == ARM_NAND_WRITE ? 32 : 0;
+	} else if (lpc32xx_info->selected_controller == LPC32xx_SLC_CONTROLLER) {
+		/* SLC_DATA: must use 32-bit access */
+		io->data = 0x20020000;
+		io->reg_width = 32;
+	} else
+		return ERROR_NAND_NO_BUFFER;
+
+	return ERROR_OK;
+}
+
+static int lpc32xx_write_block_data(struct nand_device *nand, uint8_t *data, int size)
+{
+	struct lpc32xx_nand_controller *lpc32xx_info = nand->controller_priv;
+	int retval;
+
+	retval = lpc32xx_io_setup(nand, ARM_NAND_WRITE);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return arm_nandwrite(&lpc32xx_info->io, data, size);
+}
+
+static int lpc32xx_read_block_data(struct nand_device *nand, uint8_t *data, int size)
+{
+	struct lpc32xx_nand_controller *lpc32xx_info = nand->controller_priv;
+	int retval;
+
+	retval = lpc32xx_io_setup(nand, ARM_NAND_READ);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return arm_nandread(&lpc32xx_info->io, data, size);
+}
+
 static int lpc32xx_write_page_mlc(struct nand_device *nand, uint32_t page,
 	uint8_t *data, uint32_t data_size,
 	uint8_t *oob, uint32_t oob_size)
@@ -1269,6 +1322,8 @@ static int lpc32xx_write_page(struct nand_device *nand, uint32_t page,
 			return nand_write_page_raw(nand, page, data,
 				data_size, oob, oob_size);
 		}
+		/* make room for the DMA buffers */
+		arm_nand_release(&lpc32xx_info->io);
 		retval = target_alloc_working_area(target,
 				nand->page_size + DATA_OFFS,
 				&pworking_area);
@@ -1599,6 +1654,8 @@ static int lpc32xx_read_page(struct nand_device *nand, uint32_t page,
 	} else if (lpc32xx_info->selected_controller == LPC32xx_SLC_CONTROLLER) {
 		struct working_area *pworking_area;
 
+		/* make room for the DMA buffers */
+		arm_nand_release(&lpc32xx_info->io);
 		retval = target_alloc_working_area(target,
 				nand->page_size + 0x200,
 				&pworking_area);
@@ -1778,6 +1835,9 @@ COMMAND_HANDLER(handle_lpc32xx_select_command)
 				LPC32xx_SLC_CONTROLLER;
 		} else
 			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		/* the hosted loop depends on the data register */
+		lpc32xx_info->io.op = ARM_NAND_NONE;
 	}
 
 	command_print(CMD_CTX, "%s controller selected",
@@ -1807,6 +1867,14 @@ static const struct command_registration lpc32xx_command_handler[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+static void lpc32xx_free_driver_priv(struct nand_device *nand)
+{
+	struct lpc32xx_nand_controller *info = nand->controller_priv;
+
+	arm_nand_release(&info->io);
+	free(info);
+}
+
 struct nand_flash_controller lpc32xx_nand_controller = {
 	.name = "lpc32xx",
 	.commands = lpc32xx_command_handler,
@@ -1817,7 +1885,10 @@ struct nand_flash_controller lpc32xx_nand_controller = {
 	.address = lpc32xx_address,
 	.write_data = lpc32xx_write_data,
 	.read_data = lpc32xx_read_data,
+	.write_block_data = lpc32xx_write_block_data,
+	.read_block_data = lpc32xx_read_block_data,
 	.write_page = lpc32xx_write_page,
 	.read_page = lpc32xx_read_page,
 	.nand_ready = lpc32xx_nand_ready,
+	.free_driver_priv = lpc32xx_free_driver_priv,
 };
@@ -21,6 +21,8 @@
 #ifndef LPC32xx_NAND_CONTROLLER_H
 #define LPC32xx_NAND_CONTROLLER_H
 
+#include "arm_io.h"
+
 enum lpc32xx_selected_controller {
 	LPC32xx_NO_CONTROLLER,
 	LPC32xx_MLC_CONTROLLER,
@@ -33,6 +35,9 @@ struct lpc32xx_nand_controller {
 	int sw_write_protection;
 	uint32_t sw_wp_lower_bound;
 	uint32_t sw_wp_upper_bound;
+
+	/* raw page data moved by code running on the target */
+	struct arm_nand_data io;
 };
 
 #endif	/*LPC32xx_NAND_CONTROLLER_H */
@@ -214,6 +214,14 @@ static int nuc910_nand_init(struct nand_device *nand)
 	return ERROR_OK;
 }
 
+static void nuc910_nand_free_driver_priv(struct nand_device *nand)
+{
+	struct nuc910_nand_controller *nuc910_nand = nand->controller_priv;
+
+	arm_nand_release(&nuc910_nand->io);
+	free(nuc910_nand);
+}
+
 struct nand_flash_controller nuc910_nand_controller = {
 	.name = "nuc910",
 	.command = nuc910_nand_command,
@@ -226,4 +234,5 @@ struct nand_flash_controller nuc910_nand_controller = {
 	.reset = nuc910_nand_reset,
 	.nand_device_command = nuc910_nand_device_command,
 	.init = nuc910_nand_init,
+	.free_driver_priv = nuc910_nand_free_driver_priv,
 };
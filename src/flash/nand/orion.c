@@ -149,6 +149,14 @@ static int orion_nand_init(struct nand_device *nand)
 	return ERROR_OK;
 }
 
+static void orion_free_driver_priv(struct nand_device *nand)
+{
+	struct orion_nand_controller *info = nand->controller_priv;
+
+	arm_nand_release(&info->io);
+	free(info);
+}
+
 struct nand_flash_controller orion_nand_controller = {
 	.name = "orion",
 	.usage = "<target_id> <NAND_address>",
@@ -160,4 +168,5 @@ struct nand_flash_controller orion_nand_controller = {
 	.reset = orion_nand_reset,
 	.nand_device_command = orion_nand_device_command,
 	.init = orion_nand_init,
+	.free_driver_priv = orion_free_driver_priv,
 };
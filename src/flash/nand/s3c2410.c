@@ -112,7 +112,10 @@ struct nand_flash_controller s3c2410_nand_controller = {
 	.address = &s3c24xx_address,
 	.write_data = &s3c2410_write_data,
 	.read_data = &s3c2410_read_data,
+	.write_block_data = &s3c24xx_write_block_data,
+	.read_block_data = &s3c24xx_read_block_data,
 	.write_page = s3c24xx_write_page,
 	.read_page = s3c24xx_read_page,
 	.nand_ready = &s3c2410_nand_ready,
+	.free_driver_priv = &s3c24xx_free_driver_priv,
 };
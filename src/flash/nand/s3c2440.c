@@ -83,7 +83,8 @@ int s3c2440_nand_ready(struct nand_device *nand, int timeout)
 	return 0;
 }
 
-/* use the fact we can read/write 4 bytes in one go via a single 32bit op */
+/* unless the data can be moved on the target, use the fact we can
+ * read/write 4 bytes in one go via a single 32bit op */
 
 int s3c2440_read_block_data(struct nand_device *nand, uint8_t *data, int data_size)
 {
@@ -91,13 +92,13 @@ int s3c2440_read_block_data(struct nand_device *nand, uint8_t *data, int data_si
 	struct target *target = nand->target;
 	uint32_t nfdata = s3c24xx_info->data;
 	uint32_t tmp;
+	int retval;
 
-	LOG_INFO("%s: reading data: %p, %p, %d", __func__, nand, data, data_size);
+	LOG_DEBUG("%s: reading data: %p, %p, %d", __func__, nand, data, data_size);
 
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("target must be halted to use S3C24XX NAND flash controller");
-		return ERROR_NAND_OPERATION_FAILED;
-	}
+	retval = s3c24xx_read_block_data(nand, data, data_size);
+	if (retval != ERROR_NAND_NO_BUFFER)
+		return retval;
 
 	while (data_size >= 4) {
 		target_read_u32(target, nfdata, &tmp);
@@ -127,11 +128,11 @@ int s3c2440_write_block_data(struct nand_device *nand, uint8_t *data, int data_s
 	struct target *target = nand->target;
 	uint32_t nfdata = s3c24xx_info->data;
 	uint32_t tmp;
+	int retval;
 
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("target must be halted to use S3C24XX NAND flash controller");
-		return ERROR_NAND_OPERATION_FAILED;
-	}
+	retval = s3c24xx_write_block_data(nand, data, data_size);
+	if (retval != ERROR_NAND_NO_BUFFER)
+		return retval;
 
 	while (data_size >= 4) {
 		tmp = le_to_h_u32(data);
@@ -165,4 +166,5 @@ struct nand_flash_controller s3c2440_nand_controller = {
 	.write_block_data = &s3c2440_write_block_data,
 	.read_block_data = &s3c2440_read_block_data,
 	.nand_ready = &s3c2440_nand_ready,
+	.free_driver_priv = &s3c24xx_free_driver_priv,
 };
@@ -74,4 +74,5 @@ struct nand_flash_controller s3c2443_nand_controller = {
 	.write_block_data = &s3c2440_write_block_data,
 	.read_block_data = &s3c2440_read_block_data,
 	.nand_ready = &s3c2440_nand_ready,
+	.free_driver_priv = &s3c24xx_free_driver_priv,
 };
@@ -41,12 +41,24 @@ S3C24XX_DEVICE_COMMAND()
 		return -ENOMEM;
 	}
 
+	memset(s3c24xx_info, 0, sizeof(*s3c24xx_info));
+	s3c24xx_info->io.target = nand->target;
+	s3c24xx_info->io.op = ARM_NAND_NONE;
+
 	nand->controller_priv = s3c24xx_info;
 	*info = s3c24xx_info;
 
 	return ERROR_OK;
 }
 
+void s3c24xx_free_driver_priv(struct nand_device *nand)
+{
+	struct s3c24xx_nand_controller *s3c24xx_info = nand->controller_priv;
+
+	arm_nand_release(&s3c24xx_info->io);
+	free(s3c24xx_info);
+}
+
 int s3c24xx_reset(struct nand_device *nand)
 {
 	struct s3c24xx_nand_controller *s3c24xx_info = nand->controller_priv;
@@ -117,3 +129,39 @@ int s3c24xx_read_data(struct nand_device *nand, void *data)
 	target_read_u8(target, s3c24xx_info->data, data);
 	return ERROR_OK;
 }
+
+/* move a page through the data register with a loop on the target */
+
+int s3c24xx_read_block_data(struct nand_device *nand, uint8_t *data, int data_size)
+{
+	struct s3c24xx_nand_controller *s3c24xx_info = nand->controller_priv;
+	struct arm_nand_data *io = &s3c24xx_info->io;
+
+	if (nand->target->state != TARGET_HALTED) {
+		LOG_ERROR("target must be halted to use S3C24XX NAND flash controller");
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	io->data = s3c24xx_info->data;
+	io->bus_width = nand->bus_width;
+	io->chunk_size = nand->page_size;
+
+	return arm_nandread(io, data, data_size);
+}
+
+int s3c24xx_write_block_data(struct nand_device *nand, uint8_t *data, int data_size)
+{
+	struct s3c24xx_nand_controller *s3c24xx_info = nand->controller_priv;
+	struct arm_nand_data *io = &s3c24xx_info->io;
+
+	if (nand->target->state != TARGET_HALTED) {
+		LOG_ERROR("target must be halted to use S3C24XX NAND flash controller");
+		return ERROR_NAND_OPERATION_FAILED;
+	}
+
+	io->data = s3c24xx_info->data;
+	io->bus_width = nand->bus_width;
+	io->chunk_size = nand->page_size;
+
+	return arm_nandwrite(io, data, data_size);
+}
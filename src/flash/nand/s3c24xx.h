@@ -28,6 +28,7 @@
  */
 
 #include "imp.h"
+#include "arm_io.h"
 #include "s3c24xx_regs.h"
 #include <target/target.h>
 
@@ -37,6 +38,9 @@ struct s3c24xx_nand_controller {
 	uint32_t		 addr;
 	uint32_t		 data;
 	uint32_t		 nfstat;
+
+	/* data moved by code running on the target */
+	struct arm_nand_data	 io;
 };
 
 /* Default to using the un-translated NAND register based address */
@@ -57,6 +61,8 @@ S3C24XX_DEVICE_COMMAND();
 			return retval; \
 	} while (0)
 
+void s3c24xx_free_driver_priv(struct nand_device *nand);
+
 int s3c24xx_reset(struct nand_device *nand);
 
 int s3c24xx_command(struct nand_device *nand, uint8_t command);
@@ -70,6 +76,11 @@ int s3c24xx_read_data(struct nand_device *nand, void *data);
 
 /* code shared between different controllers */
 
+int s3c24xx_read_block_data(struct nand_device *nand,
+		uint8_t *data, int data_size);
+int s3c24xx_write_block_data(struct nand_device *nand,
+		uint8_t *data, int data_size);
+
 int s3c2440_nand_ready(struct nand_device *nand, int timeout);
 
 int s3c2440_read_block_data(struct nand_device *nand,
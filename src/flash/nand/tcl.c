@@ -120,6 +120,8 @@ COMMAND_HANDLER(handle_nand_info_command)
 
 		if (p->blocks[j].is_bad == 0)
 			bad_state = "";
+		else if (p->blocks[j].is_retired)
+			bad_state = " (retired)";
 		else if (p->blocks[j].is_bad == 1)
 			bad_state = " (marked bad)";
 		else
@@ -190,6 +192,8 @@ COMMAND_HANDLER(handle_nand_erase_command)
 	}
 
 	retval = nand_erase(p, offset, offset + length - 1);
+	if (nand_bbt_sync(p) != ERROR_OK)
+		LOG_WARNING("couldn't save the bad block table");
 	if (retval == ERROR_OK) {
 		command_print(CMD_CTX, "erased blocks %lu to %lu "
 			"on NAND flash device #%s '%s'",
@@ -234,6 +238,8 @@ COMMAND_HANDLER(handle_nand_check_bad_blocks_command)
 	}
 
 	retval = nand_build_bbt(p, first, last);
+	if (nand_bbt_sync(p) != ERROR_OK)
+		LOG_WARNING("couldn't save the bad block table");
 	if (retval == ERROR_OK) {
 		command_print(CMD_CTX, "checked NAND flash device for bad blocks, "
 			"use \"nand info\" command to list blocks");
@@ -251,24 +257,45 @@ COMMAND_HANDLER(handle_nand_write_command)
 	if (ERROR_OK != retval)
 		return retval;
 
+	struct nand_bulk_write w;
+	retval = nand_bulk_write_start(&w, nand, s.address / nand->page_size,
+			s.page ? s.page_size : 0, s.oob ? s.oob_size : 0, s.skip_bad);
+	if (ERROR_OK != retval) {
+		nand_fileio_cleanup(&s);
+		return retval;
+	}
+
 	uint32_t total_bytes = s.size;
 	while (s.size > 0) {
 		int bytes_read = nand_fileio_read(nand, &s);
 		if (bytes_read <= 0) {
 			command_print(CMD_CTX, "error while reading file");
+			nand_bulk_write_finish(&w);
 			return nand_fileio_cleanup(&s);
 		}
 		s.size -= bytes_read;
 
-		retval = nand_write_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+		/* the page goes where the writer says, past any bad blocks */
+		s.address = w.page * nand->page_size;
+		retval = nand_bulk_write_page(&w, s.page, s.oob, s.size == 0);
 		if (ERROR_OK != retval) {
 			command_print(CMD_CTX, "failed writing file %s "
 				"to NAND flash %s at offset 0x%8.8" PRIx32,
 				CMD_ARGV[1], CMD_ARGV[0], s.address);
+			nand_bulk_write_finish(&w);
 			return nand_fileio_cleanup(&s);
 		}
-		s.address += s.page_size;
+	}
+
+	retval = nand_bulk_write_finish(&w);
+	s.address = w.page * nand->page_size;
+	if (nand_bbt_sync(nand) != ERROR_OK)
+		LOG_WARNING("couldn't save the bad block table");
+	if (ERROR_OK != retval) {
+		command_print(CMD_CTX, "failed writing file %s to NAND flash %s",
+			CMD_ARGV[1], CMD_ARGV[0]);
+		nand_fileio_cleanup(&s);
+		return retval;
 	}
 
 	if (nand_fileio_finish(&s) == ERROR_OK) {
@@ -276,6 +303,9 @@ COMMAND_HANDLER(handle_nand_write_command)
 			"offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
 			CMD_ARGV[1], CMD_ARGV[0], s.address, duration_elapsed(&s.bench),
 			duration_kbps(&s.bench, total_bytes));
+		if (w.skipped)
+			command_print(CMD_CTX, "skipped %u bad blocks, %u of them "
+				"failing while written", w.skipped, w.remapped);
 	}
 	return ERROR_OK;
 }
@@ -299,6 +329,19 @@ COMMAND_HANDLER(handle_nand_verify_command)
 		return retval;
 
 	while (file.size > 0) {
+		/* skip the bad blocks nand write skipped */
+		if (file.skip_bad && (dev.address % nand->erase_size == 0
+				|| dev.address == file.address)) {
+			uint32_t page = dev.address / nand->page_size;
+			retval = nand_skip_bad_blocks(nand, &page, NULL);
+			if (ERROR_OK != retval) {
+				nand_fileio_cleanup(&dev);
+				nand_fileio_cleanup(&file);
+				return retval;
+			}
+			dev.address = page * nand->page_size;
+		}
+
 		retval = nand_read_page(nand, dev.address / dev.page_size,
 				dev.page, dev.page_size, dev.oob, dev.oob_size);
 		if (ERROR_OK != retval) {
@@ -341,44 +384,37 @@ COMMAND_HANDLER(handle_nand_verify_command)
 
 COMMAND_HANDLER(handle_nand_dump_command)
 {
-	int filesize;
 	struct nand_device *nand = NULL;
 	struct nand_fileio_state s;
 	int retval = CALL_COMMAND_HANDLER(nand_fileio_parse_args,
-			&s, &nand, FILEIO_WRITE, true, false);
+			&s, &nand, FILEIO_WRITE, true, true);
 	if (ERROR_OK != retval)
 		return retval;
 
-	while (s.size > 0) {
-		size_t size_written;
-		retval = nand_read_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
-		if (ERROR_OK != retval) {
-			command_print(CMD_CTX, "reading NAND flash page failed");
-			nand_fileio_cleanup(&s);
-			return retval;
-		}
-
-		if (NULL != s.page)
-			fileio_write(&s.fileio, s.page_size, s.page, &size_written);
-
-		if (NULL != s.oob)
-			fileio_write(&s.fileio, s.oob_size, s.oob, &size_written);
-
-		s.size -= nand->page_size;
-		s.address += nand->page_size;
-	}
-
-	retval = fileio_size(&s.fileio, &filesize);
-	if (retval != ERROR_OK)
+	struct nand_dump_result result;
+	retval = nand_dump(nand, &s, &result);
+	if (ERROR_OK != retval) {
+		command_print(CMD_CTX, "dumping NAND flash %s failed after %" PRIu32
+			" pages, at offset 0x%8.8" PRIx32 "; 'resume' continues it",
+			CMD_ARGV[0], result.resumed + result.pages, s.address);
+		nand_fileio_cleanup(&s);
 		return retval;
+	}
 
 	if (nand_fileio_finish(&s) == ERROR_OK) {
 		command_print(CMD_CTX, "dumped %ld bytes in %fs (%0.3f KiB/s)",
-			(long)filesize, duration_elapsed(&s.bench),
-			duration_kbps(&s.bench, filesize));
+			(long)result.bytes, duration_elapsed(&s.bench),
+			duration_kbps(&s.bench, result.bytes));
+		if (result.resumed)
+			command_print(CMD_CTX, "%" PRIu32 " pages were dumped already",
+				result.resumed);
+		if (result.skipped)
+			command_print(CMD_CTX, "skipped %u bad blocks", result.skipped);
+		if (result.corrected || result.failed)
+			command_print(CMD_CTX, "ECC corrected %u bits, "
+				"%u blocks uncorrectable", result.corrected, result.failed);
 	}
-	return ERROR_OK;
+	return result.failed ? ERROR_NAND_OPERATION_FAILED : ERROR_OK;
 }
 
 COMMAND_HANDLER(handle_nand_raw_access_command)
@@ -405,6 +441,125 @@ COMMAND_HANDLER(handle_nand_raw_access_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_nand_cache_program_command)
+{
+	if ((CMD_ARGC < 1) || (CMD_ARGC > 2))
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[1], p->use_cache_program);
+
+	const char *msg = p->use_cache_program ? "enabled" : "disabled";
+	command_print(CMD_CTX, "cache program is %s", msg);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_nand_bbt_save_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	const char *filename = CMD_ARGC == 2 ? CMD_ARGV[1] : p->bbt_file;
+	if (filename == NULL)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = nand_bbt_save(p, filename);
+	if (retval == ERROR_OK) {
+		command_print(CMD_CTX, "saved bad block table of NAND flash "
+			"device '%s' to %s", p->name, filename);
+	}
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_nand_bbt_load_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	const char *filename = CMD_ARGC == 2 ? CMD_ARGV[1] : p->bbt_file;
+	if (filename == NULL)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = nand_bbt_load(p, filename);
+	if (retval == ERROR_OK) {
+		command_print(CMD_CTX, "loaded bad block table of NAND flash "
+			"device '%s' from %s", p->name, filename);
+	}
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_nand_bbt_file_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct nand_device *p;
+	int retval = CALL_COMMAND_HANDLER(nand_command_get_device, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	if (CMD_ARGC == 2) {
+		free(p->bbt_file);
+		p->bbt_file = NULL;
+		if (strcmp(CMD_ARGV[1], "none") != 0)
+			p->bbt_file = strdup(CMD_ARGV[1]);
+	}
+
+	if (p->bbt_file)
+		command_print(CMD_CTX, "bad block table of NAND flash device "
+			"'%s' kept in %s", p->name, p->bbt_file);
+	else
+		command_print(CMD_CTX, "bad block table of NAND flash device "
+			"'%s' not kept", p->name);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration nand_bbt_command_handlers[] = {
+	{
+		.name = "save",
+		.handler = handle_nand_bbt_save_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [filename]",
+		.help = "save the bad block table to a file",
+	},
+	{
+		.name = "load",
+		.handler = handle_nand_bbt_load_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [filename]",
+		.help = "load the bad block table from a file, "
+			"checking some blocks against it",
+	},
+	{
+		.name = "file",
+		.handler = handle_nand_bbt_file_command,
+		.mode = COMMAND_ANY,
+		.usage = "bank_id [filename|'none']",
+		.help = "file the bad block table is loaded from when probing "
+			"and saved to when it changes",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration nand_exec_command_handlers[] = {
 	{
 		.name = "list",
@@ -445,7 +600,9 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_dump_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset length "
-			"['oob_raw'|'oob_only']",
+			"['oob_raw'|'oob_only'|'oob_split'] "
+			"['oob_softecc'|'oob_softecc_kw'|'oob_softecc_bch4'|"
+			"'oob_softecc_bch8'] ['skip_bad'] ['resume']",
 		.help = "dump from NAND flash device",
 	},
 	{
@@ -453,7 +610,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_verify_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'|"
+			"'oob_softecc_bch4'|'oob_softecc_bch8'] ['skip_bad']",
 		.help = "verify NAND flash device",
 	},
 	{
@@ -461,7 +619,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_write_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'|"
+			"'oob_softecc_bch4'|'oob_softecc_bch8'] ['skip_bad']",
 		.help = "write to NAND flash device",
 	},
 	{
@@ -471,6 +630,13 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.usage = "bank_id ['enable'|'disable']",
 		.help = "raw access to NAND flash device",
 	},
+	{
+		.name = "cache_program",
+		.handler = handle_nand_cache_program_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['enable'|'disable']",
+		.help = "use the cache program command when writing pages",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -548,6 +714,9 @@ static COMMAND_HELPER(create_nand_device, const char *bank_name,
 	c->address_cycles = 0;
 	c->page_size = 0;
 	c->use_raw = 0;
+	c->use_cache_program = false;
+	c->bbt_file = NULL;
+	c->bbt_dirty = false;
 	c->next = NULL;
 
 	retval = CALL_COMMAND_HANDLER(controller->nand_device_command, c);
@@ -586,6 +755,18 @@ COMMAND_HANDLER(handle_nand_device_command)
 	return CALL_COMMAND_HANDLER(create_nand_device, bank_name, controller);
 }
 
+COMMAND_HANDLER(handle_nand_ecc_selftest_command)
+{
+	unsigned kib = 1024;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], kib);
+
+	return nand_ecc_selftest(CMD_CTX, kib);
+}
+
 static const struct command_registration nand_config_command_handlers[] = {
 	{
 		.name = "device",
@@ -601,6 +782,21 @@ static const struct command_registration nand_config_command_handlers[] = {
 		.help = "lists available NAND drivers",
 		.usage = ""
 	},
+	{
+		.name = "ecc_selftest",
+		.handler = &handle_nand_ecc_selftest_command,
+		.mode = COMMAND_ANY,
+		.help = "check the software ECC codes against known answers "
+			"and time them over some KiB of data",
+		.usage = "[kib]"
+	},
+	{
+		.name = "bbt",
+		.mode = COMMAND_ANY,
+		.help = "NAND bad block table command group",
+		.usage = "",
+		.chain = nand_bbt_command_handlers,
+	},
 	{
 		.name = "init",
 		.mode = COMMAND_CONFIG,
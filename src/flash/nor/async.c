@@ -0,0 +1,386 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "async.h"
+#include <helper/binarybuffer.h>
+#include <helper/time_support.h>
+#include <target/algorithm.h>
+#include <target/armv7m.h>
+
+#define FLASH_ASYNC_FIFO_SIZE	16384
+#define FLASH_ASYNC_FIFO_MIN	256
+
+/* the write and read pointers at the start of the FIFO working area */
+#define FLASH_ASYNC_FIFO_HEADER	8
+
+/* Compressed streams: the decompressor may have to program up to
+ * FLASH_ASYNC_LZ_MAX_MATCH words for each two FIFO words, so the FIFO
+ * is kept small enough that a full one drains well within the timeout
+ * target_run_flash_async_algorithm() allows after the last write. */
+#define FLASH_ASYNC_LZ_FIFO_SIZE	2048
+#define FLASH_ASYNC_LZ_MAX_MATCH	128
+#define FLASH_ASYNC_LZ_MIN_MATCH	3
+#define FLASH_ASYNC_LZ_MAX_LITERALS	0xffff
+#define FLASH_ASYNC_LZ_HASH_BITS	12
+
+static struct flash_async_stats async_stats;
+static bool async_compress;
+
+/* FIFO area size for @a data_size bytes of payload: header plus whole blocks */
+static uint32_t flash_async_fifo_size(uint32_t data_size, uint32_t block_size)
+{
+	return FLASH_ASYNC_FIFO_HEADER + (data_size & ~(block_size - 1));
+}
+
+static int flash_async_stream(struct flash_bank *bank,
+		const struct flash_async_loader *loader,
+		uint8_t *buffer, uint32_t count, uint32_t payload,
+		int num_reg_params, struct reg_param *reg_params)
+{
+	struct target *target = bank->target;
+	struct working_area *code;
+	struct working_area *fifo;
+	struct armv7m_algorithm armv7m_info;
+	uint32_t block_size = loader->block_size;
+	uint32_t data_size = loader->fifo_size ? loader->fifo_size : FLASH_ASYNC_FIFO_SIZE;
+	uint32_t data_min = loader->fifo_min ? loader->fifo_min : FLASH_ASYNC_FIFO_MIN;
+	struct duration bench;
+	int retval;
+
+	assert(block_size && !(block_size & (block_size - 1)));
+
+	if (!is_armv7m(target_to_armv7m(target))) {
+		async_stats.fallbacks++;
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* the FIFO is one block larger than the data since it can't
+	 * be filled completely; no point in making it larger still */
+	if (data_size > (count + 1) * block_size)
+		data_size = (count + 1) * block_size;
+	if (data_min < 2 * block_size)
+		data_min = 2 * block_size;
+
+	retval = target_alloc_algorithm(target, loader->code, loader->code_size, &code);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+		LOG_DEBUG("no working area for the flash loader");
+		async_stats.fallbacks++;
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	while (target_alloc_working_area_try(target,
+			flash_async_fifo_size(data_size, block_size), &fifo) != ERROR_OK) {
+		data_size /= 2;
+		if (data_size < data_min) {
+			/* we already allocated the loader, but failed to get a FIFO */
+			target_free_working_area(target, code);
+			LOG_WARNING("no large enough working area available, "
+					"can't do block memory writes");
+			async_stats.fallbacks++;
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+		LOG_DEBUG("retry target_alloc_working_area(%s, size=%u)",
+				target_name(target), (unsigned) data_size);
+	}
+
+	buf_set_u32(reg_params[loader->fifo_start_param].value, 0, 32, fifo->address);
+	buf_set_u32(reg_params[loader->fifo_end_param].value, 0, 32,
+			fifo->address + fifo->size);
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	duration_start(&bench);
+
+	retval = target_run_flash_async_algorithm(target, buffer, count, block_size,
+			0, NULL,
+			num_reg_params, reg_params,
+			fifo->address, fifo->size,
+			code->address, 0,
+			&armv7m_info);
+
+	if (duration_measure(&bench) == ERROR_OK) {
+		async_stats.seconds += duration_elapsed(&bench);
+		LOG_DEBUG("streamed %" PRIu32 " bytes through a %" PRIu32 " byte FIFO "
+				"in %fs (%0.3f KiB/s)", payload, fifo->size,
+				duration_elapsed(&bench), duration_kbps(&bench, payload));
+	}
+	async_stats.runs++;
+	if (retval == ERROR_OK) {
+		async_stats.bytes += payload;
+		async_stats.link_bytes += count * block_size;
+	}
+
+	target_free_working_area(target, fifo);
+	target_free_working_area(target, code);
+
+	return retval;
+}
+
+int flash_async_write(struct flash_bank *bank,
+		const struct flash_async_loader *loader,
+		uint8_t *buffer, uint32_t count,
+		int num_reg_params, struct reg_param *reg_params)
+{
+	return flash_async_stream(bank, loader, buffer, count,
+			count * loader->block_size, num_reg_params, reg_params);
+}
+
+static uint32_t flash_async_lz_hash(const uint8_t *word)
+{
+	uint32_t value;
+
+	memcpy(&value, word, sizeof(value));
+	return (value * 2654435761u) >> (32 - FLASH_ASYNC_LZ_HASH_BITS);
+}
+
+static uint32_t flash_async_lz_emit(struct target *target, uint8_t *out, uint32_t n,
+		const uint8_t *literals, uint32_t num_literals,
+		uint32_t match, uint32_t offset)
+{
+	target_buffer_set_u32(target, out + 4 * n++, num_literals << 16 | match);
+	memcpy(out + 4 * n, literals, 4 * num_literals);
+	n += num_literals;
+	if (match)
+		target_buffer_set_u32(target, out + 4 * n++, offset);
+	return n;
+}
+
+/*
+ * Word granular LZ77 in the spirit of LZ4: a token word holding the
+ * number of literal words in its upper and the match length in its
+ * lower half, the literal words, then the match offset in words if the
+ * match length isn't zero.  Returns the number of words in @a out,
+ * which must have room for @a words + @a words / 0xffff + 1 of them.
+ */
+static uint32_t flash_async_lz_compress(struct target *target,
+		const uint8_t *in, uint32_t words, uint8_t *out, uint32_t *head)
+{
+	uint32_t literal = 0;
+	uint32_t n = 0;
+	uint32_t i = 0;
+
+	memset(head, 0xff, sizeof(uint32_t) << FLASH_ASYNC_LZ_HASH_BITS);
+
+	while (i < words) {
+		uint32_t candidates[2];
+		uint32_t best_len = 0, best_offset = 0;
+		uint32_t h = flash_async_lz_hash(in + 4 * i);
+
+		/* the previous word catches fill patterns, the hash the rest */
+		candidates[0] = i - 1;
+		candidates[1] = head[h];
+		head[h] = i;
+
+		for (int c = 0; c < 2; c++) {
+			uint32_t from = candidates[c];
+			uint32_t len = 0;
+
+			if (from >= i)
+				continue;
+			while (i + len < words && len < FLASH_ASYNC_LZ_MAX_MATCH
+					&& !memcmp(in + 4 * (from + len), in + 4 * (i + len), 4))
+				len++;
+			if (len > best_len) {
+				best_len = len;
+				best_offset = i - from;
+			}
+		}
+
+		if (best_len >= FLASH_ASYNC_LZ_MIN_MATCH) {
+			n = flash_async_lz_emit(target, out, n, in + 4 * literal, i - literal,
+					best_len, best_offset);
+			while (--best_len) {
+				i++;
+				head[flash_async_lz_hash(in + 4 * i)] = i;
+			}
+			literal = ++i;
+		} else if (++i - literal == FLASH_ASYNC_LZ_MAX_LITERALS) {
+			n = flash_async_lz_emit(target, out, n, in + 4 * literal, i - literal, 0, 0);
+			literal = i;
+		}
+	}
+
+	if (literal < words)
+		n = flash_async_lz_emit(target, out, n, in + 4 * literal, words - literal, 0, 0);
+
+	return n;
+}
+
+int flash_async_write_compressed(struct flash_bank *bank,
+		const struct flash_async_sink *sink, uint32_t reg_base,
+		const uint8_t *buffer, uint32_t address, uint32_t count,
+		uint32_t *status, uint32_t *fail_address)
+{
+	struct target *target = bank->target;
+	struct reg_param reg_params[5];
+	struct flash_async_loader loader;
+	uint32_t words = count / 4;
+	uint32_t packed_words;
+	uint8_t *code, *packed;
+	uint32_t *head;
+	int retval;
+
+	/* see contrib/loaders/flash/async_unpack.S for src */
+
+	static const uint8_t unpack_code[] = {
+									/* next_token: */
+		0xc3, 0xb3,					/* cbz		r3, done */
+		0x00, 0xf0, 0x23, 0xf8,		/* bl		get_word */
+		0x4f, 0xea, 0x16, 0x4a,		/* lsr		r10, r6, #16 */
+		0x1f, 0xfa, 0x86, 0xfc,		/* uxth		r12, r6 */
+									/* literals: */
+		0xba, 0xf1, 0x00, 0x0f,		/* cmp		r10, #0 */
+		0x09, 0xd0,					/* beq		match */
+		0x00, 0xf0, 0x1a, 0xf8,		/* bl		get_word */
+		0x00, 0xf0, 0x30, 0xf8,		/* bl		put_word */
+		0xb8, 0xf1, 0x00, 0x0f,		/* cmp		r8, #0 */
+		0x25, 0xd1,					/* bne		error */
+		0xaa, 0xf1, 0x01, 0x0a,		/* sub		r10, r10, #1 */
+		0xf2, 0xe7,					/* b		literals */
+									/* match: */
+		0xbc, 0xf1, 0x00, 0x0f,		/* cmp		r12, #0 */
+		0xe8, 0xd0,					/* beq		next_token */
+		0x00, 0xf0, 0x0d, 0xf8,		/* bl		get_word */
+		0xa2, 0xeb, 0x86, 0x0b,		/* sub		r11, r2, r6, lsl #2 */
+									/* copy: */
+		0x5b, 0xf8, 0x04, 0x6b,		/* ldr		r6, [r11], #4 */
+		0x00, 0xf0, 0x1f, 0xf8,		/* bl		put_word */
+		0xb8, 0xf1, 0x00, 0x0f,		/* cmp		r8, #0 */
+		0x14, 0xd1,					/* bne		error */
+		0xbc, 0xf1, 0x01, 0x0c,		/* subs		r12, r12, #1 */
+		0xf5, 0xd1,					/* bne		copy */
+		0xd9, 0xe7,					/* b		next_token */
+									/* get_word: */
+		0xd0, 0xf8, 0x00, 0x80,		/* ldr		r8, [r0, #0] */
+		0xb8, 0xf1, 0x00, 0x0f,		/* cmp		r8, #0 */
+		0x10, 0xd0,					/* beq		exit */
+		0x45, 0x68,					/* ldr		r5, [r0, #4] */
+		0x45, 0x45,					/* cmp		r5, r8 */
+		0xf7, 0xd0,					/* beq		get_word */
+		0x55, 0xf8, 0x04, 0x6b,		/* ldr		r6, [r5], #4 */
+		0x8d, 0x42,					/* cmp		r5, r1 */
+		0x28, 0xbf,					/* it		cs */
+		0x00, 0xf1, 0x08, 0x05,		/* addcs	r5, r0, #8 */
+		0x45, 0x60,					/* str		r5, [r0, #4] */
+		0x5b, 0x1e,					/* subs		r3, r3, #1 */
+		0x70, 0x47,					/* bx		lr */
+									/* error: */
+		0x00, 0x25,					/* movs		r5, #0 */
+		0x45, 0x60,					/* str		r5, [r0, #4] */
+		0x01, 0xe0,					/* b		exit */
+									/* done: */
+		0x4f, 0xf0, 0x00, 0x08,		/* mov		r8, #0 */
+									/* exit: */
+		0x40, 0x46,					/* mov		r0, r8 */
+		0x00, 0xbe,					/* bkpt		#0 */
+									/* put_word: (sink code) */
+	};
+
+	if (!async_compress || words == 0 || (address & 3))
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	code = malloc(sizeof(unpack_code) + sink->code_size);
+	packed = malloc(4 * (words + words / FLASH_ASYNC_LZ_MAX_LITERALS + 1));
+	head = malloc(sizeof(uint32_t) << FLASH_ASYNC_LZ_HASH_BITS);
+	if (code == NULL || packed == NULL || head == NULL) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup;
+	}
+
+	packed_words = flash_async_lz_compress(target, buffer, words, packed, head);
+
+	/* not worth the slower loader unless the link is the bottleneck */
+	if (packed_words > words - words / 8) {
+		LOG_DEBUG("%" PRIu32 " bytes only compress to %" PRIu32 ", not compressing",
+				4 * words, 4 * packed_words);
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup;
+	}
+
+	LOG_DEBUG("compressed %" PRIu32 " bytes at 0x%8.8" PRIx32 " to %" PRIu32,
+			4 * words, address, 4 * packed_words);
+
+	memcpy(code, unpack_code, sizeof(unpack_code));
+	memcpy(code + sizeof(unpack_code), sink->code, sink->code_size);
+
+	memset(&loader, 0, sizeof(loader));
+	loader.code = code;
+	loader.code_size = sizeof(unpack_code) + sink->code_size;
+	loader.block_size = 4;
+	loader.fifo_size = FLASH_ASYNC_LZ_FIFO_SIZE;
+	loader.fifo_start_param = 0;
+	loader.fifo_end_param = 1;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* buffer start, status (out) */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* buffer end */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_IN_OUT);	/* target address */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* count (words) */
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);	/* flash register base */
+
+	buf_set_u32(reg_params[2].value, 0, 32, address);
+	buf_set_u32(reg_params[3].value, 0, 32, packed_words);
+	buf_set_u32(reg_params[4].value, 0, 32, reg_base);
+
+	retval = flash_async_stream(bank, &loader, packed, packed_words, 4 * words,
+			5, reg_params);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED) {
+		*status = buf_get_u32(reg_params[0].value, 0, 32);
+		*fail_address = buf_get_u32(reg_params[2].value, 0, 32);
+	}
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+	destroy_reg_param(&reg_params[3]);
+	destroy_reg_param(&reg_params[4]);
+
+cleanup:
+	free(head);
+	free(packed);
+	free(code);
+
+	return retval;
+}
+
+void flash_async_set_compress(bool enable)
+{
+	async_compress = enable;
+}
+
+bool flash_async_get_compress(void)
+{
+	return async_compress;
+}
+
+void flash_async_get_stats(struct flash_async_stats *stats)
+{
+	*stats = async_stats;
+}
+
+void flash_async_reset_stats(void)
+{
+	memset(&async_stats, 0, sizeof(async_stats));
+}
@@ -0,0 +1,119 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef FLASH_NOR_ASYNC_H
+#define FLASH_NOR_ASYNC_H
+
+#include <flash/nor/core.h>
+
+struct reg_param;
+
+/**
+ * @file
+ * Streams data to a target-resident flash loader through the FIFO
+ * protocol of target_run_flash_async_algorithm(): the loader keeps
+ * programming while the host refills the ring buffer behind it.
+ *
+ * The FIFO working area starts with the write and read pointers, both
+ * owned by the protocol; the loader gets the FIFO start and end
+ * addresses in two of its registers, consumes one block at a time,
+ * stores its read pointer back after each block, stops when the write
+ * pointer is zero and sets the read pointer to zero on error.
+ *
+ * This needs a core whose memory can be accessed while it runs, which
+ * today means ARMv7-M; elsewhere flash_async_write() reports
+ * ERROR_TARGET_RESOURCE_NOT_AVAILABLE so drivers can use their
+ * blockwise or word-at-a-time paths.
+ */
+
+/** A position independent FIFO flash loader. */
+struct flash_async_loader {
+	const uint8_t *code;	/**< Loader code, entered at offset zero. */
+	uint32_t code_size;
+	uint32_t block_size;	/**< Bytes consumed per step, a power of two. */
+	uint32_t fifo_size;	/**< Preferred FIFO size in bytes, zero for 16 KiB. */
+	uint32_t fifo_min;	/**< Give up below this FIFO size, zero for 256 bytes. */
+	int fifo_start_param;	/**< reg_params index receiving the FIFO start address. */
+	int fifo_end_param;	/**< reg_params index receiving the FIFO end address. */
+};
+
+/**
+ * Loads @a loader into a working area, allocates its FIFO and streams
+ * @a count blocks from @a buffer through it.  The caller initializes
+ * all other register parameters and evaluates the loader's outputs
+ * afterwards; both working areas are released before returning.
+ *
+ * @returns ERROR_OK on success, ERROR_TARGET_RESOURCE_NOT_AVAILABLE if
+ * the target or its working area can't run the loader, and
+ * ERROR_FLASH_OPERATION_FAILED if the loader reported an error.
+ */
+int flash_async_write(struct flash_bank *bank,
+		const struct flash_async_loader *loader,
+		uint8_t *buffer, uint32_t count,
+		int num_reg_params, struct reg_param *reg_params);
+
+/**
+ * The target specific part of a compressed stream loader: a Thumb-2
+ * routine appended to the generic decompressor, see
+ * contrib/loaders/flash/async_unpack.S.  It is called with the word to
+ * program in r6, the flash address in r2 and the register base given
+ * to flash_async_write_compressed() in r4.  It must advance r2 by four,
+ * may clobber r6 to r9 and returns the error status in r8, zero when
+ * the word was programmed.
+ */
+struct flash_async_sink {
+	const uint8_t *code;
+	uint32_t code_size;
+};
+
+/**
+ * Compresses @a count bytes from @a buffer on the host and streams them
+ * to a decompressor on the target, which hands the data to @a sink one
+ * word at a time.  Repeated data is copied from flash already written
+ * by this call, so the decompressor needs no RAM beyond its FIFO.
+ *
+ * Only used while enabled by flash_async_set_compress(), and only if
+ * the data shrinks noticeably.
+ *
+ * @param status Receives r8 of the sink when the loader fails.
+ * @param fail_address Receives the flash address reached on failure.
+ * @returns ERROR_OK on success, ERROR_TARGET_RESOURCE_NOT_AVAILABLE if
+ * the data should be written uncompressed instead, and
+ * ERROR_FLASH_OPERATION_FAILED if the loader reported an error.
+ */
+int flash_async_write_compressed(struct flash_bank *bank,
+		const struct flash_async_sink *sink, uint32_t reg_base,
+		const uint8_t *buffer, uint32_t address, uint32_t count,
+		uint32_t *status, uint32_t *fail_address);
+
+/** Enables or disables flash_async_write_compressed(). */
+void flash_async_set_compress(bool enable);
+bool flash_async_get_compress(void);
+
+/** Totals for all data streamed through flash_async_write(). */
+struct flash_async_stats {
+	uint64_t bytes;		/**< payload bytes streamed */
+	uint64_t link_bytes;	/**< bytes sent to the target, less if compressed */
+	unsigned runs;		/**< loader invocations */
+	unsigned fallbacks;	/**< requests refused for lack of resources */
+	double seconds;		/**< time spent streaming */
+};
+
+void flash_async_get_stats(struct flash_async_stats *stats);
+void flash_async_reset_stats(void);
+
+#endif /* FLASH_NOR_ASYNC_H */
@@ -1848,18 +1848,13 @@ do_retry:
 }
 
 /**
- * Performs the given command and wait until its completion (or an error).
+ * Waits for the command started last to complete (or an error).
  * @param pPrivate - info about the bank
- * @param command  - Command to perform.
- * @param argument - Optional command argument.
  * @param status   - put command status bits here
  */
-static int EFC_PerformCommand(struct sam3_bank_private *pPrivate,
-	unsigned command,
-	unsigned argument,
+static int EFC_WaitCommand(struct sam3_bank_private *pPrivate,
 	uint32_t *status)
 {
-
 	int r;
 	uint32_t v;
 	long long ms_now, ms_end;
@@ -1868,10 +1863,6 @@ static int EFC_PerformCommand(struct sam3_bank_private *pPrivate,
 	if (status)
 		*status = 0;
 
-	r = EFC_StartCommand(pPrivate, command, argument);
-	if (r != ERROR_OK)
-		return r;
-
 	ms_end = 500 + timeval_ms();
 
 	do {
@@ -1893,6 +1884,31 @@ static int EFC_PerformCommand(struct sam3_bank_private *pPrivate,
 
 }
 
+/**
+ * Performs the given command and wait until its completion (or an error).
+ * @param pPrivate - info about the bank
+ * @param command  - Command to perform.
+ * @param argument - Optional command argument.
+ * @param status   - put command status bits here
+ */
+static int EFC_PerformCommand(struct sam3_bank_private *pPrivate,
+	unsigned command,
+	unsigned argument,
+	uint32_t *status)
+{
+	int r;
+
+	/* default */
+	if (status)
+		*status = 0;
+
+	r = EFC_StartCommand(pPrivate, command, argument);
+	if (r != ERROR_OK)
+		return r;
+
+	return EFC_WaitCommand(pPrivate, status);
+}
+
 /**
  * Read the unique ID.
  * @param pPrivate - info about the bank
@@ -3117,10 +3133,10 @@ static const uint8_t
 	0x00, 0xBE				/* bkpt #0 */
 };
 
-static int sam3_page_write(struct sam3_bank_private *pPrivate, unsigned pagenum, uint8_t *buf)
+/* load a page into the latch buffer and start programming it */
+static int sam3_page_start(struct sam3_bank_private *pPrivate, unsigned pagenum, uint8_t *buf)
 {
 	uint32_t adr;
-	uint32_t status;
 	uint32_t fmr;	/* EEFC Flash Mode Register */
 	int r;
 
@@ -3155,12 +3171,25 @@ static int sam3_page_write(struct sam3_bank_private *pPrivate, unsigned pagenum,
 		return r;
 	}
 
-	r = EFC_PerformCommand(pPrivate,
-			/* send Erase & Write Page */
-			AT91C_EFC_FCMD_EWP,
-			pagenum,
-			&status);
+	/* send Erase & Write Page */
+	r = EFC_StartCommand(pPrivate, AT91C_EFC_FCMD_EWP, pagenum);
+	if (r != ERROR_OK)
+		LOG_ERROR("SAM3: Error performing Erase & Write page @ phys address 0x%08x",
+			(unsigned int)(adr));
+	return r;
+}
 
+/* wait for the page started by sam3_page_start() to be programmed */
+static int sam3_page_finish(struct sam3_bank_private *pPrivate, unsigned pagenum)
+{
+	uint32_t adr;
+	uint32_t status;
+	int r;
+
+	adr = pagenum * pPrivate->page_size;
+	adr += pPrivate->base_address;
+
+	r = EFC_WaitCommand(pPrivate, &status);
 	if (r != ERROR_OK)
 		LOG_ERROR("SAM3: Error performing Erase & Write page @ phys address 0x%08x",
 			(unsigned int)(adr));
@@ -3172,7 +3201,17 @@ static int sam3_page_write(struct sam3_bank_private *pPrivate, unsigned pagenum,
 		LOG_ERROR("SAM3: Flash Command error @phys address 0x%08x", (unsigned int)(adr));
 		return ERROR_FAIL;
 	}
-	return ERROR_OK;
+	return r;
+}
+
+static int sam3_page_write(struct sam3_bank_private *pPrivate, unsigned pagenum, uint8_t *buf)
+{
+	int r;
+
+	r = sam3_page_start(pPrivate, pagenum, buf);
+	if (r != ERROR_OK)
+		return r;
+	return sam3_page_finish(pPrivate, pagenum);
 }
 
 static int sam3_write(struct flash_bank *bank,
@@ -3325,6 +3364,102 @@ done:
 	return r;
 }
 
+/*
+ * Chips with two EEFCs (e.g. SAM3U4, SAM3X8) can program a page in
+ * each bank at the same time: start a page on every controller, then
+ * wait for each one in turn and hand it its next page.  Partial pages
+ * at the ends of a job go through sam3_write() first.
+ */
+static int sam3_write_concurrent(struct flash_write_job *jobs, int num_jobs)
+{
+	struct sam3_bank_private *pPrivate[SAM3_MAX_FLASH_BANKS];
+	unsigned page_cur[SAM3_MAX_FLASH_BANKS];
+	unsigned page_stop[SAM3_MAX_FLASH_BANKS];
+	bool busy[SAM3_MAX_FLASH_BANKS];
+	uint8_t *buffer[SAM3_MAX_FLASH_BANKS];
+	int r = ERROR_OK;
+	int i, j;
+
+	if (num_jobs > SAM3_MAX_FLASH_BANKS)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	for (i = 0; i < num_jobs; i++) {
+		pPrivate[i] = get_sam3_bank_private(jobs[i].bank);
+		if (!pPrivate[i] || !pPrivate[i]->probed
+				|| jobs[i].bank->target->state != TARGET_HALTED
+				|| pPrivate[i]->pChip != pPrivate[0]->pChip
+				|| jobs[i].offset + jobs[i].count > pPrivate[i]->size_bytes)
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		for (j = 0; j < i; j++) {
+			if (pPrivate[j]->controller_address == pPrivate[i]->controller_address)
+				return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+		unsigned page_size = pPrivate[i]->page_size;
+		uint32_t offset = jobs[i].offset;
+		uint32_t end = offset + jobs[i].count;
+		uint32_t head = (page_size - (offset % page_size)) % page_size;
+		uint32_t tail = end % page_size;
+
+		if (head >= jobs[i].count || end - tail <= offset + head) {
+			/* less than one full page, nothing to overlap */
+			r = sam3_write(jobs[i].bank, jobs[i].buffer, offset, jobs[i].count);
+			head = jobs[i].count;
+			tail = 0;
+		} else {
+			if (head)
+				r = sam3_write(jobs[i].bank, jobs[i].buffer, offset, head);
+			if (r == ERROR_OK && tail)
+				r = sam3_write(jobs[i].bank, jobs[i].buffer + jobs[i].count - tail,
+						end - tail, tail);
+		}
+		if (r != ERROR_OK)
+			return r;
+
+		buffer[i] = jobs[i].buffer + head;
+		page_cur[i] = (offset + head) / page_size;
+		page_stop[i] = (end - tail) / page_size;
+		busy[i] = false;
+	}
+
+	for (;;) {
+		bool more = false;
+
+		for (i = 0; i < num_jobs; i++) {
+			if (page_cur[i] >= page_stop[i])
+				continue;
+			if (busy[i]) {
+				r = sam3_page_finish(pPrivate[i], page_cur[i] - 1);
+				busy[i] = false;
+				if (r != ERROR_OK)
+					goto done;
+			}
+			r = sam3_page_start(pPrivate[i], page_cur[i], buffer[i]);
+			if (r != ERROR_OK)
+				goto done;
+			busy[i] = true;
+			buffer[i] += pPrivate[i]->page_size;
+			page_cur[i]++;
+			more = true;
+		}
+		if (!more)
+			break;
+	}
+
+done:
+	/* let every controller finish before reporting */
+	for (i = 0; i < num_jobs; i++) {
+		if (busy[i]) {
+			int r2 = sam3_page_finish(pPrivate[i], page_cur[i] - 1);
+			if (r == ERROR_OK)
+				r = r2;
+		}
+	}
+	return r;
+}
+
 COMMAND_HANDLER(sam3_handle_info_command)
 {
 	struct sam3_chip *pChip;
@@ -3550,6 +3685,7 @@ struct flash_driver at91sam3_flash = {
 	.erase = sam3_erase,
 	.protect = sam3_protect,
 	.write = sam3_write,
+	.write_concurrent = sam3_write_concurrent,
 	.read = default_flash_read,
 	.probe = sam3_probe,
 	.auto_probe = sam3_auto_probe,
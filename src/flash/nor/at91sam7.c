@@ -584,6 +584,10 @@ static int at91sam7_read_part_info(struct flash_bank *bank)
 				fb->driver = bank->driver;
 				fb->driver_priv = malloc(sizeof(struct at91sam7_flash_bank));
 				fb->name = "sam7_probed";
+				fb->erase_pending = false;
+				fb->cache = NULL;
+				fb->cache_sectors = 0;
+				fb->cache_generation = 0;
 				fb->next = NULL;
 
 				/* link created bank in 'flash_banks' list */
@@ -649,8 +653,6 @@ static int at91sam7_erase_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
 	uint16_t retval;
-	uint32_t blank;
-	uint16_t fast_check;
 	uint8_t *buffer;
 	uint16_t nSector;
 	uint16_t nByte;
@@ -664,23 +666,7 @@ static int at91sam7_erase_check(struct flash_bank *bank)
 	at91sam7_read_clock_info(bank);
 	at91sam7_set_flash_mode(bank, FMR_TIMING_FLASH);
 
-	fast_check = 1;
-	for (nSector = 0; nSector < bank->num_sectors; nSector++) {
-		retval = target_blank_check_memory(target,
-				bank->base + bank->sectors[nSector].offset,
-				bank->sectors[nSector].size,
-				&blank);
-		if (retval != ERROR_OK) {
-			fast_check = 0;
-			break;
-		}
-		if (blank == 0xFF)
-			bank->sectors[nSector].is_erased = 1;
-		else
-			bank->sectors[nSector].is_erased = 0;
-	}
-
-	if (fast_check)
+	if (flash_blank_check_sectors(bank, 0xff) == ERROR_OK)
 		return ERROR_OK;
 
 	LOG_USER("Running slow fallback erase check - add working memory");
@@ -822,6 +808,10 @@ FLASH_BANK_COMMAND_HANDLER(at91sam7_flash_bank_command)
 				fb->driver = bank->driver;
 				fb->driver_priv = malloc(sizeof(struct at91sam7_flash_bank));
 				fb->name = "sam7_probed";
+				fb->erase_pending = false;
+				fb->cache = NULL;
+				fb->cache_sectors = 0;
+				fb->cache_generation = 0;
 				fb->next = NULL;
 
 				/* link created bank in 'flash_banks' list */
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include "batch.h"
+#include <target/armv7m.h>
+#include <target/arm_adi_v5.h>
+
+/* words queued before the queue is run */
+#define FLASH_BATCH_WORDS	64
+/* most status reads queued between two words */
+#define FLASH_BATCH_MAX_POLLS	16
+/* status reads after a batch before giving up on the last word */
+#define FLASH_BATCH_TIMEOUT_POLLS	100
+
+struct flash_batch {
+	struct adiv5_dap *dap;
+	unsigned polls;		/**< status reads before each word */
+	uint32_t status[FLASH_BATCH_WORDS * FLASH_BATCH_MAX_POLLS];
+};
+
+int flash_batch_write_u32(struct flash_batch *batch, uint32_t address, uint32_t value)
+{
+	return mem_ap_write_u32(batch->dap, address, value);
+}
+
+int flash_batch_write_u8(struct flash_batch *batch, uint32_t address, uint8_t value)
+{
+	int retval = dap_setup_accessport(batch->dap, CSW_8BIT | CSW_ADDRINC_OFF, address);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the byte goes on its own lane of the data bus */
+	return dap_queue_ap_write(batch->dap, AP_REG_DRW, (uint32_t)value << 8 * (address & 3));
+}
+
+static bool flash_batch_busy(const struct flash_batch_ops *ops, uint32_t status)
+{
+	return (status & ops->busy_mask) == ops->busy_value;
+}
+
+/* wait for the controller to finish the last word */
+static int flash_batch_wait(struct flash_bank *bank,
+		const struct flash_batch_ops *ops, uint32_t *status)
+{
+	for (int i = 0; i < FLASH_BATCH_TIMEOUT_POLLS; i++) {
+		int retval = target_read_u32(bank->target, ops->status_reg, status);
+		if (retval != ERROR_OK)
+			return retval;
+		if (!flash_batch_busy(ops, *status))
+			return ERROR_OK;
+	}
+
+	LOG_ERROR("timeout waiting for the flash controller");
+	return ERROR_FLASH_OPERATION_FAILED;
+}
+
+/* program whatever part of a batch didn't make it, a word at a time */
+static int flash_batch_repair(struct flash_bank *bank,
+		const struct flash_batch_ops *ops, uint32_t address,
+		const uint8_t *buffer, uint32_t count, unsigned *repaired)
+{
+	struct target *target = bank->target;
+	uint8_t readback[FLASH_BATCH_WORDS * 4];
+	int retval;
+
+	if (ops->recover) {
+		retval = ops->recover(bank);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = target_read_buffer(target, address, count * 4, readback);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (memcmp(readback + 4 * i, buffer + 4 * i, 4) == 0)
+			continue;
+		if (target_buffer_get_u32(target, readback + 4 * i) != 0xffffffff) {
+			LOG_ERROR("flash word at 0x%8.8" PRIx32 " programmed wrongly",
+				address + 4 * i);
+			return ERROR_FLASH_OPERATION_FAILED;
+		}
+
+		retval = ops->write_word(bank, address + 4 * i,
+				target_buffer_get_u32(target, buffer + 4 * i));
+		if (retval != ERROR_OK)
+			return retval;
+		(*repaired)++;
+	}
+
+	return ERROR_OK;
+}
+
+int flash_batch_write_words(struct flash_bank *bank, const struct flash_batch_ops *ops,
+		uint32_t address, const uint8_t *buffer, uint32_t count)
+{
+	struct target *target = bank->target;
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct flash_batch *batch;
+	unsigned batches = 0, failed = 0, repaired = 0;
+	uint32_t status;
+	int retval = ERROR_OK;
+
+	if (!is_armv7m(armv7m) || armv7m->stlink || armv7m->arm.dap == NULL)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	batch = malloc(sizeof(*batch));
+	if (batch == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	batch->dap = armv7m->arm.dap;
+	batch->polls = 1;
+
+	if (ops->recover)
+		retval = ops->recover(bank);
+
+	while (count > 0 && retval == ERROR_OK) {
+		uint32_t n = count < FLASH_BATCH_WORDS ? count : FLASH_BATCH_WORDS;
+		bool ok;
+
+		for (uint32_t i = 0; i < n && retval == ERROR_OK; i++) {
+			for (unsigned p = 0; p < batch->polls && retval == ERROR_OK; p++)
+				retval = mem_ap_read_u32(batch->dap, ops->status_reg,
+						&batch->status[i * batch->polls + p]);
+			if (retval == ERROR_OK)
+				retval = ops->queue_word(batch, address + 4 * i,
+						target_buffer_get_u32(target, buffer + 4 * i));
+		}
+		if (retval == ERROR_OK)
+			retval = dap_run(batch->dap);
+		if (retval == ERROR_OK)
+			retval = flash_batch_wait(bank, ops, &status);
+		if (retval != ERROR_OK)
+			break;
+		batches++;
+
+		/* the last read before each word tells how its predecessor went */
+		ok = !(status & ops->error_mask);
+		for (uint32_t i = 0; i < n && ok; i++) {
+			uint32_t before = batch->status[i * batch->polls + batch->polls - 1];
+			ok = !flash_batch_busy(ops, before) && !(before & ops->error_mask);
+		}
+
+		if (!ok) {
+			failed++;
+			if (batch->polls < FLASH_BATCH_MAX_POLLS)
+				batch->polls *= 2;
+			retval = flash_batch_repair(bank, ops, address, buffer, n, &repaired);
+		}
+
+		address += 4 * n;
+		buffer += 4 * n;
+		count -= n;
+	}
+
+	LOG_DEBUG("%u batches, %u checked after a busy or failed status, "
+			"%u words programmed singly, %u status reads per word",
+			batches, failed, repaired, batch->polls);
+
+	free(batch);
+
+	return retval;
+}
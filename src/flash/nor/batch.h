@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef FLASH_NOR_BATCH_H
+#define FLASH_NOR_BATCH_H
+
+#include <flash/nor/core.h>
+
+/**
+ * @file
+ * Word programming through flash controller registers, without an
+ * algorithm running on the target.
+ *
+ * Instead of polling the controller after every word, the register
+ * writes for many words are queued on the MEM-AP and sent in one
+ * go, each preceded by reads of the status register whose results are
+ * only looked at afterwards.  If one of them shows that the previous
+ * word was still being programmed, or failed, the words of that batch
+ * are read back and those still erased are programmed one at a time;
+ * the number of status reads between words is doubled for the next
+ * batches.
+ *
+ * This needs an ADIv5 debug port, which today means a Cortex-M that is
+ * not behind a high level adapter; elsewhere flash_batch_write_words()
+ * reports ERROR_TARGET_RESOURCE_NOT_AVAILABLE so drivers can use their
+ * word-at-a-time paths.
+ */
+
+struct flash_batch;
+
+/** How a flash controller programs one word. */
+struct flash_batch_ops {
+	uint32_t status_reg;	/**< register telling whether it is busy */
+	uint32_t busy_mask;	/**< busy while (status & busy_mask) == busy_value */
+	uint32_t busy_value;
+	uint32_t error_mask;	/**< status bits flagging a failed command */
+	/** Queues the register writes that program @a word at @a address. */
+	int (*queue_word)(struct flash_batch *batch, uint32_t address, uint32_t word);
+	/** Programs a single word, waiting for and checking the result. */
+	int (*write_word)(struct flash_bank *bank, uint32_t address, uint32_t word);
+	/** Optional: clears error flags left behind by a failed batch. */
+	int (*recover)(struct flash_bank *bank);
+};
+
+/** Queues a register write, for flash_batch_ops::queue_word. */
+int flash_batch_write_u32(struct flash_batch *batch, uint32_t address, uint32_t value);
+/** Same as flash_batch_write_u32(), for byte wide registers. */
+int flash_batch_write_u8(struct flash_batch *batch, uint32_t address, uint8_t value);
+
+/**
+ * Programs @a count words from @a buffer, in target byte order, at
+ * @a address, which the flash must hold erased.
+ *
+ * @returns ERROR_OK on success, ERROR_TARGET_RESOURCE_NOT_AVAILABLE if
+ * the target's debug port can't queue memory accesses, or an error.
+ */
+int flash_batch_write_words(struct flash_bank *bank, const struct flash_batch_ops *ops,
+		uint32_t address, const uint8_t *buffer, uint32_t count);
+
+#endif /* FLASH_NOR_BATCH_H */
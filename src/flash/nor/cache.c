@@ -0,0 +1,325 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <target/image.h>
+
+/**
+ * @file
+ * Host side record of flash sector contents.
+ *
+ * Whenever the flash core writes or reads a complete sector, it keeps
+ * the sector's checksum and, if so configured, a copy of its contents,
+ * tagged with the bank's current cache generation.  Events after which
+ * the contents can't be trusted, such as a reset, advance the
+ * generation, which retires all entries of the bank at once; erasing
+ * or writing memory retires individual sectors.
+ */
+
+struct flash_sector_cache {
+	uint32_t generation;	/**< zero if never recorded */
+	uint32_t offset;	/**< sector geometry when recorded */
+	uint32_t size;
+	uint32_t crc;
+	uint8_t *data;		/**< contents, NULL in FLASH_CACHE_CRC mode */
+};
+
+static enum flash_cache_mode cache_mode;
+static bool cache_callback_registered;
+
+/* the bank's entry for @a sector if it holds a current record */
+static struct flash_sector_cache *flash_cache_lookup(struct flash_bank *bank, int sector)
+{
+	struct flash_sector_cache *entry;
+
+	if (bank->cache == NULL || sector >= bank->cache_sectors)
+		return NULL;
+
+	entry = &bank->cache[sector];
+	if (entry->generation != bank->cache_generation
+			|| entry->offset != bank->sectors[sector].offset
+			|| entry->size != bank->sectors[sector].size)
+		return NULL;
+
+	return entry;
+}
+
+static bool flash_cache_alloc(struct flash_bank *bank)
+{
+	if (bank->cache && bank->cache_sectors == bank->num_sectors)
+		return true;
+
+	flash_cache_flush(bank);
+
+	bank->cache = calloc(bank->num_sectors, sizeof(*bank->cache));
+	if (bank->cache == NULL)
+		return false;
+	bank->cache_sectors = bank->num_sectors;
+	bank->cache_generation = 1;
+
+	return true;
+}
+
+void flash_cache_flush(struct flash_bank *bank)
+{
+	for (int i = 0; i < bank->cache_sectors; i++)
+		free(bank->cache[i].data);
+	free(bank->cache);
+	bank->cache = NULL;
+	bank->cache_sectors = 0;
+}
+
+/* retire all entries of @a bank */
+static void flash_cache_new_generation(struct flash_bank *bank)
+{
+	if (bank->cache == NULL)
+		return;
+
+	if (++bank->cache_generation == 0) {
+		/* wrapped, no entry may match by accident */
+		for (int i = 0; i < bank->cache_sectors; i++)
+			bank->cache[i].generation = 0;
+		bank->cache_generation = 1;
+	}
+}
+
+void flash_cache_invalidate(struct flash_bank *bank, int first, int last)
+{
+	for (int i = first; i <= last && i < bank->cache_sectors; i++)
+		bank->cache[i].generation = 0;
+}
+
+void flash_cache_update(struct flash_bank *bank,
+		const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	uint32_t end = offset + count;
+
+	if (cache_mode == FLASH_CACHE_OFF || !flash_cache_alloc(bank))
+		return;
+
+	for (int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		struct flash_sector_cache *entry = &bank->cache[i];
+		uint32_t start = sector->offset;
+		uint32_t stop = sector->offset + sector->size;
+
+		if (stop <= offset || start >= end)
+			continue;
+
+		if (start < offset || stop > end) {
+			/* a partial update needs the rest of the sector */
+			if (flash_cache_lookup(bank, i) == NULL || entry->data == NULL) {
+				entry->generation = 0;
+				continue;
+			}
+			if (start < offset)
+				start = offset;
+			if (stop > end)
+				stop = end;
+			memcpy(entry->data + start - sector->offset,
+					buffer + start - offset, stop - start);
+		} else if (cache_mode == FLASH_CACHE_CONTENT) {
+			uint8_t *data = realloc(entry->data, sector->size);
+			if (data == NULL) {
+				entry->generation = 0;
+				continue;
+			}
+			entry->data = data;
+			memcpy(data, buffer + start - offset, sector->size);
+		} else {
+			free(entry->data);
+			entry->data = NULL;
+		}
+
+		if (image_calculate_checksum(entry->data ? entry->data
+					: (uint8_t *)buffer + sector->offset - offset,
+					sector->size, &entry->crc) != ERROR_OK) {
+			entry->generation = 0;
+			continue;
+		}
+		entry->offset = sector->offset;
+		entry->size = sector->size;
+		entry->generation = bank->cache_generation;
+	}
+}
+
+/* the bank holding all of @a count bytes at @a addr, if any */
+static struct flash_bank *flash_cache_bank(struct target *target,
+		uint32_t addr, uint32_t count)
+{
+	if (cache_mode == FLASH_CACHE_OFF || count == 0)
+		return NULL;
+
+	for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next) {
+		if (bank->target != target || bank->cache == NULL)
+			continue;
+		if (addr >= bank->base && addr - bank->base < bank->size
+				&& count <= bank->size - (addr - bank->base))
+			return bank;
+	}
+
+	return NULL;
+}
+
+bool flash_cache_read(struct target *target,
+		uint32_t addr, uint32_t count, uint8_t *buffer)
+{
+	struct flash_bank *bank = flash_cache_bank(target, addr, count);
+	uint32_t offset, end;
+
+	if (bank == NULL)
+		return false;
+
+	offset = addr - bank->base;
+	end = offset + count;
+
+	/* first make sure every byte is known */
+	uint32_t covered = offset;
+	for (int i = 0; i < bank->num_sectors && covered < end; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		struct flash_sector_cache *entry;
+
+		if (sector->offset > covered || sector->offset + sector->size <= covered)
+			continue;
+		entry = flash_cache_lookup(bank, i);
+		if (entry == NULL || entry->data == NULL)
+			return false;
+		covered = sector->offset + sector->size;
+	}
+	if (covered < end)
+		return false;
+
+	for (int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		uint32_t start = sector->offset;
+		uint32_t stop = sector->offset + sector->size;
+
+		if (stop <= offset || start >= end)
+			continue;
+		if (start < offset)
+			start = offset;
+		if (stop > end)
+			stop = end;
+		memcpy(buffer + start - offset,
+				bank->cache[i].data + start - sector->offset, stop - start);
+	}
+
+	LOG_DEBUG("served %" PRIu32 " bytes at 0x%8.8" PRIx32 " from the flash cache",
+			count, addr);
+	return true;
+}
+
+bool flash_cache_checksum(struct target *target,
+		uint32_t addr, uint32_t count, uint32_t *crc)
+{
+	struct flash_bank *bank = flash_cache_bank(target, addr, count);
+	uint8_t *buffer;
+	bool known;
+
+	if (bank == NULL)
+		return false;
+
+	/* a single recorded sector even without its contents */
+	for (int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector_cache *entry;
+
+		if (bank->base + bank->sectors[i].offset != addr
+				|| bank->sectors[i].size != count)
+			continue;
+		entry = flash_cache_lookup(bank, i);
+		if (entry == NULL)
+			return false;
+		*crc = entry->crc;
+		return true;
+	}
+
+	if (cache_mode != FLASH_CACHE_CONTENT)
+		return false;
+
+	buffer = malloc(count);
+	if (buffer == NULL)
+		return false;
+
+	known = flash_cache_read(target, addr, count, buffer)
+		&& image_calculate_checksum(buffer, count, crc) == ERROR_OK;
+
+	free(buffer);
+	return known;
+}
+
+void flash_cache_invalidate_range(struct target *target,
+		uint32_t addr, uint32_t count)
+{
+	if (cache_mode == FLASH_CACHE_OFF || count == 0)
+		return;
+
+	for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next) {
+		if (bank->target != target || bank->cache == NULL)
+			continue;
+		if (addr + count <= bank->base || addr >= bank->base + bank->size)
+			continue;
+
+		for (int i = 0; i < bank->cache_sectors && i < bank->num_sectors; i++) {
+			uint32_t start = bank->base + bank->sectors[i].offset;
+			if (addr < start + bank->sectors[i].size && addr + count > start)
+				bank->cache[i].generation = 0;
+		}
+	}
+}
+
+static int flash_cache_event_handler(struct target *target,
+		enum target_event event, void *priv)
+{
+	switch (event) {
+	case TARGET_EVENT_RESET_START:
+	case TARGET_EVENT_RESET_ASSERT_PRE:
+	case TARGET_EVENT_RESUMED:
+		/* the application might write its own flash */
+		for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next) {
+			if (bank->target == target)
+				flash_cache_new_generation(bank);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return ERROR_OK;
+}
+
+void flash_cache_set_mode(enum flash_cache_mode mode)
+{
+	if (mode != cache_mode) {
+		for (struct flash_bank *bank = flash_bank_list(); bank; bank = bank->next)
+			flash_cache_flush(bank);
+	}
+	cache_mode = mode;
+
+	if (mode != FLASH_CACHE_OFF && !cache_callback_registered) {
+		target_register_event_callback(flash_cache_event_handler, NULL);
+		cache_callback_registered = true;
+	}
+}
+
+enum flash_cache_mode flash_cache_get_mode(void)
+{
+	return cache_mode;
+}
@@ -29,11 +29,13 @@
 #include "imp.h"
 #include "cfi.h"
 #include "non_cfi.h"
+#include "async.h"
 #include <target/arm.h>
 #include <target/arm7_9_common.h>
 #include <target/armv7m.h>
 #include <target/mips32.h>
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 
 #define CFI_MAX_BUS_WIDTH       4
@@ -147,6 +149,16 @@ static void cfi_command(struct flash_bank *bank, uint8_t cmd, uint8_t *cmd_buf)
 	}
 }
 
+/* index of byte @a byte of chip @a chip within a bus word */
+static inline int cfi_lane_index(struct flash_bank *bank, int chip, int byte)
+{
+	int index = chip * bank->chip_width + byte;
+
+	if (bank->target->endianness == TARGET_LITTLE_ENDIAN)
+		return index;
+	return bank->bus_width - 1 - index;
+}
+
 static int cfi_send_command(struct flash_bank *bank, uint8_t cmd, uint32_t address)
 {
 	uint8_t command[CFI_MAX_BUS_WIDTH];
@@ -155,6 +167,21 @@ static int cfi_send_command(struct flash_bank *bank, uint8_t cmd, uint32_t addre
 	return target_write_memory(bank->target, address, bank->bus_width, 1, command);
 }
 
+/* like cfi_send_command(), but @a value spans the whole chip width,
+ * as needed for the word count of a buffered write
+ */
+static int cfi_send_value(struct flash_bank *bank, uint32_t value, uint32_t address)
+{
+	uint8_t data[CFI_MAX_BUS_WIDTH];
+	int i, j;
+
+	for (i = 0; i < bank->bus_width / bank->chip_width; i++)
+		for (j = 0; j < bank->chip_width; j++)
+			data[cfi_lane_index(bank, i, j)] = value >> (8 * j);
+
+	return target_write_memory(bank->target, address, bank->bus_width, 1, data);
+}
+
 /* read unsigned 8-bit value from the bank
  * flash banks are expected to be made of similar chips
  * the query result should be the same for all
@@ -178,34 +205,44 @@ static int cfi_query_u8(struct flash_bank *bank, int sector, uint32_t offset, ui
 	return ERROR_OK;
 }
 
+/* read the low byte of every chip on the bus, i.e. their individual
+ * status when a command is in progress
+ */
+static int cfi_get_lanes(struct flash_bank *bank, uint32_t address, uint8_t *lanes)
+{
+	uint8_t data[CFI_MAX_BUS_WIDTH];
+	int i;
+
+	int retval;
+	retval = target_read_memory(bank->target, address, bank->bus_width, 1, data);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (i = 0; i < bank->bus_width / bank->chip_width; i++)
+		lanes[i] = data[cfi_lane_index(bank, i, 0)];
+
+	return ERROR_OK;
+}
+
 /* read unsigned 8-bit value from the bank
  * in case of a bank made of multiple chips,
  * the individual values are ORed
  */
 static int cfi_get_u8(struct flash_bank *bank, int sector, uint32_t offset, uint8_t *val)
 {
-	struct target *target = bank->target;
-	uint8_t data[CFI_MAX_BUS_WIDTH];
+	uint8_t lanes[CFI_MAX_BUS_WIDTH];
+	uint8_t value = 0;
 	int i;
 
 	int retval;
-	retval = target_read_memory(target, flash_address(bank, sector, offset),
-			bank->bus_width, 1, data);
+	retval = cfi_get_lanes(bank, flash_address(bank, sector, offset), lanes);
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (bank->target->endianness == TARGET_LITTLE_ENDIAN) {
-		for (i = 0; i < bank->bus_width / bank->chip_width; i++)
-			data[0] |= data[i];
+	for (i = 0; i < bank->bus_width / bank->chip_width; i++)
+		value |= lanes[i];
 
-		*val = data[0];
-	} else {
-		uint8_t value = 0;
-		for (i = 0; i < bank->bus_width / bank->chip_width; i++)
-			value |= data[bank->bus_width - 1 - i];
-
-		*val = value;
-	}
+	*val = value;
 	return ERROR_OK;
 }
 
@@ -302,9 +339,36 @@ static void cfi_intel_clear_status_register(struct flash_bank *bank)
 	cfi_send_command(bank, 0x50, flash_address(bank, 0, 0x0));
 }
 
+static void cfi_intel_report_status(struct flash_bank *bank, int chip, uint8_t status)
+{
+	if (bank->bus_width == bank->chip_width)
+		LOG_ERROR("status register: 0x%x", status);
+	else
+		LOG_ERROR("chip %d status register: 0x%x", chip, status);
+	if (status & 0x2)
+		LOG_ERROR("Block Lock-Bit Detected, Operation Abort");
+	if (status & 0x4)
+		LOG_ERROR("Program suspended");
+	if (status & 0x8)
+		LOG_ERROR("Low Programming Voltage Detected, Operation Aborted");
+	if (status & 0x10)
+		LOG_ERROR("Program Error / Error in Setting Lock-Bit");
+	if (status & 0x20)
+		LOG_ERROR("Error in Block Erasure or Clear Lock-Bits");
+	if (status & 0x40)
+		LOG_ERROR("Block Erase Suspended");
+}
+
+/* wait for the state machines of all chips on the bus; each chip's
+ * status is evaluated on its own, a ready chip doesn't hide a busy one
+ */
 static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint8_t *val)
 {
-	uint8_t status;
+	uint8_t lanes[CFI_MAX_BUS_WIDTH];
+	uint8_t status = 0;
+	int chips = bank->bus_width / bank->chip_width;
+	unsigned busy = (1 << chips) - 1;
+	int i;
 
 	int retval = ERROR_OK;
 
@@ -314,87 +378,102 @@ static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint
 			return ERROR_FAIL;
 		}
 
-		retval = cfi_get_u8(bank, 0, 0x0, &status);
+		retval = cfi_get_lanes(bank, flash_address(bank, 0, 0x0), lanes);
 		if (retval != ERROR_OK)
 			return retval;
 
-		if (status & 0x80)
+		for (i = 0; i < chips; i++) {
+			if ((busy & (1 << i)) && (lanes[i] & 0x80))
+				busy &= ~(1 << i);
+		}
+		if (!busy)
 			break;
 
 		alive_sleep(1);
 	}
 
-	/* mask out bit 0 (reserved) */
-	status = status & 0xfe;
+	for (i = 0; i < chips; i++) {
+		/* mask out bit 0 (reserved) */
+		uint8_t chip_status = lanes[i] & 0xfe;
 
-	LOG_DEBUG("status: 0x%x", status);
+		if (chip_status != 0x80) {
+			cfi_intel_report_status(bank, i, chip_status);
+			retval = ERROR_FAIL;
+		}
+		status |= chip_status;
+	}
 
-	if (status != 0x80) {
-		LOG_ERROR("status register: 0x%x", status);
-		if (status & 0x2)
-			LOG_ERROR("Block Lock-Bit Detected, Operation Abort");
-		if (status & 0x4)
-			LOG_ERROR("Program suspended");
-		if (status & 0x8)
-			LOG_ERROR("Low Programming Voltage Detected, Operation Aborted");
-		if (status & 0x10)
-			LOG_ERROR("Program Error / Error in Setting Lock-Bit");
-		if (status & 0x20)
-			LOG_ERROR("Error in Block Erasure or Clear Lock-Bits");
-		if (status & 0x40)
-			LOG_ERROR("Block Erase Suspended");
+	LOG_DEBUG("status: 0x%x", status);
 
+	if (retval != ERROR_OK)
 		cfi_intel_clear_status_register(bank);
 
-		retval = ERROR_FAIL;
-	}
-
 	*val = status;
 	return retval;
 }
 
+/* toggle bit polling of all chips on the bus, each chip finishes on its
+ * own and only a chip which is still busy can report a DQ5 timeout
+ */
 static int cfi_spansion_wait_status_busy(struct flash_bank *bank, int timeout)
 {
-	uint8_t status, oldstatus;
+	uint8_t status[CFI_MAX_BUS_WIDTH], oldstatus[CFI_MAX_BUS_WIDTH];
+	uint8_t recheck[CFI_MAX_BUS_WIDTH], oldrecheck[CFI_MAX_BUS_WIDTH];
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	uint32_t address = flash_address(bank, 0, 0x0);
+	int chips = bank->bus_width / bank->chip_width;
+	unsigned busy = (1 << chips) - 1;
+	int i;
 	int retval;
 
-	retval = cfi_get_u8(bank, 0, 0x0, &oldstatus);
+	retval = cfi_get_lanes(bank, address, oldstatus);
 	if (retval != ERROR_OK)
 		return retval;
 
 	do {
-		retval = cfi_get_u8(bank, 0, 0x0, &status);
-
+		retval = cfi_get_lanes(bank, address, status);
 		if (retval != ERROR_OK)
 			return retval;
 
-		if ((status ^ oldstatus) & 0x40) {
-			if (status & cfi_info->status_poll_mask & 0x20) {
-				retval = cfi_get_u8(bank, 0, 0x0, &oldstatus);
+		for (i = 0; i < chips; i++) {
+			if (!(busy & (1 << i)))
+				continue;
+
+			if (!((status[i] ^ oldstatus[i]) & 0x40)) {
+				/* no toggle: finished, OK */
+				busy &= ~(1 << i);
+			} else if (status[i] & cfi_info->status_poll_mask & 0x20) {
+				retval = cfi_get_lanes(bank, address, oldrecheck);
 				if (retval != ERROR_OK)
 					return retval;
-				retval = cfi_get_u8(bank, 0, 0x0, &status);
+				retval = cfi_get_lanes(bank, address, recheck);
 				if (retval != ERROR_OK)
 					return retval;
-				if ((status ^ oldstatus) & 0x40) {
-					LOG_ERROR("dq5 timeout, status: 0x%x", status);
+				if ((recheck[i] ^ oldrecheck[i]) & 0x40) {
+					if (chips == 1)
+						LOG_ERROR("dq5 timeout, status: 0x%x", recheck[i]);
+					else
+						LOG_ERROR("chip %d: dq5 timeout, status: 0x%x", i, recheck[i]);
 					return ERROR_FLASH_OPERATION_FAILED;
-				} else {
-					LOG_DEBUG("status: 0x%x", status);
-					return ERROR_OK;
 				}
+				busy &= ~(1 << i);
 			}
-		} else {/* no toggle: finished, OK */
-			LOG_DEBUG("status: 0x%x", status);
+		}
+
+		if (!busy) {
+			LOG_DEBUG("status: 0x%x", status[0]);
 			return ERROR_OK;
 		}
 
-		oldstatus = status;
+		memcpy(oldstatus, status, chips);
 		alive_sleep(1);
 	} while (timeout-- > 0);
 
-	LOG_ERROR("timeout, status: 0x%x", status);
+	for (i = 0; i < chips; i++) {
+		if (busy & (1 << i))
+			break;
+	}
+	LOG_ERROR("timeout, status: 0x%x", status[i]);
 
 	return ERROR_FLASH_BUSY;
 }
@@ -827,6 +906,7 @@ FLASH_BANK_COMMAND_HANDLER(cfi_flash_bank_command)
 	cfi_info->x16_as_x8 = 0;
 	cfi_info->jedec_probe = 0;
 	cfi_info->not_cfi = 0;
+	cfi_info->write_method = CFI_WRITE_AUTO;
 
 	for (unsigned i = 6; i < CMD_ARGC; i++) {
 		if (strcmp(CMD_ARGV[i], "x16_as_x8") == 0)
@@ -841,22 +921,29 @@ FLASH_BANK_COMMAND_HANDLER(cfi_flash_bank_command)
 	return ERROR_OK;
 }
 
-static int cfi_intel_erase(struct flash_bank *bank, int first, int last)
+static int cfi_intel_erase_issue(struct flash_bank *bank, int sector)
 {
 	int retval;
-	struct cfi_flash_bank *cfi_info = bank->driver_priv;
-	int i;
 
-	cfi_intel_clear_status_register(bank);
+	retval = cfi_send_command(bank, 0x20, flash_address(bank, sector, 0x0));
+	if (retval != ERROR_OK)
+		return retval;
 
-	for (i = first; i <= last; i++) {
-		retval = cfi_send_command(bank, 0x20, flash_address(bank, i, 0x0));
-		if (retval != ERROR_OK)
-			return retval;
+	return cfi_send_command(bank, 0xd0, flash_address(bank, sector, 0x0));
+}
 
-		retval = cfi_send_command(bank, 0xd0, flash_address(bank, i, 0x0));
-		if (retval != ERROR_OK)
-			return retval;
+static int cfi_intel_erase_wait(struct flash_bank *bank)
+{
+	int retval;
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	int i;
+
+	for (i = cfi_info->erase_next; i <= cfi_info->erase_last; i++) {
+		if (i != cfi_info->erase_next) {
+			retval = cfi_intel_erase_issue(bank, i);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 
 		uint8_t status;
 		retval = cfi_intel_wait_status_busy(bank, cfi_info->block_erase_timeout, &status);
@@ -879,37 +966,47 @@ static int cfi_intel_erase(struct flash_bank *bank, int first, int last)
 	return cfi_send_command(bank, 0xff, flash_address(bank, 0, 0x0));
 }
 
-static int cfi_spansion_erase(struct flash_bank *bank, int first, int last)
+static int cfi_spansion_erase_issue(struct flash_bank *bank, int sector)
 {
 	int retval;
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
 	struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
-	int i;
 
-	for (i = first; i <= last; i++) {
-		retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
-		if (retval != ERROR_OK)
-			return retval;
+	retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
+	if (retval != ERROR_OK)
+		return retval;
 
-		retval = cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
-		if (retval != ERROR_OK)
-			return retval;
+	retval = cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
+	if (retval != ERROR_OK)
+		return retval;
 
-		retval = cfi_send_command(bank, 0x80, flash_address(bank, 0, pri_ext->_unlock1));
-		if (retval != ERROR_OK)
-			return retval;
+	retval = cfi_send_command(bank, 0x80, flash_address(bank, 0, pri_ext->_unlock1));
+	if (retval != ERROR_OK)
+		return retval;
 
-		retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
-		if (retval != ERROR_OK)
-			return retval;
+	retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
+	if (retval != ERROR_OK)
+		return retval;
 
-		retval = cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
-		if (retval != ERROR_OK)
-			return retval;
+	retval = cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
+	if (retval != ERROR_OK)
+		return retval;
 
-		retval = cfi_send_command(bank, 0x30, flash_address(bank, i, 0x0));
-		if (retval != ERROR_OK)
-			return retval;
+	return cfi_send_command(bank, 0x30, flash_address(bank, sector, 0x0));
+}
+
+static int cfi_spansion_erase_wait(struct flash_bank *bank)
+{
+	int retval;
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	int i;
+
+	for (i = cfi_info->erase_next; i <= cfi_info->erase_last; i++) {
+		if (i != cfi_info->erase_next) {
+			retval = cfi_spansion_erase_issue(bank, i);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 
 		if (cfi_spansion_wait_status_busy(bank, cfi_info->block_erase_timeout) == ERROR_OK)
 			bank->sectors[i].is_erased = 1;
@@ -927,7 +1024,9 @@ static int cfi_spansion_erase(struct flash_bank *bank, int first, int last)
 	return cfi_send_command(bank, 0xf0, flash_address(bank, 0, 0x0));
 }
 
-static int cfi_erase(struct flash_bank *bank, int first, int last)
+/* start erasing the first sector; the chip erases one sector at a
+ * time, so cfi_erase_wait() issues the remaining ones */
+static int cfi_erase_start(struct flash_bank *bank, int first, int last)
 {
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
 
@@ -942,22 +1041,57 @@ static int cfi_erase(struct flash_bank *bank, int first, int last)
 	if (cfi_info->qry[0] != 'Q')
 		return ERROR_FLASH_BANK_NOT_PROBED;
 
+	cfi_info->erase_next = first;
+	cfi_info->erase_last = last;
+
 	switch (cfi_info->pri_id) {
 		case 1:
 		case 3:
-			return cfi_intel_erase(bank, first, last);
+			cfi_intel_clear_status_register(bank);
+			return cfi_intel_erase_issue(bank, first);
 			break;
 		case 2:
-			return cfi_spansion_erase(bank, first, last);
+			return cfi_spansion_erase_issue(bank, first);
 			break;
 		default:
 			LOG_ERROR("cfi primary command set %i unsupported", cfi_info->pri_id);
 			break;
 	}
 
+	/* nothing to wait for */
+	cfi_info->erase_next = last + 1;
 	return ERROR_OK;
 }
 
+static int cfi_erase_wait(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+
+	if (cfi_info->erase_next > cfi_info->erase_last)
+		return ERROR_OK;
+
+	switch (cfi_info->pri_id) {
+		case 1:
+		case 3:
+			return cfi_intel_erase_wait(bank);
+			break;
+		case 2:
+			return cfi_spansion_erase_wait(bank);
+			break;
+	}
+
+	return ERROR_OK;
+}
+
+static int cfi_erase(struct flash_bank *bank, int first, int last)
+{
+	int retval = cfi_erase_start(bank, first, last);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cfi_erase_wait(bank);
+}
+
 static int cfi_intel_protect(struct flash_bank *bank, int set, int first, int last)
 {
 	int retval;
@@ -1261,22 +1395,16 @@ static int cfi_intel_write_block(struct flash_bank *bank, uint8_t *buffer,
 	}
 	cfi_fix_code_endian(target, target_code, target_code_src, target_code_size / 4);
 
-	/* Get memory for block write handler */
-	retval = target_alloc_working_area(target,
-			target_code_size,
-			&write_algorithm);
-	if (retval != ERROR_OK) {
+	/* Get memory for block write handler, and load the code there */
+	retval = target_alloc_algorithm(target, target_code,
+			target_code_size, &write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 		LOG_WARNING("No working area available, can't do block memory writes");
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
-	;
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Unable to write block write code to target");
-		goto cleanup;
+		return retval;
 	}
 
 	/* Get a workspace buffer for the data to flash starting with 32k size.
@@ -1501,17 +1629,9 @@ static int cfi_spansion_write_block_mips(struct flash_bank *bank, uint8_t *buffe
 	}
 	cfi_fix_code_endian(target, target_code, target_code_src, target_code_size / 4);
 
-	/* allocate working area */
-	retval = target_alloc_working_area(target, target_code_size,
-			&write_algorithm);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
+	/* allocate working area, and write algorithm code to it */
+	retval = target_alloc_algorithm(target, target_code,
+			target_code_size, &write_algorithm);
 	if (retval != ERROR_OK) {
 		free(target_code);
 		return retval;
@@ -1582,7 +1702,8 @@ static int cfi_spansion_write_block_mips(struct flash_bank *bank, uint8_t *buffe
 		count -= thisrun_count;
 	}
 
-	target_free_all_working_areas(target);
+	target_free_working_area(target, source);
+	target_free_working_area(target, write_algorithm);
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
@@ -1598,6 +1719,106 @@ static int cfi_spansion_write_block_mips(struct flash_bank *bank, uint8_t *buffe
 	return retval;
 }
 
+/* Spansion 16-bit word programming fed through the FIFO of
+ * target_run_flash_async_algorithm(), so the host keeps loading data
+ * while the chips program; ARMv7-M only, like the blockwise loader. */
+static int cfi_spansion_write_block_async(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t address, uint32_t count)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
+	struct reg_param reg_params[11];
+	int retval;
+
+	/* see contrib/loaders/flash/armv7m_cfi_span_16_async.S for src */
+	static const uint8_t armv7m_word_16_async_code[] = {
+		/* wait_fifo: */
+		0x06, 0x68,               /* ldr   r6, [r0, #0] */
+		0x00, 0x2e,               /* cmp   r6, #0 */
+		0x29, 0xd0,               /* beq   abort */
+		0x47, 0x68,               /* ldr   r7, [r0, #4] */
+		0xb7, 0x42,               /* cmp   r7, r6 */
+		0xf9, 0xd0,               /* beq   wait_fifo */
+		0x37, 0xf8, 0x02, 0x5b,   /* ldrh  r5, [r7], #2 */
+		0x67, 0x45,               /* cmp   r7, r12 */
+		0x28, 0xbf,               /* it    hs */
+		0x00, 0xf1, 0x08, 0x07,   /* addhs r7, r0, #8 */
+		0x47, 0x60,               /* str   r7, [r0, #4] */
+		/* code: */
+		0xa8, 0xf8, 0x00, 0x90,   /* strh  r9, [r8] */
+		0xaa, 0xf8, 0x00, 0xb0,   /* strh  r11, [r10] */
+		0xa8, 0xf8, 0x00, 0x30,   /* strh  r3, [r8] */
+		0x0d, 0x80,               /* strh  r5, [r1] */
+		0x00, 0xbf,               /* nop */
+		/* busy: */
+		0x0e, 0x88,               /* ldrh  r6, [r1] */
+		0x85, 0xea, 0x06, 0x07,   /* eor   r7, r5, r6 */
+		0x27, 0x40,               /* ands  r7, r4 */
+		0x0b, 0xd0,               /* beq   cont */
+		0x16, 0xea, 0x97, 0x06,   /* ands  r6, r6, r7, lsr #2 */
+		0xf7, 0xd0,               /* beq   busy */
+		0x0e, 0x88,               /* ldrh  r6, [r1] */
+		0x85, 0xea, 0x06, 0x07,   /* eor   r7, r5, r6 */
+		0x27, 0x40,               /* ands  r7, r4 */
+		0x03, 0xd0,               /* beq   cont */
+		0x4f, 0xf0, 0x00, 0x05,   /* mov   r5, #0 */
+		0x45, 0x60,               /* str   r5, [r0, #4] */
+		0x08, 0xe0,               /* b     done */
+		/* cont: */
+		0x01, 0xf1, 0x02, 0x01,   /* add   r1, r1, #2 */
+		0x52, 0x1e,               /* subs  r2, r2, #1 */
+		0xd5, 0xd1,               /* bne   wait_fifo */
+		0x4f, 0xf0, 0x80, 0x05,   /* mov   r5, #128 */
+		0x01, 0xe0,               /* b     done */
+		/* abort: */
+		0x4f, 0xf0, 0x00, 0x05,   /* mov   r5, #0 */
+		/* done: */
+		0x00, 0xbe,               /* bkpt  #0 */
+	};
+
+	static const struct flash_async_loader armv7m_word_16_async_loader = {
+		.code = armv7m_word_16_async_code,
+		.code_size = sizeof(armv7m_word_16_async_code),
+		.block_size = 2,
+		.fifo_start_param = 0,
+		.fifo_end_param = 10,
+	};
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);	/* FIFO start */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN_OUT);	/* flash address */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* number of writes */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);
+	init_reg_param(&reg_params[5], "r5", 32, PARAM_IN);	/* status */
+	init_reg_param(&reg_params[6], "r8", 32, PARAM_OUT);
+	init_reg_param(&reg_params[7], "r9", 32, PARAM_OUT);
+	init_reg_param(&reg_params[8], "r10", 32, PARAM_OUT);
+	init_reg_param(&reg_params[9], "r11", 32, PARAM_OUT);
+	init_reg_param(&reg_params[10], "r12", 32, PARAM_OUT);	/* FIFO end */
+
+	buf_set_u32(reg_params[1].value, 0, 32, address);
+	buf_set_u32(reg_params[2].value, 0, 32, count / 2);
+	buf_set_u32(reg_params[3].value, 0, 32, cfi_command_val(bank, 0xA0));
+	buf_set_u32(reg_params[4].value, 0, 32, cfi_command_val(bank, 0x80));
+	buf_set_u32(reg_params[6].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock1));
+	buf_set_u32(reg_params[7].value, 0, 32, 0xaaaaaaaa);
+	buf_set_u32(reg_params[8].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock2));
+	buf_set_u32(reg_params[9].value, 0, 32, 0x55555555);
+
+	retval = flash_async_write(bank, &armv7m_word_16_async_loader,
+			buffer, count / 2, 11, reg_params);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		LOG_ERROR("flash write block failed at 0x%08" PRIx32 ", status: 0x%" PRIx32,
+				buf_get_u32(reg_params[1].value, 0, 32),
+				buf_get_u32(reg_params[5].value, 0, 32));
+
+	for (int i = 0; i < 11; i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
 static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 	uint32_t address, uint32_t count)
 {
@@ -1645,7 +1866,7 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0xe0257006,		/* eor	r7, r5, r6				*/
 		0xe0147007,		/* ands	r7, r4, r7				*/
 		0x0a000007,		/* beq	8140 <sp_32_cont> ; b if DQ7 == Data7 */
-		0xe0166124,		/* ands	r6, r6, r4, lsr #2		*/
+		0xe0166127,		/* ands	r6, r6, r7, lsr #2		*/
 		0x0afffff9,		/* beq	8110 <sp_32_busy> ;	b if DQ5 low */
 		0xe5916000,		/* ldr	r6, [r1]				*/
 		0xe0257006,		/* eor	r7, r5, r6				*/
@@ -1677,7 +1898,7 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0xe0257006,		/* eor	r7, r5, r6				*/
 		0xe0147007,		/* ands	r7, r4, r7				*/
 		0x0a000007,		/* beq	8198 <sp_16_cont>		*/
-		0xe0166124,		/* ands	r6, r6, r4, lsr #2		*/
+		0xe0166127,		/* ands	r6, r6, r7, lsr #2		*/
 		0x0afffff9,		/* beq	8168 <sp_16_busy>		*/
 		0xe1d160b0,		/* ldrh	r6, [r1]				*/
 		0xe0257006,		/* eor	r7, r5, r6				*/
@@ -1705,7 +1926,7 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0xEA85880E,
 		0x40270706,
 		0xEA16D00A,
-		0xD0F70694,
+		0xD0F70697,
 		0xEA85880E,
 		0x40270706,
 		0xF04FD002,
@@ -1755,7 +1976,7 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0xe0257006,		/* eor	r7, r5, r6				*/
 		0xe0147007,		/* ands	r7, r4, r7				*/
 		0x0a000007,		/* beq	81f0 <sp_8_cont>		*/
-		0xe0166124,		/* ands	r6, r6, r4, lsr #2		*/
+		0xe0166127,		/* ands	r6, r6, r7, lsr #2		*/
 		0x0afffff9,		/* beq	81c0 <sp_8_busy>		*/
 		0xe5d16000,		/* ldrb	r6, [r1]				*/
 		0xe0257006,		/* eor	r7, r5, r6				*/
@@ -1776,6 +1997,14 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 	if (strncmp(target_type_name(target), "mips_m4k", 8) == 0)
 		return cfi_spansion_write_block_mips(bank, buffer, address, count);
 
+	/* stream where the loader can, otherwise write block by block */
+	if (is_armv7m(target_to_armv7m(target)) && bank->bus_width == 2
+			&& (cfi_info->status_poll_mask & (1 << 5))) {
+		retval = cfi_spansion_write_block_async(bank, buffer, address, count);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
 	if (is_armv7m(target_to_armv7m(target))) {	/* armv7m target */
 		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
 		armv7m_algo.core_mode = ARM_MODE_THREAD;
@@ -1849,17 +2078,9 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 	}
 	cfi_fix_code_endian(target, target_code, target_code_src, target_code_size / 4);
 
-	/* allocate working area */
-	retval = target_alloc_working_area(target, target_code_size,
-			&write_algorithm);
-	if (retval != ERROR_OK) {
-		free(target_code);
-		return retval;
-	}
-
-	/* write algorithm code to working area */
-	retval = target_write_buffer(target, write_algorithm->address,
-			target_code_size, target_code);
+	/* allocate working area, and write algorithm code to it */
+	retval = target_alloc_algorithm(target, target_code,
+			target_code_size, &write_algorithm);
 	if (retval != ERROR_OK) {
 		free(target_code);
 		return retval;
@@ -1930,7 +2151,8 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		count -= thisrun_count;
 	}
 
-	target_free_all_working_areas(target);
+	target_free_working_area(target, source);
+	target_free_working_area(target, write_algorithm);
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
@@ -1946,6 +2168,323 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 	return retval;
 }
 
+/* Program through the write buffers of all chips on the bus at once:
+ * each run loads up to one buffer window (the buffers of all chips side
+ * by side), commits it and polls the chips in parallel.  A chip which is
+ * done doesn't stop the polling of the others, and DQ5/DQ1 are only
+ * evaluated for chips which are still busy.
+ */
+static int cfi_spansion_write_block_buffered(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t address, uint32_t count)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
+	struct target *target = bank->target;
+	struct reg_param reg_params[11];
+	void *arm_algo;
+	struct arm_algorithm armv4_5_algo;
+	struct armv7m_algorithm armv7m_algo;
+	struct working_area *write_algorithm;
+	struct working_area *source;
+	uint32_t buffer_size = 32768;
+	uint32_t window_size;
+	uint32_t status;
+	int retval = ERROR_OK;
+
+	/* input parameters -
+	 *	R0 = source address
+	 *	R1 = destination address (out: start of the failing buffer)
+	 *	R2 = number of writes
+	 *	R3 = write buffer size, in writes, a power of two
+	 *	R4 = constant to mask DQ7 bits (also used for DQ5 and DQ1 with shift)
+	 *	R12 = "write to buffer" command
+	 * output parameters -
+	 *	R5 = 0x80 ok 0x00 bad
+	 * temp registers -
+	 *	R6 = value read from flash to test status
+	 *	R7 = write pointer
+	 *	R14 = lanes still busy
+	 * unlock registers -
+	 *  R8 = unlock1_addr
+	 *  R9 = unlock1_cmd
+	 *  R10 = unlock2_addr
+	 *  R11 = unlock2_cmd */
+
+	/* see contib/loaders/flash/armv4_5_cfi_span_buf_32.s for src */
+	static const uint32_t armv4_5_buf_32_code[] = {
+		/* <code>:						*/
+		0xe2436001,		/* sub	r6, r3, #1				*/
+		0xe0066121,		/* and	r6, r6, r1, lsr #2		*/
+		0xe0436006,		/* sub	r6, r3, r6				*/
+		0xe1560002,		/* cmp	r6, r2					*/
+		0x81a06002,		/* movhi	r6, r2				*/
+		0xe0422006,		/* sub	r2, r2, r6				*/
+		0xe5889000,		/* str	r9, [r8]				*/
+		0xe58ab000,		/* str	r11, [r10]				*/
+		0xe581c000,		/* str	r12, [r1]				*/
+		0xe2467001,		/* sub	r7, r6, #1				*/
+		0xe1a053a4,		/* mov	r5, r4, lsr #7			*/
+		0xe00e0597,		/* mul	lr, r7, r5				*/
+		0xe581e000,		/* str	lr, [r1]				*/
+		0xe1a07001,		/* mov	r7, r1					*/
+		/* <copy>:						*/
+		0xe4905004,		/* ldr	r5, [r0], #4			*/
+		0xe4875004,		/* str	r5, [r7], #4			*/
+		0xe2566001,		/* subs	r6, r6, #1				*/
+		0x1afffffb,		/* bne	<copy>					*/
+		0xe08c62a4,		/* add	r6, r12, r4, lsr #5		*/
+		0xe5816000,		/* str	r6, [r1]				*/
+		/* <busy>:						*/
+		0xe5176004,		/* ldr	r6, [r7, #-4]			*/
+		0xe026e005,		/* eor	lr, r6, r5				*/
+		0xe01ee004,		/* ands	lr, lr, r4				*/
+		0x0a000008,		/* beq	<cont>					*/
+		0xe116012e,		/* tst	r6, lr, lsr #2			*/
+		0x0116032e,		/* tsteq	r6, lr, lsr #6		*/
+		0x0afffff8,		/* beq	<busy>					*/
+		0xe5176004,		/* ldr	r6, [r7, #-4]			*/
+		0xe0266005,		/* eor	r6, r6, r5				*/
+		0xe0166004,		/* ands	r6, r6, r4				*/
+		0x0a000001,		/* beq	<cont>					*/
+		0xe3a05000,		/* mov	r5, #0					*/
+		0xea000003,		/* b	<done>					*/
+		/* <cont>:						*/
+		0xe1a01007,		/* mov	r1, r7					*/
+		0xe3520000,		/* cmp	r2, #0					*/
+		0x1affffdb,		/* bne	<code>					*/
+		0xe3a05080,		/* mov	r5, #128				*/
+		/* <done>:						*/
+		0xeafffffe		/* b	<done>					*/
+	};
+
+	/* see contib/loaders/flash/armv4_5_cfi_span_buf_16.s for src */
+	static const uint32_t armv4_5_buf_16_code[] = {
+		/* <code>:						*/
+		0xe2436001,		/* sub	r6, r3, #1				*/
+		0xe00660a1,		/* and	r6, r6, r1, lsr #1		*/
+		0xe0436006,		/* sub	r6, r3, r6				*/
+		0xe1560002,		/* cmp	r6, r2					*/
+		0x81a06002,		/* movhi	r6, r2				*/
+		0xe0422006,		/* sub	r2, r2, r6				*/
+		0xe1c890b0,		/* strh	r9, [r8]				*/
+		0xe1cab0b0,		/* strh	r11, [r10]				*/
+		0xe1c1c0b0,		/* strh	r12, [r1]				*/
+		0xe2467001,		/* sub	r7, r6, #1				*/
+		0xe1a053a4,		/* mov	r5, r4, lsr #7			*/
+		0xe00e0597,		/* mul	lr, r7, r5				*/
+		0xe1c1e0b0,		/* strh	lr, [r1]				*/
+		0xe1a07001,		/* mov	r7, r1					*/
+		/* <copy>:						*/
+		0xe0d050b2,		/* ldrh	r5, [r0], #2			*/
+		0xe0c750b2,		/* strh	r5, [r7], #2			*/
+		0xe2566001,		/* subs	r6, r6, #1				*/
+		0x1afffffb,		/* bne	<copy>					*/
+		0xe08c62a4,		/* add	r6, r12, r4, lsr #5		*/
+		0xe1c160b0,		/* strh	r6, [r1]				*/
+		/* <busy>:						*/
+		0xe15760b2,		/* ldrh	r6, [r7, #-2]			*/
+		0xe026e005,		/* eor	lr, r6, r5				*/
+		0xe01ee004,		/* ands	lr, lr, r4				*/
+		0x0a000008,		/* beq	<cont>					*/
+		0xe116012e,		/* tst	r6, lr, lsr #2			*/
+		0x0116032e,		/* tsteq	r6, lr, lsr #6		*/
+		0x0afffff8,		/* beq	<busy>					*/
+		0xe15760b2,		/* ldrh	r6, [r7, #-2]			*/
+		0xe0266005,		/* eor	r6, r6, r5				*/
+		0xe0166004,		/* ands	r6, r6, r4				*/
+		0x0a000001,		/* beq	<cont>					*/
+		0xe3a05000,		/* mov	r5, #0					*/
+		0xea000003,		/* b	<done>					*/
+		/* <cont>:						*/
+		0xe1a01007,		/* mov	r1, r7					*/
+		0xe3520000,		/* cmp	r2, #0					*/
+		0x1affffdb,		/* bne	<code>					*/
+		0xe3a05080,		/* mov	r5, #128				*/
+		/* <done>:						*/
+		0xeafffffe		/* b	<done>					*/
+	};
+
+	/* see contib/loaders/flash/armv7m_cfi_span_buf_16.s for src */
+	static const uint32_t armv7m_buf_16_code[] = {
+		0x0601F1A3,
+		0x0651EA06,
+		0x0606EBA3,
+		0xBF884296,
+		0xEBA24616,
+		0xF8A80206,
+		0xF8AA9000,
+		0xF8A1B000,
+		0xF1A6C000,
+		0xEA4F0701,
+		0xFB0715D4,
+		0xF8A1FE05,
+		0x460FE000,
+		0x5B02F830,
+		0x5B02F827,
+		0xD1F91E76,
+		0x1654EB0C,
+		0xF837800E,
+		0xEA866C02,
+		0xEA1E0E05,
+		0xD00E0E04,
+		0x0F9EEA16,
+		0xEA16BF08,
+		0xD0F21F9E,
+		0x6C02F837,
+		0x0605EA86,
+		0xD0024026,
+		0x0500F04F,
+		0x4639E004,
+		0xD1C32A00,
+		0x0580F04F,
+		0xBF00BE00
+	};
+
+	/* the loader relies on DQ5 to detect failures */
+	if (!(cfi_info->status_poll_mask & (1 << 5))
+			|| strncmp(target_type_name(target), "mips_m4k", 8) == 0)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (is_armv7m(target_to_armv7m(target))) {	/* armv7m target */
+		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
+		armv7m_algo.core_mode = ARM_MODE_THREAD;
+		arm_algo = &armv7m_algo;
+	} else if (is_arm(target_to_arm(target))) {
+		/* All other ARM CPUs have 32 bit instructions */
+		armv4_5_algo.common_magic = ARM_COMMON_MAGIC;
+		armv4_5_algo.core_mode = ARM_MODE_SVC;
+		armv4_5_algo.core_state = ARM_STATE_ARM;
+		arm_algo = &armv4_5_algo;
+	} else
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	int target_code_size = 0;
+	const uint32_t *target_code_src = NULL;
+
+	switch (bank->bus_width) {
+		case 2:
+			if (is_armv7m(target_to_armv7m(target))) {
+				target_code_src = armv7m_buf_16_code;
+				target_code_size = sizeof(armv7m_buf_16_code);
+			} else {
+				target_code_src = armv4_5_buf_16_code;
+				target_code_size = sizeof(armv4_5_buf_16_code);
+			}
+			break;
+		case 4:
+			if (is_armv7m(target_to_armv7m(target)))
+				return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+			target_code_src = armv4_5_buf_32_code;
+			target_code_size = sizeof(armv4_5_buf_32_code);
+			break;
+		default:
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* the buffers of all chips side by side */
+	window_size = (1UL << cfi_info->max_buf_write_size) * (bank->bus_width / bank->chip_width);
+	if (window_size < (uint32_t)bank->bus_width * 2)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* flash write code */
+	uint8_t *target_code;
+
+	/* convert bus-width dependent algorithm code to correct endianness */
+	target_code = malloc(target_code_size);
+	if (target_code == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	cfi_fix_code_endian(target, target_code, target_code_src, target_code_size / 4);
+
+	/* allocate working area, and write algorithm code to it */
+	retval = target_alloc_algorithm(target, target_code,
+			target_code_size, &write_algorithm);
+	free(target_code);
+	if (retval != ERROR_OK)
+		return retval;
+
+	while (buffer_size < window_size
+			|| target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
+		buffer_size /= 2;
+		if (buffer_size <= 256 || buffer_size < window_size) {
+			target_free_working_area(target, write_algorithm);
+
+			LOG_WARNING(
+				"not enough working area available, can't do buffered block writes");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+	}
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_IN_OUT);
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);
+	init_reg_param(&reg_params[5], "r5", 32, PARAM_IN);
+	init_reg_param(&reg_params[6], "r8", 32, PARAM_OUT);
+	init_reg_param(&reg_params[7], "r9", 32, PARAM_OUT);
+	init_reg_param(&reg_params[8], "r10", 32, PARAM_OUT);
+	init_reg_param(&reg_params[9], "r11", 32, PARAM_OUT);
+	init_reg_param(&reg_params[10], "r12", 32, PARAM_OUT);
+
+	while (count > 0) {
+		/* end each run on a window boundary, so the next one starts
+		 * with complete windows */
+		uint32_t thisrun_count = buffer_size - (address & (window_size - 1));
+		if (thisrun_count > count)
+			thisrun_count = count;
+
+		retval = target_write_buffer(target, source->address, thisrun_count, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, source->address);
+		buf_set_u32(reg_params[1].value, 0, 32, address);
+		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count / bank->bus_width);
+		buf_set_u32(reg_params[3].value, 0, 32, window_size / bank->bus_width);
+		buf_set_u32(reg_params[4].value, 0, 32, cfi_command_val(bank, 0x80));
+		buf_set_u32(reg_params[6].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock1));
+		buf_set_u32(reg_params[7].value, 0, 32, 0xaaaaaaaa);
+		buf_set_u32(reg_params[8].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock2));
+		buf_set_u32(reg_params[9].value, 0, 32, 0x55555555);
+		buf_set_u32(reg_params[10].value, 0, 32, cfi_command_val(bank, 0x25));
+
+		retval = target_run_algorithm(target, 0, NULL, 11, reg_params,
+				write_algorithm->address,
+				write_algorithm->address + ((target_code_size) - 4),
+				10000, arm_algo);
+		if (retval != ERROR_OK)
+			break;
+
+		status = buf_get_u32(reg_params[5].value, 0, 32);
+		if (status != 0x80) {
+			LOG_ERROR("flash write buffer at 0x%" PRIx32 " failed",
+				buf_get_u32(reg_params[1].value, 0, 32));
+
+			/* write-to-buffer-abort reset */
+			cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
+			cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
+			cfi_send_command(bank, 0xf0, flash_address(bank, 0, pri_ext->_unlock1));
+
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		buffer += thisrun_count;
+		address += thisrun_count;
+		count -= thisrun_count;
+	}
+
+	target_free_working_area(target, source);
+	target_free_working_area(target, write_algorithm);
+
+	for (int i = 0; i < 11; i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
 static int cfi_intel_write_word(struct flash_bank *bank, uint8_t *word, uint32_t address)
 {
 	int retval;
@@ -1976,36 +2515,38 @@ static int cfi_intel_write_word(struct flash_bank *bank, uint8_t *word, uint32_t
 	return ERROR_OK;
 }
 
-static int cfi_intel_write_words(struct flash_bank *bank, uint8_t *word,
+/* a buffered write may start anywhere, but mustn't cross the boundary
+ * of a buffer window, i.e. the write buffers of all chips side by side
+ */
+static int cfi_check_buffer_range(struct flash_bank *bank,
 	uint32_t wordcount, uint32_t address)
 {
-	int retval;
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
-	struct target *target = bank->target;
-
-	/* Calculate buffer size and boundary mask
-	 * buffersize is (buffer size per chip) * (number of chips)
-	 * bufferwsize is buffersize in words */
 	uint32_t buffersize =
 		(1UL << cfi_info->max_buf_write_size) * (bank->bus_width / bank->chip_width);
-	uint32_t buffermask = buffersize-1;
-	uint32_t bufferwsize = buffersize / bank->bus_width;
-
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base 0x%" PRIx32 ", address 0x%" PRIx32
-			" not aligned to 2^%d boundary",
-			bank->base, address, cfi_info->max_buf_write_size);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
+	uint32_t buffermask = buffersize - 1;
 
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRId32 " exceeds available buffersize %" PRId32,
-			wordcount, buffersize);
+	if (wordcount == 0 || (address & buffermask) + wordcount * bank->bus_width > buffersize) {
+		LOG_ERROR("%" PRIu32 " data words at base 0x%" PRIx32 ", address 0x%" PRIx32
+			" cross a 2^%d boundary", wordcount, bank->base, address,
+			cfi_info->max_buf_write_size);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
+	return ERROR_OK;
+}
+
+static int cfi_intel_write_words(struct flash_bank *bank, uint8_t *word,
+	uint32_t wordcount, uint32_t address)
+{
+	int retval;
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct target *target = bank->target;
+
+	retval = cfi_check_buffer_range(bank, wordcount, address);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* Write to flash buffer */
 	cfi_intel_clear_status_register(bank);
 
@@ -2030,11 +2571,11 @@ static int cfi_intel_write_words(struct flash_bank *bank, uint8_t *word,
 	}
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_value(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_write_memory(target, address, bank->bus_width, bufferwsize, word);
+	retval = target_write_memory(target, address, bank->bus_width, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2104,28 +2645,9 @@ static int cfi_spansion_write_words(struct flash_bank *bank, uint8_t *word,
 	struct target *target = bank->target;
 	struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
 
-	/* Calculate buffer size and boundary mask
-	 * buffersize is (buffer size per chip) * (number of chips)
-	 * bufferwsize is buffersize in words */
-	uint32_t buffersize =
-		(1UL << cfi_info->max_buf_write_size) * (bank->bus_width / bank->chip_width);
-	uint32_t buffermask = buffersize-1;
-	uint32_t bufferwsize = buffersize / bank->bus_width;
-
-	/* Check for valid range */
-	if (address & buffermask) {
-		LOG_ERROR("Write address at base 0x%" PRIx32
-			", address 0x%" PRIx32 " not aligned to 2^%d boundary",
-			bank->base, address, cfi_info->max_buf_write_size);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
-
-	/* Check for valid size */
-	if (wordcount > bufferwsize) {
-		LOG_ERROR("Number of data words %" PRId32 " exceeds available buffersize %"
-			PRId32, wordcount, buffersize);
-		return ERROR_FLASH_OPERATION_FAILED;
-	}
+	retval = cfi_check_buffer_range(bank, wordcount, address);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* Unlock */
 	retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
@@ -2142,11 +2664,11 @@ static int cfi_spansion_write_words(struct flash_bank *bank, uint8_t *word,
 		return retval;
 
 	/* Write buffer wordcount-1 and data words */
-	retval = cfi_send_command(bank, bufferwsize-1, address);
+	retval = cfi_send_value(bank, wordcount - 1, address);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_write_memory(target, address, bank->bus_width, bufferwsize, word);
+	retval = target_write_memory(target, address, bank->bus_width, wordcount, word);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -2156,13 +2678,20 @@ static int cfi_spansion_write_words(struct flash_bank *bank, uint8_t *word,
 		return retval;
 
 	if (cfi_spansion_wait_status_busy(bank, cfi_info->buf_write_timeout) != ERROR_OK) {
-		retval = cfi_send_command(bank, 0xf0, flash_address(bank, 0, 0x0));
+		/* write-to-buffer-abort reset */
+		retval = cfi_send_command(bank, 0xaa, flash_address(bank, 0, pri_ext->_unlock1));
+		if (retval != ERROR_OK)
+			return retval;
+		retval = cfi_send_command(bank, 0x55, flash_address(bank, 0, pri_ext->_unlock2));
+		if (retval != ERROR_OK)
+			return retval;
+		retval = cfi_send_command(bank, 0xf0, flash_address(bank, 0, pri_ext->_unlock1));
 		if (retval != ERROR_OK)
 			return retval;
 
 		LOG_ERROR("couldn't write block at base 0x%" PRIx32
 			", address 0x%" PRIx32 ", size 0x%" PRIx32, bank->base, address,
-			bufferwsize);
+			wordcount);
 		return ERROR_FLASH_OPERATION_FAILED;
 	}
 
@@ -2296,6 +2825,7 @@ static int cfi_write(struct flash_bank *bank, uint8_t *buffer, uint32_t offset,
 	int blk_count;	/* number of bus_width bytes for block copy */
 	uint8_t current_word[CFI_MAX_BUS_WIDTH * 4];	/* word (bus_width size) currently being
 							 *programmed */
+	enum cfi_write_method method;
 	int i;
 	int retval;
 
@@ -2333,20 +2863,31 @@ static int cfi_write(struct flash_bank *bank, uint8_t *buffer, uint32_t offset,
 
 	/* handle blocks of bus_size aligned bytes */
 	blk_count = count & ~(bank->bus_width - 1);	/* round down, leave tail bytes */
+	method = cfi_info->write_method;
+	retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	switch (cfi_info->pri_id) {
 		/* try block writes (fails without working area) */
 		case 1:
 		case 3:
-			retval = cfi_intel_write_block(bank, buffer, write_p, blk_count);
+			if (method == CFI_WRITE_AUTO || method == CFI_WRITE_LOADER_WORD)
+				retval = cfi_intel_write_block(bank, buffer, write_p, blk_count);
 			break;
 		case 2:
-			retval = cfi_spansion_write_block(bank, buffer, write_p, blk_count);
+			if ((method == CFI_WRITE_AUTO || method == CFI_WRITE_LOADER_BUFFER)
+					&& cfi_info->buf_write_timeout_typ != 0)
+				retval = cfi_spansion_write_block_buffered(bank, buffer, write_p, blk_count);
+			if ((method == CFI_WRITE_AUTO && retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+					|| method == CFI_WRITE_LOADER_WORD)
+				retval = cfi_spansion_write_block(bank, buffer, write_p, blk_count);
 			break;
 		default:
 			LOG_ERROR("cfi primary command set %i unsupported", cfi_info->pri_id);
 			retval = ERROR_FLASH_OPERATION_FAILED;
 			break;
 	}
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE
+			&& (method == CFI_WRITE_LOADER_BUFFER || method == CFI_WRITE_LOADER_WORD))
+		return ERROR_FLASH_OPER_UNSUPPORTED;
 	if (retval == ERROR_OK) {
 		/* Increment pointers and decrease count on succesful block write */
 		buffer += blk_count;
@@ -2364,6 +2905,11 @@ static int cfi_write(struct flash_bank *bank, uint8_t *buffer, uint32_t offset,
 			uint32_t buffermask = buffersize-1;
 			uint32_t bufferwsize = buffersize / bank->bus_width;
 
+			if (method == CFI_WRITE_HOST_WORD)
+				bufferwsize = 0;
+			else if (method == CFI_WRITE_HOST_BUFFER && cfi_info->buf_write_timeout_typ == 0)
+				return ERROR_FLASH_OPER_UNSUPPORTED;
+
 			/* fall back to memory writes */
 			while (count >= (uint32_t)bank->bus_width) {
 				int fallback;
@@ -2372,13 +2918,18 @@ static int cfi_write(struct flash_bank *bank, uint8_t *buffer, uint32_t offset,
 						PRIx32 " bytes remaining", write_p, count);
 				}
 				fallback = 1;
-				if ((bufferwsize > 0) && (count >= buffersize) &&
-						!(write_p & buffermask)) {
-					retval = cfi_write_words(bank, buffer, bufferwsize, write_p);
+				/* up to the end of the buffer window, also when
+				 * starting or ending within one */
+				uint32_t thisrun_count = buffersize - (write_p & buffermask);
+				if (thisrun_count > count)
+					thisrun_count = count & ~(bank->bus_width - 1);
+				if ((bufferwsize > 0) && (thisrun_count > (uint32_t)bank->bus_width)) {
+					retval = cfi_write_words(bank, buffer,
+							thisrun_count / bank->bus_width, write_p);
 					if (retval == ERROR_OK) {
-						buffer += buffersize;
-						write_p += buffersize;
-						count -= buffersize;
+						buffer += thisrun_count;
+						write_p += thisrun_count;
+						count -= thisrun_count;
 						fallback = 0;
 					} else if (retval != ERROR_FLASH_OPER_UNSUPPORTED)
 						return retval;
@@ -3036,10 +3587,146 @@ static void cfi_fixup_0002_write_buffer(struct flash_bank *bank, void *param)
 	cfi_info->buf_write_timeout_typ = 0;
 }
 
+COMMAND_HANDLER(cfi_handle_benchmark_command)
+{
+	static const struct {
+		enum cfi_write_method method;
+		const char *name;
+	} methods[] = {
+		{ CFI_WRITE_LOADER_BUFFER, "loader, write buffer" },
+		{ CFI_WRITE_LOADER_WORD, "loader, single words" },
+		{ CFI_WRITE_HOST_BUFFER, "host, write buffer" },
+		{ CFI_WRITE_HOST_WORD, "host, single words" },
+	};
+	struct flash_bank *bank;
+	struct cfi_flash_bank *cfi_info;
+	uint32_t first = 0, last;
+	int retval;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (strcmp(bank->driver->name, "cfi")) {
+		command_print(CMD_CTX, "not a cfi flash bank");
+		return ERROR_FLASH_BANK_INVALID;
+	}
+	cfi_info = bank->driver_priv;
+
+	last = bank->num_sectors - 1;
+	if (CMD_ARGC > 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], first);
+		last = first;
+	}
+	if (CMD_ARGC > 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], last);
+	if (first > last || last >= (uint32_t)bank->num_sectors) {
+		command_print(CMD_CTX, "invalid sector range %" PRIu32 " through %" PRIu32,
+				first, last);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	uint32_t offset = bank->sectors[first].offset;
+	uint32_t size = bank->sectors[last].offset + bank->sectors[last].size - offset;
+
+	uint8_t *pattern = malloc(size);
+	uint8_t *readback = malloc(size);
+	if (pattern == NULL || readback == NULL) {
+		free(pattern);
+		free(readback);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	uint32_t seed = 0x2545f491;
+	for (uint32_t i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		pattern[i] = seed;
+	}
+
+	command_print(CMD_CTX, "cfi bank %u, %d x %d bit chip(s), %u byte write buffer each, "
+			"sectors %" PRIu32 " through %" PRIu32 " (%" PRIu32 " bytes):",
+			bank->bank_number, bank->bus_width / bank->chip_width,
+			bank->chip_width * 8, cfi_info->buf_write_timeout_typ
+				? 1U << cfi_info->max_buf_write_size : 0,
+			first, last, size);
+
+	for (unsigned i = 0; i < ARRAY_SIZE(methods); i++) {
+		struct duration program;
+
+		retval = flash_driver_erase(bank, first, last);
+		if (retval != ERROR_OK)
+			break;
+
+		cfi_info->write_method = methods[i].method;
+		duration_start(&program);
+		retval = flash_driver_write(bank, pattern, offset, size);
+		cfi_info->write_method = CFI_WRITE_AUTO;
+		if (retval == ERROR_FLASH_OPER_UNSUPPORTED) {
+			command_print(CMD_CTX, "  %-22s not available", methods[i].name);
+			retval = ERROR_OK;
+			continue;
+		}
+		if (retval != ERROR_OK || duration_measure(&program) != ERROR_OK)
+			break;
+
+		/* check the flash, not the flash cache */
+		flash_cache_invalidate(bank, first, last);
+		retval = flash_driver_read(bank, readback, offset, size);
+		if (retval != ERROR_OK)
+			break;
+		if (memcmp(readback, pattern, size)) {
+			command_print(CMD_CTX, "  %-22s verify FAILED", methods[i].name);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		command_print(CMD_CTX, "  %-22s %fs (%0.0f bytes/s)", methods[i].name,
+				duration_elapsed(&program),
+				duration_kbps(&program, size) * 1024.0);
+	}
+
+	free(pattern);
+	free(readback);
+
+	return retval;
+}
+
+static const struct command_registration cfi_exec_command_handlers[] = {
+	{
+		.name = "benchmark",
+		.handler = cfi_handle_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [first [last]]",
+		.help = "Erase and program sectors once with each write method, "
+			"reporting the throughput of each. Destroys their contents.",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration cfi_command_handlers[] = {
+	{
+		.name = "cfi",
+		.mode = COMMAND_ANY,
+		.help = "cfi flash command group",
+		.usage = "",
+		.chain = cfi_exec_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 struct flash_driver cfi_flash = {
 	.name = "cfi",
+	.commands = cfi_command_handlers,
 	.flash_bank_command = cfi_flash_bank_command,
 	.erase = cfi_erase,
+	.erase_start = cfi_erase_start,
+	.erase_wait = cfi_erase_wait,
 	.protect = cfi_protect,
 	.write = cfi_write,
 	.read = cfi_read,
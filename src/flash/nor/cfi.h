@@ -24,6 +24,15 @@
 #define CFI_STATUS_POLL_MASK_DQ5_DQ6_DQ7 0xE0 /* DQ5..DQ7 */
 #define CFI_STATUS_POLL_MASK_DQ6_DQ7     0xC0 /* DQ6..DQ7 */
 
+/* how cfi_write() programs the aligned part of the data */
+enum cfi_write_method {
+	CFI_WRITE_AUTO,			/* fastest method available */
+	CFI_WRITE_LOADER_BUFFER,	/* target algorithm, write buffer */
+	CFI_WRITE_LOADER_WORD,		/* target algorithm, single words */
+	CFI_WRITE_HOST_BUFFER,		/* JTAG accesses, write buffer */
+	CFI_WRITE_HOST_WORD,		/* JTAG accesses, single words */
+};
+
 struct cfi_flash_bank {
 	int x16_as_x8;
 	int jedec_probe;
@@ -72,6 +81,13 @@ struct cfi_flash_bank {
 	unsigned buf_write_timeout;
 	unsigned block_erase_timeout;
 	unsigned chip_erase_timeout;
+
+	/* erase begun by cfi_erase_start() */
+	int erase_next;
+	int erase_last;
+
+	/* forced by "cfi benchmark", otherwise CFI_WRITE_AUTO */
+	enum cfi_write_method write_method;
 };
 
 /* Intel primary extended query table
@@ -40,17 +40,81 @@ static struct flash_bank *flash_banks;
 
 int flash_driver_erase(struct flash_bank *bank, int first, int last)
 {
+	struct flash_stats_mark mark;
 	int retval;
 
+	retval = flash_driver_erase_wait(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	flash_cache_invalidate(bank, first, last);
+
+	flash_stats_enter(&mark, FLASH_PHASE_ERASE);
 	retval = bank->driver->erase(bank, first, last);
+	flash_stats_erase(bank, first, last, flash_stats_leave(&mark));
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %d to %d", first, last);
 
 	return retval;
 }
 
+/**
+ * Starts erasing sectors, leaving the erase running in the background
+ * if the driver supports that; otherwise this is flash_driver_erase().
+ * Every other flash_driver_*() call on the bank first completes the
+ * erase, so callers only need flash_driver_erase_wait() to collect its
+ * result early.
+ */
+int flash_driver_erase_start(struct flash_bank *bank, int first, int last)
+{
+	struct flash_stats_mark mark;
+	int retval;
+
+	if (!bank->driver->erase_start || !bank->driver->erase_wait)
+		return flash_driver_erase(bank, first, last);
+
+	retval = flash_driver_erase_wait(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	flash_cache_invalidate(bank, first, last);
+
+	flash_stats_enter(&mark, FLASH_PHASE_ERASE);
+	retval = bank->driver->erase_start(bank, first, last);
+	flash_stats_erase(bank, first, last, flash_stats_leave(&mark));
+	if (retval != ERROR_OK) {
+		LOG_ERROR("failed erasing sectors %d to %d", first, last);
+		return retval;
+	}
+
+	bank->erase_pending = true;
+	bank->erase_first = first;
+	bank->erase_last = last;
+	return ERROR_OK;
+}
+
+int flash_driver_erase_wait(struct flash_bank *bank)
+{
+	struct flash_stats_mark mark;
+	int retval;
+
+	if (!bank->erase_pending)
+		return ERROR_OK;
+	bank->erase_pending = false;
+
+	flash_stats_enter(&mark, FLASH_PHASE_ERASE);
+	retval = bank->driver->erase_wait(bank);
+	flash_stats_erase(bank, bank->erase_first, bank->erase_last,
+			flash_stats_leave(&mark));
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed erasing flash bank at 0x%8.8" PRIx32, bank->base);
+
+	return retval;
+}
+
 int flash_driver_protect(struct flash_bank *bank, int set, int first, int last)
 {
+	struct flash_stats_mark mark;
 	int retval;
 
 	/* callers may not supply illegal parameters ... */
@@ -62,6 +126,10 @@ int flash_driver_protect(struct flash_bank *bank, int set, int first, int last)
 	/* force "set" to 0/1 */
 	set = !!set;
 
+	retval = flash_driver_erase_wait(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* DANGER!
 	 *
 	 * We must not use any cached information about protection state!!!!
@@ -73,7 +141,9 @@ int flash_driver_protect(struct flash_bank *bank, int set, int first, int last)
 	 *
 	 * Drivers only receive valid sector range.
 	 */
+	flash_stats_enter(&mark, FLASH_PHASE_UNLOCK);
 	retval = bank->driver->protect(bank, set, first, last);
+	flash_stats_leave(&mark);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed setting protection for areas %d to %d", first, last);
 
@@ -83,16 +153,126 @@ int flash_driver_protect(struct flash_bank *bank, int set, int first, int last)
 int flash_driver_write(struct flash_bank *bank,
 	uint8_t *buffer, uint32_t offset, uint32_t count)
 {
+	struct flash_stats_mark mark;
 	int retval;
 
+	retval = flash_driver_erase_wait(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	flash_stats_enter(&mark, FLASH_PHASE_PROGRAM);
 	retval = bank->driver->write(bank, buffer, offset, count);
+	flash_stats_program(bank, offset, count, flash_stats_leave(&mark));
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error writing to flash at address 0x%08" PRIx32 " at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
+		flash_cache_invalidate_range(bank->target, bank->base + offset, count);
+	} else
+		flash_cache_update(bank, buffer, offset, count);
+
+	return retval;
+}
+
+/**
+ * Programs a list of jobs, handing jobs for different banks of one
+ * driver to flash_driver_s::write_concurrent where the driver offers
+ * it.  Jobs for the same bank are still written in list order.
+ */
+int flash_driver_write_jobs(struct flash_write_job *jobs, int num_jobs)
+{
+	struct flash_write_job *group;
+	int *index;
+	bool *done;
+	int retval = ERROR_OK;
+
+	group = malloc(num_jobs * sizeof(*group));
+	index = malloc(num_jobs * sizeof(*index));
+	done = calloc(num_jobs, sizeof(*done));
+	if (group == NULL || index == NULL || done == NULL) {
+		free(group);
+		free(index);
+		free(done);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
+	for (int i = 0; i < num_jobs; i++) {
+		struct flash_bank *bank = jobs[i].bank;
+		int group_jobs = 0;
+
+		if (done[i])
+			continue;
+
+		/* the first pending job of every bank sharing this driver and target */
+		for (int j = i; bank->driver->write_concurrent && j < num_jobs; j++) {
+			struct flash_bank *other = jobs[j].bank;
+			int k;
+
+			if (done[j] || other->driver != bank->driver
+					|| other->target != bank->target)
+				continue;
+			for (k = 0; k < group_jobs; k++) {
+				if (group[k].bank == other)
+					break;
+			}
+			if (k < group_jobs)
+				continue;
+			index[group_jobs] = j;
+			group[group_jobs++] = jobs[j];
+		}
+
+		if (group_jobs > 1) {
+			LOG_DEBUG("programming %d %s banks concurrently",
+					group_jobs, bank->driver->name);
+			for (int k = 0; k < group_jobs && retval == ERROR_OK; k++)
+				retval = flash_driver_erase_wait(group[k].bank);
+			if (retval != ERROR_OK)
+				break;
+
+			struct flash_stats_mark mark;
+			uint64_t group_bytes = 0;
+			double seconds;
+
+			for (int k = 0; k < group_jobs; k++)
+				group_bytes += group[k].count;
+			flash_stats_enter(&mark, FLASH_PHASE_PROGRAM);
+			retval = bank->driver->write_concurrent(group, group_jobs);
+			seconds = flash_stats_leave(&mark);
+			for (int k = 0; k < group_jobs && group_bytes && retval == ERROR_OK; k++)
+				flash_stats_program(group[k].bank, group[k].offset, group[k].count,
+						seconds * group[k].count / group_bytes);
+			for (int k = 0; k < group_jobs; k++) {
+				if (retval == ERROR_OK)
+					flash_cache_update(group[k].bank, group[k].buffer,
+							group[k].offset, group[k].count);
+				else
+					flash_cache_invalidate_range(group[k].bank->target,
+							group[k].bank->base + group[k].offset, group[k].count);
+			}
+			if (retval == ERROR_OK) {
+				for (int k = 0; k < group_jobs; k++)
+					done[index[k]] = true;
+				continue;
+			}
+			if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+				LOG_ERROR("error writing to flash banks concurrently");
+				break;
+			}
+		}
+
+		retval = flash_driver_write(bank, jobs[i].buffer,
+				jobs[i].offset, jobs[i].count);
+		if (retval != ERROR_OK)
+			break;
+		done[i] = true;
+	}
+
+	free(group);
+	free(index);
+	free(done);
+
 	return retval;
 }
 
@@ -103,13 +283,21 @@ int flash_driver_read(struct flash_bank *bank,
 
 	LOG_DEBUG("call flash_driver_read()");
 
+	retval = flash_driver_erase_wait(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (flash_cache_read(bank->target, bank->base + offset, count, buffer))
+		return ERROR_OK;
+
 	retval = bank->driver->read(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error reading to flash at address 0x%08" PRIx32 " at offset 0x%8.8" PRIx32,
 			bank->base,
 			offset);
-	}
+	} else
+		flash_cache_update(bank, buffer, offset, count);
 
 	return retval;
 }
@@ -275,8 +463,8 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 		for (j = 0; j < bank->sectors[i].size; j += buffer_size) {
 			uint32_t chunk;
 			chunk = buffer_size;
-			if (chunk > (j - bank->sectors[i].size))
-				chunk = (j - bank->sectors[i].size);
+			if (chunk > (bank->sectors[i].size - j))
+				chunk = (bank->sectors[i].size - j);
 
 			retval = target_read_memory(target,
 					bank->base + bank->sectors[i].offset + j,
@@ -301,36 +489,54 @@ done:
 	return retval;
 }
 
-int default_flash_blank_check(struct flash_bank *bank)
+int flash_blank_check_sectors(struct flash_bank *bank, uint8_t erased_value)
 {
-	struct target *target = bank->target;
+	struct target_memory_check_block *blocks;
+	uint32_t *bitmap;
 	int i;
 	int retval;
-	int fast_check = 0;
-	uint32_t blank;
 
-	if (bank->target->state != TARGET_HALTED) {
-		LOG_ERROR("Target not halted");
-		return ERROR_TARGET_NOT_HALTED;
+	if (bank->num_sectors == 0)
+		return ERROR_OK;
+
+	blocks = malloc(bank->num_sectors * sizeof(*blocks));
+	bitmap = malloc(DIV_ROUND_UP(bank->num_sectors, 32) * sizeof(uint32_t));
+	if (blocks == NULL || bitmap == NULL) {
+		free(blocks);
+		free(bitmap);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
 	for (i = 0; i < bank->num_sectors; i++) {
-		uint32_t address = bank->base + bank->sectors[i].offset;
-		uint32_t size = bank->sectors[i].size;
+		blocks[i].address = bank->base + bank->sectors[i].offset;
+		blocks[i].size = bank->sectors[i].size;
+	}
 
-		retval = target_blank_check_memory(target, address, size, &blank);
-		if (retval != ERROR_OK) {
-			fast_check = 0;
-			break;
-		}
-		if (blank == 0xFF)
-			bank->sectors[i].is_erased = 1;
-		else
-			bank->sectors[i].is_erased = 0;
-		fast_check = 1;
+	retval = target_blank_check_memory_blocks(bank->target, blocks,
+			bank->num_sectors, erased_value, bitmap);
+	if (retval == ERROR_OK) {
+		for (i = 0; i < bank->num_sectors; i++)
+			bank->sectors[i].is_erased = (bitmap[i / 32] >> (i % 32)) & 1;
 	}
 
-	if (!fast_check) {
+	free(blocks);
+	free(bitmap);
+
+	return retval;
+}
+
+int default_flash_blank_check(struct flash_bank *bank)
+{
+	int retval;
+
+	if (bank->target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	retval = flash_blank_check_sectors(bank, 0xff);
+	if (retval != ERROR_OK) {
 		LOG_USER("Running slow fallback erase check - add working memory");
 		return default_flash_mem_blank_check(bank);
 	}
@@ -508,6 +714,15 @@ int flash_erase_address_range(struct target *target,
 		addr, length, &flash_driver_erase);
 }
 
+/* like flash_erase_address_range() with padding, but leaves the erase
+ * running where the driver supports that */
+static int flash_erase_address_range_start(struct target *target,
+	uint32_t addr, uint32_t length)
+{
+	return flash_iterate_address_range(target, "erase",
+		addr, length, &flash_driver_erase_start);
+}
+
 static int flash_driver_unprotect(struct flash_bank *bank, int first, int last)
 {
 	return flash_driver_protect(bank, 0, first, last);
@@ -537,11 +752,260 @@ static int compare_section(const void *a, const void *b)
 		return -1;
 }
 
-int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
+/* unlock one stretch of a run and start erasing it ahead of programming;
+ * the erase is completed by the first driver call touching the bank */
+static int flash_prepare_range(struct target *target,
+	uint32_t address, uint32_t size, int erase, bool unlock)
 {
 	int retval = ERROR_OK;
 
+	if (unlock)
+		retval = flash_unlock_address_range(target, address, size);
+	if (retval == ERROR_OK && erase)
+		retval = flash_erase_address_range_start(target, address, size);
+
+	return retval;
+}
+
+/* unlock/erase/program one stretch of a run */
+static int flash_write_range(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, uint32_t address, uint32_t size, int erase, bool unlock)
+{
+	int retval = flash_prepare_range(target, address, size, erase, unlock);
+	if (retval == ERROR_OK)
+		retval = flash_driver_write(c, buffer, address - c->base, size);
+
+	return retval;
+}
+
+/* checksum of flash contents, from the cache if it knows them */
+static int flash_checksum(struct target *target,
+	uint32_t address, uint32_t size, uint32_t *crc)
+{
+	if (flash_cache_checksum(target, address, size, crc))
+		return ERROR_OK;
+
+	return target_checksum_memory(target, address, size, crc);
+}
+
+/**
+ * Incremental variant of flash_write_range(): compares the CRC32 of the
+ * flash contents, computed on the target by target_checksum_memory(),
+ * with that of @a buffer and only touches sectors that differ.
+ * An unchanged run costs a single checksum; otherwise every sector the
+ * run overlaps is checked and consecutive differing sectors are erased
+ * and programmed together.
+ */
+static int flash_write_delta(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, uint32_t address, uint32_t size, int erase, bool unlock,
+	uint32_t *written)
+{
+	uint32_t offset = address - c->base;
+	uint32_t end = offset + size;
+	uint32_t group_start = 0, group_end = 0;
+	uint32_t image_crc, flash_crc;
+	int sector, touched = 0, changed = 0;
+	int retval;
+
+	*written = 0;
+
+	retval = image_calculate_checksum(buffer, size, &image_crc);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = flash_checksum(target, address, size, &flash_crc);
+	if (retval != ERROR_OK)
+		return retval;
+	if (image_crc == flash_crc) {
+		LOG_INFO("flash at 0x%8.8" PRIx32 " (%" PRIu32 " bytes) already up to date",
+			address, size);
+		return ERROR_OK;
+	}
+
+	for (sector = 0; sector <= c->num_sectors; sector++) {
+		uint32_t start = 0, stop = 0;
+		bool differs = false;
+
+		if (sector < c->num_sectors) {
+			start = c->sectors[sector].offset;
+			stop = start + c->sectors[sector].size;
+			if (start < offset)
+				start = offset;
+			if (stop > end)
+				stop = end;
+			if (stop <= start)
+				continue;
+			touched++;
+
+			retval = image_calculate_checksum(buffer + start - offset,
+					stop - start, &image_crc);
+			if (retval != ERROR_OK)
+				return retval;
+			retval = flash_checksum(target, c->base + start,
+					stop - start, &flash_crc);
+			if (retval != ERROR_OK)
+				return retval;
+			differs = image_crc != flash_crc;
+		}
+
+		if (differs) {
+			changed++;
+			if (group_end == start && group_end != group_start) {
+				group_end = stop;
+				continue;
+			}
+		}
+
+		/* flush the pending group of differing sectors */
+		if (group_end != group_start) {
+			retval = flash_write_range(target, c,
+					buffer + group_start - offset, c->base + group_start,
+					group_end - group_start, erase, unlock);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += group_end - group_start;
+		}
+
+		group_start = differs ? start : 0;
+		group_end = differs ? stop : 0;
+	}
+
+	LOG_INFO("flash at 0x%8.8" PRIx32 ": %d of %d sectors changed",
+		address, changed, touched);
+
+	return ERROR_OK;
+}
+
+/* layout check of the plan against the banks as they are now */
+bool flash_plan_valid(struct flash_plan *plan)
+{
+	for (int i = 0; i < plan->num_jobs; i++) {
+		struct flash_write_job *job = &plan->jobs[i];
+		struct flash_bank *c;
+		uint32_t crc;
+
+		for (c = flash_bank_list(); c; c = c->next) {
+			if (c == job->bank)
+				break;
+		}
+		if (c == NULL || c->target != plan->target
+				|| c->num_sectors != plan->num_sectors[i])
+			return false;
+
+		/* drivers get a writable buffer, make sure it wasn't changed */
+		if (image_calculate_checksum(job->buffer, job->count, &crc) != ERROR_OK
+				|| crc != plan->crc[i])
+			return false;
+	}
+
+	return true;
+}
+
+void flash_plan_free(struct flash_plan *plan)
+{
+	if (plan == NULL)
+		return;
+
+	for (int i = 0; i < plan->num_jobs; i++)
+		free(plan->jobs[i].buffer);
+	free(plan->jobs);
+	free(plan->num_sectors);
+	free(plan->crc);
+	free(plan->checks);
+	free(plan);
+}
+
+static int flash_plan_add_job(struct flash_plan *plan, struct flash_bank *c,
+	uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct flash_write_job *jobs;
+	int *num_sectors;
+	uint32_t *crc, buffer_crc;
+	int retval;
+
+	retval = image_calculate_checksum(buffer, count, &buffer_crc);
+	if (retval != ERROR_OK)
+		return retval;
+
+	jobs = realloc(plan->jobs, (plan->num_jobs + 1) * sizeof(*jobs));
+	if (jobs != NULL)
+		plan->jobs = jobs;
+	num_sectors = realloc(plan->num_sectors, (plan->num_jobs + 1) * sizeof(*num_sectors));
+	if (num_sectors != NULL)
+		plan->num_sectors = num_sectors;
+	crc = realloc(plan->crc, (plan->num_jobs + 1) * sizeof(*crc));
+	if (crc != NULL)
+		plan->crc = crc;
+	if (jobs == NULL || num_sectors == NULL || crc == NULL) {
+		LOG_ERROR("Out of memory for flash write jobs");
+		return ERROR_FAIL;
+	}
+
+	jobs[plan->num_jobs].bank = c;
+	jobs[plan->num_jobs].buffer = buffer;
+	jobs[plan->num_jobs].offset = offset;
+	jobs[plan->num_jobs].count = count;
+	num_sectors[plan->num_jobs] = c->num_sectors;
+	crc[plan->num_jobs] = buffer_crc;
+	plan->num_jobs++;
+
+	return ERROR_OK;
+}
+
+/* the CRC32 of every part of an image section that goes to flash, taken
+ * from the jobs since padding may differ from what ends up in flash */
+static int flash_plan_add_checks(struct flash_plan *plan, struct image *image)
+{
+	for (int i = 0; i < image->num_sections; i++) {
+		uint32_t address = image->sections[i].base_address;
+		uint32_t end = address + image->sections[i].size;
+
+		for (int j = 0; j < plan->num_jobs; j++) {
+			struct flash_write_job *job = &plan->jobs[j];
+			uint32_t start = job->bank->base + job->offset;
+			uint32_t stop = start + job->count;
+			struct flash_plan_check *checks;
+			int retval;
+
+			if (start < address)
+				start = address;
+			if (stop > end)
+				stop = end;
+			if (stop <= start)
+				continue;
+
+			checks = realloc(plan->checks, (plan->num_checks + 1) * sizeof(*checks));
+			if (checks == NULL) {
+				LOG_ERROR("Out of memory for flash verify list");
+				return ERROR_FAIL;
+			}
+			plan->checks = checks;
+			checks[plan->num_checks].address = start;
+			checks[plan->num_checks].size = stop - start;
+			retval = image_calculate_checksum(job->buffer
+					+ start - job->bank->base - job->offset,
+					stop - start, &checks[plan->num_checks].crc);
+			if (retval != ERROR_OK)
+				return retval;
+			plan->num_checks++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Reads @a image into sector aligned runs, one job per run.  With
+ * @a prepare, each run is unlocked and its erase started before its data
+ * is read, so that reading overlaps with erasing.
+ */
+static int flash_plan_build(struct flash_plan *plan, struct image *image,
+	bool prepare)
+{
+	struct target *target = plan->target;
+	int erase = plan->erase;
+	bool unlock = plan->unlock;
+	int retval = ERROR_OK;
+
 	int section;
 	uint32_t section_offset;
 	struct flash_bank *c;
@@ -550,16 +1014,6 @@ int flash_write_unlock(struct target *target, struct image *image,
 	section = 0;
 	section_offset = 0;
 
-	if (written)
-		*written = 0;
-
-	if (erase) {
-		/* assume all sectors need erasing - stops any problems
-		 * when flash_write is called multiple times */
-
-		flash_set_dirty();
-	}
-
 	/* allocate padding array */
 	padding = calloc(image->num_sections, sizeof(*padding));
 
@@ -672,6 +1126,15 @@ int flash_write_unlock(struct target *target, struct image *image,
 			run_size += delta;
 		}
 
+		/* unlock and start erasing before reading the image data, which
+		 * is then prepared while the flash is busy erasing */
+		if (prepare) {
+			retval = flash_prepare_range(target, run_address, run_size,
+					erase, unlock);
+			if (retval != ERROR_OK)
+				goto done;
+		}
+
 		/* allocate buffer */
 		buffer = malloc(run_size);
 		if (buffer == NULL) {
@@ -681,6 +1144,9 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 		buffer_size = 0;
 
+		struct flash_stats_mark mark;
+		flash_stats_enter(&mark, FLASH_PHASE_PREPARE);
+
 		/* read sections to the buffer */
 		while (buffer_size < run_size) {
 			size_t size_read;
@@ -704,6 +1170,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 			retval = image_read_section(image, t_section_num, section_offset,
 					size_read, buffer + buffer_size, &size_read);
 			if (retval != ERROR_OK || size_read == 0) {
+				flash_stats_leave(&mark);
 				free(buffer);
 				goto done;
 			}
@@ -721,37 +1188,301 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
+		retval = flash_plan_add_job(plan, c, buffer, run_address - c->base, run_size);
+		if (retval != ERROR_OK)
+			free(buffer);
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+		flash_stats_leave(&mark);
+
+		if (retval != ERROR_OK) {
+			/* abort operation */
+			goto done;
 		}
+	}
+
+	retval = flash_plan_add_checks(plan, image);
+
+done:
+	free(sections);
+	free(padding);
+
+	return retval;
+}
+
+/* compare the flash contents with each image section by CRC32; unlike
+ * the incremental write this must not trust the flash cache */
+static int flash_plan_verify(struct flash_plan *plan)
+{
+	struct flash_stats_mark mark;
+	int retval = ERROR_OK;
 
-		if (retval == ERROR_OK) {
-			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+	flash_stats_enter(&mark, FLASH_PHASE_VERIFY);
+
+	for (int i = 0; i < plan->num_checks && retval == ERROR_OK; i++) {
+		struct flash_plan_check *check = &plan->checks[i];
+		uint32_t flash_crc;
+
+		retval = target_checksum_memory(plan->target, check->address,
+				check->size, &flash_crc);
+		if (retval == ERROR_OK && check->crc != flash_crc) {
+			LOG_ERROR("verify failed for %" PRIu32 " bytes at 0x%8.8" PRIx32,
+				check->size, check->address);
+			retval = ERROR_FLASH_OPERATION_FAILED;
 		}
+	}
 
-		free(buffer);
+	flash_stats_leave(&mark);
 
-		if (retval != ERROR_OK) {
-			/* abort operation */
+	return retval;
+}
+
+/* program the jobs of a plan, unlocking and erasing first unless
+ * flash_plan_build() already started that */
+static int flash_plan_program(struct flash_plan *plan, uint32_t *written,
+	bool prepared, bool incremental)
+{
+	int retval = ERROR_OK;
+
+	if (incremental) {
+		for (int i = 0; i < plan->num_jobs && retval == ERROR_OK; i++) {
+			struct flash_write_job *job = &plan->jobs[i];
+			struct flash_stats_mark mark;
+			uint32_t run_written = 0;
+
+			/* comparing is verify time, the writes are charged on their own */
+			flash_stats_enter(&mark, FLASH_PHASE_VERIFY);
+			retval = flash_write_delta(plan->target, job->bank, job->buffer,
+					job->bank->base + job->offset, job->count,
+					plan->erase, plan->unlock, &run_written);
+			flash_stats_leave(&mark);
+			*written += run_written;
+		}
+		return retval;
+	}
+
+	for (int i = 0; i < plan->num_jobs && retval == ERROR_OK && !prepared; i++) {
+		struct flash_write_job *job = &plan->jobs[i];
+		retval = flash_prepare_range(plan->target, job->bank->base + job->offset,
+				job->count, plan->erase, plan->unlock);
+	}
+
+	/* program once all runs are prepared, so that runs in independent
+	 * banks can be written concurrently and erases keep running while
+	 * other banks are programmed */
+	if (retval == ERROR_OK && plan->num_jobs)
+		retval = flash_driver_write_jobs(plan->jobs, plan->num_jobs);
+
+	for (int i = 0; i < plan->num_jobs && retval == ERROR_OK; i++)
+		*written += plan->jobs[i].count;
+
+	return retval;
+}
+
+int flash_write_plan(struct target *target, struct image *image,
+	struct flash_plan **plan, uint32_t *written, int erase, bool unlock,
+	bool incremental, bool verify)
+{
+	struct flash_plan *p = plan ? *plan : NULL;
+	uint32_t total = 0;
+	bool prepared = false;
+	int retval = ERROR_OK;
+
+	flash_stats_start();
+
+	if (erase) {
+		/* assume all sectors need erasing - stops any problems
+		 * when flash_write is called multiple times */
+
+		flash_set_dirty();
+	}
+
+	if (p == NULL) {
+		p = calloc(1, sizeof(*p));
+		if (p == NULL) {
+			LOG_ERROR("Out of memory for flash write plan");
+			retval = ERROR_FAIL;
 			goto done;
 		}
+		p->target = target;
+		p->erase = erase;
+		p->unlock = unlock;
 
-		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+		prepared = !incremental;
+		retval = flash_plan_build(p, image, prepared);
 	}
 
+	if (retval == ERROR_OK)
+		retval = flash_plan_program(p, &total, prepared, incremental);
+
+	if (retval == ERROR_OK && verify)
+		retval = flash_plan_verify(p);
+
 done:
-	free(sections);
-	free(padding);
+	/* don't leave an erase running behind a failure; one that fails
+	 * unnoticed fails the write */
+	for (struct flash_bank *c = flash_bank_list(); c; c = c->next) {
+		int wait_retval = flash_driver_erase_wait(c);
+		if (retval == ERROR_OK)
+			retval = wait_retval;
+	}
+
+	flash_stats_stop();
+
+	if (plan && *plan == NULL && retval == ERROR_OK)
+		*plan = p;
+	else if (plan == NULL || *plan != p)
+		flash_plan_free(p);
+
+	if (written)
+		*written = total;
+
+	return retval;
+}
+
+int flash_write_unlock(struct target *target, struct image *image,
+	uint32_t *written, int erase, bool unlock, bool incremental, bool verify)
+{
+	return flash_write_plan(target, image, NULL, written, erase, unlock,
+			incremental, verify);
+}
+
+/* the jobs of @a plan moved to the same addresses on @a target, whose
+ * banks must be laid out the same way; the buffers stay shared */
+static int flash_plan_bind(struct flash_plan *plan, struct target *target,
+	struct flash_plan *bound)
+{
+	*bound = *plan;
+	bound->target = target;
+	bound->jobs = malloc(plan->num_jobs * sizeof(*bound->jobs));
+	if (bound->jobs == NULL && plan->num_jobs) {
+		LOG_ERROR("Out of memory for flash write jobs");
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < plan->num_jobs; i++) {
+		struct flash_bank *bank = plan->jobs[i].bank;
+		struct flash_bank *c;
+		int retval;
+
+		retval = get_flash_bank_by_addr(target, bank->base, false, &c);
+		if (retval != ERROR_OK)
+			return retval;
+		if (c == NULL || c->base != bank->base || c->size != bank->size
+				|| c->num_sectors != bank->num_sectors) {
+			LOG_ERROR("%s: flash at 0x%8.8" PRIx32 " differs from that of %s",
+				target_name(target), bank->base, target_name(plan->target));
+			return ERROR_FLASH_BANK_INVALID;
+		}
+		for (int j = 0; j < c->num_sectors; j++) {
+			if (c->sectors[j].offset != bank->sectors[j].offset
+					|| c->sectors[j].size != bank->sectors[j].size) {
+				LOG_ERROR("%s: sectors of flash at 0x%8.8" PRIx32 " differ from "
+					"those of %s", target_name(target), bank->base,
+					target_name(plan->target));
+				return ERROR_FLASH_BANK_INVALID;
+			}
+		}
+
+		bound->jobs[i] = plan->jobs[i];
+		bound->jobs[i].bank = c;
+	}
+
+	return ERROR_OK;
+}
+
+int flash_write_gang(struct image *image, struct flash_gang_result *results,
+	int num_targets, int erase, bool unlock, bool verify)
+{
+	struct flash_plan *plan;
+	struct flash_plan *bound;
+	int retval = ERROR_OK;
+
+	for (int i = 0; i < num_targets; i++) {
+		results[i].retval = ERROR_OK;
+		results[i].written = 0;
+		results[i].seconds = 0;
+	}
+	if (num_targets == 0)
+		return ERROR_OK;
+
+	plan = calloc(1, sizeof(*plan));
+	bound = calloc(num_targets, sizeof(*bound));
+	if (plan == NULL || bound == NULL) {
+		free(plan);
+		free(bound);
+		LOG_ERROR("Out of memory for flash write plan");
+		return ERROR_FAIL;
+	}
+
+	flash_stats_start();
+
+	if (erase)
+		flash_set_dirty();
+
+	/* the image is read once, into the plan of the first target */
+	plan->target = results[0].target;
+	plan->erase = erase;
+	plan->unlock = unlock;
+	retval = flash_plan_build(plan, image, false);
+	for (int i = 0; i < num_targets; i++) {
+		if (retval == ERROR_OK)
+			results[i].retval = flash_plan_bind(plan, results[i].target, &bound[i]);
+		else
+			results[i].retval = retval;
+	}
+
+	/* unlock and start erasing everywhere, so that the erases of the
+	 * other targets run while the first one is programmed */
+	for (int i = 0; i < num_targets; i++) {
+		struct duration bench;
+
+		if (results[i].retval != ERROR_OK)
+			continue;
+		duration_start(&bench);
+		for (int j = 0; j < bound[i].num_jobs && results[i].retval == ERROR_OK; j++) {
+			struct flash_write_job *job = &bound[i].jobs[j];
+			results[i].retval = flash_prepare_range(results[i].target,
+					job->bank->base + job->offset, job->count, erase, unlock);
+		}
+		if (duration_measure(&bench) == ERROR_OK)
+			results[i].seconds += duration_elapsed(&bench);
+	}
+
+	for (int i = 0; i < num_targets; i++) {
+		struct duration bench;
+
+		if (results[i].retval != ERROR_OK)
+			continue;
+		duration_start(&bench);
+		results[i].retval = flash_plan_program(&bound[i], &results[i].written,
+				true, false);
+		if (results[i].retval == ERROR_OK && verify)
+			results[i].retval = flash_plan_verify(&bound[i]);
+		if (duration_measure(&bench) == ERROR_OK)
+			results[i].seconds += duration_elapsed(&bench);
+	}
+
+	/* don't leave an erase running behind a failure; one that fails
+	 * unnoticed fails the write on its target */
+	for (struct flash_bank *c = flash_bank_list(); c; c = c->next) {
+		int wait_retval = flash_driver_erase_wait(c);
+		if (wait_retval == ERROR_OK)
+			continue;
+		for (int i = 0; i < num_targets; i++) {
+			if (results[i].target == c->target && results[i].retval == ERROR_OK)
+				results[i].retval = wait_retval;
+		}
+	}
+
+	flash_stats_stop();
+
+	for (int i = 0; i < num_targets; i++) {
+		free(bound[i].jobs);
+		if (results[i].retval != ERROR_OK)
+			retval = ERROR_FAIL;
+	}
+	free(bound);
+	flash_plan_free(plan);
 
 	return retval;
 }
@@ -759,5 +1490,11 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, int erase)
 {
-	return flash_write_unlock(target, image, written, erase, false);
+	return flash_write_unlock(target, image, written, erase, false, false, false);
+}
+
+int flash_write_incremental(struct target *target, struct image *image,
+	uint32_t *written, int erase)
+{
+	return flash_write_unlock(target, image, written, erase, false, true, false);
 }
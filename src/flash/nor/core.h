@@ -96,12 +96,59 @@ struct flash_bank {
 	/** Array of sectors, allocated and initilized by the flash driver */
 	struct flash_sector *sectors;
 
+	/** An erase started by flash_driver_s::erase_start is still running */
+	bool erase_pending;
+	int erase_first; /**< Sectors of the pending erase */
+	int erase_last;
+
+	/** Host side record of the sector contents, see flash_cache_read() */
+	struct flash_sector_cache *cache;
+	int cache_sectors; /**< Number of entries in @c cache */
+	/** Entries recorded in another generation are stale */
+	uint32_t cache_generation;
+
 	struct flash_bank *next; /**< The next flash bank on this chip */
 };
 
 /** Registers the 'flash' subsystem commands */
 int flash_register_commands(struct command_context *cmd_ctx);
 
+/** What the flash content cache keeps for each sector. */
+enum flash_cache_mode {
+	FLASH_CACHE_OFF,
+	FLASH_CACHE_CRC,	/**< checksums, for verification */
+	FLASH_CACHE_CONTENT,	/**< complete sector contents */
+};
+
+/**
+ * Sets what the flash core records about the sectors it writes, or
+ * reads in full, so verification and reads can skip the target.
+ * Records are dropped when they can no longer be trusted: when the
+ * sector is erased, the target resets or runs, memory in the bank is
+ * written other than through the flash core, or a driver specific
+ * command is invoked on the bank.
+ */
+void flash_cache_set_mode(enum flash_cache_mode mode);
+enum flash_cache_mode flash_cache_get_mode(void);
+
+/**
+ * Serves a read of @a count bytes at @a addr from the flash content
+ * cache.
+ * @returns true if the whole range was recorded and @a buffer filled.
+ */
+bool flash_cache_read(struct target *target,
+		uint32_t addr, uint32_t count, uint8_t *buffer);
+/**
+ * Computes the checksum target_checksum_memory() would return for
+ * @a count bytes at @a addr from the flash content cache.
+ * @returns true if the cache knew the range.
+ */
+bool flash_cache_checksum(struct target *target,
+		uint32_t addr, uint32_t count, uint32_t *crc);
+/** Forgets recorded contents overlapping @a count bytes at @a addr. */
+void flash_cache_invalidate_range(struct target *target,
+		uint32_t addr, uint32_t count);
+
 /**
  * Erases @a length bytes in the @a target flash, starting at @a addr.
  * The range @a addr to @a addr + @a length - 1 must be strictly
@@ -128,6 +175,15 @@ int flash_unlock_address_range(struct target *target, uint32_t addr,
 int flash_write(struct target *target,
 		struct image *image, uint32_t *written, int erase);
 
+/**
+ * Like flash_write(), but first compares each sector the image touches
+ * with a CRC computed on the target and skips those already holding the
+ * right data.  Only the sectors that differ are erased and programmed;
+ * @a written counts just their bytes.
+ */
+int flash_write_incremental(struct target *target,
+		struct image *image, uint32_t *written, int erase);
+
 /**
  * Forces targets to re-examine their erase/protection state.
  * This routine must be called when the system may modify the status.
@@ -152,6 +208,15 @@ int default_flash_read(struct flash_bank *bank,
  * @returns ERROR_OK if successful; otherwise, an error code.
  */
 int default_flash_blank_check(struct flash_bank *bank);
+/**
+ * Checks all sectors of @a bank in as few algorithm runs as the
+ * target's working area allows, updating their is_erased flags.
+ * @param bank The bank to check.
+ * @param erased_value The value of an erased byte.
+ * @returns ERROR_OK if successful; otherwise, an error code, in which
+ * case the caller should fall back to reading the bank.
+ */
+int flash_blank_check_sectors(struct flash_bank *bank, uint8_t erased_value);
 
 /**
  * Returns the flash bank specified by @a name, which matches the
@@ -204,4 +269,14 @@ struct flash_bank *get_flash_bank_by_num_noprobe(int num);
 int get_flash_bank_by_addr(struct target *target, uint32_t addr, bool check,
 		struct flash_bank **result_bank);
 
+/**
+ * Copies @a count bytes of target memory at @a address to a file.
+ * Ranges inside flash banks are read through the flash drivers.
+ * @param map If true and the host allows it, the file is mapped into
+ * memory and target reads go straight into it.
+ * @returns ERROR_OK if the file was written, or an error.
+ */
+int flash_dump_memory(struct target *target, uint32_t address,
+		uint32_t count, const char *filename, bool map);
+
 #endif /* FLASH_NOR_CORE_H */
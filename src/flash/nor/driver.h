@@ -26,6 +26,17 @@
 
 struct flash_bank;
 
+/**
+ * One bank's share of a concurrent write, see
+ * flash_driver_s::write_concurrent.
+ */
+struct flash_write_job {
+	struct flash_bank *bank;
+	uint8_t *buffer;
+	uint32_t offset;	/**< offset into the bank */
+	uint32_t count;		/**< number of bytes */
+};
+
 #define __FLASH_BANK_COMMAND(name) \
 		COMMAND_HELPER(name, struct flash_bank *bank)
 
@@ -108,6 +119,29 @@ struct flash_driver {
 	 */
 	int (*erase)(struct flash_bank *bank, int first, int last);
 
+	/**
+	 * Optionally start erasing sectors without waiting for the
+	 * erase to complete, so the host can prepare data or program
+	 * other banks meanwhile.  The flash layer calls
+	 * flash_driver_s::erase_wait before any other operation on
+	 * the bank; drivers whose hardware erases one sector at a time
+	 * may issue the remaining sectors from there.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param first The number of the first sector to erase.
+	 * @param last The number of the last sector to erase.
+	 * @returns ERROR_OK if the erase was started; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, int first, int last);
+
+	/**
+	 * Complete the erase begun by flash_driver_s::erase_start.
+	 *
+	 * @param bank The bank being erased.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*erase_wait)(struct flash_bank *bank);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
@@ -139,6 +173,22 @@ struct flash_driver {
 	int (*write)(struct flash_bank *bank,
 			uint8_t *buffer, uint32_t offset, uint32_t count);
 
+	/**
+	 * Optionally program several banks at the same time, for parts
+	 * whose banks have independent flash controllers.  Every job
+	 * addresses a different bank of this driver on the same target.
+	 *
+	 * The driver should check that it can handle the combination
+	 * before touching the flash, and return
+	 * ERROR_TARGET_RESOURCE_NOT_AVAILABLE if it can't; the jobs are
+	 * then passed to flash_driver_s::write one after another.
+	 *
+	 * @param jobs The banks and data to program.
+	 * @param num_jobs Number of entries in @a jobs, at least two.
+	 * @returns ERROR_OK if successful; otherwise, an error code.
+	 */
+	int (*write_concurrent)(struct flash_write_job *jobs, int num_jobs);
+
 	/**
 	 * Read data from the flash. Note CPU address will be
 	 * "bank->base + offset", while the physical address is
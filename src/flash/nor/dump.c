@@ -0,0 +1,238 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <helper/fileio.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/**
+ * @file
+ * Copying target memory, flash or not, to a file.
+ *
+ * Memory is read in large chunks; ranges inside a flash bank go
+ * through flash_driver_read(), so that drivers with their own read
+ * method, pending background erases and the flash cache are taken
+ * into account.  Only banks that may hold part of the dump are probed,
+ * once per dump; a bank that fails to probe is read as plain memory,
+ * so that a RAM dump doesn't depend on unrelated flash.
+ *
+ * Target accesses block, so rather than handing buffers to a writer,
+ * the file can be mapped into memory: each chunk is then read straight
+ * into the page cache and the kernel writes it back while the next
+ * chunk is transferred, which leaves the debug link as the limit.
+ */
+
+/* bytes read from the target at once */
+#define FLASH_DUMP_CHUNK	(64 * 1024)
+
+struct flash_dump {
+	struct target *target;
+	/* the probed banks holding part of the dump */
+	struct flash_bank **banks;
+	unsigned num_banks;
+};
+
+/* whether bank @a c can hold part of the range; banks configured with
+ * a size of 0 are only sized by probing */
+static bool flash_dump_may_hold(struct flash_bank *c, uint32_t address,
+		uint32_t count)
+{
+	uint64_t end = (uint64_t)address + count;
+
+	if (c->base >= end)
+		return false;
+	return c->size == 0 || (uint64_t)c->base + c->size > address;
+}
+
+static int flash_dump_find_banks(struct flash_dump *d, struct target *target,
+		uint32_t address, uint32_t count)
+{
+	unsigned num_banks = 0;
+
+	d->target = target;
+	d->num_banks = 0;
+	for (struct flash_bank *c = flash_bank_list(); c; c = c->next)
+		num_banks++;
+
+	d->banks = malloc(num_banks * sizeof(*d->banks));
+	if (d->banks == NULL && num_banks) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (struct flash_bank *c = flash_bank_list(); c; c = c->next) {
+		if (c->target != target || !flash_dump_may_hold(c, address, count))
+			continue;
+
+		if (c->driver->auto_probe(c) != ERROR_OK) {
+			LOG_WARNING("couldn't probe flash bank %d, "
+				"reading it as plain memory", c->bank_number);
+			continue;
+		}
+		if (c->size && flash_dump_may_hold(c, address, count))
+			d->banks[d->num_banks++] = c;
+	}
+
+	return ERROR_OK;
+}
+
+/* read the next stretch of memory at @a address, up to @a count bytes */
+static int flash_dump_read(struct flash_dump *d, uint32_t address,
+		uint32_t *count, uint8_t *buffer)
+{
+	for (unsigned i = 0; i < d->num_banks; i++) {
+		struct flash_bank *c = d->banks[i];
+
+		if (address >= c->base && address - c->base < c->size) {
+			if (*count > c->size - (address - c->base))
+				*count = c->size - (address - c->base);
+			return flash_driver_read(c, buffer, address - c->base, *count);
+		}
+		/* stop plain memory reads where a bank starts */
+		if (c->base > address && c->base - address < *count)
+			*count = c->base - address;
+	}
+
+	return target_read_buffer(d->target, address, *count, buffer);
+}
+
+static int flash_dump_buffered(struct flash_dump *d, uint32_t address,
+		uint32_t count, const char *filename)
+{
+	struct fileio fileio;
+	uint8_t *buffer;
+	int retval, retvaltemp;
+
+	buffer = malloc(count < FLASH_DUMP_CHUNK ? count : FLASH_DUMP_CHUNK);
+	if (buffer == NULL && count) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = fileio_open(&fileio, filename, FILEIO_WRITE, FILEIO_BINARY);
+	if (retval != ERROR_OK) {
+		free(buffer);
+		return retval;
+	}
+
+	while (count > 0) {
+		uint32_t this_run_size = count < FLASH_DUMP_CHUNK ? count : FLASH_DUMP_CHUNK;
+		size_t size_written;
+
+		retval = flash_dump_read(d, address, &this_run_size, buffer);
+		if (retval != ERROR_OK)
+			break;
+
+		retval = fileio_write(&fileio, this_run_size, buffer, &size_written);
+		if (retval != ERROR_OK)
+			break;
+
+		count -= this_run_size;
+		address += this_run_size;
+		keep_alive();
+	}
+
+	free(buffer);
+
+	retvaltemp = fileio_close(&fileio);
+	if (retval == ERROR_OK)
+		retval = retvaltemp;
+
+	return retval;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+static int flash_dump_mapped(struct flash_dump *d, uint32_t address,
+		uint32_t count, const char *filename)
+{
+	uint8_t *map;
+	uint32_t done = 0;
+	int fd, retval = ERROR_OK;
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		LOG_ERROR("couldn't open %s: %s", filename, strerror(errno));
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	if (ftruncate(fd, count) != 0) {
+		LOG_ERROR("couldn't size %s: %s", filename, strerror(errno));
+		close(fd);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	map = mmap(NULL, count, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		LOG_ERROR("couldn't map %s: %s", filename, strerror(errno));
+		close(fd);
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	while (done < count) {
+		uint32_t this_run_size = count - done;
+
+		if (this_run_size > FLASH_DUMP_CHUNK)
+			this_run_size = FLASH_DUMP_CHUNK;
+		retval = flash_dump_read(d, address + done, &this_run_size, map + done);
+		if (retval != ERROR_OK)
+			break;
+
+		done += this_run_size;
+		keep_alive();
+	}
+
+	if (munmap(map, count) != 0 && retval == ERROR_OK)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	if (close(fd) != 0 && retval == ERROR_OK)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+
+	return retval;
+}
+#endif
+
+int flash_dump_memory(struct target *target, uint32_t address,
+		uint32_t count, const char *filename, bool map)
+{
+	struct flash_dump d;
+	int retval;
+
+	retval = flash_dump_find_banks(&d, target, address, count);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (map && count > 0) {
+#ifdef HAVE_SYS_MMAN_H
+		retval = flash_dump_mapped(&d, address, count, filename);
+		free(d.banks);
+		return retval;
+#else
+		LOG_WARNING("mapped files are not supported on this host");
+#endif
+	}
+
+	retval = flash_dump_buffered(&d, address, count, filename);
+	free(d.banks);
+
+	return retval;
+}
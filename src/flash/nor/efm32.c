@@ -32,6 +32,7 @@
 #endif
 
 #include "imp.h"
+#include "async.h"
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
@@ -487,13 +488,8 @@ static int efm32x_protect(struct flash_bank *bank, int set, int first, int last)
 static int efm32x_write_block(struct flash_bank *bank, uint8_t *buf,
 	uint32_t offset, uint32_t count)
 {
-	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
-	struct working_area *write_algorithm;
-	struct working_area *source;
 	uint32_t address = bank->base + offset;
 	struct reg_param reg_params[5];
-	struct armv7m_algorithm armv7m_info;
 	int ret = ERROR_OK;
 
 	/* see contrib/loaders/flash/efm32.S for src */
@@ -570,31 +566,12 @@ static int efm32x_write_block(struct flash_bank *bank, uint8_t *buf,
 			0x71, 0x1b, 0x00, 0x00
 	};
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(efm32x_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	};
-
-	ret = target_write_buffer(target, write_algorithm->address,
-		sizeof(efm32x_flash_write_code),
-		(uint8_t *)efm32x_flash_write_code);
-	if (ret != ERROR_OK)
-		return ret;
-
-	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		buffer_size &= ~3UL; /* Make sure it's 4 byte aligned */
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	static const struct flash_async_loader efm32x_loader = {
+		.code = efm32x_flash_write_code,
+		.code_size = sizeof(efm32x_flash_write_code),
+		.block_size = 4,
+		.fifo_start_param = 2,
+		.fifo_end_param = 3,
 	};
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* flash base (in), status (out) */
@@ -605,19 +582,9 @@ static int efm32x_write_block(struct flash_bank *bank, uint8_t *buf,
 
 	buf_set_u32(reg_params[0].value, 0, 32, EFM32_MSC_REGBASE);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
-	buf_set_u32(reg_params[2].value, 0, 32, source->address);
-	buf_set_u32(reg_params[3].value, 0, 32, source->address + source->size);
 	buf_set_u32(reg_params[4].value, 0, 32, address);
 
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
-
-	ret = target_run_flash_async_algorithm(target, buf, count, 4,
-			0, NULL,
-			5, reg_params,
-			source->address, source->size,
-			write_algorithm->address, 0,
-			&armv7m_info);
+	ret = flash_async_write(bank, &efm32x_loader, buf, count, 5, reg_params);
 
 	if (ret == ERROR_FLASH_OPERATION_FAILED) {
 		LOG_ERROR("flash write failed at address 0x%"PRIx32,
@@ -634,9 +601,6 @@ static int efm32x_write_block(struct flash_bank *bank, uint8_t *buf,
 		}
 	}
 
-	target_free_working_area(target, source);
-	target_free_working_area(target, write_algorithm);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
@@ -29,12 +29,14 @@
 #endif
 
 #include "imp.h"
+#include "async.h"
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
 
 /* em357 register locations */
 
+#define EM357_FLASH_BASE        0x40008000
 #define EM357_FLASH_ACR         0x40008000
 #define EM357_FLASH_KEYR        0x40008004
 #define EM357_FLASH_OPTKEYR     0x40008008
@@ -456,127 +458,89 @@ static int em357_write_block(struct flash_bank *bank, uint8_t *buffer,
 	uint32_t offset, uint32_t count)
 {
 	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
-	struct working_area *write_algorithm;
-	struct working_area *source;
 	uint32_t address = bank->base + offset;
-	struct reg_param reg_params[4];
-	struct armv7m_algorithm armv7m_info;
+	struct reg_param reg_params[5];
 	int retval = ERROR_OK;
 
-	/* see contib/loaders/flash/stm32x.s for src, the same is used here except for
-	 * a modified *_FLASH_BASE */
+	/* see contrib/loaders/flash/em357.S for src */
 
 	static const uint8_t em357_flash_write_code[] = {
-		/* #define EM357_FLASH_CR_OFFSET	0x10
-		 * #define EM357_FLASH_SR_OFFSET	0x0C
-		 * write: */
-		0x08, 0x4c,					/* ldr	r4, EM357_FLASH_BASE */
-		0x1c, 0x44,					/* add	r4, r3 */
-		/* write_half_word: */
-		0x01, 0x23,					/* movs	r3, #0x01 */
-		0x23, 0x61,					/* str	r3, [r4,
-								 *#EM357_FLASH_CR_OFFSET] */
-		0x30, 0xf8, 0x02, 0x3b,		/* ldrh	r3, [r0], #0x02 */
-		0x21, 0xf8, 0x02, 0x3b,		/* strh	r3, [r1], #0x02 */
+		/* #define EM357_FLASH_CR_OFFSET	0x10 */
+		/* #define EM357_FLASH_SR_OFFSET	0x0C */
+		/* wait_fifo: */
+		0x16, 0x68,					/* ldr	r6, [r2, #0] */
+		0x00, 0x2e,					/* cmp	r6, #0 */
+		0x19, 0xd0,					/* beq	exit */
+		0x55, 0x68,					/* ldr	r5, [r2, #4] */
+		0xb5, 0x42,					/* cmp	r5, r6 */
+		0xf9, 0xd0,					/* beq	wait_fifo */
+		0x01, 0x26,					/* movs	r6, #1 */
+		0x06, 0x61,					/* str	r6, [r0, #EM357_FLASH_CR_OFFSET] */
+		0x35, 0xf8, 0x02, 0x6b,		/* ldrh	r6, [r5], #2 */
+		0x24, 0xf8, 0x02, 0x6b,		/* strh	r6, [r4], #2 */
 		/* busy: */
-		0xe3, 0x68,					/* ldr	r3, [r4,
-								 *#EM357_FLASH_SR_OFFSET] */
-		0x13, 0xf0, 0x01, 0x0f,		/* tst	r3, #0x01 */
-		0xfb, 0xd0,					/* beq	busy */
-		0x13, 0xf0, 0x14, 0x0f,		/* tst	r3, #0x14 */
-		0x01, 0xd1,					/* bne	exit */
-		0x01, 0x3a,					/* subs	r2, r2, #0x01 */
-		0xf0, 0xd1,					/* bne	write_half_word */
+		0xc6, 0x68,					/* ldr	r6, [r0, #EM357_FLASH_SR_OFFSET] */
+		0x16, 0xf0, 0x01, 0x0f,		/* tst	r6, #0x01 */
+		0xfb, 0xd1,					/* bne	busy */
+		0x16, 0xf0, 0x14, 0x0f,		/* tst	r6, #0x14 */
+		0x07, 0xd1,					/* bne	error */
+		0x9d, 0x42,					/* cmp	r5, r3 */
+		0x28, 0xbf,					/* it	cs */
+		0x02, 0xf1, 0x08, 0x05,		/* addcs	r5, r2, #8 */
+		0x55, 0x60,					/* str	r5, [r2, #4] */
+		0x49, 0x1e,					/* subs	r1, r1, #1 */
+		0x11, 0xb1,					/* cbz	r1, exit */
+		0xe4, 0xe7,					/* b	wait_fifo */
+		/* error: */
+		0x00, 0x25,					/* movs	r5, #0 */
+		0x55, 0x60,					/* str	r5, [r2, #4] */
 		/* exit: */
+		0x30, 0x46,					/* mov	r0, r6 */
 		0x00, 0xbe,					/* bkpt	#0x00 */
-		0x00, 0x80, 0x00, 0x40,		/* EM357_FLASH_BASE: .word 0x40008000 */
 	};
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(em357_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-	;
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(em357_flash_write_code), (uint8_t *)em357_flash_write_code);
-	if (retval != ERROR_OK)
-		return retval;
-
-	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING(
-				"no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
-	}
-	;
-
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
-
-	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
-	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
-	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
-	init_reg_param(&reg_params[3], "r3", 32, PARAM_IN_OUT);
+	static const struct flash_async_loader em357_loader = {
+		.code = em357_flash_write_code,
+		.code_size = sizeof(em357_flash_write_code),
+		.block_size = 2,
+		.fifo_start_param = 2,
+		.fifo_end_param = 3,
+	};
 
-	while (count > 0) {
-		uint32_t thisrun_count = (count > (buffer_size / 2)) ?
-			(buffer_size / 2) : count;
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* flash base (in), status (out) */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* count (halfword-16bit) */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* buffer start */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* buffer end */
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_IN_OUT);	/* target address */
 
-		retval = target_write_buffer(target, source->address, thisrun_count * 2, buffer);
-		if (retval != ERROR_OK)
-			break;
+	buf_set_u32(reg_params[0].value, 0, 32, EM357_FLASH_BASE);
+	buf_set_u32(reg_params[1].value, 0, 32, count);
+	buf_set_u32(reg_params[4].value, 0, 32, address);
 
-		buf_set_u32(reg_params[0].value, 0, 32, source->address);
-		buf_set_u32(reg_params[1].value, 0, 32, address);
-		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count);
-		buf_set_u32(reg_params[3].value, 0, 32, 0);
+	retval = flash_async_write(bank, &em357_loader, buffer, count, 5, reg_params);
 
-		retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
-				write_algorithm->address, 0, 10000, &armv7m_info);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("error executing em357 flash write algorithm");
-			break;
-		}
+	if (retval == ERROR_FLASH_OPERATION_FAILED) {
+		LOG_ERROR("flash write failed at address 0x%" PRIx32,
+				buf_get_u32(reg_params[4].value, 0, 32));
 
-		if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_PGERR) {
+		if (buf_get_u32(reg_params[0].value, 0, 32) & FLASH_PGERR) {
 			LOG_ERROR("flash memory not erased before writing");
 			/* Clear but report errors */
 			target_write_u32(target, EM357_FLASH_SR, FLASH_PGERR);
-			retval = ERROR_FAIL;
-			break;
 		}
 
-		if (buf_get_u32(reg_params[3].value, 0, 32) & FLASH_WRPRTERR) {
+		if (buf_get_u32(reg_params[0].value, 0, 32) & FLASH_WRPRTERR) {
 			LOG_ERROR("flash memory write protected");
 			/* Clear but report errors */
 			target_write_u32(target, EM357_FLASH_SR, FLASH_WRPRTERR);
-			retval = ERROR_FAIL;
-			break;
 		}
-
-		buffer += thisrun_count * 2;
-		address += thisrun_count * 2;
-		count -= thisrun_count;
 	}
 
-	target_free_working_area(target, source);
-	target_free_working_area(target, write_algorithm);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 	destroy_reg_param(&reg_params[3]);
+	destroy_reg_param(&reg_params[4]);
 
 	return retval;
 }
@@ -25,6 +25,7 @@
 #include "driver.h"
 /* almost all drivers will need this file */
 #include <target/target.h>
+#include <helper/time_support.h>
 
 /**
  * Adds a new NOR bank to the global list of banks.
@@ -38,14 +39,162 @@ void flash_bank_add(struct flash_bank *bank);
 struct flash_bank *flash_bank_list(void);
 
 int flash_driver_erase(struct flash_bank *bank, int first, int last);
+int flash_driver_erase_start(struct flash_bank *bank, int first, int last);
+int flash_driver_erase_wait(struct flash_bank *bank);
 int flash_driver_protect(struct flash_bank *bank, int set, int first, int last);
 int flash_driver_write(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t count);
+int flash_driver_write_jobs(struct flash_write_job *jobs, int num_jobs);
 int flash_driver_read(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t count);
 
+/** Records @a count bytes of @a buffer as the contents at @a offset. */
+void flash_cache_update(struct flash_bank *bank,
+		const uint8_t *buffer, uint32_t offset, uint32_t count);
+/** Forgets the recorded contents of sectors @a first to @a last. */
+void flash_cache_invalidate(struct flash_bank *bank, int first, int last);
+/** Forgets everything recorded about @a bank. */
+void flash_cache_flush(struct flash_bank *bank);
+
+/** Steps of a flash write, see flash_stats_get(). */
+enum flash_phase {
+	FLASH_PHASE_UNLOCK,
+	FLASH_PHASE_ERASE,
+	FLASH_PHASE_PREPARE,	/**< reading and padding image data */
+	FLASH_PHASE_PROGRAM,
+	FLASH_PHASE_VERIFY,	/**< comparing checksums */
+	FLASH_PHASES
+};
+
+struct flash_phase_stats {
+	double seconds;			/**< host time spent in the phase */
+	struct target_timing target;	/**< its share of target operations */
+};
+
+/** What happened to one sector, time shared out among the sectors of each call. */
+struct flash_sector_stats {
+	int bank_number;
+	int sector;
+	bool erased;
+	double erase_seconds;
+	uint32_t bytes;		/**< bytes programmed */
+	double program_seconds;
+};
+
+struct flash_stats {
+	double seconds;		/**< duration of the whole operation */
+	struct flash_phase_stats phase[FLASH_PHASES];
+	int num_sectors;
+	struct flash_sector_stats *sectors;	/**< in order of first use */
+};
+
+/**
+ * Starts recording a new flash write, discarding the previous record;
+ * flash_stats_stop() ends it.
+ */
+void flash_stats_start(void);
+void flash_stats_stop(void);
+/** @returns the record of the latest flash write, NULL if none yet. */
+const struct flash_stats *flash_stats_get(void);
+const char *flash_phase_name(enum flash_phase phase);
+
+/** A step in progress, see flash_stats_enter(). */
+struct flash_stats_mark {
+	enum flash_phase phase;
+	struct duration start;
+	double nested;		/**< seconds spent in steps within this one */
+	struct flash_stats_mark *outer;
+};
+
+/**
+ * Charges the time until the matching flash_stats_leave() to @a phase,
+ * except for the time of steps entered meanwhile.  Steps must be left
+ * in the reverse order of entering them.
+ */
+void flash_stats_enter(struct flash_stats_mark *mark, enum flash_phase phase);
+/** @returns the seconds charged to the step, nested steps excluded. */
+double flash_stats_leave(struct flash_stats_mark *mark);
+/** Shares @a seconds of erasing among sectors @a first to @a last. */
+void flash_stats_erase(struct flash_bank *bank, int first, int last, double seconds);
+/** Shares @a seconds of programming among the sectors in the range, by bytes. */
+void flash_stats_program(struct flash_bank *bank,
+		uint32_t offset, uint32_t count, double seconds);
+
+/** CRC32 of a stretch of image data, for verifying it in flash. */
+struct flash_plan_check {
+	uint32_t address;
+	uint32_t size;
+	uint32_t crc;
+};
+
+/**
+ * An image read into sector aligned runs, ready to be programmed any
+ * number of times by flash_write_plan().
+ */
+struct flash_plan {
+	struct target *target;
+	int erase;		/**< runs were padded for erasing ... */
+	bool unlock;		/**< ... or unlocking */
+	int num_jobs;
+	struct flash_write_job *jobs;	/**< owning their buffers */
+	int *num_sectors;	/**< sectors of each job's bank when planned */
+	uint32_t *crc;		/**< CRC32 of each job's buffer */
+	int num_checks;
+	struct flash_plan_check *checks;	/**< image sections in flash */
+};
+
+/**
+ * Writes an image to flash memory of the given target, optionally
+ * verifying it.  If @a plan points to a plan, that is programmed and
+ * @a image is not used; if it points to NULL, the plan made from
+ * @a image is handed back there on success for the caller to free.
+ */
+int flash_write_plan(struct target *target, struct image *image,
+		struct flash_plan **plan, uint32_t *written, int erase, bool unlock,
+		bool incremental, bool verify);
+/** @returns whether @a plan still matches the flash banks it was made for. */
+bool flash_plan_valid(struct flash_plan *plan);
+void flash_plan_free(struct flash_plan *plan);
+
 /* write (optional verify) an image to flash memory of the given target */
 int flash_write_unlock(struct target *target, struct image *image,
-		uint32_t *written, int erase, bool unlock);
+		uint32_t *written, int erase, bool unlock, bool incremental, bool verify);
+
+/** Outcome of a gang write on one of its targets. */
+struct flash_gang_result {
+	struct target *target;
+	int retval;
+	uint32_t written;
+	double seconds;		/**< spent on this target alone */
+};
+
+/**
+ * Writes @a image to the same flash addresses of several targets, set in
+ * @a results, which must have identically laid out banks there.  The
+ * image is read once.  All targets are unlocked and start erasing before
+ * any of them is programmed, then they are programmed and optionally
+ * verified one after the other.
+ *
+ * @returns ERROR_OK if all targets were written, ERROR_FAIL otherwise;
+ * results[i].retval tells about each target.
+ */
+int flash_write_gang(struct image *image, struct flash_gang_result *results,
+		int num_targets, int erase, bool unlock, bool verify);
+
+/**
+ * Like flash_write_unlock() on the image file @a url, but reusing the
+ * plan of an earlier write of the same, unmodified file with the same
+ * options when the plan cache is enabled.
+ *
+ * @param reused Set to whether a cached plan was used.
+ */
+int flash_write_image_file(struct target *target, const char *url,
+		const char *type, bool base_address_set, long long base_address,
+		uint32_t *written, int erase, bool unlock, bool incremental, bool verify,
+		bool *reused);
+void flash_plan_cache_set_enabled(bool enable);
+bool flash_plan_cache_enabled(void);
+/** Drops all cached plans. */
+void flash_plan_cache_flush(void);
 
 #endif /* FLASH_NOR_IMP_H */
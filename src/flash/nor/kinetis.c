@@ -29,6 +29,7 @@
 #endif
 
 #include "imp.h"
+#include "batch.h"
 #include "helper/binarybuffer.h"
 
 /*
@@ -262,6 +263,46 @@ static int kinetis_ftfx_command(struct flash_bank *bank, uint32_t w0,
 	return ERROR_OK;
 }
 
+static int kinetis_queue_longword(struct flash_batch *batch,
+				  uint32_t address, uint32_t word)
+{
+	int result;
+
+	/* program longword command, then launch it by writing CCIF */
+	result = flash_batch_write_u32(batch, 0x40020004, (0x06 << 24) | address);
+	if (result == ERROR_OK)
+		result = flash_batch_write_u32(batch, 0x40020008, word);
+	if (result == ERROR_OK)
+		result = flash_batch_write_u8(batch, 0x40020000, 0x80);
+
+	return result;
+}
+
+static int kinetis_write_longword(struct flash_bank *bank,
+				  uint32_t address, uint32_t word)
+{
+	uint8_t ftfx_fstat;
+
+	return kinetis_ftfx_command(bank, (0x06 << 24) | address, word, 0,
+				    &ftfx_fstat);
+}
+
+static int kinetis_clear_errors(struct flash_bank *bank)
+{
+	/* write one to clear ACCERR and FPVIOL */
+	return target_write_u8(bank->target, 0x40020000, 0x30);
+}
+
+static const struct flash_batch_ops kinetis_longword_ops = {
+	.status_reg = 0x40020000,	/* FSTAT in the low byte */
+	.busy_mask = 0x80,		/* CCIF */
+	.busy_value = 0,
+	.error_mask = 0x70,		/* RDCOLERR, ACCERR, FPVIOL */
+	.queue_word = kinetis_queue_longword,
+	.write_word = kinetis_write_longword,
+	.recover = kinetis_clear_errors,
+};
+
 static int kinetis_erase(struct flash_bank *bank, int first, int last)
 {
 	int result, i;
@@ -429,7 +470,17 @@ static int kinetis_write(struct flash_bank *bank, uint8_t *buffer,
 	}
 	/* program longword command, not supported in "SF3" devices */
 	else if (kinfo->granularity != 3) {
-		for (i = 0; i < count; i += 4) {
+		/* queue many longwords at once where the debug port allows */
+		int retval = flash_batch_write_words(bank, &kinetis_longword_ops,
+						     bank->base + offset, buffer, count / 4);
+		if (retval == ERROR_OK)
+			i = count & ~3;
+		else if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			i = 0;
+		else
+			return ERROR_FLASH_OPERATION_FAILED;
+
+		for (; i < count; i += 4) {
 			uint8_t ftfx_fstat;
 
 			LOG_DEBUG("write longword @ %08X", offset + i);
@@ -24,6 +24,7 @@
 
 #include "imp.h"
 #include "spi.h"
+#include "async.h"
 #include <jtag/jtag.h>
 #include <helper/time_support.h>
 #include <target/algorithm.h>
@@ -42,7 +43,6 @@
 /* Timeout in ms */
 #define SSP_CMD_TIMEOUT   (100)
 #define SSP_PROBE_TIMEOUT (100)
-#define SSP_MAX_TIMEOUT  (3000)
 
 struct lpcspifi_flash_bank {
 	int probed;
@@ -51,7 +51,7 @@ struct lpcspifi_flash_bank {
 	uint32_t ioconfig_base;
 	uint32_t bank_num;
 	uint32_t max_spi_clock_mhz;
-	struct flash_device *dev;
+	struct spi_nor nor;
 };
 
 struct lpcspifi_target {
@@ -115,6 +115,15 @@ static int ssp_setcs(struct target *target, uint32_t io_base, unsigned int value
 	return io_write_reg(target, io_base, 0x12ac, value ? 0xffffffff : 0x00000000);
 }
 
+/* Deassert CS at the end of a command, also when it failed, so the
+ * flash doesn't take the next command as part of this one. */
+static int ssp_end_command(struct target *target, uint32_t io_base, int retval)
+{
+	int cs_retval = ssp_setcs(target, io_base, 1);
+
+	return retval != ERROR_OK ? retval : cs_retval;
+}
+
 /* Poll the SSP busy flag. When this comes back as 0, the transfer is complete
  * and the controller is idle. */
 static int poll_ssp_busy(struct target *target, uint32_t ssp_base, int timeout)
@@ -293,6 +302,45 @@ static int lpcspifi_set_sw_mode(struct flash_bank *bank)
 	return retval;
 }
 
+/* Shift one byte out and one in */
+static int ssp_exchange(struct target *target, uint32_t ssp_base,
+	uint8_t out, uint8_t *in)
+{
+	uint32_t value;
+	int retval;
+
+	retval = ssp_write_reg(target, ssp_base, SSP_DATA, out);
+	if (retval == ERROR_OK)
+		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
+	if (retval == ERROR_OK)
+		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
+	if (retval == ERROR_OK && in)
+		*in = value;
+
+	return retval;
+}
+
+/* Send a command and clock in its response; SW mode only */
+static int lpcspifi_transfer(struct flash_bank *bank, const uint8_t *tx,
+	unsigned tx_len, uint8_t *rx, unsigned rx_len)
+{
+	struct target *target = bank->target;
+	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+	uint32_t ssp_base = lpcspifi_info->ssp_base;
+	uint32_t io_base = lpcspifi_info->io_base;
+	int retval;
+
+	retval = ssp_setcs(target, io_base, 0);
+	for (unsigned i = 0; i < tx_len && retval == ERROR_OK; i++)
+		retval = ssp_exchange(target, ssp_base, tx[i], NULL);
+	/* Dummy writes to clock in data */
+	for (unsigned i = 0; i < rx_len && retval == ERROR_OK; i++)
+		retval = ssp_exchange(target, ssp_base, 0x00, &rx[i]);
+	retval = ssp_end_command(target, io_base, retval);
+
+	return retval;
+}
+
 /* Read the status register of the external SPI flash chip. */
 static int read_status_reg(struct flash_bank *bank, uint32_t *status)
 {
@@ -315,8 +363,7 @@ static int read_status_reg(struct flash_bank *bank, uint32_t *status)
 		retval = ssp_write_reg(target, ssp_base, SSP_DATA, 0x00);
 	if (retval == ERROR_OK)
 		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
-	if (retval == ERROR_OK)
-		retval = ssp_setcs(target, io_base, 1);
+	retval = ssp_end_command(target, io_base, retval);
 
 	if (retval == ERROR_OK)
 		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
@@ -367,8 +414,7 @@ static int lpcspifi_write_enable(struct flash_bank *bank)
 		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
 	if (retval == ERROR_OK)
 		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-	if (retval == ERROR_OK)
-		retval = ssp_setcs(target, io_base, 1);
+	retval = ssp_end_command(target, io_base, retval);
 
 	/* read flash status register */
 	if (retval == ERROR_OK)
@@ -399,73 +445,34 @@ static int lpcspifi_bulk_erase(struct flash_bank *bank)
 	if (retval == ERROR_OK)
 		retval = lpcspifi_write_enable(bank);
 
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* send SPI command "bulk erase" */
+	retval = ssp_setcs(target, io_base, 0);
 	if (retval == ERROR_OK)
-		ssp_setcs(target, io_base, 0);
-	if (retval == ERROR_OK)
-		retval = ssp_write_reg(target, ssp_base, SSP_DATA, lpcspifi_info->dev->chip_erase_cmd);
+		retval = ssp_write_reg(target, ssp_base, SSP_DATA, lpcspifi_info->nor.chip_erase_cmd);
 	if (retval == ERROR_OK)
 		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
 	if (retval == ERROR_OK)
 		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-	if (retval == ERROR_OK)
-		retval = ssp_setcs(target, io_base, 1);
+	retval = ssp_end_command(target, io_base, retval);
 
 	/* poll flash BSY for self-timed bulk erase */
 	if (retval == ERROR_OK)
-		retval = wait_till_ready(bank, bank->num_sectors*SSP_MAX_TIMEOUT);
+		retval = wait_till_ready(bank, lpcspifi_info->nor.chip_erase_ms);
 
 	return retval;
 }
 
-static int lpcspifi_erase(struct flash_bank *bank, int first, int last)
+static int lpcspifi_erase_blocks(struct flash_bank *bank,
+	const struct spi_nor_erase_step *steps, unsigned num_steps)
 {
 	struct target *target = bank->target;
-	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
 	struct reg_param reg_params[4];
 	struct armv7m_algorithm armv7m_info;
 	struct working_area *erase_algorithm;
 	int retval = ERROR_OK;
-	int sector;
-
-	LOG_DEBUG("erase from sector %d to sector %d", first, last);
-
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("Target not halted");
-		return ERROR_TARGET_NOT_HALTED;
-	}
-
-	if ((first < 0) || (last < first) || (last >= bank->num_sectors)) {
-		LOG_ERROR("Flash sector invalid");
-		return ERROR_FLASH_SECTOR_INVALID;
-	}
-
-	if (!(lpcspifi_info->probed)) {
-		LOG_ERROR("Flash bank not probed");
-		return ERROR_FLASH_BANK_NOT_PROBED;
-	}
-
-	for (sector = first; sector <= last; sector++) {
-		if (bank->sectors[sector].is_protected) {
-			LOG_ERROR("Flash sector %d protected", sector);
-			return ERROR_FAIL;
-		}
-	}
-
-	/* If we're erasing the entire chip and the flash supports
-	 * it, use a bulk erase instead of going sector-by-sector. */
-	if (first == 0 && last == (bank->num_sectors - 1)
-		&& lpcspifi_info->dev->chip_erase_cmd != lpcspifi_info->dev->erase_cmd) {
-		LOG_DEBUG("Chip supports the bulk erase command."\
-		" Will use bulk erase instead of sector-by-sector erase.");
-		retval = lpcspifi_bulk_erase(bank);
-
-		if (retval == ERROR_OK) {
-			retval = lpcspifi_set_hw_mode(bank);
-			return retval;
-		} else
-			LOG_WARNING("Bulk flash erase failed. Falling back to sector-by-sector erase.");
-	}
 
 	retval = lpcspifi_set_hw_mode(bank);
 	if (retval != ERROR_OK)
@@ -545,19 +552,22 @@ static int lpcspifi_erase(struct flash_bank *bank, int first, int last)
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* Erase command */
 	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* Sector size */
 
-	buf_set_u32(reg_params[0].value, 0, 32, bank->sectors[first].offset);
-	buf_set_u32(reg_params[1].value, 0, 32, last - first + 1);
-	buf_set_u32(reg_params[2].value, 0, 32, lpcspifi_info->dev->erase_cmd);
-	buf_set_u32(reg_params[3].value, 0, 32, bank->sectors[first].size);
+	/* one run of the algorithm per run of equal blocks */
+	for (unsigned i = 0; i < num_steps && retval == ERROR_OK; i++) {
+		buf_set_u32(reg_params[0].value, 0, 32, steps[i].offset);
+		buf_set_u32(reg_params[1].value, 0, 32, steps[i].count);
+		buf_set_u32(reg_params[2].value, 0, 32, steps[i].cmd);
+		buf_set_u32(reg_params[3].value, 0, 32, steps[i].size);
 
-	/* Run the algorithm */
-	retval = target_run_algorithm(target, 0 , NULL, 4, reg_params,
-		erase_algorithm->address,
-		erase_algorithm->address + sizeof(lpcspifi_flash_erase_code) - 4,
-		3000*(last - first + 1), &armv7m_info);
+		/* Run the algorithm */
+		retval = target_run_algorithm(target, 0 , NULL, 4, reg_params,
+			erase_algorithm->address,
+			erase_algorithm->address + sizeof(lpcspifi_flash_erase_code) - 4,
+			steps[i].timeout_ms, &armv7m_info);
 
-	if (retval != ERROR_OK)
-		LOG_ERROR("Error executing flash erase algorithm");
+		if (retval != ERROR_OK)
+			LOG_ERROR("Error executing flash erase algorithm");
+	}
 
 	target_free_working_area(target, erase_algorithm);
 
@@ -566,11 +576,21 @@ static int lpcspifi_erase(struct flash_bank *bank, int first, int last)
 	destroy_reg_param(&reg_params[2]);
 	destroy_reg_param(&reg_params[3]);
 
-	retval = lpcspifi_set_hw_mode(bank);
-
 	return retval;
 }
 
+static int lpcspifi_erase(struct flash_bank *bank, int first, int last)
+{
+	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+
+	if (!(lpcspifi_info->probed)) {
+		LOG_ERROR("Flash bank not probed");
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	return spi_nor_erase(bank, &lpcspifi_info->nor, first, last);
+}
+
 static int lpcspifi_protect(struct flash_bank *bank, int set,
 	int first, int last)
 {
@@ -581,47 +601,13 @@ static int lpcspifi_protect(struct flash_bank *bank, int set,
 	return ERROR_OK;
 }
 
-static int lpcspifi_write(struct flash_bank *bank, uint8_t *buffer,
+static int lpcspifi_program(struct flash_bank *bank, uint8_t *buffer,
 	uint32_t offset, uint32_t count)
 {
-	struct target *target = bank->target;
 	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
-	uint32_t page_size, fifo_size;
-	struct working_area *fifo;
 	struct reg_param reg_params[5];
-	struct armv7m_algorithm armv7m_info;
-	struct working_area *write_algorithm;
-	int sector;
 	int retval = ERROR_OK;
 
-	LOG_DEBUG("offset=0x%08" PRIx32 " count=0x%08" PRIx32,
-		offset, count);
-
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("Target not halted");
-		return ERROR_TARGET_NOT_HALTED;
-	}
-
-	if (offset + count > lpcspifi_info->dev->size_in_bytes) {
-		LOG_WARNING("Writes past end of flash. Extra data discarded.");
-		count = lpcspifi_info->dev->size_in_bytes - offset;
-	}
-
-	/* Check sector protection */
-	for (sector = 0; sector < bank->num_sectors; sector++) {
-		/* Start offset in or before this sector? */
-		/* End offset in or behind this sector? */
-		if ((offset <
-				(bank->sectors[sector].offset + bank->sectors[sector].size))
-			&& ((offset + count - 1) >= bank->sectors[sector].offset)
-			&& bank->sectors[sector].is_protected) {
-			LOG_ERROR("Flash sector %d protected", sector);
-			return ERROR_FAIL;
-		}
-	}
-
-	page_size = lpcspifi_info->dev->pagesize;
-
 	retval = lpcspifi_set_hw_mode(bank);
 	if (retval != ERROR_OK)
 		return retval;
@@ -681,78 +667,34 @@ static int lpcspifi_write(struct flash_bank *bank, uint8_t *buffer,
 		0x50, 0x60, 0x30, 0x46, 0x00, 0xbe, 0xff, 0xff
 	};
 
-	if (target_alloc_working_area(target, sizeof(lpcspifi_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_ERROR("Insufficient working area. You must configure"\
-			" a working area > %zdB in order to write to SPIFI flash.",
-			sizeof(lpcspifi_flash_write_code));
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	/* Beyond 8 KiB of FIFO, we start to get diminishing returns */
+	static const struct flash_async_loader lpcspifi_loader = {
+		.code = lpcspifi_flash_write_code,
+		.code_size = sizeof(lpcspifi_flash_write_code),
+		.block_size = 1,
+		.fifo_size = 0x2000,
+		.fifo_start_param = 0,
+		.fifo_end_param = 1,
 	};
 
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(lpcspifi_flash_write_code),
-			lpcspifi_flash_write_code);
-	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return retval;
-	}
-
-	/* FIFO allocation */
-	fifo_size = target_get_working_area_avail(target);
-
-	if (fifo_size == 0) {
-		/* if we already allocated the writing code but failed to get fifo
-		 * space, free the algorithm */
-		target_free_working_area(target, write_algorithm);
-
-		LOG_ERROR("Insufficient working area. Please allocate at least"\
-			" %zdB of working area to enable flash writes.",
-			sizeof(lpcspifi_flash_write_code) + 1
-		);
-
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	} else if (fifo_size < page_size)
-		LOG_WARNING("Working area size is limited; flash writes may be"\
-			" slow. Increase working area size to at least %zdB"\
-			" to reduce write times.",
-			sizeof(lpcspifi_flash_write_code) + page_size
-		);
-	else if (fifo_size > 0x2000) /* Beyond this point, we start to get diminishing returns */
-		fifo_size = 0x2000;
-
-	if (target_alloc_working_area(target, fifo_size, &fifo) != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	};
-
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
-
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);		/* buffer start, status (out) */
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);		/* buffer end */
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);		/* target address */
-	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);		/* count (halfword-16bit) */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);		/* count (bytes) */
 	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);		/* page size */
 
-	buf_set_u32(reg_params[0].value, 0, 32, fifo->address);
-	buf_set_u32(reg_params[1].value, 0, 32, fifo->address + fifo->size);
 	buf_set_u32(reg_params[2].value, 0, 32, offset);
 	buf_set_u32(reg_params[3].value, 0, 32, count);
-	buf_set_u32(reg_params[4].value, 0, 32, page_size);
-
-	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
-			0, NULL,
-			5, reg_params,
-			fifo->address, fifo->size,
-			write_algorithm->address, 0,
-			&armv7m_info
-	);
+	buf_set_u32(reg_params[4].value, 0, 32, lpcspifi_info->nor.pagesize);
 
-	if (retval != ERROR_OK)
-		LOG_ERROR("Error executing flash write algorithm");
+	retval = flash_async_write(bank, &lpcspifi_loader, buffer, count, 5, reg_params);
 
-	target_free_working_area(target, fifo);
-	target_free_working_area(target, write_algorithm);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		LOG_ERROR("Insufficient working area. You must configure"\
+			" a working area > %zdB in order to write to SPIFI flash.",
+			sizeof(lpcspifi_flash_write_code) + lpcspifi_info->nor.pagesize);
+	else if (retval != ERROR_OK)
+		LOG_ERROR("Error executing flash write algorithm");
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
@@ -760,20 +702,50 @@ static int lpcspifi_write(struct flash_bank *bank, uint8_t *buffer,
 	destroy_reg_param(&reg_params[3]);
 	destroy_reg_param(&reg_params[4]);
 
-	/* Switch to HW mode before return to prompt */
-	retval = lpcspifi_set_hw_mode(bank);
 	return retval;
 }
 
+static int lpcspifi_write(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t offset, uint32_t count)
+{
+	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+
+	if (!(lpcspifi_info->probed)) {
+		LOG_ERROR("Flash bank not probed");
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	return spi_nor_write(bank, &lpcspifi_info->nor, buffer, offset, count);
+}
+
+static int lpcspifi_read(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t offset, uint32_t count)
+{
+	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+
+	if (!(lpcspifi_info->probed)) {
+		LOG_ERROR("Flash bank not probed");
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	return spi_nor_read(bank, &lpcspifi_info->nor, buffer, offset, count);
+}
+
+static const struct spi_nor_ops lpcspifi_nor_ops = {
+	.transfer = lpcspifi_transfer,
+	.erase = lpcspifi_erase_blocks,
+	.erase_chip = lpcspifi_bulk_erase,
+	.program = lpcspifi_program,
+	.memory_mode = lpcspifi_set_hw_mode,
+};
+
 /* Return ID of flash device */
 /* On exit, SW mode is kept */
 static int lpcspifi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 {
 	struct target *target = bank->target;
-	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
-	uint32_t ssp_base = lpcspifi_info->ssp_base;
-	uint32_t io_base = lpcspifi_info->io_base;
-	uint32_t value;
+	uint8_t cmd = SPIFLASH_READ_ID;
+	uint8_t value[3];
 	int retval;
 
 	if (target->state != TARGET_HALTED) {
@@ -792,46 +764,9 @@ static int lpcspifi_read_flash_id(struct flash_bank *bank, uint32_t *id)
 
 	/* Send SPI command "read ID" */
 	if (retval == ERROR_OK)
-		retval = ssp_setcs(target, io_base, 0);
-	if (retval == ERROR_OK)
-		retval = ssp_write_reg(target, ssp_base, SSP_DATA, SPIFLASH_READ_ID);
-	if (retval == ERROR_OK)
-		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
+		retval = lpcspifi_transfer(bank, &cmd, 1, value, sizeof(value));
 	if (retval == ERROR_OK)
-		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-
-	/* Dummy write to clock in data */
-	if (retval == ERROR_OK)
-		retval = ssp_write_reg(target, ssp_base, SSP_DATA, 0x00);
-	if (retval == ERROR_OK)
-		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
-	if (retval == ERROR_OK)
-		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-	if (retval == ERROR_OK)
-		((uint8_t *)id)[0] = value;
-
-	/* Dummy write to clock in data */
-	if (retval == ERROR_OK)
-		retval = ssp_write_reg(target, ssp_base, SSP_DATA, 0x00);
-	if (retval == ERROR_OK)
-		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
-	if (retval == ERROR_OK)
-		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-	if (retval == ERROR_OK)
-		((uint8_t *)id)[1] = value;
-
-	/* Dummy write to clock in data */
-	if (retval == ERROR_OK)
-		retval = ssp_write_reg(target, ssp_base, SSP_DATA, 0x00);
-	if (retval == ERROR_OK)
-		retval = poll_ssp_busy(target, ssp_base, SSP_CMD_TIMEOUT);
-	if (retval == ERROR_OK)
-		retval = ssp_read_reg(target, ssp_base, SSP_DATA, &value);
-	if (retval == ERROR_OK)
-		((uint8_t *)id)[2] = value;
-
-	if (retval == ERROR_OK)
-		retval = ssp_setcs(target, io_base, 1);
+		*id = value[0] | value[1] << 8 | value[2] << 16;
 
 	return retval;
 }
@@ -843,7 +778,6 @@ static int lpcspifi_probe(struct flash_bank *bank)
 	uint32_t ssp_base;
 	uint32_t io_base;
 	uint32_t ioconfig_base;
-	struct flash_sector *sectors;
 	uint32_t id = 0; /* silence uninitialized warning */
 	struct lpcspifi_target *target_device;
 	int retval;
@@ -878,45 +812,17 @@ static int lpcspifi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = lpcspifi_set_hw_mode(bank);
-	if (retval != ERROR_OK)
+	/* identify the device and lay out the sectors while still in SW mode */
+	lpcspifi_info->nor.ops = &lpcspifi_nor_ops;
+	retval = spi_nor_probe(bank, &lpcspifi_info->nor, id);
+	if (retval != ERROR_OK) {
+		lpcspifi_set_hw_mode(bank);
 		return retval;
-
-	lpcspifi_info->dev = NULL;
-	for (struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			lpcspifi_info->dev = p;
-			break;
-		}
-
-	if (!lpcspifi_info->dev) {
-		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
-		return ERROR_FAIL;
-	}
-
-	LOG_INFO("Found flash device \'%s\' (ID 0x%08" PRIx32 ")",
-		lpcspifi_info->dev->name, lpcspifi_info->dev->device_id);
-
-	/* Set correct size value */
-	bank->size = lpcspifi_info->dev->size_in_bytes;
-
-	/* create and fill sectors array */
-	bank->num_sectors =
-		lpcspifi_info->dev->size_in_bytes / lpcspifi_info->dev->sectorsize;
-	sectors = malloc(sizeof(struct flash_sector) * bank->num_sectors);
-	if (sectors == NULL) {
-		LOG_ERROR("not enough memory");
-		return ERROR_FAIL;
-	}
-
-	for (int sector = 0; sector < bank->num_sectors; sector++) {
-		sectors[sector].offset = sector * lpcspifi_info->dev->sectorsize;
-		sectors[sector].size = lpcspifi_info->dev->sectorsize;
-		sectors[sector].is_erased = -1;
-		sectors[sector].is_protected = 1;
 	}
 
-	bank->sectors = sectors;
+	retval = lpcspifi_set_hw_mode(bank);
+	if (retval != ERROR_OK)
+		return retval;
 
 	lpcspifi_info->probed = 1;
 	return ERROR_OK;
@@ -939,6 +845,7 @@ static int lpcspifi_protect_check(struct flash_bank *bank)
 static int get_lpcspifi_info(struct flash_bank *bank, char *buf, int buf_size)
 {
 	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
+	int printed;
 
 	if (!(lpcspifi_info->probed)) {
 		snprintf(buf, buf_size,
@@ -946,11 +853,11 @@ static int get_lpcspifi_info(struct flash_bank *bank, char *buf, int buf_size)
 		return ERROR_OK;
 	}
 
-	snprintf(buf, buf_size, "\nSPIFI flash information:\n"
-		"  Device \'%s\' (ID 0x%08x)\n",
-		lpcspifi_info->dev->name, lpcspifi_info->dev->device_id);
+	printed = snprintf(buf, buf_size, "\nSPIFI flash information:\n");
+	if (printed < 0 || printed >= buf_size)
+		return ERROR_OK;
 
-	return ERROR_OK;
+	return spi_nor_info(&lpcspifi_info->nor, buf + printed, buf_size - printed);
 }
 
 struct flash_driver lpcspifi_flash = {
@@ -959,7 +866,7 @@ struct flash_driver lpcspifi_flash = {
 	.erase = lpcspifi_erase,
 	.protect = lpcspifi_protect,
 	.write = lpcspifi_write,
-	.read = default_flash_read,
+	.read = lpcspifi_read,
 	.probe = lpcspifi_probe,
 	.auto_probe = lpcspifi_auto_probe,
 	.erase_check = default_flash_blank_check,
@@ -0,0 +1,195 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <target/image.h>
+#include <sys/stat.h>
+
+/**
+ * @file
+ * Cache of flash write plans.
+ *
+ * Writing the same image file over and over, as on a production line,
+ * parses and pads it every time.  With the cache enabled, the plan made
+ * by flash_write_plan() is kept, keyed by the file's path, modification
+ * time and size together with the options that shape the plan, and the
+ * next write of the unchanged file programs it directly.
+ */
+
+/* plans of this many files are kept, the least recently used goes first */
+#define FLASH_PLAN_CACHE_ENTRIES	4
+
+struct flash_plan_entry {
+	char *url;
+	char *type;		/**< NULL to guess from the file */
+	bool base_address_set;
+	long long base_address;
+	time_t mtime;
+	off_t size;
+	ino_t ino;
+	struct flash_plan *plan;
+	unsigned last_use;
+};
+
+static bool plan_cache_enabled;
+static struct flash_plan_entry plan_cache[FLASH_PLAN_CACHE_ENTRIES];
+static unsigned plan_cache_uses;
+
+static void flash_plan_entry_free(struct flash_plan_entry *entry)
+{
+	free(entry->url);
+	free(entry->type);
+	flash_plan_free(entry->plan);
+	memset(entry, 0, sizeof(*entry));
+}
+
+void flash_plan_cache_flush(void)
+{
+	for (int i = 0; i < FLASH_PLAN_CACHE_ENTRIES; i++)
+		flash_plan_entry_free(&plan_cache[i]);
+}
+
+void flash_plan_cache_set_enabled(bool enable)
+{
+	if (!enable)
+		flash_plan_cache_flush();
+	plan_cache_enabled = enable;
+}
+
+bool flash_plan_cache_enabled(void)
+{
+	return plan_cache_enabled;
+}
+
+static bool flash_plan_entry_matches(struct flash_plan_entry *entry,
+		const struct flash_plan_entry *key)
+{
+	struct flash_plan *plan = entry->plan;
+
+	if (plan == NULL || strcmp(entry->url, key->url) != 0)
+		return false;
+	if ((entry->type == NULL) != (key->type == NULL)
+			|| (entry->type && strcmp(entry->type, key->type) != 0))
+		return false;
+	if (entry->base_address_set != key->base_address_set
+			|| (key->base_address_set && entry->base_address != key->base_address))
+		return false;
+
+	return entry->mtime == key->mtime && entry->size == key->size
+		&& entry->ino == key->ino;
+}
+
+int flash_write_image_file(struct target *target, const char *url,
+		const char *type, bool base_address_set, long long base_address,
+		uint32_t *written, int erase, bool unlock, bool incremental, bool verify,
+		bool *reused)
+{
+	struct flash_plan_entry key, *entry = NULL;
+	struct flash_plan *plan = NULL;
+	struct image image;
+	struct stat st;
+	int retval;
+
+	*reused = false;
+
+	memset(&key, 0, sizeof(key));
+	key.url = (char *)url;
+	key.type = (char *)type;
+	key.base_address_set = base_address_set;
+	key.base_address = base_address;
+
+	/* only regular files can be told apart by their time stamps */
+	if (plan_cache_enabled && stat(url, &st) == 0 && S_ISREG(st.st_mode)) {
+		key.mtime = st.st_mtime;
+		key.size = st.st_size;
+		key.ino = st.st_ino;
+
+		for (int i = 0; i < FLASH_PLAN_CACHE_ENTRIES; i++) {
+			struct flash_plan_entry *e = &plan_cache[i];
+
+			if (!flash_plan_entry_matches(e, &key))
+				continue;
+			if (e->plan->target != target || e->plan->erase != erase
+					|| e->plan->unlock != unlock)
+				continue;
+			if (!flash_plan_valid(e->plan)) {
+				LOG_DEBUG("dropping stale write plan of %s", url);
+				flash_plan_entry_free(e);
+				continue;
+			}
+			entry = e;
+			break;
+		}
+
+		if (entry == NULL) {
+			/* a slot for the new plan */
+			entry = &plan_cache[0];
+			for (int i = 1; i < FLASH_PLAN_CACHE_ENTRIES && entry->plan; i++) {
+				if (plan_cache[i].plan == NULL
+						|| plan_cache[i].last_use < entry->last_use)
+					entry = &plan_cache[i];
+			}
+			flash_plan_entry_free(entry);
+		} else {
+			LOG_INFO("reusing write plan of %s", url);
+			*reused = true;
+		}
+		entry->last_use = ++plan_cache_uses;
+	}
+
+	if (entry && entry->plan) {
+		plan = entry->plan;
+		return flash_write_plan(target, NULL, &plan, written, erase, unlock,
+				incremental, verify);
+	}
+
+	image.base_address_set = base_address_set;
+	image.base_address = base_address;
+	image.start_address_set = 0;
+
+	retval = image_open(&image, url, type);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = flash_write_plan(target, &image, entry ? &plan : NULL, written,
+			erase, unlock, incremental, verify);
+
+	image_close(&image);
+
+	if (plan) {
+		entry->url = strdup(url);
+		entry->type = type ? strdup(type) : NULL;
+		if (entry->url == NULL || (type && entry->type == NULL)) {
+			flash_plan_free(plan);
+			plan = NULL;
+		}
+		entry->plan = plan;
+		entry->base_address_set = base_address_set;
+		entry->base_address = base_address;
+		entry->mtime = key.mtime;
+		entry->size = key.size;
+		entry->ino = key.ino;
+		if (plan == NULL)
+			flash_plan_entry_free(entry);
+	}
+
+	return retval;
+}
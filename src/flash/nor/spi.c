@@ -69,3 +69,531 @@ struct flash_device flash_devices[] = {
 	FLASH_ID("win w25q64cv",   0xd8, 0xC7, 0x001740ef, 0x100, 0x10000, 0x800000),
 	FLASH_ID(NULL,             0,    0,	   0,          0,     0,       0)
 };
+
+/* erase timeout per block when the device doesn't tell */
+#define SPI_NOR_ERASE_TIMEOUT		3000
+/* and for the whole chip, per sector */
+#define SPI_NOR_CHIP_ERASE_TIMEOUT	3000
+
+/* BFPT, the Basic Flash Parameter Table, is the one every SFDP device has */
+#define SFDP_SIGNATURE			0x50444653 /* "SFDP" */
+#define SFDP_BFPT_ID			0xff00
+#define SFDP_MAX_SIZE			1024
+
+static uint32_t sfdp_get_u32(const uint8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* typical time in ms of a BFPT erase time field, count in bits 4:0 */
+static unsigned sfdp_erase_time(uint32_t field, const unsigned *units)
+{
+	return ((field & 0x1f) + 1) * units[(field >> 5) & 3];
+}
+
+int spi_nor_parse_sfdp(struct spi_nor *nor, const uint8_t *sfdp, uint32_t len)
+{
+	static const unsigned block_units[] = { 1, 16, 128, 1000 };
+	static const unsigned chip_units[] = { 16, 256, 4000, 64000 };
+	uint32_t bfpt = 0, dwords = 0, dw[16];
+	uint32_t num_headers;
+	uint64_t bits;
+	unsigned n = 0;
+
+	if (len < 16 || sfdp_get_u32(sfdp) != SFDP_SIGNATURE)
+		return ERROR_FAIL;
+
+	num_headers = sfdp[6] + 1;
+	for (uint32_t i = 0; i < num_headers && 16 + 8 * i <= len; i++) {
+		const uint8_t *header = sfdp + 8 + 8 * i;
+		if ((header[0] | header[7] << 8) == SFDP_BFPT_ID) {
+			dwords = header[3];
+			bfpt = header[4] | header[5] << 8 | header[6] << 16;
+			break;
+		}
+	}
+
+	/* JESD216 defines nine words, later revisions more */
+	if (dwords < 9 || bfpt + 36 > len) {
+		LOG_DEBUG("no usable basic flash parameter table");
+		return ERROR_FAIL;
+	}
+	if (dwords > ARRAY_SIZE(dw))
+		dwords = ARRAY_SIZE(dw);
+	if (bfpt + 4 * dwords > len)
+		dwords = (len - bfpt) / 4;
+	memset(dw, 0, sizeof(dw));
+	for (uint32_t i = 0; i < dwords; i++)
+		dw[i] = sfdp_get_u32(sfdp + bfpt + 4 * i);
+
+	/* density, in bits */
+	if (dw[1] & 0x80000000) {
+		if ((dw[1] & 0x7fffffff) > 63)
+			return ERROR_FAIL;
+		bits = (uint64_t)1 << (dw[1] & 0x7fffffff);
+	} else
+		bits = (uint64_t)dw[1] + 1;
+	if (bits / 8 > 0x1000000) {
+		LOG_WARNING("only the first 16 MiB of the %" PRIu64 " MiB flash are "
+				"reachable with three byte addresses", bits / 8 >> 20);
+		bits = 8 * 0x1000000;
+	}
+	nor->size = bits / 8;
+
+	/* erase types, with their timing if the table is long enough */
+	for (int t = 0; t < SPI_NOR_MAX_ERASE_TYPES; t++) {
+		uint32_t field = dw[7 + t / 2] >> (16 * (t & 1));
+		struct spi_nor_erase_type *type = &nor->erase[n];
+
+		if ((field & 0xff) == 0 || (field & 0xff) > 31)
+			continue;
+		type->size = 1 << (field & 0xff);
+		type->cmd = field >> 8;
+		type->typ_ms = 0;
+		type->max_ms = SPI_NOR_ERASE_TIMEOUT;
+		if (dwords >= 10) {
+			unsigned multiplier = 2 * ((dw[9] & 0xf) + 1);
+			type->typ_ms = sfdp_erase_time(dw[9] >> (4 + 7 * t), block_units);
+			if (type->typ_ms * multiplier > type->max_ms)
+				type->max_ms = type->typ_ms * multiplier;
+		}
+		n++;
+	}
+	if (n == 0 && (dw[0] & 3) == 1) {
+		/* only the 4 KiB erase of the first word */
+		nor->erase[0].size = 4096;
+		nor->erase[0].cmd = dw[0] >> 8;
+		nor->erase[0].typ_ms = 0;
+		nor->erase[0].max_ms = SPI_NOR_ERASE_TIMEOUT;
+		n = 1;
+	}
+	if (n == 0)
+		return ERROR_FAIL;
+
+	/* insertion sort by size */
+	for (unsigned i = 1; i < n; i++) {
+		struct spi_nor_erase_type type = nor->erase[i];
+		unsigned j = i;
+		for (; j > 0 && nor->erase[j - 1].size > type.size; j--)
+			nor->erase[j] = nor->erase[j - 1];
+		nor->erase[j] = type;
+	}
+	nor->num_erase_types = n;
+
+	if (dwords >= 11) {
+		nor->pagesize = 1 << ((dw[10] >> 4) & 0xf);
+		nor->chip_erase_ms = sfdp_erase_time(dw[10] >> 24, chip_units)
+			* 2 * ((dw[9] & 0xf) + 1);
+	} else
+		nor->pagesize = 256;
+
+	/* prefer quad address and data over quad data only */
+	nor->quad_read_cmd = 0;
+	if (dw[0] & (1 << 21)) {
+		nor->quad_read_cmd = dw[2] >> 8;
+		nor->quad_read_dummy = (dw[2] & 0x1f) + ((dw[2] >> 5) & 7);
+	} else if (dw[0] & (1 << 22)) {
+		nor->quad_read_cmd = dw[2] >> 24;
+		nor->quad_read_dummy = ((dw[2] >> 16) & 0x1f) + ((dw[2] >> 21) & 7);
+	}
+
+	nor->sfdp = true;
+	return ERROR_OK;
+}
+
+static int spi_nor_read_sfdp(struct flash_bank *bank, struct spi_nor *nor,
+		uint32_t address, uint8_t *buffer, uint32_t count)
+{
+	uint8_t cmd[5] = {
+		SPIFLASH_READ_SFDP, address >> 16, address >> 8, address, 0
+	};
+
+	return nor->ops->transfer(bank, cmd, sizeof(cmd), buffer, count);
+}
+
+/* reads and parses the SFDP tables, if the device has some */
+static int spi_nor_probe_sfdp(struct flash_bank *bank, struct spi_nor *nor)
+{
+	uint8_t header[8 + 8 * 8];
+	uint8_t *sfdp;
+	uint32_t len = 0, num_headers;
+	int retval;
+
+	retval = spi_nor_read_sfdp(bank, nor, 0, header, sizeof(header));
+	if (retval != ERROR_OK)
+		return retval;
+	if (sfdp_get_u32(header) != SFDP_SIGNATURE)
+		return ERROR_FAIL;
+
+	num_headers = header[6] + 1;
+	if (num_headers > 8)
+		num_headers = 8;
+	for (uint32_t i = 0; i < num_headers; i++) {
+		const uint8_t *h = header + 8 + 8 * i;
+		uint32_t end = (h[4] | h[5] << 8 | h[6] << 16) + 4 * h[3];
+		if ((h[0] | h[7] << 8) == SFDP_BFPT_ID && end > len)
+			len = end;
+	}
+	if (len == 0 || len > SFDP_MAX_SIZE)
+		return ERROR_FAIL;
+
+	sfdp = malloc(len);
+	if (sfdp == NULL)
+		return ERROR_FAIL;
+
+	retval = spi_nor_read_sfdp(bank, nor, 0, sfdp, len);
+	if (retval == ERROR_OK)
+		retval = spi_nor_parse_sfdp(nor, sfdp, len);
+
+	free(sfdp);
+	return retval;
+}
+
+int spi_nor_probe(struct flash_bank *bank, struct spi_nor *nor, uint32_t id)
+{
+	const struct spi_nor_ops *ops = nor->ops;
+	struct flash_sector *sectors;
+	struct spi_nor_erase_type *unit;
+	uint32_t num_sectors;
+
+	memset(nor, 0, sizeof(*nor));
+	nor->ops = ops;
+	nor->device_id = id;
+
+	for (struct flash_device *p = flash_devices; p->name ; p++)
+		if (p->device_id == id) {
+			nor->dev = p;
+			break;
+		}
+
+	if (nor->dev) {
+		nor->size = nor->dev->size_in_bytes;
+		nor->pagesize = nor->dev->pagesize;
+		if (nor->dev->chip_erase_cmd != nor->dev->erase_cmd)
+			nor->chip_erase_cmd = nor->dev->chip_erase_cmd;
+		nor->erase[0].size = nor->dev->sectorsize;
+		nor->erase[0].cmd = nor->dev->erase_cmd;
+		nor->erase[0].max_ms = SPI_NOR_ERASE_TIMEOUT;
+		nor->num_erase_types = 1;
+	}
+
+	if (ops->transfer) {
+		struct spi_nor table = *nor;
+
+		if (spi_nor_probe_sfdp(bank, nor) == ERROR_OK) {
+			LOG_DEBUG("using SFDP parameters");
+			/* SFDP has no chip erase command: keep what the table
+			 * says, or the one all SFDP devices use */
+			nor->chip_erase_cmd = nor->dev ? table.chip_erase_cmd : 0xc7;
+		} else
+			*nor = table;
+	}
+
+	if (nor->num_erase_types == 0) {
+		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
+		return ERROR_FAIL;
+	}
+
+	if (nor->chip_erase_ms == 0)
+		nor->chip_erase_ms = SPI_NOR_CHIP_ERASE_TIMEOUT
+			* (nor->size / nor->erase[nor->num_erase_types - 1].size);
+
+	if (nor->dev)
+		LOG_INFO("Found flash device \'%s\' (ID 0x%08" PRIx32 ")",
+			nor->dev->name, id);
+	else
+		LOG_INFO("Found SFDP flash device (ID 0x%08" PRIx32 ", %" PRIu32 " KiB)",
+			id, nor->size >> 10);
+
+	/* sectors are the smallest erase blocks, larger ones get used when possible */
+	unit = &nor->erase[0];
+	num_sectors = nor->size / unit->size;
+	sectors = malloc(sizeof(struct flash_sector) * num_sectors);
+	if (sectors == NULL) {
+		LOG_ERROR("not enough memory");
+		return ERROR_FAIL;
+	}
+
+	for (uint32_t sector = 0; sector < num_sectors; sector++) {
+		sectors[sector].offset = sector * unit->size;
+		sectors[sector].size = unit->size;
+		sectors[sector].is_erased = -1;
+		sectors[sector].is_protected = 1;
+	}
+
+	free(bank->sectors);
+	bank->sectors = sectors;
+	bank->num_sectors = num_sectors;
+	bank->size = nor->size;
+
+	return ERROR_OK;
+}
+
+/* what an erase command costs, for planning */
+static unsigned spi_nor_erase_cost(const struct spi_nor_erase_type *type)
+{
+	if (type->typ_ms)
+		return type->typ_ms;
+
+	/* without data, assume a fixed overhead and a small part per KiB */
+	return 30 + (type->size >> 10);
+}
+
+int spi_nor_plan_erase(const struct spi_nor *nor, uint32_t offset, uint32_t count,
+		struct spi_nor_erase_step **steps, unsigned *num_steps)
+{
+	uint32_t unit = nor->erase[0].size;
+	uint32_t units, i;
+	uint64_t *cost;
+	uint8_t *choice;
+	struct spi_nor_erase_step *plan;
+	unsigned n = 0;
+
+	if (count == 0 || offset % unit || count % unit)
+		return ERROR_FLASH_DST_BREAKS_ALIGNMENT;
+
+	units = count / unit;
+	cost = malloc((units + 1) * sizeof(*cost));
+	choice = malloc(units);
+	plan = malloc(units * sizeof(*plan));
+	if (cost == NULL || choice == NULL || plan == NULL) {
+		free(cost);
+		free(choice);
+		free(plan);
+		return ERROR_FAIL;
+	}
+
+	/* cheapest cover of every tail of the range, the smallest block always fits */
+	cost[units] = 0;
+	for (i = units; i-- > 0; ) {
+		cost[i] = UINT64_MAX;
+		for (unsigned t = 0; t < nor->num_erase_types; t++) {
+			const struct spi_nor_erase_type *type = &nor->erase[t];
+			uint32_t blocks = type->size / unit;
+
+			if (blocks > units - i || (offset + i * unit) % type->size)
+				continue;
+			if (spi_nor_erase_cost(type) + cost[i + blocks] < cost[i]) {
+				cost[i] = spi_nor_erase_cost(type) + cost[i + blocks];
+				choice[i] = t;
+			}
+		}
+	}
+
+	for (i = 0; i < units; ) {
+		const struct spi_nor_erase_type *type = &nor->erase[choice[i]];
+
+		if (n > 0 && plan[n - 1].cmd == type->cmd && plan[n - 1].size == type->size)
+			plan[n - 1].count++;
+		else {
+			plan[n].offset = offset + i * unit;
+			plan[n].size = type->size;
+			plan[n].cmd = type->cmd;
+			plan[n].count = 1;
+			plan[n].timeout_ms = 0;
+			n++;
+		}
+		plan[n - 1].timeout_ms += type->max_ms;
+		i += type->size / unit;
+	}
+
+	LOG_DEBUG("erase 0x%8.8" PRIx32 "+0x%" PRIx32 " in %u steps, about %" PRIu64 " ms",
+			offset, count, n, cost[0]);
+
+	free(cost);
+	free(choice);
+	*steps = plan;
+	*num_steps = n;
+	return ERROR_OK;
+}
+
+static int spi_nor_memory_mode(struct flash_bank *bank, struct spi_nor *nor, int retval)
+{
+	int mode_retval = nor->ops->memory_mode(bank);
+
+	return retval != ERROR_OK ? retval : mode_retval;
+}
+
+int spi_nor_erase(struct flash_bank *bank, struct spi_nor *nor, int first, int last)
+{
+	struct spi_nor_erase_step *steps;
+	unsigned num_steps;
+	int retval;
+
+	LOG_DEBUG("erase from sector %d to sector %d", first, last);
+
+	if (bank->target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if ((first < 0) || (last < first) || (last >= bank->num_sectors)) {
+		LOG_ERROR("Flash sector invalid");
+		return ERROR_FLASH_SECTOR_INVALID;
+	}
+
+	for (int sector = first; sector <= last; sector++) {
+		if (bank->sectors[sector].is_protected) {
+			LOG_ERROR("Flash sector %d protected", sector);
+			return ERROR_FAIL;
+		}
+	}
+
+	/* If we're erasing the entire chip and the flash supports
+	 * it, use a bulk erase instead of going block-by-block. */
+	if (first == 0 && last == (bank->num_sectors - 1)
+			&& nor->chip_erase_cmd && nor->ops->erase_chip) {
+		retval = nor->ops->erase_chip(bank);
+		if (retval == ERROR_OK)
+			return spi_nor_memory_mode(bank, nor, retval);
+		LOG_WARNING("Bulk flash erase failed. Falling back to block erase.");
+	}
+
+	retval = spi_nor_plan_erase(nor, bank->sectors[first].offset,
+			bank->sectors[last].offset + bank->sectors[last].size
+			- bank->sectors[first].offset, &steps, &num_steps);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = nor->ops->erase(bank, steps, num_steps);
+	free(steps);
+
+	return spi_nor_memory_mode(bank, nor, retval);
+}
+
+static bool spi_nor_is_erased(const uint8_t *buffer, uint32_t count)
+{
+	while (count--)
+		if (*buffer++ != 0xff)
+			return false;
+	return true;
+}
+
+int spi_nor_write(struct flash_bank *bank, struct spi_nor *nor, uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	uint32_t page_size = nor->pagesize;
+	uint32_t cur_count;
+	int retval = ERROR_OK;
+
+	LOG_DEBUG("offset=0x%08" PRIx32 " count=0x%08" PRIx32, offset, count);
+
+	if (bank->target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (offset + count > nor->size) {
+		LOG_WARNING("Writes past end of flash. Extra data discarded.");
+		count = nor->size - offset;
+	}
+
+	/* Check sector protection */
+	for (int sector = 0; sector < bank->num_sectors; sector++) {
+		/* Start offset in or before this sector? */
+		/* End offset in or behind this sector? */
+		if ((offset <
+				(bank->sectors[sector].offset + bank->sectors[sector].size))
+			&& ((offset + count - 1) >= bank->sectors[sector].offset)
+			&& bank->sectors[sector].is_protected) {
+			LOG_ERROR("Flash sector %d protected", sector);
+			return ERROR_FAIL;
+		}
+	}
+
+	/* programming all ones changes nothing, leave out such pages */
+	while (count > 0) {
+		cur_count = page_size - offset % page_size;
+		if (cur_count > count)
+			cur_count = count;
+		if (!spi_nor_is_erased(buffer, cur_count))
+			break;
+		buffer += cur_count;
+		offset += cur_count;
+		count -= cur_count;
+	}
+
+	if (nor->ops->program) {
+		/* the whole run in one go, trailing erased pages trimmed as well */
+		while (count > 0) {
+			cur_count = (offset + count - 1) % page_size + 1;
+			if (cur_count > count)
+				cur_count = count;
+			if (!spi_nor_is_erased(buffer + count - cur_count, cur_count))
+				break;
+			count -= cur_count;
+		}
+		if (count > 0)
+			retval = nor->ops->program(bank, buffer, offset, count);
+	} else {
+		while (count > 0) {
+			cur_count = page_size - offset % page_size;
+			if (cur_count > count)
+				cur_count = count;
+
+			if (!spi_nor_is_erased(buffer, cur_count)) {
+				retval = nor->ops->program_page(bank, buffer, offset, cur_count);
+				if (retval != ERROR_OK)
+					break;
+			}
+
+			buffer += cur_count;
+			offset += cur_count;
+			count -= cur_count;
+
+			keep_alive();
+		}
+	}
+
+	return spi_nor_memory_mode(bank, nor, retval);
+}
+
+int spi_nor_read(struct flash_bank *bank, struct spi_nor *nor, uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	int retval;
+
+	/* a reset may have left the controller out of memory mapped mode */
+	retval = nor->ops->memory_mode(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return target_read_buffer(bank->target, bank->base + offset, count, buffer);
+}
+
+int spi_nor_info(struct spi_nor *nor, char *buf, int buf_size)
+{
+	int printed;
+
+	if (nor->dev)
+		printed = snprintf(buf, buf_size, "  Device \'%s\' (ID 0x%08" PRIx32 ")\n",
+				nor->dev->name, nor->device_id);
+	else
+		printed = snprintf(buf, buf_size, "  SFDP device (ID 0x%08" PRIx32 ")\n",
+				nor->device_id);
+	if (printed < 0 || printed >= buf_size)
+		return ERROR_OK;
+	buf += printed;
+	buf_size -= printed;
+
+	printed = snprintf(buf, buf_size, "  %" PRIu32 " KiB, %" PRIu32 " byte pages, erase blocks:",
+			nor->size >> 10, nor->pagesize);
+	for (unsigned t = 0; t < nor->num_erase_types && printed >= 0 && printed < buf_size; t++) {
+		buf += printed;
+		buf_size -= printed;
+		printed = snprintf(buf, buf_size, " 0x%" PRIx32 " (0x%02x)",
+				nor->erase[t].size, nor->erase[t].cmd);
+	}
+	if (printed < 0 || printed >= buf_size)
+		return ERROR_OK;
+	buf += printed;
+	buf_size -= printed;
+
+	if (nor->quad_read_cmd)
+		snprintf(buf, buf_size, "\n  quad read 0x%02x, %u dummy clocks\n",
+				nor->quad_read_cmd, nor->quad_read_dummy);
+	else
+		snprintf(buf, buf_size, "\n");
+
+	return ERROR_OK;
+}
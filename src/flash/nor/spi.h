@@ -21,6 +21,9 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 
+#ifndef FLASH_NOR_SPI_H
+#define FLASH_NOR_SPI_H
+
 /* data structure to maintain flash ids from different vendors */
 struct flash_device {
 	char *name;
@@ -56,3 +59,109 @@ extern struct flash_device flash_devices[];
 #define SPIFLASH_PAGE_PROGRAM	0x02 /* Page Program */
 #define SPIFLASH_FAST_READ		0x0B /* Fast Read */
 #define SPIFLASH_READ			0x03 /* Normal Read */
+#define SPIFLASH_READ_SFDP		0x5A /* Read Serial Flash Discoverable Parameters */
+
+/**
+ * @file
+ * Shared SPI NOR engine.
+ *
+ * A controller driver provides the bus primitives in struct spi_nor_ops
+ * and the engine does the rest: it identifies the device from the
+ * flash_devices table and, if the controller can send arbitrary
+ * commands, from its SFDP tables; lays out the bank in units of the
+ * smallest erase block; plans erases from the mix of block sizes that
+ * takes the least time; and programs whole runs of pages at once,
+ * skipping pages that would stay erased.  Every operation ends with the
+ * controller back in memory mapped mode, so verify and read go through
+ * the fastest read the controller was set up for.
+ */
+
+#define SPI_NOR_MAX_ERASE_TYPES	4
+
+/** One of the erase commands of a device. */
+struct spi_nor_erase_type {
+	uint32_t size;		/**< block size in bytes, zero if unused */
+	uint8_t cmd;
+	unsigned typ_ms;	/**< typical erase time, zero if unknown */
+	unsigned max_ms;	/**< timeout for one block */
+};
+
+/** A run of equally sized blocks erased with the same command. */
+struct spi_nor_erase_step {
+	uint32_t offset;
+	uint32_t size;		/**< of one block */
+	uint32_t count;
+	uint8_t cmd;
+	unsigned timeout_ms;	/**< for the whole run */
+};
+
+struct spi_nor;
+
+struct spi_nor_ops {
+	/**
+	 * Sends @a tx_len bytes and then clocks in @a rx_len bytes within
+	 * one chip select cycle.  NULL if the controller can only issue
+	 * its built-in commands, which rules out SFDP.
+	 */
+	int (*transfer)(struct flash_bank *bank, const uint8_t *tx, unsigned tx_len,
+			uint8_t *rx, unsigned rx_len);
+	/** Runs all @a num_steps steps, waiting for each block to finish. */
+	int (*erase)(struct flash_bank *bank, const struct spi_nor_erase_step *steps,
+			unsigned num_steps);
+	/** Erases the whole device; NULL if not supported. */
+	int (*erase_chip)(struct flash_bank *bank);
+	/**
+	 * Programs @a count bytes at @a offset, which may span any number
+	 * of pages.  Either this or @a program_page must be provided.
+	 */
+	int (*program)(struct flash_bank *bank, uint8_t *buffer,
+			uint32_t offset, uint32_t count);
+	/** Programs @a count bytes at @a offset within a single page. */
+	int (*program_page)(struct flash_bank *bank, uint8_t *buffer,
+			uint32_t offset, uint32_t count);
+	/** Returns the controller to memory mapped mode. */
+	int (*memory_mode)(struct flash_bank *bank);
+};
+
+/** Device parameters and state of the engine, embedded in the driver's bank data. */
+struct spi_nor {
+	const struct spi_nor_ops *ops;
+	const struct flash_device *dev;	/**< table entry, NULL if only known by SFDP */
+	uint32_t device_id;
+	uint32_t size;
+	uint32_t pagesize;
+	uint8_t chip_erase_cmd;		/**< zero if the device has none */
+	unsigned chip_erase_ms;		/**< timeout for erase_chip */
+	struct spi_nor_erase_type erase[SPI_NOR_MAX_ERASE_TYPES];
+	unsigned num_erase_types;	/**< sorted by ascending size */
+	bool sfdp;			/**< parameters come from SFDP */
+	uint8_t quad_read_cmd;		/**< 1-1-4 or 1-4-4 fast read, zero if none */
+	uint8_t quad_read_dummy;	/**< dummy and mode clocks of quad_read_cmd */
+};
+
+/**
+ * Sets up @a nor for the device with JEDEC ID @a id and creates the
+ * bank's sectors.  The controller must accept commands, i.e. be out of
+ * memory mapped mode, if it provides transfer().
+ */
+int spi_nor_probe(struct flash_bank *bank, struct spi_nor *nor, uint32_t id);
+
+/** Parses an SFDP image starting at SFDP address zero into @a nor. */
+int spi_nor_parse_sfdp(struct spi_nor *nor, const uint8_t *sfdp, uint32_t len);
+
+/**
+ * Covers [@a offset, @a offset + @a count) with the combination of
+ * erase blocks taking the least total time.  The range must be aligned
+ * to the smallest erase block.  The caller frees *@a steps.
+ */
+int spi_nor_plan_erase(const struct spi_nor *nor, uint32_t offset, uint32_t count,
+		struct spi_nor_erase_step **steps, unsigned *num_steps);
+
+int spi_nor_erase(struct flash_bank *bank, struct spi_nor *nor, int first, int last);
+int spi_nor_write(struct flash_bank *bank, struct spi_nor *nor, uint8_t *buffer,
+		uint32_t offset, uint32_t count);
+int spi_nor_read(struct flash_bank *bank, struct spi_nor *nor, uint8_t *buffer,
+		uint32_t offset, uint32_t count);
+int spi_nor_info(struct spi_nor *nor, char *buf, int buf_size);
+
+#endif /* FLASH_NOR_SPI_H */
@@ -0,0 +1,200 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+
+/**
+ * @file
+ * Where the time of a flash write goes.
+ *
+ * The flash core brackets its steps with flash_stats_enter() and
+ * flash_stats_leave().  Time is charged to the innermost step, e.g. the
+ * wait for a background erase which a write has to complete first is
+ * erase time, not program time.  Each charge also takes the difference
+ * of target_timing_get(), splitting a phase further into transfers,
+ * algorithm runs and working area setup.
+ */
+
+static struct flash_stats stats;
+static bool stats_valid;	/* stats describe an operation */
+static bool stats_active;	/* ... which is still running */
+static struct duration stats_total;
+
+static struct flash_stats_mark *stats_top;
+static struct duration stats_since;
+static struct target_timing stats_target;
+
+static const char * const phase_names[FLASH_PHASES] = {
+	[FLASH_PHASE_UNLOCK] = "unlock",
+	[FLASH_PHASE_ERASE] = "erase",
+	[FLASH_PHASE_PREPARE] = "prepare",
+	[FLASH_PHASE_PROGRAM] = "program",
+	[FLASH_PHASE_VERIFY] = "verify",
+};
+
+const char *flash_phase_name(enum flash_phase phase)
+{
+	return phase_names[phase];
+}
+
+/* charge the time since the last call to the innermost step */
+static void flash_stats_charge(void)
+{
+	struct target_timing now;
+
+	target_timing_get(&now);
+
+	if (stats_active && stats_top != NULL
+			&& duration_measure(&stats_since) == ERROR_OK) {
+		struct flash_phase_stats *phase = &stats.phase[stats_top->phase];
+
+		phase->seconds += duration_elapsed(&stats_since);
+		phase->target.transfer += now.transfer - stats_target.transfer;
+		phase->target.algorithm += now.algorithm - stats_target.algorithm;
+		phase->target.working_area += now.working_area - stats_target.working_area;
+		phase->target.algorithm_runs += now.algorithm_runs - stats_target.algorithm_runs;
+		phase->target.bytes_written += now.bytes_written - stats_target.bytes_written;
+		phase->target.bytes_read += now.bytes_read - stats_target.bytes_read;
+	}
+
+	stats_target = now;
+	duration_start(&stats_since);
+}
+
+void flash_stats_start(void)
+{
+	free(stats.sectors);
+	memset(&stats, 0, sizeof(stats));
+	stats_valid = true;
+	stats_active = true;
+
+	duration_start(&stats_total);
+	flash_stats_charge();
+}
+
+void flash_stats_stop(void)
+{
+	if (!stats_active)
+		return;
+
+	flash_stats_charge();
+	if (duration_measure(&stats_total) == ERROR_OK)
+		stats.seconds = duration_elapsed(&stats_total);
+	stats_active = false;
+}
+
+const struct flash_stats *flash_stats_get(void)
+{
+	return stats_valid ? &stats : NULL;
+}
+
+void flash_stats_enter(struct flash_stats_mark *mark, enum flash_phase phase)
+{
+	flash_stats_charge();
+
+	mark->phase = phase;
+	mark->nested = 0;
+	mark->outer = stats_top;
+	stats_top = mark;
+	duration_start(&mark->start);
+}
+
+double flash_stats_leave(struct flash_stats_mark *mark)
+{
+	double total = 0;
+
+	flash_stats_charge();
+
+	assert(stats_top == mark);
+	stats_top = mark->outer;
+
+	if (duration_measure(&mark->start) == ERROR_OK)
+		total = duration_elapsed(&mark->start);
+	if (mark->outer != NULL)
+		mark->outer->nested += total;
+
+	return total > mark->nested ? total - mark->nested : 0;
+}
+
+/* the record of @a sector in @a bank, created on first use */
+static struct flash_sector_stats *flash_stats_sector(struct flash_bank *bank, int sector)
+{
+	struct flash_sector_stats *entry;
+
+	for (int i = stats.num_sectors - 1; i >= 0; i--) {
+		entry = &stats.sectors[i];
+		if (entry->bank_number == bank->bank_number && entry->sector == sector)
+			return entry;
+	}
+
+	entry = realloc(stats.sectors, (stats.num_sectors + 1) * sizeof(*entry));
+	if (entry == NULL)
+		return NULL;
+	stats.sectors = entry;
+
+	entry = &stats.sectors[stats.num_sectors++];
+	memset(entry, 0, sizeof(*entry));
+	entry->bank_number = bank->bank_number;
+	entry->sector = sector;
+
+	return entry;
+}
+
+void flash_stats_erase(struct flash_bank *bank, int first, int last, double seconds)
+{
+	if (!stats_active || first > last)
+		return;
+
+	for (int i = first; i <= last; i++) {
+		struct flash_sector_stats *entry = flash_stats_sector(bank, i);
+		if (entry == NULL)
+			return;
+		entry->erased = true;
+		entry->erase_seconds += seconds / (last - first + 1);
+	}
+}
+
+void flash_stats_program(struct flash_bank *bank,
+		uint32_t offset, uint32_t count, double seconds)
+{
+	uint32_t end = offset + count;
+
+	if (!stats_active || count == 0)
+		return;
+
+	for (int i = 0; i < bank->num_sectors; i++) {
+		uint32_t start = bank->sectors[i].offset;
+		uint32_t stop = start + bank->sectors[i].size;
+
+		if (stop <= offset || start >= end)
+			continue;
+		if (start < offset)
+			start = offset;
+		if (stop > end)
+			stop = end;
+
+		struct flash_sector_stats *entry = flash_stats_sector(bank, i);
+		if (entry == NULL)
+			return;
+		entry->bytes += stop - start;
+		entry->program_seconds += seconds * (stop - start) / count;
+	}
+}
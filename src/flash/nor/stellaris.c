@@ -31,6 +31,8 @@
 
 #include "jtag/interface.h"
 #include "imp.h"
+#include "async.h"
+#include "batch.h"
 #include <target/algorithm.h>
 #include <target/armv7m.h>
 
@@ -83,6 +85,9 @@
 #define FMC_ERASE	(1 << 1)
 #define FMC_WRITE	(1 << 0)
 
+/* ms to wait for a word write, which takes well below one */
+#define STELLARIS_WRITE_TIMEOUT	100
+
 /* STELLARIS constants */
 
 /* values to write in FMA to commit write-"once" values */
@@ -999,18 +1004,22 @@ static const uint8_t stellaris_write_code[] = {
 static int stellaris_write_block(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t wcount)
 {
-	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
-	struct working_area *source;
-	struct working_area *write_algorithm;
 	uint32_t address = bank->base + offset;
 	struct reg_param reg_params[4];
-	struct armv7m_algorithm armv7m_info;
 	int retval = ERROR_OK;
 
 	/* power of two, and multiple of word size */
 	static const unsigned buf_min = 128;
 
+	static const struct flash_async_loader stellaris_loader = {
+		.code = stellaris_write_code,
+		.code_size = sizeof(stellaris_write_code),
+		.block_size = 4,
+		.fifo_min = buf_min,
+		.fifo_start_param = 0,
+		.fifo_end_param = 1,
+	};
+
 	/* for small buffers it's faster not to download an algorithm */
 	if (wcount * 4 < buf_min)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -1018,58 +1027,19 @@ static int stellaris_write_block(struct flash_bank *bank,
 	LOG_DEBUG("(bank=%p buffer=%p offset=%08" PRIx32 " wcount=%08" PRIx32 "",
 			bank, buffer, offset, wcount);
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(stellaris_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_DEBUG("no working area for block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	};
-
-	/* plus a buffer big enough for this data */
-	if (wcount * 4 < buffer_size)
-		buffer_size = wcount * 4;
-
-	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		if (buffer_size <= buf_min) {
-			target_free_working_area(target, write_algorithm);
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
-		LOG_DEBUG("retry target_alloc_working_area(%s, size=%u)",
-				target_name(target), (unsigned) buffer_size);
-	};
-
-	target_write_buffer(target, write_algorithm->address,
-			sizeof(stellaris_write_code),
-			(uint8_t *) stellaris_write_code);
-
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
-
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
 	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
 
-	buf_set_u32(reg_params[0].value, 0, 32, source->address);
-	buf_set_u32(reg_params[1].value, 0, 32, source->address + source->size);
 	buf_set_u32(reg_params[2].value, 0, 32, address);
 	buf_set_u32(reg_params[3].value, 0, 32, wcount);
 
-	retval = target_run_flash_async_algorithm(target, buffer, wcount, 4,
-			0, NULL,
-			4, reg_params,
-			source->address, source->size,
-			write_algorithm->address, 0,
-			&armv7m_info);
+	retval = flash_async_write(bank, &stellaris_loader, buffer, wcount, 4, reg_params);
 
 	if (retval == ERROR_FLASH_OPERATION_FAILED)
 		LOG_ERROR("error %d executing stellaris flash write algorithm", retval);
 
-	target_free_working_area(target, write_algorithm);
-	target_free_working_area(target, source);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
@@ -1078,13 +1048,66 @@ static int stellaris_write_block(struct flash_bank *bank,
 	return retval;
 }
 
+static int stellaris_queue_word(struct flash_batch *batch,
+		uint32_t address, uint32_t word)
+{
+	int retval;
+
+	retval = flash_batch_write_u32(batch, FLASH_FMA, address);
+	if (retval == ERROR_OK)
+		retval = flash_batch_write_u32(batch, FLASH_FMD, word);
+	if (retval == ERROR_OK)
+		retval = flash_batch_write_u32(batch, FLASH_FMC, FMC_WRKEY | FMC_WRITE);
+
+	return retval;
+}
+
+/* Program one word, and wait until the write completes */
+static int stellaris_write_word(struct flash_bank *bank,
+		uint32_t address, uint32_t word)
+{
+	struct target *target = bank->target;
+	uint32_t flash_fmc;
+	long long endtime;
+	int retval;
+
+	retval = target_write_u32(target, FLASH_FMA, address);
+	if (retval == ERROR_OK)
+		retval = target_write_u32(target, FLASH_FMD, word);
+	if (retval == ERROR_OK)
+		retval = target_write_u32(target, FLASH_FMC, FMC_WRKEY | FMC_WRITE);
+	if (retval != ERROR_OK)
+		return retval;
+
+	endtime = timeval_ms() + STELLARIS_WRITE_TIMEOUT;
+	do {
+		retval = target_read_u32(target, FLASH_FMC, &flash_fmc);
+		if (retval != ERROR_OK)
+			return retval;
+		if (!(flash_fmc & FMC_WRITE))
+			return ERROR_OK;
+	} while (timeval_ms() < endtime);
+
+	LOG_ERROR("timeout waiting for flash write at 0x%08" PRIx32, address);
+	return ERROR_FLASH_OPERATION_FAILED;
+}
+
+static const struct flash_batch_ops stellaris_word_ops = {
+	.status_reg = FLASH_FMC,
+	.busy_mask = FMC_WRITE,
+	.busy_value = FMC_WRITE,
+	/* access violations show up in FLASH_CRIS, checked afterwards */
+	.queue_word = stellaris_queue_word,
+	.write_word = stellaris_write_word,
+};
+
 static int stellaris_write(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
 	struct stellaris_flash_bank *stellaris_info = bank->driver_priv;
 	struct target *target = bank->target;
 	uint32_t address = offset;
-	uint32_t flash_cris, flash_fmc;
+	uint32_t flash_cris;
 	uint32_t words_remaining = (count / 4);
 	uint32_t bytes_remaining = (count & 0x00000003);
 	uint32_t bytes_written = 0;
@@ -1143,19 +1166,26 @@ static int stellaris_write(struct flash_bank *bank, uint8_t *buffer,
 		}
 	}
 
+	/* without a working area, still avoid a round trip per word */
+	if (words_remaining > 0) {
+		retval = flash_batch_write_words(bank, &stellaris_word_ops,
+				address, buffer, words_remaining);
+		if (retval == ERROR_OK) {
+			buffer += words_remaining * 4;
+			address += words_remaining * 4;
+			words_remaining = 0;
+		} else if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
 	while (words_remaining > 0) {
 		if (!(address & 0xff))
 			LOG_DEBUG("0x%" PRIx32 "", address);
 
-		/* Program one word */
-		target_write_u32(target, FLASH_FMA, address);
-		target_write_buffer(target, FLASH_FMD, 4, buffer);
-		target_write_u32(target, FLASH_FMC, FMC_WRKEY | FMC_WRITE);
-		/* LOG_DEBUG("0x%x 0x%x 0x%x",address,buf_get_u32(buffer, 0, 32),FMC_WRKEY | FMC_WRITE); */
-		/* Wait until write complete */
-		do {
-			target_read_u32(target, FLASH_FMC, &flash_fmc);
-		} while (flash_fmc & FMC_WRITE);
+		retval = stellaris_write_word(bank, address,
+				target_buffer_get_u32(target, buffer));
+		if (retval != ERROR_OK)
+			return retval;
 
 		buffer += 4;
 		address += 4;
@@ -1171,15 +1201,10 @@ static int stellaris_write(struct flash_bank *bank, uint8_t *buffer,
 		if (!(address & 0xff))
 			LOG_DEBUG("0x%" PRIx32 "", address);
 
-		/* Program one word */
-		target_write_u32(target, FLASH_FMA, address);
-		target_write_buffer(target, FLASH_FMD, 4, last_word);
-		target_write_u32(target, FLASH_FMC, FMC_WRKEY | FMC_WRITE);
-		/* LOG_DEBUG("0x%x 0x%x 0x%x",address,buf_get_u32(buffer, 0, 32),FMC_WRKEY | FMC_WRITE); */
-		/* Wait until write complete */
-		do {
-			target_read_u32(target, FLASH_FMC, &flash_fmc);
-		} while (flash_fmc & FMC_WRITE);
+		retval = stellaris_write_word(bank, address,
+				target_buffer_get_u32(target, last_word));
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
 	/* Check access violations */
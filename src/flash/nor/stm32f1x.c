@@ -29,6 +29,7 @@
 #endif
 
 #include "imp.h"
+#include "async.h"
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
@@ -124,6 +125,11 @@ struct stm32x_flash_bank {
 	uint32_t register_base;
 	uint16_t default_rdp;
 	int user_data_offset;
+
+	/* erase begun by stm32x_erase_start() */
+	int erase_next;
+	int erase_last;
+	bool erase_mass;
 };
 
 static int stm32x_mass_erase(struct flash_bank *bank);
@@ -421,18 +427,36 @@ static int stm32x_protect_check(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
-static int stm32x_erase(struct flash_bank *bank, int first, int last)
+/* start erasing one page, or the whole bank for FLASH_MER */
+static int stm32x_erase_issue(struct flash_bank *bank, uint32_t cr, int sector)
 {
 	struct target *target = bank->target;
-	int i;
+
+	int retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), cr);
+	if (retval != ERROR_OK)
+		return retval;
+	if (cr == FLASH_PER) {
+		retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_AR),
+				bank->base + bank->sectors[sector].offset);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), cr | FLASH_STRT);
+}
+
+static int stm32x_erase_start(struct flash_bank *bank, int first, int last)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	struct target *target = bank->target;
 
 	if (bank->target->state != TARGET_HALTED) {
 		LOG_ERROR("Target not halted");
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	if ((first == 0) && (last == (bank->num_sectors - 1)))
-		return stm32x_mass_erase(bank);
+	stm32x_info->erase_next = first;
+	stm32x_info->erase_last = last;
+	stm32x_info->erase_mass = (first == 0) && (last == (bank->num_sectors - 1));
 
 	/* unlock flash registers */
 	int retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY1);
@@ -442,24 +466,36 @@ static int stm32x_erase(struct flash_bank *bank, int first, int last)
 	if (retval != ERROR_OK)
 		return retval;
 
-	for (i = first; i <= last; i++) {
-		retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PER);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_AR),
-				bank->base + bank->sectors[i].offset);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target,
-				stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PER | FLASH_STRT);
-		if (retval != ERROR_OK)
-			return retval;
+	return stm32x_erase_issue(bank, stm32x_info->erase_mass ? FLASH_MER : FLASH_PER, first);
+}
+
+/* the controller erases one page at a time, so the remaining pages
+ * of the range are issued from here */
+static int stm32x_erase_wait(struct flash_bank *bank)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	struct target *target = bank->target;
+	int retval;
+	int i;
 
+	for (;;) {
 		retval = stm32x_wait_status_busy(bank, FLASH_ERASE_TIMEOUT);
 		if (retval != ERROR_OK)
 			return retval;
 
-		bank->sectors[i].is_erased = 1;
+		if (stm32x_info->erase_mass) {
+			for (i = 0; i < bank->num_sectors; i++)
+				bank->sectors[i].is_erased = 1;
+			break;
+		}
+
+		bank->sectors[stm32x_info->erase_next].is_erased = 1;
+		if (++stm32x_info->erase_next > stm32x_info->erase_last)
+			break;
+
+		retval = stm32x_erase_issue(bank, FLASH_PER, stm32x_info->erase_next);
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
 	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_LOCK);
@@ -469,6 +505,15 @@ static int stm32x_erase(struct flash_bank *bank, int first, int last)
 	return ERROR_OK;
 }
 
+static int stm32x_erase(struct flash_bank *bank, int first, int last)
+{
+	int retval = stm32x_erase_start(bank, first, last);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return stm32x_erase_wait(bank);
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, int first, int last)
 {
 	struct stm32x_flash_bank *stm32x_info = NULL;
@@ -563,17 +608,77 @@ static int stm32x_protect(struct flash_bank *bank, int set, int first, int last)
 	return stm32x_write_options(bank);
 }
 
+static void stm32x_report_write_error(struct flash_bank *bank,
+		uint32_t status, uint32_t address)
+{
+	struct target *target = bank->target;
+
+	LOG_ERROR("flash write failed at address 0x%"PRIx32, address);
+
+	if (status & FLASH_PGERR) {
+		LOG_ERROR("flash memory not erased before writing");
+		/* Clear but report errors */
+		target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR), FLASH_PGERR);
+	}
+
+	if (status & FLASH_WRPRTERR) {
+		LOG_ERROR("flash memory write protected");
+		/* Clear but report errors */
+		target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR), FLASH_WRPRTERR);
+	}
+}
+
+/* write @a count bytes, a multiple of four, through the decompressor */
+static int stm32x_write_compressed(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t address, uint32_t count)
+{
+	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
+	uint32_t status, fail_address;
+	int retval;
+
+	/* see contrib/loaders/flash/stm32f1x_put_word.S for src */
+
+	static const uint8_t stm32x_put_word_code[] = {
+		/* #define STM32_FLASH_SR_OFFSET 0x0C */
+		/* put_word: */
+			0x22, 0xf8, 0x02, 0x6b,	/* strh  r6, [r2], #2 */
+		/* wait1: */
+			0xd4, 0xf8, 0x0c, 0x80,	/* ldr   r8, [r4, #STM32_FLASH_SR_OFFSET] */
+			0x18, 0xf0, 0x01, 0x0f,	/* tst   r8, #0x01 */
+			0xfa, 0xd1,				/* bne   wait1 */
+			0x18, 0xf0, 0x14, 0x08,	/* ands  r8, r8, #0x14 */
+			0x18, 0xbf,				/* it    ne */
+			0x70, 0x47,				/* bxne  lr */
+			0x36, 0x0c,				/* lsrs  r6, r6, #16 */
+			0x22, 0xf8, 0x02, 0x6b,	/* strh  r6, [r2], #2 */
+		/* wait2: */
+			0xd4, 0xf8, 0x0c, 0x80,	/* ldr   r8, [r4, #STM32_FLASH_SR_OFFSET] */
+			0x18, 0xf0, 0x01, 0x0f,	/* tst   r8, #0x01 */
+			0xfa, 0xd1,				/* bne   wait2 */
+			0x08, 0xf0, 0x14, 0x08,	/* and   r8, r8, #0x14 */
+			0x70, 0x47,				/* bx    lr */
+	};
+
+	static const struct flash_async_sink stm32x_sink = {
+		.code = stm32x_put_word_code,
+		.code_size = sizeof(stm32x_put_word_code),
+	};
+
+	retval = flash_async_write_compressed(bank, &stm32x_sink, stm32x_info->register_base,
+			buffer, address, count, &status, &fail_address);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		stm32x_report_write_error(bank, status, fail_address);
+
+	return retval;
+}
+
 static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
 	struct stm32x_flash_bank *stm32x_info = bank->driver_priv;
-	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
-	struct working_area *write_algorithm;
-	struct working_area *source;
 	uint32_t address = bank->base + offset;
 	struct reg_param reg_params[5];
-	struct armv7m_algorithm armv7m_info;
 	int retval = ERROR_OK;
 
 	/* see contrib/loaders/flash/stm32f1x.S for src */
@@ -617,30 +722,12 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 			0x00, 0xbe,   /* bkpt  #0 */
 	};
 
-	/* flash write code */
-	if (target_alloc_working_area(target, sizeof(stm32x_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	};
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(stm32x_flash_write_code), (uint8_t *)stm32x_flash_write_code);
-	if (retval != ERROR_OK)
-		return retval;
-
-	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		buffer_size &= ~3UL; /* Make sure it's 4 byte aligned */
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
+	static const struct flash_async_loader stm32x_loader = {
+		.code = stm32x_flash_write_code,
+		.code_size = sizeof(stm32x_flash_write_code),
+		.block_size = 2,
+		.fifo_start_param = 2,
+		.fifo_end_param = 3,
 	};
 
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* flash base (in), status (out) */
@@ -651,40 +738,14 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 
 	buf_set_u32(reg_params[0].value, 0, 32, stm32x_info->register_base);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
-	buf_set_u32(reg_params[2].value, 0, 32, source->address);
-	buf_set_u32(reg_params[3].value, 0, 32, source->address + source->size);
 	buf_set_u32(reg_params[4].value, 0, 32, address);
 
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
+	retval = flash_async_write(bank, &stm32x_loader, buffer, count, 5, reg_params);
 
-	retval = target_run_flash_async_algorithm(target, buffer, count, 2,
-			0, NULL,
-			5, reg_params,
-			source->address, source->size,
-			write_algorithm->address, 0,
-			&armv7m_info);
-
-	if (retval == ERROR_FLASH_OPERATION_FAILED) {
-		LOG_ERROR("flash write failed at address 0x%"PRIx32,
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+		stm32x_report_write_error(bank, buf_get_u32(reg_params[0].value, 0, 32),
 				buf_get_u32(reg_params[4].value, 0, 32));
 
-		if (buf_get_u32(reg_params[0].value, 0, 32) & FLASH_PGERR) {
-			LOG_ERROR("flash memory not erased before writing");
-			/* Clear but report errors */
-			target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR), FLASH_PGERR);
-		}
-
-		if (buf_get_u32(reg_params[0].value, 0, 32) & FLASH_WRPRTERR) {
-			LOG_ERROR("flash memory write protected");
-			/* Clear but report errors */
-			target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_SR), FLASH_WRPRTERR);
-		}
-	}
-
-	target_free_working_area(target, source);
-	target_free_working_area(target, write_algorithm);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
@@ -694,6 +755,21 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 	return retval;
 }
 
+/* unlock a bank and enter programming mode */
+static int stm32x_start_pg(struct flash_bank *bank)
+{
+	struct target *target = bank->target;
+
+	int retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY1);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY2);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PG);
+}
+
 static int stm32x_write(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
@@ -729,19 +805,23 @@ static int stm32x_write(struct flash_bank *bank, uint8_t *buffer,
 	int retval, retval2;
 
 	/* unlock flash registers */
-	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY1);
-	if (retval != ERROR_OK)
-		goto cleanup;
-	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_KEYR), KEY2);
+	retval = stm32x_start_pg(bank);
 	if (retval != ERROR_OK)
 		goto cleanup;
 
-	retval = target_write_u32(target, stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_PG);
-	if (retval != ERROR_OK)
-		goto cleanup;
+	/* pairs of halfwords go through the decompressor, if enabled */
+	retval = stm32x_write_compressed(bank, buffer, bank->base + offset,
+			(words_remaining & ~1) * 2);
+	if (retval == ERROR_OK) {
+		buffer += (words_remaining & ~1) * 2;
+		offset += (words_remaining & ~1) * 2;
+		words_remaining &= 1;
+	} else if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		goto reset_pg_and_lock;
 
 	/* try using a block write */
-	retval = stm32x_write_block(bank, buffer, offset, words_remaining);
+	if (words_remaining > 0)
+		retval = stm32x_write_block(bank, buffer, offset, words_remaining);
 
 	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
 		/* if block write failed (no sufficient working area),
@@ -778,6 +858,170 @@ cleanup:
 	return retval;
 }
 
+/*
+ * XL density devices have an independent controller for each bank.
+ * Interleave the data for both banks into one FIFO stream, so one
+ * loader can start a halfword in each bank before waiting for either.
+ */
+static int stm32x_write_concurrent(struct flash_write_job *jobs, int num_jobs)
+{
+	struct flash_write_job *job[2] = { NULL, NULL };
+	struct reg_param reg_params[8];
+	uint32_t halfwords[2];
+	uint32_t count;
+	uint8_t *stream;
+	int retval, retval2;
+	int i;
+
+	if (num_jobs != 2)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	for (i = 0; i < num_jobs; i++) {
+		struct stm32x_flash_bank *stm32x_info = jobs[i].bank->driver_priv;
+		int b = stm32x_info->register_base == FLASH_REG_BASE_B1;
+
+		if (!stm32x_info->probed || !stm32x_info->has_dual_banks || job[b]
+				|| jobs[i].bank->target->state != TARGET_HALTED
+				|| (jobs[i].offset & 1) || (jobs[i].count & 1))
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		job[b] = &jobs[i];
+		halfwords[b] = jobs[i].count / 2;
+	}
+
+	count = halfwords[0] > halfwords[1] ? halfwords[0] : halfwords[1];
+	stream = malloc(count * 4);
+	if (stream == NULL)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	memset(stream, 0xff, count * 4);
+	for (i = 0; i < 2; i++) {
+		for (uint32_t n = 0; n < halfwords[i]; n++)
+			memcpy(stream + 4 * n + 2 * i, job[i]->buffer + 2 * n, 2);
+	}
+
+	/* see contrib/loaders/flash/stm32f1x_dual.S for src */
+
+	static const uint8_t stm32x_flash_write_dual_code[] = {
+		/* #define STM32_FLASH_SR_OFFSET 0x0C */
+		/* wait_fifo: */
+			0xd2, 0xf8, 0x00, 0x90,   /* ldr   r9, [r2, #0] */
+			0xb9, 0xf1, 0x00, 0x0f,   /* cmp   r9, #0 */
+			0x2f, 0xd0,               /* beq   exit */
+			0xd2, 0xf8, 0x04, 0x80,   /* ldr   r8, [r2, #4] */
+			0xc8, 0x45,               /* cmp   r8, r9 */
+			0xf6, 0xd0,               /* beq   wait_fifo */
+			0x26, 0xb1,               /* cbz   r6, skip_bank0 */
+			0xb8, 0xf8, 0x00, 0x90,   /* ldrh  r9, [r8, #0] */
+			0x24, 0xf8, 0x02, 0x9b,   /* strh  r9, [r4], #2 */
+			0x76, 0x1e,               /* subs  r6, r6, #1 */
+		/* skip_bank0: */
+			0x27, 0xb1,               /* cbz   r7, skip_bank1 */
+			0xb8, 0xf8, 0x02, 0x90,   /* ldrh  r9, [r8, #2] */
+			0x25, 0xf8, 0x02, 0x9b,   /* strh  r9, [r5], #2 */
+			0x7f, 0x1e,               /* subs  r7, r7, #1 */
+		/* skip_bank1: */
+			0x08, 0xf1, 0x04, 0x08,   /* add   r8, r8, #4 */
+		/* busy_bank0: */
+			0xd0, 0xf8, 0x0c, 0x90,   /* ldr   r9, [r0, #STM32_FLASH_SR_OFFSET] */
+			0x19, 0xf0, 0x01, 0x0f,   /* tst   r9, #0x01 */
+			0xfa, 0xd1,               /* bne   busy_bank0 */
+			0x19, 0xf0, 0x14, 0x0f,   /* tst   r9, #0x14 */
+			0x11, 0xd1,               /* bne   error */
+		/* busy_bank1: */
+			0xd1, 0xf8, 0x0c, 0x90,   /* ldr   r9, [r1, #STM32_FLASH_SR_OFFSET] */
+			0x19, 0xf0, 0x01, 0x0f,   /* tst   r9, #0x01 */
+			0xfa, 0xd1,               /* bne   busy_bank1 */
+			0x19, 0xf0, 0x14, 0x0f,   /* tst   r9, #0x14 */
+			0x09, 0xd1,               /* bne   error */
+			0x98, 0x45,               /* cmp   r8, r3 */
+			0x28, 0xbf,               /* it    cs */
+			0x02, 0xf1, 0x08, 0x08,   /* addcs r8, r2, #8 */
+			0xc2, 0xf8, 0x04, 0x80,   /* str   r8, [r2, #4] */
+			0x56, 0xea, 0x07, 0x0c,   /* orrs  r12, r6, r7 */
+			0xcf, 0xd1,               /* bne   wait_fifo */
+			0x03, 0xe0,               /* b     exit */
+		/* error: */
+			0x4f, 0xf0, 0x00, 0x08,   /* mov   r8, #0 */
+			0xc2, 0xf8, 0x04, 0x80,   /* str   r8, [r2, #4] */
+		/* exit: */
+			0x48, 0x46,               /* mov   r0, r9 */
+			0x00, 0xbe,               /* bkpt  #0 */
+	};
+
+	static const struct flash_async_loader stm32x_dual_loader = {
+		.code = stm32x_flash_write_dual_code,
+		.code_size = sizeof(stm32x_flash_write_dual_code),
+		.block_size = 4,
+		.fifo_start_param = 2,
+		.fifo_end_param = 3,
+	};
+
+	retval = stm32x_start_pg(job[0]->bank);
+	if (retval == ERROR_OK)
+		retval = stm32x_start_pg(job[1]->bank);
+	if (retval != ERROR_OK)
+		goto reset_pg_and_lock;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* bank 0 flash base (in), status (out) */
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* bank 1 flash base */
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* buffer start */
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* buffer end */
+	init_reg_param(&reg_params[4], "r4", 32, PARAM_IN_OUT);	/* bank 0 target address */
+	init_reg_param(&reg_params[5], "r5", 32, PARAM_IN_OUT);	/* bank 1 target address */
+	init_reg_param(&reg_params[6], "r6", 32, PARAM_OUT);	/* bank 0 count (halfword-16bit) */
+	init_reg_param(&reg_params[7], "r7", 32, PARAM_OUT);	/* bank 1 count (halfword-16bit) */
+
+	buf_set_u32(reg_params[0].value, 0, 32, FLASH_REG_BASE_B0);
+	buf_set_u32(reg_params[1].value, 0, 32, FLASH_REG_BASE_B1);
+	buf_set_u32(reg_params[4].value, 0, 32, job[0]->bank->base + job[0]->offset);
+	buf_set_u32(reg_params[5].value, 0, 32, job[1]->bank->base + job[1]->offset);
+	buf_set_u32(reg_params[6].value, 0, 32, halfwords[0]);
+	buf_set_u32(reg_params[7].value, 0, 32, halfwords[1]);
+
+	retval = flash_async_write(job[0]->bank, &stm32x_dual_loader, stream, count,
+			8, reg_params);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED) {
+		for (i = 0; i < 2; i++) {
+			struct flash_bank *bank = job[i]->bank;
+			uint32_t status;
+
+			if (stm32x_get_flash_status(bank, &status) != ERROR_OK)
+				continue;
+			if (!(status & (FLASH_PGERR | FLASH_WRPRTERR)))
+				continue;
+
+			LOG_ERROR("flash write failed at address 0x%"PRIx32,
+					buf_get_u32(reg_params[4 + i].value, 0, 32));
+
+			if (status & FLASH_PGERR)
+				LOG_ERROR("flash memory not erased before writing");
+			if (status & FLASH_WRPRTERR)
+				LOG_ERROR("flash memory write protected");
+
+			/* Clear but report errors */
+			target_write_u32(bank->target, stm32x_get_flash_reg(bank, STM32_FLASH_SR),
+					status & (FLASH_PGERR | FLASH_WRPRTERR));
+		}
+	}
+
+	for (i = 0; i < 8; i++)
+		destroy_reg_param(&reg_params[i]);
+
+reset_pg_and_lock:
+	for (i = 0; i < 2; i++) {
+		struct flash_bank *bank = job[i]->bank;
+		retval2 = target_write_u32(bank->target,
+				stm32x_get_flash_reg(bank, STM32_FLASH_CR), FLASH_LOCK);
+		if (retval == ERROR_OK)
+			retval = retval2;
+	}
+
+	free(stream);
+
+	return retval;
+}
+
 static int stm32x_get_device_id(struct flash_bank *bank, uint32_t *device_id)
 {
 	/* This check the device CPUID core register to detect
@@ -1562,8 +1806,11 @@ struct flash_driver stm32f1x_flash = {
 	.commands = stm32x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_wait = stm32x_erase_wait,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
+	.write_concurrent = stm32x_write_concurrent,
 	.read = default_flash_read,
 	.probe = stm32x_probe,
 	.auto_probe = stm32x_auto_probe,
@@ -29,6 +29,7 @@
 #endif
 
 #include "imp.h"
+#include "async.h"
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
@@ -125,6 +126,11 @@
 
 #define FLASH_ERROR (FLASH_PGSERR | FLASH_PGPERR | FLASH_PGAERR | FLASH_WRPERR | FLASH_OPERR)
 
+/* FLASH_ACR register bits */
+
+#define FLASH_DCEN     (1 << 10)
+#define FLASH_DCRST    (1 << 12)
+
 /* STM32_FLASH_OPTCR register bits */
 
 #define OPT_LOCK      (1 << 0)
@@ -484,12 +490,8 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
 	struct target *target = bank->target;
-	uint32_t buffer_size = 16384;
-	struct working_area *write_algorithm;
-	struct working_area *source;
 	uint32_t address = bank->base + offset;
 	struct reg_param reg_params[5];
-	struct armv7m_algorithm armv7m_info;
 	int retval = ERROR_OK;
 
 	/* see contrib/loaders/flash/stm32f2x.S for src */
@@ -532,52 +534,25 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0x01, 0x01, 0x00, 0x00,		/* .word	0x00000101 */
 	};
 
-	if (target_alloc_working_area(target, sizeof(stm32x_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_WARNING("no working area available, can't do block memory writes");
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	static const struct flash_async_loader stm32x_loader = {
+		.code = stm32x_flash_write_code,
+		.code_size = sizeof(stm32x_flash_write_code),
+		.block_size = 2,
+		.fifo_start_param = 0,
+		.fifo_end_param = 1,
 	};
 
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(stm32x_flash_write_code),
-			(uint8_t *)stm32x_flash_write_code);
-	if (retval != ERROR_OK)
-		return retval;
-
-	/* memory buffer */
-	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK) {
-		buffer_size /= 2;
-		if (buffer_size <= 256) {
-			/* we already allocated the writing code, but failed to get a
-			 * buffer, free the algorithm */
-			target_free_working_area(target, write_algorithm);
-
-			LOG_WARNING("no large enough working area available, can't do block memory writes");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
-	};
-
-	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
-	armv7m_info.core_mode = ARM_MODE_THREAD;
-
 	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);		/* buffer start, status (out) */
 	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);		/* buffer end */
 	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);		/* target address */
 	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);		/* count (halfword-16bit) */
 	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);		/* flash base */
 
-	buf_set_u32(reg_params[0].value, 0, 32, source->address);
-	buf_set_u32(reg_params[1].value, 0, 32, source->address + source->size);
 	buf_set_u32(reg_params[2].value, 0, 32, address);
 	buf_set_u32(reg_params[3].value, 0, 32, count);
 	buf_set_u32(reg_params[4].value, 0, 32, STM32_FLASH_BASE);
 
-	retval = target_run_flash_async_algorithm(target, buffer, count, 2,
-			0, NULL,
-			5, reg_params,
-			source->address, source->size,
-			write_algorithm->address, 0,
-			&armv7m_info);
+	retval = flash_async_write(bank, &stm32x_loader, buffer, count, 5, reg_params);
 
 	if (retval == ERROR_FLASH_OPERATION_FAILED) {
 		LOG_ERROR("error executing stm32x flash write algorithm");
@@ -595,9 +570,6 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 		}
 	}
 
-	target_free_working_area(target, source);
-	target_free_working_area(target, write_algorithm);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
@@ -607,6 +579,85 @@ static int stm32x_write_block(struct flash_bank *bank, uint8_t *buffer,
 	return retval;
 }
 
+/* write @a count bytes, a multiple of four, through the decompressor */
+static int stm32x_write_compressed(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t address, uint32_t count)
+{
+	struct target *target = bank->target;
+	uint32_t status, fail_address;
+	uint32_t acr;
+	int retval, retval2;
+
+	/* see contrib/loaders/flash/stm32f2x_put_word.S for src */
+
+	static const uint8_t stm32x_put_word_code[] = {
+									/* put_word: */
+		0x40, 0xF2, 0x01, 0x19,		/* movw		r9, #STM32_PROG16 */
+		0xC4, 0xF8, 0x10, 0x90,		/* str		r9, [r4, #STM32_FLASH_CR_OFFSET] */
+		0x22, 0xF8, 0x02, 0x6B,		/* strh		r6, [r2], #0x02 */
+									/* wait1: */
+		0xD4, 0xF8, 0x0C, 0x80,		/* ldr		r8, [r4, #STM32_FLASH_SR_OFFSET] */
+		0x18, 0xF4, 0x80, 0x3F,		/* tst		r8, #0x10000 */
+		0xFA, 0xD1,					/* bne		wait1 */
+		0x18, 0xF0, 0xF0, 0x08,		/* ands		r8, r8, #0xf0 */
+		0x18, 0xBF,					/* it		ne */
+		0x70, 0x47,					/* bxne		lr */
+		0x36, 0x0C,					/* lsrs		r6, r6, #16 */
+		0x22, 0xF8, 0x02, 0x6B,		/* strh		r6, [r2], #0x02 */
+									/* wait2: */
+		0xD4, 0xF8, 0x0C, 0x80,		/* ldr		r8, [r4, #STM32_FLASH_SR_OFFSET] */
+		0x18, 0xF4, 0x80, 0x3F,		/* tst		r8, #0x10000 */
+		0xFA, 0xD1,					/* bne		wait2 */
+		0x08, 0xF0, 0xF0, 0x08,		/* and		r8, r8, #0xf0 */
+		0x70, 0x47,					/* bx		lr */
+	};
+
+	static const struct flash_async_sink stm32x_sink = {
+		.code = stm32x_put_word_code,
+		.code_size = sizeof(stm32x_put_word_code),
+	};
+
+	if (!flash_async_get_compress())
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* The decompressor reads back words it has just programmed,
+	 * keep the data cache from serving stale copies of them */
+	retval = target_read_u32(target, STM32_FLASH_ACR, &acr);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = target_write_u32(target, STM32_FLASH_ACR, acr & ~FLASH_DCEN);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = flash_async_write_compressed(bank, &stm32x_sink, STM32_FLASH_BASE,
+			buffer, address, count, &status, &fail_address);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED) {
+		LOG_ERROR("flash write failed at address 0x%" PRIx32, fail_address);
+
+		uint32_t error = status & FLASH_ERROR;
+
+		if (error & FLASH_WRPERR)
+			LOG_ERROR("flash memory write protected");
+
+		if (error != 0) {
+			LOG_ERROR("flash write failed = %08x", error);
+			/* Clear but report errors */
+			target_write_u32(target, STM32_FLASH_SR, error);
+			retval = ERROR_FAIL;
+		}
+	}
+
+	/* flush the data cache before enabling it again */
+	retval2 = target_write_u32(target, STM32_FLASH_ACR, (acr & ~FLASH_DCEN) | FLASH_DCRST);
+	if (retval2 == ERROR_OK)
+		retval2 = target_write_u32(target, STM32_FLASH_ACR, acr);
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+	return retval;
+}
+
 static int stm32x_write(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
@@ -631,6 +682,16 @@ static int stm32x_write(struct flash_bank *bank, uint8_t *buffer,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* pairs of half words go through the decompressor, if enabled */
+	retval = stm32x_write_compressed(bank, buffer, address, (words_remaining & ~1) * 2);
+	if (retval == ERROR_OK) {
+		buffer += (words_remaining & ~1) * 2;
+		offset += (words_remaining & ~1) * 2;
+		address += (words_remaining & ~1) * 2;
+		words_remaining &= 1;
+	} else if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+		return retval;
+
 	/* multiple half words (2-byte) to be programmed? */
 	if (words_remaining > 0) {
 		/* try using a block write */
@@ -608,6 +608,10 @@ static int stm32lx_erase_check(struct flash_bank *bank)
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* erased flash reads as zero on these parts */
+	if (flash_blank_check_sectors(bank, 0x00) == ERROR_OK)
+		return ERROR_OK;
+
 	uint8_t *buffer = malloc(buffer_size);
 	if (buffer == NULL) {
 		LOG_ERROR("failed to allocate read buffer");
@@ -622,8 +626,8 @@ static int stm32lx_erase_check(struct flash_bank *bank)
 		for (j = 0; j < bank->sectors[i].size; j += buffer_size) {
 			uint32_t chunk;
 			chunk = buffer_size;
-			if (chunk > (j - bank->sectors[i].size))
-				chunk = (j - bank->sectors[i].size);
+			if (chunk > (bank->sectors[i].size - j))
+				chunk = (bank->sectors[i].size - j);
 
 			retval = target_read_memory(target, bank->base
 					+ bank->sectors[i].offset + j, 4, chunk / 4, buffer);
@@ -114,13 +114,12 @@
 /* Timeout in ms */
 #define SMI_CMD_TIMEOUT   (100)
 #define SMI_PROBE_TIMEOUT (100)
-#define SMI_MAX_TIMEOUT  (3000)
 
 struct stmsmi_flash_bank {
 	int probed;
 	uint32_t io_base;
 	uint32_t bank_num;
-	struct flash_device *dev;
+	struct spi_nor nor;
 };
 
 struct stmsmi_target {
@@ -268,15 +267,14 @@ static int smi_write_enable(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
-static uint32_t erase_command(struct stmsmi_flash_bank *stmsmi_info,
-	uint32_t offset)
+static uint32_t erase_command(uint8_t erase_cmd, uint32_t offset)
 {
 	union {
 		uint32_t command;
 		uint8_t x[4];
 	} cmd;
 
-	cmd.x[0] = stmsmi_info->dev->erase_cmd;
+	cmd.x[0] = erase_cmd;
 	cmd.x[1] = offset >> 16;
 	cmd.x[2] = offset >> 8;
 	cmd.x[3] = offset;
@@ -284,7 +282,8 @@ static uint32_t erase_command(struct stmsmi_flash_bank *stmsmi_info,
 	return cmd.command;
 }
 
-static int smi_erase_sector(struct flash_bank *bank, int sector)
+static int smi_erase_block(struct flash_bank *bank, uint8_t erase_cmd,
+	uint32_t offset, int timeout)
 {
 	struct target *target = bank->target;
 	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
@@ -303,7 +302,7 @@ static int smi_erase_sector(struct flash_bank *bank, int sector)
 	SMI_CLEAR_TFF();
 
 	/* send SPI command "block erase" */
-	cmd = erase_command(stmsmi_info, bank->sectors[sector].offset);
+	cmd = erase_command(erase_cmd, offset);
 	SMI_WRITE_REG(SMI_TR, cmd);
 	SMI_WRITE_REG(SMI_CR2, stmsmi_info->bank_num | SMI_SEND | SMI_TX_LEN_4);
 
@@ -311,55 +310,82 @@ static int smi_erase_sector(struct flash_bank *bank, int sector)
 	SMI_POLL_TFF(SMI_CMD_TIMEOUT);
 
 	/* poll WIP for end of self timed Sector Erase cycle */
-	retval = wait_till_ready(bank, SMI_MAX_TIMEOUT);
+	retval = wait_till_ready(bank, timeout);
 	if (retval != ERROR_OK)
 		return retval;
 
 	return ERROR_OK;
 }
 
-static int stmsmi_erase(struct flash_bank *bank, int first, int last)
+static int stmsmi_erase_blocks(struct flash_bank *bank,
+	const struct spi_nor_erase_step *steps, unsigned num_steps)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned i = 0; i < num_steps; i++) {
+		for (uint32_t block = 0; block < steps[i].count; block++) {
+			retval = smi_erase_block(bank, steps[i].cmd,
+				steps[i].offset + block * steps[i].size,
+				steps[i].timeout_ms / steps[i].count);
+			if (retval != ERROR_OK)
+				return retval;
+			keep_alive();
+		}
+	}
+
+	return retval;
+}
+
+static int smi_erase_chip(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
 	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
 	uint32_t io_base = stmsmi_info->io_base;
-	int retval = ERROR_OK;
-	int sector;
+	int retval;
 
-	LOG_DEBUG("%s: from sector %d to sector %d", __func__, first, last);
+	retval = smi_write_enable(bank);
+	if (retval != ERROR_OK)
+		return retval;
 
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("Target not halted");
-		return ERROR_TARGET_NOT_HALTED;
-	}
+	/* Switch to SW mode to send bulk erase command */
+	SMI_SET_SW_MODE();
 
-	if ((first < 0) || (last < first) || (last >= bank->num_sectors)) {
-		LOG_ERROR("Flash sector invalid");
-		return ERROR_FLASH_SECTOR_INVALID;
-	}
+	/* clear transmit finished flag */
+	SMI_CLEAR_TFF();
+
+	/* send SPI command "bulk erase" */
+	SMI_WRITE_REG(SMI_TR, stmsmi_info->nor.chip_erase_cmd);
+	SMI_WRITE_REG(SMI_CR2, stmsmi_info->bank_num | SMI_SEND | SMI_TX_LEN_1);
+
+	/* Poll transmit finished flag */
+	SMI_POLL_TFF(SMI_CMD_TIMEOUT);
+
+	/* poll WIP for end of self timed bulk erase cycle */
+	return wait_till_ready(bank, stmsmi_info->nor.chip_erase_ms);
+}
+
+static int stmsmi_set_hw_mode(struct flash_bank *bank)
+{
+	struct target *target = bank->target;
+	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
+	uint32_t io_base = stmsmi_info->io_base;
+
+	SMI_SET_HW_MODE();
+	return ERROR_OK;
+}
+
+static int stmsmi_erase(struct flash_bank *bank, int first, int last)
+{
+	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
+
+	LOG_DEBUG("%s: from sector %d to sector %d", __func__, first, last);
 
 	if (!(stmsmi_info->probed)) {
 		LOG_ERROR("Flash bank not probed");
 		return ERROR_FLASH_BANK_NOT_PROBED;
 	}
 
-	for (sector = first; sector <= last; sector++) {
-		if (bank->sectors[sector].is_protected) {
-			LOG_ERROR("Flash sector %d protected", sector);
-			return ERROR_FAIL;
-		}
-	}
-
-	for (sector = first; sector <= last; sector++) {
-		retval = smi_erase_sector(bank, sector);
-		if (retval != ERROR_OK)
-			break;
-		keep_alive();
-	}
-
-	/* Switch to HW mode before return to prompt */
-	SMI_SET_HW_MODE();
-	return retval;
+	return spi_nor_erase(bank, &stmsmi_info->nor, first, last);
 }
 
 static int stmsmi_protect(struct flash_bank *bank, int set,
@@ -397,43 +423,12 @@ static int smi_write_buffer(struct flash_bank *bank, uint8_t *buffer,
 	return ERROR_OK;
 }
 
-static int stmsmi_write(struct flash_bank *bank, uint8_t *buffer,
+/* Program within one page; burst writes need aligned words */
+static int stmsmi_program_page(struct flash_bank *bank, uint8_t *buffer,
 	uint32_t offset, uint32_t count)
 {
-	struct target *target = bank->target;
-	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
-	uint32_t io_base = stmsmi_info->io_base;
-	uint32_t cur_count, page_size, page_offset;
-	int sector;
-	int retval = ERROR_OK;
-
-	LOG_DEBUG("%s: offset=0x%08" PRIx32 " count=0x%08" PRIx32,
-		__func__, offset, count);
-
-	if (target->state != TARGET_HALTED) {
-		LOG_ERROR("Target not halted");
-		return ERROR_TARGET_NOT_HALTED;
-	}
-
-	if (offset + count > stmsmi_info->dev->size_in_bytes) {
-		LOG_WARNING("Write pasts end of flash. Extra data discarded.");
-		count = stmsmi_info->dev->size_in_bytes - offset;
-	}
-
-	/* Check sector protection */
-	for (sector = 0; sector < bank->num_sectors; sector++) {
-		/* Start offset in or before this sector? */
-		/* End offset in or behind this sector? */
-		if ((offset <
-				(bank->sectors[sector].offset + bank->sectors[sector].size))
-			&& ((offset + count - 1) >= bank->sectors[sector].offset)
-			&& bank->sectors[sector].is_protected) {
-			LOG_ERROR("Flash sector %d protected", sector);
-			return ERROR_FAIL;
-		}
-	}
-
-	page_size = stmsmi_info->dev->pagesize;
+	uint32_t cur_count;
+	int retval;
 
 	/* unaligned buffer head */
 	if (count > 0 && (offset & 3) != 0) {
@@ -443,44 +438,68 @@ static int stmsmi_write(struct flash_bank *bank, uint8_t *buffer,
 		retval = smi_write_buffer(bank, buffer, bank->base + offset,
 			cur_count);
 		if (retval != ERROR_OK)
-			goto err;
+			return retval;
 		offset += cur_count;
 		buffer += cur_count;
 		count -= cur_count;
 	}
 
-	page_offset = offset % page_size;
 	/* central part, aligned words */
-	while (count >= 4) {
-		/* clip block at page boundary */
-		if (page_offset + count > page_size)
-			cur_count = page_size - page_offset;
-		else
-			cur_count = count & ~3;
-
+	if (count >= 4) {
+		cur_count = count & ~3;
 		retval = smi_write_buffer(bank, buffer, bank->base + offset,
 			cur_count);
 		if (retval != ERROR_OK)
-			goto err;
-
-		page_offset = 0;
-		buffer += cur_count;
+			return retval;
 		offset += cur_count;
+		buffer += cur_count;
 		count -= cur_count;
-
-		keep_alive();
 	}
 
 	/* buffer tail */
 	if (count > 0)
-		retval = smi_write_buffer(bank, buffer, bank->base + offset, count);
+		return smi_write_buffer(bank, buffer, bank->base + offset, count);
 
-err:
-	/* Switch to HW mode before return to prompt */
-	SMI_SET_HW_MODE();
-	return retval;
+	return ERROR_OK;
 }
 
+static int stmsmi_write(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t offset, uint32_t count)
+{
+	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
+
+	LOG_DEBUG("%s: offset=0x%08" PRIx32 " count=0x%08" PRIx32,
+		__func__, offset, count);
+
+	if (!(stmsmi_info->probed)) {
+		LOG_ERROR("Flash bank not probed");
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	return spi_nor_write(bank, &stmsmi_info->nor, buffer, offset, count);
+}
+
+static int stmsmi_read(struct flash_bank *bank, uint8_t *buffer,
+	uint32_t offset, uint32_t count)
+{
+	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
+
+	if (!(stmsmi_info->probed)) {
+		LOG_ERROR("Flash bank not probed");
+		return ERROR_FLASH_BANK_NOT_PROBED;
+	}
+
+	return spi_nor_read(bank, &stmsmi_info->nor, buffer, offset, count);
+}
+
+/* SW mode only takes four bytes per transfer, too few to read SFDP */
+static const struct spi_nor_ops stmsmi_nor_ops = {
+	.erase = stmsmi_erase_blocks,
+	.erase_chip = smi_erase_chip,
+	.program_page = stmsmi_program_page,
+	.memory_mode = stmsmi_set_hw_mode,
+};
+
 /* Return ID of flash device */
 /* On exit, SW mode is kept */
 static int read_flash_id(struct flash_bank *bank, uint32_t *id)
@@ -527,13 +546,10 @@ static int stmsmi_probe(struct flash_bank *bank)
 	struct target *target = bank->target;
 	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
 	uint32_t io_base;
-	struct flash_sector *sectors;
 	uint32_t id = 0; /* silence uninitialized warning */
 	struct stmsmi_target *target_device;
 	int retval;
 
-	if (stmsmi_info->probed)
-		free(bank->sectors);
 	stmsmi_info->probed = 0;
 
 	for (target_device = target_devices ; target_device->name ; ++target_device)
@@ -574,41 +590,11 @@ static int stmsmi_probe(struct flash_bank *bank)
 	if (retval != ERROR_OK)
 		return retval;
 
-	stmsmi_info->dev = NULL;
-	for (struct flash_device *p = flash_devices; p->name ; p++)
-		if (p->device_id == id) {
-			stmsmi_info->dev = p;
-			break;
-		}
-
-	if (!stmsmi_info->dev) {
-		LOG_ERROR("Unknown flash device (ID 0x%08" PRIx32 ")", id);
-		return ERROR_FAIL;
-	}
-
-	LOG_INFO("Found flash device \'%s\' (ID 0x%08" PRIx32 ")",
-		stmsmi_info->dev->name, stmsmi_info->dev->device_id);
-
-	/* Set correct size value */
-	bank->size = stmsmi_info->dev->size_in_bytes;
-
-	/* create and fill sectors array */
-	bank->num_sectors =
-		stmsmi_info->dev->size_in_bytes / stmsmi_info->dev->sectorsize;
-	sectors = malloc(sizeof(struct flash_sector) * bank->num_sectors);
-	if (sectors == NULL) {
-		LOG_ERROR("not enough memory");
-		return ERROR_FAIL;
-	}
-
-	for (int sector = 0; sector < bank->num_sectors; sector++) {
-		sectors[sector].offset = sector * stmsmi_info->dev->sectorsize;
-		sectors[sector].size = stmsmi_info->dev->sectorsize;
-		sectors[sector].is_erased = -1;
-		sectors[sector].is_protected = 1;
-	}
+	stmsmi_info->nor.ops = &stmsmi_nor_ops;
+	retval = spi_nor_probe(bank, &stmsmi_info->nor, id);
+	if (retval != ERROR_OK)
+		return retval;
 
-	bank->sectors = sectors;
 	stmsmi_info->probed = 1;
 	return ERROR_OK;
 }
@@ -630,6 +616,7 @@ static int stmsmi_protect_check(struct flash_bank *bank)
 static int get_stmsmi_info(struct flash_bank *bank, char *buf, int buf_size)
 {
 	struct stmsmi_flash_bank *stmsmi_info = bank->driver_priv;
+	int printed;
 
 	if (!(stmsmi_info->probed)) {
 		snprintf(buf, buf_size,
@@ -637,11 +624,11 @@ static int get_stmsmi_info(struct flash_bank *bank, char *buf, int buf_size)
 		return ERROR_OK;
 	}
 
-	snprintf(buf, buf_size, "\nSMI flash information:\n"
-		"  Device \'%s\' (ID 0x%08x)\n",
-		stmsmi_info->dev->name, stmsmi_info->dev->device_id);
+	printed = snprintf(buf, buf_size, "\nSMI flash information:\n");
+	if (printed < 0 || printed >= buf_size)
+		return ERROR_OK;
 
-	return ERROR_OK;
+	return spi_nor_info(&stmsmi_info->nor, buf + printed, buf_size - printed);
 }
 
 struct flash_driver stmsmi_flash = {
@@ -650,7 +637,7 @@ struct flash_driver stmsmi_flash = {
 	.erase = stmsmi_erase,
 	.protect = stmsmi_protect,
 	.write = stmsmi_write,
-	.read = default_flash_read,
+	.read = stmsmi_read,
 	.probe = stmsmi_probe,
 	.auto_probe = stmsmi_auto_probe,
 	.erase_check = default_flash_blank_check,
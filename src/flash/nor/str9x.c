@@ -46,6 +46,11 @@ struct str9x_flash_bank {
 	uint32_t *sector_bits;
 	int variant;
 	int bank1;
+
+	/* erase begun by str9x_erase_start() */
+	int erase_next;
+	int erase_last;
+	uint8_t erase_cmd;
 };
 
 enum str9x_status_codes {
@@ -223,14 +228,29 @@ static int str9x_protect_check(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
-static int str9x_erase(struct flash_bank *bank, int first, int last)
+/* issue the erase command for one sector (or the bank) and select
+ * the status register */
+static int str9x_erase_issue(struct flash_bank *bank, int sector, uint8_t erase_cmd)
 {
 	struct target *target = bank->target;
-	int i;
-	uint32_t adr;
-	uint8_t status;
-	uint8_t erase_cmd;
-	int total_timeout;
+	uint32_t adr = bank->base + bank->sectors[sector].offset;
+	int retval;
+
+	/* erase sectors or block */
+	retval = target_write_u16(target, adr, erase_cmd);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = target_write_u16(target, adr, 0xD0);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* get status */
+	return target_write_u16(target, adr, 0x70);
+}
+
+static int str9x_erase_start(struct flash_bank *bank, int first, int last)
+{
+	struct str9x_flash_bank *str9x_info = bank->driver_priv;
 
 	if (bank->target->state != TARGET_HALTED) {
 		LOG_ERROR("Target not halted");
@@ -240,34 +260,47 @@ static int str9x_erase(struct flash_bank *bank, int first, int last)
 	/* Check if we can erase whole bank */
 	if ((first == 0) && (last == (bank->num_sectors - 1))) {
 		/* Optimize to run erase bank command instead of sector */
-		erase_cmd = 0x80;
-		/* Add timeout duration since erase bank takes more time */
-		total_timeout = 1000 * bank->num_sectors;
+		str9x_info->erase_cmd = 0x80;
 	} else {
 		/* Erase sector command */
-		erase_cmd = 0x20;
-		total_timeout = 1000;
+		str9x_info->erase_cmd = 0x20;
 	}
+	str9x_info->erase_next = first;
+	str9x_info->erase_last = last;
+
+	return str9x_erase_issue(bank, first, str9x_info->erase_cmd);
+}
+
+/* sectors are erased one at a time, so the remaining ones are
+ * issued from here */
+static int str9x_erase_wait(struct flash_bank *bank)
+{
+	struct str9x_flash_bank *str9x_info = bank->driver_priv;
+	struct target *target = bank->target;
+	int first = str9x_info->erase_next;
+	int i;
+	uint32_t adr;
+	uint8_t status;
+	int total_timeout;
+
+	if (str9x_info->erase_cmd == 0x80) {
+		/* Add timeout duration since erase bank takes more time */
+		total_timeout = 1000 * bank->num_sectors;
+	} else
+		total_timeout = 1000;
 
 	/* this is so the compiler can *know* */
 	assert(total_timeout > 0);
 
-	for (i = first; i <= last; i++) {
+	for (i = first; i <= str9x_info->erase_last; i++) {
 		int retval;
 		adr = bank->base + bank->sectors[i].offset;
 
-		/* erase sectors or block */
-		retval = target_write_u16(target, adr, erase_cmd);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u16(target, adr, 0xD0);
-		if (retval != ERROR_OK)
-			return retval;
-
-		/* get status */
-		retval = target_write_u16(target, adr, 0x70);
-		if (retval != ERROR_OK)
-			return retval;
+		if (i != first) {
+			retval = str9x_erase_issue(bank, i, str9x_info->erase_cmd);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 
 		int timeout;
 		for (timeout = 0; timeout < total_timeout; timeout++) {
@@ -299,16 +332,25 @@ static int str9x_erase(struct flash_bank *bank, int first, int last)
 		}
 
 		/* If we ran erase bank command, we are finished */
-		if (erase_cmd == 0x80)
+		if (str9x_info->erase_cmd == 0x80)
 			break;
 	}
 
-	for (i = first; i <= last; i++)
+	for (i = first; i <= str9x_info->erase_last; i++)
 		bank->sectors[i].is_erased = 1;
 
 	return ERROR_OK;
 }
 
+static int str9x_erase(struct flash_bank *bank, int first, int last)
+{
+	int retval = str9x_erase_start(bank, first, last);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return str9x_erase_wait(bank);
+}
+
 static int str9x_protect(struct flash_bank *bank,
 		int set, int first, int last)
 {
@@ -679,6 +721,8 @@ struct flash_driver str9x_flash = {
 	.commands = str9x_command_handlers,
 	.flash_bank_command = str9x_flash_bank_command,
 	.erase = str9x_erase,
+	.erase_start = str9x_erase_start,
+	.erase_wait = str9x_erase_wait,
 	.protect = str9x_protect,
 	.write = str9x_write,
 	.read = default_flash_read,
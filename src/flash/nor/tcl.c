@@ -23,6 +23,7 @@
 #include "config.h"
 #endif
 #include "imp.h"
+#include "async.h"
 #include <helper/time_support.h>
 #include <target/image.h>
 
@@ -31,7 +32,7 @@
  * Implements Tcl commands used to access NOR flash facilities.
  */
 
-COMMAND_HELPER(flash_command_get_bank, unsigned name_index,
+static COMMAND_HELPER(flash_command_lookup_bank, unsigned name_index,
 	struct flash_bank **bank)
 {
 	const char *name = CMD_ARGV[name_index];
@@ -47,6 +48,19 @@ COMMAND_HELPER(flash_command_get_bank, unsigned name_index,
 	return get_flash_bank_by_num(bank_num, bank);
 }
 
+COMMAND_HELPER(flash_command_get_bank, unsigned name_index,
+	struct flash_bank **bank)
+{
+	int retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, name_index, bank);
+
+	/* driver commands may mass erase or otherwise modify the
+	 * flash without the core knowing */
+	if (retval == ERROR_OK)
+		flash_cache_invalidate(*bank, 0, (*bank)->num_sectors - 1);
+
+	return retval;
+}
+
 COMMAND_HANDLER(handle_flash_info_command)
 {
 	struct flash_bank *p;
@@ -56,7 +70,7 @@ COMMAND_HANDLER(handle_flash_info_command)
 	if (CMD_ARGC != 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -120,7 +134,7 @@ COMMAND_HANDLER(handle_flash_probe_command)
 	if (CMD_ARGC != 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -145,7 +159,7 @@ COMMAND_HANDLER(handle_flash_erase_check_command)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	struct flash_bank *p;
-	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	int retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (ERROR_OK != retval)
 		return retval;
 
@@ -272,7 +286,7 @@ COMMAND_HANDLER(handle_flash_erase_command)
 	struct flash_bank *p;
 	int retval;
 
-	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -311,7 +325,7 @@ COMMAND_HANDLER(handle_flash_protect_command)
 	struct flash_bank *p;
 	int retval;
 
-	retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -339,12 +353,50 @@ COMMAND_HANDLER(handle_flash_protect_command)
 	return retval;
 }
 
+/* summary of flash_stats_get(), the details are left to "flash stats" */
+static void flash_stats_print(struct command_context *cmd_ctx)
+{
+	const struct flash_stats *stats = flash_stats_get();
+	int erased = 0, programmed = 0;
+
+	if (stats == NULL)
+		return;
+
+	for (int i = 0; i < FLASH_PHASES; i++) {
+		const struct flash_phase_stats *phase = &stats->phase[i];
+		const struct target_timing *t = &phase->target;
+
+		if (phase->seconds == 0)
+			continue;
+		if (t->transfer == 0 && t->algorithm == 0 && t->working_area == 0) {
+			command_print(cmd_ctx, "  %-8s %fs", flash_phase_name(i), phase->seconds);
+			continue;
+		}
+		command_print(cmd_ctx, "  %-8s %fs: transfer %fs (%" PRIu64 " bytes written, %"
+				PRIu64 " read), target busy %fs (%u algorithm runs), "
+				"working area setup %fs", flash_phase_name(i), phase->seconds,
+				t->transfer, t->bytes_written, t->bytes_read,
+				t->algorithm, t->algorithm_runs, t->working_area);
+	}
+
+	for (int i = 0; i < stats->num_sectors; i++) {
+		if (stats->sectors[i].erased)
+			erased++;
+		if (stats->sectors[i].bytes)
+			programmed++;
+	}
+	if (erased || programmed)
+		command_print(cmd_ctx, "  %d sectors erased, %d programmed", erased, programmed);
+}
+
 COMMAND_HANDLER(handle_flash_write_image_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
 
-	struct image image;
+	bool base_address_set = false;
+	long long base_address = 0;
 	uint32_t written;
+	bool reused;
 
 	int retval;
 
@@ -354,6 +406,9 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool incremental = false;
+	bool compress = false;
+	bool verify = false;
 
 	for (;; ) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -366,6 +421,21 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD_CTX, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "incremental") == 0) {
+			incremental = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "incremental write enabled");
+		} else if (strcmp(CMD_ARGV[0], "compress") == 0) {
+			compress = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "compressed download enabled");
+		} else if (strcmp(CMD_ARGV[0], "verify") == 0) {
+			verify = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "verify enabled");
 		} else
 			break;
 	}
@@ -381,6 +451,105 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	struct duration bench;
 	duration_start(&bench);
 
+	if (CMD_ARGC >= 2) {
+		base_address_set = true;
+		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[1], base_address);
+	}
+
+	struct flash_async_stats before, after;
+	flash_async_get_stats(&before);
+	flash_async_set_compress(compress);
+
+	retval = flash_write_image_file(target, CMD_ARGV[0],
+			(CMD_ARGC == 3) ? CMD_ARGV[2] : NULL, base_address_set, base_address,
+			&written, auto_erase, auto_unlock, incremental, verify, &reused);
+	flash_async_set_compress(false);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
+		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
+			"in %fs (%0.3f KiB/s)%s", written, CMD_ARGV[0],
+			duration_elapsed(&bench), duration_kbps(&bench, written),
+			reused ? " using the cached write plan" : "");
+	}
+
+	flash_async_get_stats(&after);
+	if (compress && after.link_bytes - before.link_bytes < after.bytes - before.bytes) {
+		command_print(CMD_CTX, "sent %" PRIu64 " of %" PRIu64 " streamed bytes "
+				"(%0.1f%%) after compression",
+				after.link_bytes - before.link_bytes, after.bytes - before.bytes,
+				100.0 * (after.link_bytes - before.link_bytes)
+				/ (after.bytes - before.bytes));
+	}
+
+	flash_stats_print(CMD_CTX);
+
+	return retval;
+}
+
+/* targets written together by flash write_image_gang */
+static struct target **gang_targets;
+static unsigned gang_num_targets;
+
+COMMAND_HANDLER(handle_flash_gang_command)
+{
+	if (CMD_ARGC > 0) {
+		struct target **targets = calloc(CMD_ARGC, sizeof(*targets));
+		if (targets == NULL)
+			return ERROR_FAIL;
+
+		for (unsigned i = 0; i < CMD_ARGC; i++) {
+			targets[i] = get_target(CMD_ARGV[i]);
+			if (targets[i] == NULL) {
+				command_print(CMD_CTX, "Target: %s is unknown", CMD_ARGV[i]);
+				free(targets);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		free(gang_targets);
+		gang_targets = targets;
+		gang_num_targets = CMD_ARGC;
+	}
+
+	for (unsigned i = 0; i < gang_num_targets; i++)
+		command_print(CMD_CTX, "%s", target_name(gang_targets[i]));
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_write_image_gang_command)
+{
+	struct flash_gang_result *results;
+	struct image image;
+	int auto_erase = 0;
+	bool auto_unlock = false;
+	bool verify = false;
+	int retval;
+
+	for (; CMD_ARGC > 0; CMD_ARGV++, CMD_ARGC--) {
+		if (strcmp(CMD_ARGV[0], "erase") == 0)
+			auto_erase = 1;
+		else if (strcmp(CMD_ARGV[0], "unlock") == 0)
+			auto_unlock = true;
+		else if (strcmp(CMD_ARGV[0], "verify") == 0)
+			verify = true;
+		else
+			break;
+	}
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (gang_num_targets == 0) {
+		command_print(CMD_CTX, "no targets set with 'flash gang'");
+		return ERROR_FAIL;
+	}
+
+	struct duration bench;
+	duration_start(&bench);
+
 	if (CMD_ARGC >= 2) {
 		image.base_address_set = 1;
 		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[1], image.base_address);
@@ -395,18 +564,34 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
-	if (retval != ERROR_OK) {
+	results = calloc(gang_num_targets, sizeof(*results));
+	if (results == NULL) {
 		image_close(&image);
-		return retval;
+		return ERROR_FAIL;
 	}
+	for (unsigned i = 0; i < gang_num_targets; i++)
+		results[i].target = gang_targets[i];
 
-	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
-		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
-			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
-			duration_elapsed(&bench), duration_kbps(&bench, written));
+	retval = flash_write_gang(&image, results, gang_num_targets,
+			auto_erase, auto_unlock, verify);
+
+	for (unsigned i = 0; i < gang_num_targets; i++) {
+		if (results[i].retval == ERROR_OK)
+			command_print(CMD_CTX, "%s: wrote %" PRIu32 " bytes in %fs",
+					target_name(results[i].target), results[i].written,
+					results[i].seconds);
+		else
+			command_print(CMD_CTX, "%s: failed (error %d)",
+					target_name(results[i].target), results[i].retval);
 	}
 
+	if (duration_measure(&bench) == ERROR_OK)
+		command_print(CMD_CTX, "gang write of %s to %u targets took %fs",
+				CMD_ARGV[0], gang_num_targets, duration_elapsed(&bench));
+
+	flash_stats_print(CMD_CTX);
+
+	free(results);
 	image_close(&image);
 
 	return retval;
@@ -546,7 +731,7 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	duration_start(&bench);
 
 	struct flash_bank *p;
-	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	int retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
 	if (ERROR_OK != retval)
 		return retval;
 
@@ -592,6 +777,169 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_read_bank_command)
+{
+	uint32_t offset = 0, length;
+	bool map = false;
+
+	if (CMD_ARGC > 0 && strcmp(CMD_ARGV[0], "mmap") == 0) {
+		map = true;
+		CMD_ARGV++;
+		CMD_ARGC--;
+	}
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct duration bench;
+	duration_start(&bench);
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	if (CMD_ARGC > 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], offset);
+	if (offset > p->size) {
+		LOG_ERROR("offset 0x%8.8" PRIx32 " is beyond the end of the flash bank",
+			offset);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	length = p->size - offset;
+	if (CMD_ARGC > 3) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[3], length);
+		if (length > p->size - offset) {
+			LOG_ERROR("read goes beyond the end of the flash bank");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	retval = flash_dump_memory(p->target, p->base + offset, length,
+			CMD_ARGV[1], map);
+
+	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
+		command_print(CMD_CTX, "read %" PRIu32 " bytes from flash bank %u"
+			" at offset 0x%8.8" PRIx32 " to file %s in %fs (%0.3f KiB/s)",
+			length, p->bank_number, offset, CMD_ARGV[1],
+			duration_elapsed(&bench), duration_kbps(&bench, length));
+	}
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_flash_benchmark_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_lookup_bank, 0, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t first = 0;
+	uint32_t last = p->num_sectors - 1;
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], first);
+	if (CMD_ARGC > 2) {
+		if (strcmp(CMD_ARGV[2], "last") == 0)
+			last = p->num_sectors - 1;
+		else
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], last);
+	} else if (CMD_ARGC > 1)
+		last = first;
+
+	retval = flash_check_sector_parameters(CMD_CTX, first, last, p->num_sectors);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t offset = p->sectors[first].offset;
+	uint32_t size = p->sectors[last].offset + p->sectors[last].size - offset;
+
+	uint8_t *pattern = malloc(size);
+	uint8_t *readback = malloc(size);
+	if (pattern == NULL || readback == NULL) {
+		free(pattern);
+		free(readback);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* xorshift, so every run programs the same data and no two
+	 * sectors hold identical contents */
+	uint32_t seed = 0x2545f491;
+	for (uint32_t i = 0; i < size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		pattern[i] = seed;
+	}
+
+	struct flash_async_stats before, after;
+	flash_async_get_stats(&before);
+
+	struct duration erase, program, read;
+
+	duration_start(&erase);
+	retval = flash_driver_erase(p, first, last);
+	if (retval != ERROR_OK || duration_measure(&erase) != ERROR_OK)
+		goto done;
+
+	duration_start(&program);
+	retval = flash_driver_write(p, pattern, offset, size);
+	if (retval != ERROR_OK || duration_measure(&program) != ERROR_OK)
+		goto done;
+
+	/* measure the target, not the flash cache */
+	flash_cache_invalidate(p, first, last);
+
+	duration_start(&read);
+	retval = flash_driver_read(p, readback, offset, size);
+	if (retval != ERROR_OK || duration_measure(&read) != ERROR_OK)
+		goto done;
+
+	flash_async_get_stats(&after);
+
+	command_print(CMD_CTX, "flash bank %u sectors %" PRIu32 " through %" PRIu32
+			" (%" PRIu32 " bytes):", p->bank_number, first, last, size);
+	command_print(CMD_CTX, "  erase   %fs (%0.3f KiB/s)",
+			duration_elapsed(&erase), duration_kbps(&erase, size));
+	command_print(CMD_CTX, "  program %fs (%0.3f KiB/s)",
+			duration_elapsed(&program), duration_kbps(&program, size));
+	command_print(CMD_CTX, "  read    %fs (%0.3f KiB/s)",
+			duration_elapsed(&read), duration_kbps(&read, size));
+
+	if (after.runs != before.runs) {
+		double seconds = after.seconds - before.seconds;
+		uint64_t bytes = after.bytes - before.bytes;
+		uint64_t link_bytes = after.link_bytes - before.link_bytes;
+		command_print(CMD_CTX, "  streamed %" PRIu64 " bytes in %u loader run(s), "
+				"%fs (%0.3f KiB/s)", bytes, after.runs - before.runs, seconds,
+				seconds > 0 ? bytes / seconds / 1024.0 : 0.0);
+		if (link_bytes != bytes)
+			command_print(CMD_CTX, "  sent %" PRIu64 " bytes after compression", link_bytes);
+	} else if (after.fallbacks != before.fallbacks)
+		command_print(CMD_CTX, "  FIFO loader unavailable, driver fell back");
+
+	for (uint32_t i = 0; i < size; i++) {
+		if (readback[i] != pattern[i]) {
+			LOG_ERROR("verify failed at offset 0x%8.8" PRIx32 ": "
+					"read 0x%2.2x, expected 0x%2.2x",
+					offset + i, readback[i], pattern[i]);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+	}
+
+done:
+	free(pattern);
+	free(readback);
+
+	return retval;
+}
+
 void flash_set_dirty(void)
 {
 	struct flash_bank *c;
@@ -648,6 +996,23 @@ static const struct command_registration flash_exec_command_handlers[] = {
 			"before erasing.",
 
 	},
+	{
+		.name = "gang",
+		.handler = handle_flash_gang_command,
+		.mode = COMMAND_ANY,
+		.usage = "[target_name ...]",
+		.help = "Display or set the targets written by "
+			"flash write_image_gang.",
+	},
+	{
+		.name = "write_image_gang",
+		.handler = handle_flash_write_image_gang_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[erase] [unlock] [verify] filename [offset [file_type]]",
+		.help = "Write an image to the flash of all targets set with "
+			"flash gang, reading the image only once and erasing "
+			"all targets at the same time.",
+	},
 	{
 		.name = "fillw",
 		.handler = handle_flash_fill_command,
@@ -681,15 +1046,38 @@ static const struct command_registration flash_exec_command_handlers[] = {
 			"starting at specified byte offset from the "
 			"beginning of the bank.",
 	},
+	{
+		.name = "read_bank",
+		.handler = handle_flash_read_bank_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['mmap'] bank_id filename [offset [length]]",
+		.help = "Read binary data from flash bank to file, "
+			"starting at specified byte offset from the "
+			"beginning of the bank; the whole rest of the "
+			"bank unless a length is given.",
+	},
 	{
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [incremental] [compress] [verify] filename "
+			"[offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used.  Allow optional "
+			"and/or erase the region to be used, optionally only "
+			"touching sectors whose contents differ, optionally "
+			"compressing the data sent to the target, optionally "
+			"verifying the result by checksum.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
+	{
+		.name = "benchmark",
+		.handler = handle_flash_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [first_sector [last_sector|'last']]",
+		.help = "Erase, program and read back a range of sectors "
+			"with a test pattern and report the throughput of each "
+			"phase.  Destroys the previous contents.",
+	},
 	{
 		.name = "protect",
 		.handler = handle_flash_protect_command,
@@ -766,6 +1154,10 @@ COMMAND_HANDLER(handle_flash_bank_command)
 	COMMAND_PARSE_NUMBER(int, CMD_ARGV[4], c->bus_width);
 	c->num_sectors = 0;
 	c->sectors = NULL;
+	c->erase_pending = false;
+	c->cache = NULL;
+	c->cache_sectors = 0;
+	c->cache_generation = 0;
 	c->next = NULL;
 
 	int retval;
@@ -800,6 +1192,85 @@ COMMAND_HANDLER(handle_flash_banks_command)
 	return ERROR_OK;
 }
 
+static void jim_dict_add(Jim_Interp *interp, Jim_Obj *dict,
+		const char *key, Jim_Obj *value)
+{
+	Jim_ListAppendElement(interp, dict, Jim_NewStringObj(interp, key, -1));
+	Jim_ListAppendElement(interp, dict, value);
+}
+
+static Jim_Obj *jim_new_seconds(Jim_Interp *interp, double seconds)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%f", seconds);
+	return Jim_NewStringObj(interp, buf, -1);
+}
+
+static int jim_flash_stats(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
+{
+	if (argc != 1) {
+		Jim_WrongNumArgs(interp, 1, argv,
+			"no arguments to 'flash stats' command");
+		return JIM_ERR;
+	}
+
+	const struct flash_stats *stats = flash_stats_get();
+	Jim_Obj *dict = Jim_NewListObj(interp, NULL, 0);
+
+	if (stats == NULL) {
+		Jim_SetResult(interp, dict);
+		return JIM_OK;
+	}
+
+	jim_dict_add(interp, dict, "seconds", jim_new_seconds(interp, stats->seconds));
+
+	Jim_Obj *phases = Jim_NewListObj(interp, NULL, 0);
+	for (int i = 0; i < FLASH_PHASES; i++) {
+		const struct flash_phase_stats *phase = &stats->phase[i];
+		Jim_Obj *elem = Jim_NewListObj(interp, NULL, 0);
+
+		jim_dict_add(interp, elem, "seconds", jim_new_seconds(interp, phase->seconds));
+		jim_dict_add(interp, elem, "transfer",
+				jim_new_seconds(interp, phase->target.transfer));
+		jim_dict_add(interp, elem, "target_busy",
+				jim_new_seconds(interp, phase->target.algorithm));
+		jim_dict_add(interp, elem, "working_area",
+				jim_new_seconds(interp, phase->target.working_area));
+		jim_dict_add(interp, elem, "algorithm_runs",
+				Jim_NewIntObj(interp, phase->target.algorithm_runs));
+		jim_dict_add(interp, elem, "bytes_written",
+				Jim_NewIntObj(interp, phase->target.bytes_written));
+		jim_dict_add(interp, elem, "bytes_read",
+				Jim_NewIntObj(interp, phase->target.bytes_read));
+
+		jim_dict_add(interp, phases, flash_phase_name(i), elem);
+	}
+	jim_dict_add(interp, dict, "phases", phases);
+
+	Jim_Obj *sectors = Jim_NewListObj(interp, NULL, 0);
+	for (int i = 0; i < stats->num_sectors; i++) {
+		const struct flash_sector_stats *sector = &stats->sectors[i];
+		Jim_Obj *elem = Jim_NewListObj(interp, NULL, 0);
+
+		jim_dict_add(interp, elem, "bank", Jim_NewIntObj(interp, sector->bank_number));
+		jim_dict_add(interp, elem, "sector", Jim_NewIntObj(interp, sector->sector));
+		jim_dict_add(interp, elem, "erased", Jim_NewIntObj(interp, sector->erased));
+		jim_dict_add(interp, elem, "erase_seconds",
+				jim_new_seconds(interp, sector->erase_seconds));
+		jim_dict_add(interp, elem, "bytes", Jim_NewIntObj(interp, sector->bytes));
+		jim_dict_add(interp, elem, "program_seconds",
+				jim_new_seconds(interp, sector->program_seconds));
+
+		Jim_ListAppendElement(interp, sectors, elem);
+	}
+	jim_dict_add(interp, dict, "sectors", sectors);
+
+	Jim_SetResult(interp, dict);
+
+	return JIM_OK;
+}
+
 static int jim_flash_list(Jim_Interp *interp, int argc, Jim_Obj * const *argv)
 {
 	if (argc != 1) {
@@ -848,6 +1319,50 @@ COMMAND_HANDLER(handle_flash_init_command)
 	return flash_init_drivers(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_flash_cache_command)
+{
+	static const char * const modes[] = { "off", "crc", "content" };
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned i;
+		for (i = 0; i < ARRAY_SIZE(modes); i++) {
+			if (strcmp(CMD_ARGV[0], modes[i]) == 0)
+				break;
+		}
+		if (i == ARRAY_SIZE(modes))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		flash_cache_set_mode(i);
+	}
+
+	command_print(CMD_CTX, "flash cache %s", modes[flash_cache_get_mode()]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_plan_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "flush") == 0)
+			flash_plan_cache_flush();
+		else {
+			bool enable;
+			COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+			flash_plan_cache_set_enabled(enable);
+		}
+	}
+
+	command_print(CMD_CTX, "flash plan cache %s",
+			flash_plan_cache_enabled() ? "on" : "off");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_config_command_handlers[] = {
 	{
 		.name = "bank",
@@ -877,6 +1392,31 @@ static const struct command_registration flash_config_command_handlers[] = {
 		.jim_handler = jim_flash_list,
 		.help = "Returns a list of details about the flash banks.",
 	},
+	{
+		.name = "stats",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_flash_stats,
+		.help = "Returns a dict of where the time of the latest "
+			"flash write went, by phase and by sector.",
+	},
+	{
+		.name = "cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_flash_cache_command,
+		.usage = "['off'|'crc'|'content']",
+		.help = "Display or set what the flash core remembers about "
+			"sectors it wrote or read, to answer verification "
+			"and reads without accessing the target.",
+	},
+	{
+		.name = "plan_cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_flash_plan_cache_command,
+		.usage = "['on'|'off'|'flush']",
+		.help = "Display or set whether flash write_image keeps the "
+			"padded sector data of image files, to program an "
+			"unchanged file again without parsing it.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 static const struct command_registration flash_command_handlers[] = {
@@ -61,6 +61,9 @@ static inline int fileio_open_local(struct fileio_internal *fileio)
 		case FILEIO_APPENDREAD:
 			strcpy(file_access, "a+");
 			break;
+		case FILEIO_UPDATE:
+			strcpy(file_access, "r+");
+			break;
 		default:
 			LOG_ERROR("BUG: access neither read, write nor readwrite");
 			return ERROR_COMMAND_SYNTAX_ERROR;
@@ -43,6 +43,7 @@ enum fileio_access {
 	FILEIO_READWRITE,	/* open for writing, position at beginning, allow reading */
 	FILEIO_APPEND,		/* open for writing, position at end */
 	FILEIO_APPENDREAD,	/* open for writing, position at end, allow reading */
+	FILEIO_UPDATE,		/* open for reading and writing, keep contents, position at beginning */
 };
 
 struct fileio {
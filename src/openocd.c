@@ -327,6 +327,9 @@ int openocd_main(int argc, char *argv[])
 	/* Start the executable meat that can evolve into thread in future. */
 	ret = openocd_thread(argc, argv, cmd_ctx);
 
+	nand_device_free_all();
+	target_quit();
+
 	unregister_all_commands(cmd_ctx, NULL);
 
 	/* free commandline interface */
@@ -65,6 +65,8 @@ struct gdb_connection {
 	int ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	/* vFlashErase requests were deferred to vFlashDone */
+	bool vflash_erase_deferred;
 	int closed;
 	int busy;
 	int noack_mode;
@@ -112,6 +114,9 @@ static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
 
+/* defer vFlashErase and only erase/program sectors whose contents differ */
+static int gdb_flash_incremental;
+
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
  * Disabled by default.
@@ -765,6 +770,7 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->ctrl_c = 0;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	gdb_connection->vflash_erase_deferred = false;
 	gdb_connection->closed = 0;
 	gdb_connection->busy = 0;
 	gdb_connection->noack_mode = 0;
@@ -1211,7 +1217,10 @@ static int gdb_read_memory_packet(struct connection *connection,
 
 	LOG_DEBUG("addr: 0x%8.8" PRIx32 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-	retval = target_read_buffer(target, addr, len, buffer);
+	if (flash_cache_read(target, addr, len, buffer))
+		retval = ERROR_OK;
+	else
+		retval = target_read_buffer(target, addr, len, buffer);
 
 	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
 		/* TODO : Here we have to lie and send back all zero's lest stack traces won't work.
@@ -1976,6 +1985,13 @@ static int gdb_v_packet(struct connection *connection,
 		 * when flash_write is called multiple times */
 		flash_set_dirty();
 
+		/* incremental mode erases what actually changed at vFlashDone */
+		if (gdb_flash_incremental) {
+			gdb_connection->vflash_erase_deferred = true;
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
 		/* perform any target specific operations before the erase */
 		target_call_event_callbacks(gdb_service->target,
 			TARGET_EVENT_GDB_FLASH_ERASE_START);
@@ -2045,7 +2061,14 @@ static int gdb_v_packet(struct connection *connection,
 		 * always issues a vFlashErase first. */
 		target_call_event_callbacks(gdb_service->target,
 				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(gdb_service->target, gdb_connection->vflash_image, &written, 0);
+		if (gdb_flash_incremental)
+			result = flash_write_incremental(gdb_service->target,
+					gdb_connection->vflash_image, &written,
+					gdb_connection->vflash_erase_deferred);
+		else
+			result = flash_write(gdb_service->target,
+					gdb_connection->vflash_image, &written, 0);
+		gdb_connection->vflash_erase_deferred = false;
 		target_call_event_callbacks(gdb_service->target, TARGET_EVENT_GDB_FLASH_WRITE_END);
 		if (result != ERROR_OK) {
 			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
@@ -2465,6 +2488,15 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_flash_incremental_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_incremental);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -2535,6 +2567,14 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_flash_incremental",
+		.handler = handle_gdb_flash_incremental_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable skipping flash sectors "
+			"that already hold the data GDB loads",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
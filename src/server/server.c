@@ -31,6 +31,7 @@
 #include "server.h"
 #include <target/target.h>
 #include <target/target_request.h>
+#include <target/sampler.h>
 #include "openocd.h"
 #include "tcl_server.h"
 #include "telnet_server.h"
@@ -380,8 +381,8 @@ int server_loop(struct command_context *command_context)
 			tv.tv_usec = 0;
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		} else {
-			/* Every 100ms */
-			tv.tv_usec = 100000;
+			/* Every 100ms, or sooner when the next memory sample is due */
+			tv.tv_usec = sampler_idle_timeout_us(100000);
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
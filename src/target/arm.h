@@ -233,6 +233,9 @@ int arm_checksum_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t *checksum);
 int arm_blank_check_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t *blank);
+int arm_blank_check_memory_blocks(struct target *target,
+		uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+		uint32_t erased_word, uint32_t total_size);
 
 void arm_set_cpsr(struct arm *arm, uint32_t cpsr);
 struct reg *arm_reg_current(struct arm *arm, unsigned regnum);
@@ -1370,6 +1370,7 @@ struct target_type arm11_target = {
 
 	.checksum_memory = arm_checksum_memory,
 	.blank_check_memory = arm_blank_check_memory,
+	.blank_check_memory_blocks = arm_blank_check_memory_blocks,
 
 	.add_breakpoint = arm11_add_breakpoint,
 	.remove_breakpoint = arm11_remove_breakpoint,
@@ -768,6 +768,7 @@ struct target_type arm946e_target = {
 
 	.checksum_memory = arm_checksum_memory,
 	.blank_check_memory = arm_blank_check_memory,
+	.blank_check_memory_blocks = arm_blank_check_memory_blocks,
 
 	.run_algorithm = armv4_5_run_algorithm,
 
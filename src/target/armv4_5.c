@@ -547,7 +547,7 @@ static const struct reg_arch_type arm_reg_type = {
 struct reg_cache *arm_build_reg_cache(struct target *target, struct arm *arm)
 {
 	int num_regs = ARRAY_SIZE(arm_core_regs);
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = calloc(num_regs, sizeof(struct reg));
 	struct arm_reg *reg_arch_info = calloc(num_regs, sizeof(struct arm_reg));
 	int i;
@@ -1319,7 +1319,6 @@ int arm_checksum_memory(struct target *target,
 	struct arm *arm = target_to_arm(target);
 	struct reg_param reg_params[2];
 	int retval;
-	uint32_t i;
 	uint32_t exit_var = 0;
 
 	/* see contrib/loaders/checksum/armv4_5_crc.s for src */
@@ -1353,20 +1352,11 @@ int arm_checksum_memory(struct target *target,
 		0x04C11DB7		/* .word 0x04C11DB7 */
 	};
 
-	retval = target_alloc_working_area(target,
-			sizeof(arm_crc_code), &crc_algorithm);
+	retval = target_alloc_algorithm_u32(target, arm_crc_code,
+			ARRAY_SIZE(arm_crc_code), &crc_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* convert code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(arm_crc_code); i++) {
-		retval = target_write_u32(target,
-				crc_algorithm->address + i * sizeof(uint32_t),
-				arm_crc_code[i]);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
 	arm_algo.core_mode = ARM_MODE_SVC;
 	arm_algo.core_state = ARM_STATE_ARM;
@@ -1420,7 +1410,6 @@ int arm_blank_check_memory(struct target *target,
 	struct arm_algorithm arm_algo;
 	struct arm *arm = target_to_arm(target);
 	int retval;
-	uint32_t i;
 	uint32_t exit_var = 0;
 
 	/* see contrib/loaders/erase_check/armv4_5_erase_check.s for src */
@@ -1436,21 +1425,11 @@ int arm_blank_check_memory(struct target *target,
 	};
 
 	/* make sure we have a working area */
-	retval = target_alloc_working_area(target,
-			sizeof(check_code), &check_algorithm);
+	retval = target_alloc_algorithm_u32(target, check_code,
+			ARRAY_SIZE(check_code), &check_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* convert code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(check_code); i++) {
-		retval = target_write_u32(target,
-				check_algorithm->address
-				+ i * sizeof(uint32_t),
-				check_code[i]);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-
 	arm_algo.common_magic = ARM_COMMON_MAGIC;
 	arm_algo.core_mode = ARM_MODE_SVC;
 	arm_algo.core_state = ARM_STATE_ARM;
@@ -1491,6 +1470,91 @@ int arm_blank_check_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/**
+ * Runs ARM code in the target to check a table of memory blocks for
+ * erased words, setting a bit in the bitmap for each block holding
+ * nothing else.
+ */
+int arm_blank_check_memory_blocks(struct target *target,
+	uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+	uint32_t erased_word, uint32_t total_size)
+{
+	struct working_area *check_algorithm;
+	struct reg_param reg_params[4];
+	struct arm_algorithm arm_algo;
+	struct arm *arm = target_to_arm(target);
+	int retval;
+	uint32_t exit_var = 0;
+
+	/* see contrib/loaders/erase_check/armv4_5_erase_check_blocks.s for src */
+
+	static const uint32_t check_code[] = {
+		0xe3a07001,		/* mov r7, #1                */
+		/* check_block: */
+		0xe8b00030,		/* ldmia r0!, {r4, r5}       */
+		/* loop: */
+		0xe3550000,		/* cmp r5, #0                */
+		0x0a000004,		/* beq blank                 */
+		0xe4946004,		/* ldr r6, [r4], #4          */
+		0xe2455004,		/* sub r5, r5, #4            */
+		0xe1560003,		/* cmp r6, r3                */
+		0x0afffff9,		/* beq loop                  */
+		0xea000002,		/* b next                    */
+		/* blank: */
+		0xe5926000,		/* ldr r6, [r2]              */
+		0xe1866007,		/* orr r6, r6, r7            */
+		0xe5826000,		/* str r6, [r2]              */
+		/* next: */
+		0xe1b07087,		/* movs r7, r7, lsl #1       */
+		0x02822004,		/* addeq r2, r2, #4          */
+		0x03a07001,		/* moveq r7, #1              */
+		0xe2511001,		/* subs r1, r1, #1           */
+		0x1affffef,		/* bne check_block           */
+		/* end: */
+		0xe1200070,		/* bkpt #0 */
+	};
+
+	/* make sure we have a working area */
+	retval = target_alloc_algorithm_u32(target, check_code,
+			ARRAY_SIZE(check_code), &check_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	arm_algo.common_magic = ARM_COMMON_MAGIC;
+	arm_algo.core_mode = ARM_MODE_SVC;
+	arm_algo.core_state = ARM_STATE_ARM;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, table);
+
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	buf_set_u32(reg_params[1].value, 0, 32, num_blocks);
+
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
+	buf_set_u32(reg_params[2].value, 0, 32, bitmap);
+
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
+	buf_set_u32(reg_params[3].value, 0, 32, erased_word);
+
+	/* armv4 must exit using a hardware breakpoint */
+	if (arm->is_armv4)
+		exit_var = check_algorithm->address + sizeof(check_code) - 4;
+
+	retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
+			check_algorithm->address,
+			exit_var,
+			10000 + total_size / 1024, &arm_algo);
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+	destroy_reg_param(&reg_params[3]);
+
+	target_free_working_area(target, check_algorithm);
+
+	return retval;
+}
+
 static int arm_full_context(struct target *target)
 {
 	struct arm *arm = target_to_arm(target);
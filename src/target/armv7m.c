@@ -136,12 +136,26 @@ int armv7m_restore_context(struct target *target)
 	int i;
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	struct reg_cache *cache = armv7m->arm.core_cache;
+	uint32_t dirty[REG_BITMAP_WORDS(ARMV7M_NUM_REGS)];
 
 	LOG_DEBUG(" ");
 
 	if (armv7m->pre_restore_context)
 		armv7m->pre_restore_context(target);
 
+	if (armv7m->store_core_regs && register_cache_dirty_bitmap(cache, dirty)) {
+		if (armv7m->store_core_regs(target, dirty) == ERROR_OK) {
+			for (i = 0; i < (int)cache->num_regs; i++) {
+				if (dirty[i / 32] & (1u << (i % 32))) {
+					cache->reg_list[i].valid = 1;
+					cache->reg_list[i].dirty = 0;
+				}
+			}
+			return ERROR_OK;
+		}
+		LOG_DEBUG("bulk register write-back failed, writing one at a time");
+	}
+
 	for (i = ARMV7M_NUM_REGS - 1; i >= 0; i--) {
 		if (cache->reg_list[i].dirty) {
 			uint32_t value = buf_get_u32(cache->reg_list[i].value, 0, 32);
@@ -547,7 +561,7 @@ struct reg_cache *armv7m_build_reg_cache(struct target *target)
 	struct arm *arm = &armv7m->arm;
 	int num_regs = ARMV7M_NUM_REGS;
 	struct reg_cache **cache_p = register_get_last_cache_p(&target->reg_cache);
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = calloc(num_regs, sizeof(struct reg));
 	struct arm_reg *arch_info = calloc(num_regs, sizeof(struct arm_reg));
 	int i;
@@ -652,15 +666,11 @@ int armv7m_checksum_memory(struct target *target,
 		0xB7, 0x1D, 0xC1, 0x04	/* CRC32XOR:	.word	0x04c11db7 */
 	};
 
-	retval = target_alloc_working_area(target, sizeof(cortex_m3_crc_code), &crc_algorithm);
+	retval = target_alloc_algorithm(target, cortex_m3_crc_code,
+			sizeof(cortex_m3_crc_code), &crc_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = target_write_buffer(target, crc_algorithm->address,
-			sizeof(cortex_m3_crc_code), (uint8_t *)cortex_m3_crc_code);
-	if (retval != ERROR_OK)
-		goto cleanup;
-
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
@@ -684,7 +694,6 @@ int armv7m_checksum_memory(struct target *target,
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 
-cleanup:
 	target_free_working_area(target, crc_algorithm);
 
 	return retval;
@@ -712,12 +721,8 @@ int armv7m_blank_check_memory(struct target *target,
 	};
 
 	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(erase_check_code),
-		&erase_check_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
-	retval = target_write_buffer(target, erase_check_algorithm->address,
-			sizeof(erase_check_code), (uint8_t *)erase_check_code);
+	retval = target_alloc_algorithm(target, erase_check_code,
+			sizeof(erase_check_code), &erase_check_algorithm);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -755,6 +760,88 @@ int armv7m_blank_check_memory(struct target *target,
 	return retval;
 }
 
+/** Checks a table of memory blocks for erased words, setting a bit
+ * in the bitmap for each block holding nothing else. */
+int armv7m_blank_check_memory_blocks(struct target *target,
+	uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+	uint32_t erased_word, uint32_t total_size)
+{
+	struct working_area *erase_check_algorithm;
+	struct reg_param reg_params[4];
+	struct armv7m_algorithm armv7m_info;
+	int retval;
+
+	/* see contrib/loaders/erase_check/armv7m_erase_check_blocks.s for src */
+
+	static const uint8_t erase_check_code[] = {
+		0x01, 0x27,		/* movs	r7, #1 */
+		/* check_block: */
+		0x30, 0xc8,		/* ldmia	r0!, {r4, r5} */
+		/* loop: */
+		0x00, 0x2d,		/* cmp	r5, #0 */
+		0x04, 0xd0,		/* beq	blank */
+		0x40, 0xcc,		/* ldmia	r4!, {r6} */
+		0x04, 0x3d,		/* subs	r5, #4 */
+		0x9e, 0x42,		/* cmp	r6, r3 */
+		0xf9, 0xd0,		/* beq	loop */
+		0x02, 0xe0,		/* b	next */
+		/* blank: */
+		0x16, 0x68,		/* ldr	r6, [r2] */
+		0x3e, 0x43,		/* orrs	r6, r7 */
+		0x16, 0x60,		/* str	r6, [r2] */
+		/* next: */
+		0x7f, 0x00,		/* lsls	r7, r7, #1 */
+		0x01, 0xd1,		/* bne	no_wrap */
+		0x04, 0x32,		/* adds	r2, #4 */
+		0x01, 0x27,		/* movs	r7, #1 */
+		/* no_wrap: */
+		0x01, 0x39,		/* subs	r1, #1 */
+		0xee, 0xd1,		/* bne	check_block */
+		0x00, 0xbe		/* bkpt	#0 */
+	};
+
+	/* make sure we have a working area */
+	retval = target_alloc_algorithm(target, erase_check_code,
+			sizeof(erase_check_code), &erase_check_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
+	armv7m_info.core_mode = ARM_MODE_THREAD;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, table);
+
+	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);
+	buf_set_u32(reg_params[1].value, 0, 32, num_blocks);
+
+	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);
+	buf_set_u32(reg_params[2].value, 0, 32, bitmap);
+
+	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);
+	buf_set_u32(reg_params[3].value, 0, 32, erased_word);
+
+	/* a few cycles per word; allow 1ms per KiB on top of the usual */
+	retval = target_run_algorithm(target,
+			0,
+			NULL,
+			4,
+			reg_params,
+			erase_check_algorithm->address,
+			erase_check_algorithm->address + (sizeof(erase_check_code) - 2),
+			10000 + total_size / 1024,
+			&armv7m_info);
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+	destroy_reg_param(&reg_params[3]);
+
+	target_free_working_area(target, erase_check_algorithm);
+
+	return retval;
+}
+
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
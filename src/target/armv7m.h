@@ -163,6 +163,9 @@ struct armv7m_common {
 	/* Direct processor core register read and writes */
 	int (*load_core_reg_u32)(struct target *target, uint32_t num, uint32_t *value);
 	int (*store_core_reg_u32)(struct target *target, uint32_t num, uint32_t value);
+	/* Optional: write back every core register flagged in the @a dirty
+	 * bitmap (indices into the core cache) as one batch */
+	int (*store_core_regs)(struct target *target, const uint32_t *dirty);
 
 	int (*examine_debug_reason)(struct target *target);
 	int (*post_debug_entry)(struct target *target);
@@ -225,6 +228,9 @@ int armv7m_checksum_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t *checksum);
 int armv7m_blank_check_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t *blank);
+int armv7m_blank_check_memory_blocks(struct target *target,
+		uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+		uint32_t erased_word, uint32_t total_size);
 
 int armv7m_maybe_skip_bkpt_inst(struct target *target, bool *inst_found);
 
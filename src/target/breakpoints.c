@@ -43,44 +43,187 @@ static char *watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+#define BPWP_HASH_BITS	8
+#define BPWP_HASH_SIZE	(1 << BPWP_HASH_BITS)
+
+/*
+ * Address index over target->breakpoints and target->watchpoints.  The
+ * lists keep insertion order for display and for the targets that walk
+ * them to (re)install everything; the buckets make lookups by address
+ * independent of how many points are installed.  Entries sharing an
+ * address stay in insertion order within their bucket, so lookups return
+ * the same entry a list walk would.
+ */
+struct bpwp_hash {
+	struct breakpoint *bp[BPWP_HASH_SIZE];
+	struct watchpoint *wp[BPWP_HASH_SIZE];
+	struct breakpoint **bp_tail;
+	struct watchpoint **wp_tail;
+};
+
+static inline unsigned bpwp_hash_slot(uint32_t address)
+{
+	/* drop bit 0, nothing is installed at odd addresses */
+	return ((address >> 1) * 2654435761u) >> (32 - BPWP_HASH_BITS);
+}
+
+static struct bpwp_hash *bpwp_hash_get(struct target *target)
+{
+	struct bpwp_hash *hash = target->bpwp_hash;
+
+	if (hash)
+		return hash;
+
+	hash = calloc(1, sizeof(struct bpwp_hash));
+	if (hash == NULL) {
+		LOG_ERROR("out of memory");
+		return NULL;
+	}
+	hash->bp_tail = &target->breakpoints;
+	hash->wp_tail = &target->watchpoints;
+	target->bpwp_hash = hash;
+
+	return hash;
+}
+
+static struct breakpoint *breakpoint_alloc(struct target *target, uint32_t address,
+	uint32_t asid, uint32_t length, enum breakpoint_type type)
+{
+	struct bpwp_hash *hash = bpwp_hash_get(target);
+	struct breakpoint *breakpoint, **slot;
+
+	if (hash == NULL)
+		return NULL;
+
+	breakpoint = malloc(sizeof(struct breakpoint));
+	if (breakpoint == NULL)
+		return NULL;
+	breakpoint->orig_instr = malloc(length);
+	if (breakpoint->orig_instr == NULL) {
+		free(breakpoint);
+		return NULL;
+	}
+	breakpoint->address = address;
+	breakpoint->asid = asid;
+	breakpoint->length = length;
+	breakpoint->type = type;
+	breakpoint->set = 0;
+	breakpoint->next = NULL;
+	breakpoint->hash_next = NULL;
+	breakpoint->unique_id = bpwp_unique_id++;
+
+	breakpoint->prev_next = hash->bp_tail;
+	*hash->bp_tail = breakpoint;
+	hash->bp_tail = &breakpoint->next;
+
+	slot = &hash->bp[bpwp_hash_slot(address)];
+	while (*slot)
+		slot = &(*slot)->hash_next;
+	*slot = breakpoint;
+
+	return breakpoint;
+}
+
+static void breakpoint_unlink(struct target *target, struct breakpoint *breakpoint)
+{
+	struct bpwp_hash *hash = target->bpwp_hash;
+	struct breakpoint **p;
+
+	/* only the bucket is walked, the list has a link back */
+	for (p = &hash->bp[bpwp_hash_slot(breakpoint->address)]; *p; p = &(*p)->hash_next) {
+		if (*p == breakpoint) {
+			*p = breakpoint->hash_next;
+			break;
+		}
+	}
+
+	*breakpoint->prev_next = breakpoint->next;
+	if (breakpoint->next)
+		breakpoint->next->prev_next = breakpoint->prev_next;
+	else
+		hash->bp_tail = breakpoint->prev_next;
+}
+
+static void watchpoint_unlink(struct target *target, struct watchpoint *watchpoint)
+{
+	struct bpwp_hash *hash = target->bpwp_hash;
+	struct watchpoint **p;
+
+	/* only the bucket is walked, the list has a link back */
+	for (p = &hash->wp[bpwp_hash_slot(watchpoint->address)]; *p; p = &(*p)->hash_next) {
+		if (*p == watchpoint) {
+			*p = watchpoint->hash_next;
+			break;
+		}
+	}
+
+	*watchpoint->prev_next = watchpoint->next;
+	if (watchpoint->next)
+		watchpoint->next->prev_next = watchpoint->prev_next;
+	else
+		hash->wp_tail = watchpoint->prev_next;
+}
+
+/* first breakpoint installed at @a address, whatever its asid */
+struct breakpoint *breakpoint_find(struct target *target, uint32_t address)
+{
+	struct breakpoint *breakpoint;
+
+	if (target->bpwp_hash == NULL)
+		return NULL;
+
+	breakpoint = target->bpwp_hash->bp[bpwp_hash_slot(address)];
+	while (breakpoint) {
+		if (breakpoint->address == address)
+			return breakpoint;
+		breakpoint = breakpoint->hash_next;
+	}
+
+	return NULL;
+}
+
+static struct watchpoint *watchpoint_find(struct target *target, uint32_t address)
+{
+	struct watchpoint *watchpoint;
+
+	if (target->bpwp_hash == NULL)
+		return NULL;
+
+	watchpoint = target->bpwp_hash->wp[bpwp_hash_slot(address)];
+	while (watchpoint) {
+		if (watchpoint->address == address)
+			return watchpoint;
+		watchpoint = watchpoint->hash_next;
+	}
+
+	return NULL;
+}
+
 int breakpoint_add_internal(struct target *target,
 	uint32_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint;
 	char *reason;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_DEBUG("Duplicate Breakpoint address: 0x%08" PRIx32 " (BP %d)",
-				address, breakpoint->unique_id);
-			return ERROR_OK;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	breakpoint = breakpoint_find(target, address);
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_DEBUG("Duplicate Breakpoint address: 0x%08" PRIx32 " (BP %d)",
+			address, breakpoint->unique_id);
+		return ERROR_OK;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = 0;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-
-	retval = target_add_breakpoint(target, *breakpoint_p);
+	breakpoint = breakpoint_alloc(target, address, 0, length, type);
+	if (breakpoint == NULL)
+		return ERROR_FAIL;
+
+	retval = target_add_breakpoint(target, breakpoint);
 	switch (retval) {
 		case ERROR_OK:
 			break;
@@ -94,16 +237,16 @@ int breakpoint_add_internal(struct target *target,
 			reason = "unknown reason";
 fail:
 			LOG_ERROR("can't add breakpoint: %s", reason);
-			free((*breakpoint_p)->orig_instr);
-			free(*breakpoint_p);
-			*breakpoint_p = NULL;
+			breakpoint_unlink(target, breakpoint);
+			free(breakpoint->orig_instr);
+			free(breakpoint);
 			return retval;
 	}
 
 	LOG_DEBUG("added %s breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %d)",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -113,14 +256,11 @@ int context_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
+	/* the asid of any kind of breakpoint counts, so this walks the list */
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
 		if (breakpoint->asid == asid) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
@@ -130,32 +270,25 @@ int context_breakpoint_add_internal(struct target *target,
 				asid, breakpoint->unique_id);
 			return -1;
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = 0;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-	retval = target_add_context_breakpoint(target, *breakpoint_p);
+	breakpoint = breakpoint_alloc(target, 0, asid, length, type);
+	if (breakpoint == NULL)
+		return ERROR_FAIL;
+
+	retval = target_add_context_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_unlink(target, breakpoint);
+		free(breakpoint->orig_instr);
+		free(breakpoint);
 		return retval;
 	}
 
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %d)",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->asid, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->asid, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -166,13 +299,11 @@ int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint;
 	int retval;
-	int n;
-	n = 0;
+
+	breakpoint = breakpoint_find(target, address);
 	while (breakpoint) {
-		n++;
 		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
@@ -187,34 +318,27 @@ int hybrid_breakpoint_add_internal(struct target *target,
 			return -1;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->hash_next;
 	}
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->set = 0;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-
-
-	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
+
+	breakpoint = breakpoint_alloc(target, address, asid, length, type);
+	if (breakpoint == NULL)
+		return ERROR_FAIL;
+
+	retval = target_add_hybrid_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_unlink(target, breakpoint);
+		free(breakpoint->orig_instr);
+		free(breakpoint);
 		return retval;
 	}
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %d)",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address,
-		(*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address,
+		breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -288,42 +412,28 @@ int hybrid_breakpoint_add(struct target *target,
 }
 
 /* free up a breakpoint */
-static void breakpoint_free(struct target *target, struct breakpoint *breakpoint_to_remove)
+static void breakpoint_free(struct target *target, struct breakpoint *breakpoint)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint == breakpoint_to_remove)
-			break;
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
-	}
-
-	if (breakpoint == NULL)
-		return;
-
 	retval = target_remove_breakpoint(target, breakpoint);
 
 	LOG_DEBUG("free BPID: %d --> %d", breakpoint->unique_id, retval);
-	(*breakpoint_p) = breakpoint->next;
+	breakpoint_unlink(target, breakpoint);
 	free(breakpoint->orig_instr);
 	free(breakpoint);
 }
 
 int breakpoint_remove_internal(struct target *target, uint32_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-
-	while (breakpoint) {
-		if ((breakpoint->address == address) && (breakpoint->asid == 0))
-			break;
-		else if ((breakpoint->address == 0) && (breakpoint->asid == address))
-			break;
-		else if ((breakpoint->address == address) && (breakpoint->asid != 0))
-			break;
-		breakpoint = breakpoint->next;
+	struct breakpoint *breakpoint;
+
+	/* plain and hybrid breakpoints by address, else a context breakpoint by asid */
+	breakpoint = breakpoint_find(target, address);
+	if (breakpoint == NULL) {
+		breakpoint = breakpoint_find(target, 0);
+		while (breakpoint && !((breakpoint->address == 0) && (breakpoint->asid == address)))
+			breakpoint = breakpoint->hash_next;
 	}
 
 	if (breakpoint) {
@@ -377,55 +487,53 @@ void breakpoint_clear_target(struct target *target)
 
 }
 
-struct breakpoint *breakpoint_find(struct target *target, uint32_t address)
-{
-	struct breakpoint *breakpoint = target->breakpoints;
-
-	while (breakpoint) {
-		if (breakpoint->address == address)
-			return breakpoint;
-		breakpoint = breakpoint->next;
-	}
-
-	return NULL;
-}
-
 int watchpoint_add(struct target *target, uint32_t address, uint32_t length,
 	enum watchpoint_rw rw, uint32_t value, uint32_t mask)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-	struct watchpoint **watchpoint_p = &target->watchpoints;
+	struct bpwp_hash *hash;
+	struct watchpoint *watchpoint, **slot;
 	int retval;
 	char *reason;
 
-	while (watchpoint) {
-		if (watchpoint->address == address) {
-			if (watchpoint->length != length
-				|| watchpoint->value != value
-				|| watchpoint->mask != mask
-				|| watchpoint->rw != rw) {
-				LOG_ERROR("address 0x%8.8" PRIx32
-					"already has watchpoint %d",
-					address, watchpoint->unique_id);
-				return ERROR_FAIL;
-			}
-
-			/* ignore duplicate watchpoint */
-			return ERROR_OK;
+	watchpoint = watchpoint_find(target, address);
+	if (watchpoint) {
+		if (watchpoint->length != length
+			|| watchpoint->value != value
+			|| watchpoint->mask != mask
+			|| watchpoint->rw != rw) {
+			LOG_ERROR("address 0x%8.8" PRIx32
+				"already has watchpoint %d",
+				address, watchpoint->unique_id);
+			return ERROR_FAIL;
 		}
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
+
+		/* ignore duplicate watchpoint */
+		return ERROR_OK;
 	}
 
-	(*watchpoint_p) = calloc(1, sizeof(struct watchpoint));
-	(*watchpoint_p)->address = address;
-	(*watchpoint_p)->length = length;
-	(*watchpoint_p)->value = value;
-	(*watchpoint_p)->mask = mask;
-	(*watchpoint_p)->rw = rw;
-	(*watchpoint_p)->unique_id = bpwp_unique_id++;
+	hash = bpwp_hash_get(target);
+	if (hash == NULL)
+		return ERROR_FAIL;
 
-	retval = target_add_watchpoint(target, *watchpoint_p);
+	watchpoint = calloc(1, sizeof(struct watchpoint));
+	if (watchpoint == NULL)
+		return ERROR_FAIL;
+	watchpoint->address = address;
+	watchpoint->length = length;
+	watchpoint->value = value;
+	watchpoint->mask = mask;
+	watchpoint->rw = rw;
+	watchpoint->unique_id = bpwp_unique_id++;
+
+	watchpoint->prev_next = hash->wp_tail;
+	*hash->wp_tail = watchpoint;
+	hash->wp_tail = &watchpoint->next;
+	slot = &hash->wp[bpwp_hash_slot(address)];
+	while (*slot)
+		slot = &(*slot)->hash_next;
+	*slot = watchpoint;
+
+	retval = target_add_watchpoint(target, watchpoint);
 	switch (retval) {
 		case ERROR_OK:
 			break;
@@ -439,53 +547,36 @@ int watchpoint_add(struct target *target, uint32_t address, uint32_t length,
 			reason = "unrecognized error";
 bye:
 			LOG_ERROR("can't add %s watchpoint at 0x%8.8" PRIx32 ", %s",
-				watchpoint_rw_strings[(*watchpoint_p)->rw],
+				watchpoint_rw_strings[watchpoint->rw],
 				address, reason);
-			free(*watchpoint_p);
-			*watchpoint_p = NULL;
+			watchpoint_unlink(target, watchpoint);
+			free(watchpoint);
 			return retval;
 	}
 
 	LOG_DEBUG("added %s watchpoint at 0x%8.8" PRIx32
 		" of length 0x%8.8" PRIx32 " (WPID: %d)",
-		watchpoint_rw_strings[(*watchpoint_p)->rw],
-		(*watchpoint_p)->address,
-		(*watchpoint_p)->length,
-		(*watchpoint_p)->unique_id);
+		watchpoint_rw_strings[watchpoint->rw],
+		watchpoint->address,
+		watchpoint->length,
+		watchpoint->unique_id);
 
 	return ERROR_OK;
 }
 
-static void watchpoint_free(struct target *target, struct watchpoint *watchpoint_to_remove)
+static void watchpoint_free(struct target *target, struct watchpoint *watchpoint)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-	struct watchpoint **watchpoint_p = &target->watchpoints;
 	int retval;
 
-	while (watchpoint) {
-		if (watchpoint == watchpoint_to_remove)
-			break;
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
-	}
-
-	if (watchpoint == NULL)
-		return;
 	retval = target_remove_watchpoint(target, watchpoint);
 	LOG_DEBUG("free WPID: %d --> %d", watchpoint->unique_id, retval);
-	(*watchpoint_p) = watchpoint->next;
+	watchpoint_unlink(target, watchpoint);
 	free(watchpoint);
 }
 
 void watchpoint_remove(struct target *target, uint32_t address)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-
-	while (watchpoint) {
-		if (watchpoint->address == address)
-			break;
-		watchpoint = watchpoint->next;
-	}
+	struct watchpoint *watchpoint = watchpoint_find(target, address);
 
 	if (watchpoint)
 		watchpoint_free(target, watchpoint);
@@ -500,3 +591,24 @@ void watchpoint_clear_target(struct target *target)
 	while (target->watchpoints != NULL)
 		watchpoint_free(target, target->watchpoints);
 }
+
+void breakpoint_watchpoint_free_all(struct target *target)
+{
+	while (target->breakpoints != NULL) {
+		struct breakpoint *breakpoint = target->breakpoints;
+
+		target->breakpoints = breakpoint->next;
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+	}
+
+	while (target->watchpoints != NULL) {
+		struct watchpoint *watchpoint = target->watchpoints;
+
+		target->watchpoints = watchpoint->next;
+		free(watchpoint);
+	}
+
+	free(target->bpwp_hash);
+	target->bpwp_hash = NULL;
+}
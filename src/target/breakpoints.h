@@ -40,6 +40,8 @@ struct breakpoint {
 	int set;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	struct breakpoint **prev_next;	/* the link to this one in the list */
+	struct breakpoint *hash_next;	/* next in the same address bucket */
 	uint32_t unique_id;
 	int linked_BRP;
 };
@@ -52,6 +54,8 @@ struct watchpoint {
 	enum watchpoint_rw rw;
 	int set;
 	struct watchpoint *next;
+	struct watchpoint **prev_next;	/* the link to this one in the list */
+	struct watchpoint *hash_next;	/* next in the same address bucket */
 	int unique_id;
 };
 
@@ -72,4 +76,7 @@ int watchpoint_add(struct target *target,
 		enum watchpoint_rw rw, uint32_t value, uint32_t mask);
 void watchpoint_remove(struct target *target, uint32_t address);
 
+/* frees all points and their index, leaving the target alone */
+void breakpoint_watchpoint_free_all(struct target *target);
+
 #endif /* BREAKPOINTS_H */
@@ -151,6 +151,13 @@ static int cortex_m3_write_debug_halt_mask(struct target *target,
 	struct cortex_m3_common *cortex_m3 = target_to_cm3(target);
 	struct adiv5_dap *swjdp = cortex_m3->armv7m.arm.dap;
 
+	/* the core is about to execute, bring FPB/DWT up to date first */
+	if ((mask_off & C_HALT) || (mask_on & C_STEP)) {
+		int retval = cortex_m3_commit_comparators(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	/* mask off status bits */
 	cortex_m3->dcb_dhcsr &= ~((0xFFFF << 16) | mask_off);
 	/* create new register mask */
@@ -166,7 +173,9 @@ static int cortex_m3_clear_halt(struct target *target)
 	int retval;
 
 	/* clear step if any */
-	cortex_m3_write_debug_halt_mask(target, C_HALT, C_STEP);
+	retval = cortex_m3_write_debug_halt_mask(target, C_HALT, C_STEP);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* Read Debug Fault Status Register */
 	retval = mem_ap_read_atomic_u32(swjdp, NVIC_DFSR, &cortex_m3->nvic_dfsr);
@@ -189,6 +198,10 @@ static int cortex_m3_single_step_core(struct target *target)
 	uint32_t dhcsr_save;
 	int retval;
 
+	retval = cortex_m3_commit_comparators(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* backup dhcsr reg */
 	dhcsr_save = cortex_m3->dcb_dhcsr;
 
@@ -248,7 +261,9 @@ static int cortex_m3_endreset_event(struct target *target)
 	}
 
 	/* clear any interrupt masking */
-	cortex_m3_write_debug_halt_mask(target, 0, C_MASKINTS);
+	retval = cortex_m3_write_debug_halt_mask(target, 0, C_MASKINTS);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* Enable features controlled by ITM and DWT blocks, and catch only
 	 * the vectors we were told to pay attention to.
@@ -266,35 +281,20 @@ static int cortex_m3_endreset_event(struct target *target)
 	 */
 
 	/* Enable FPB */
-	retval = target_write_u32(target, FP_CTRL, 3);
+	retval = mem_ap_write_u32(swjdp, FP_CTRL, 3);
 	if (retval != ERROR_OK)
 		return retval;
 
 	cortex_m3->fpb_enabled = 1;
 
-	/* Restore FPB registers */
-	for (i = 0; i < cortex_m3->fp_num_code + cortex_m3->fp_num_lit; i++) {
-		retval = target_write_u32(target, fp_list[i].fpcr_address, fp_list[i].fpcr_value);
-		if (retval != ERROR_OK)
-			return retval;
-	}
+	/* Restore FPB and DWT registers from their shadow */
+	for (i = 0; i < cortex_m3->fp_num_code + cortex_m3->fp_num_lit; i++)
+		fp_list[i].dirty = true;
+	for (i = 0; i < cortex_m3->dwt_num_comp; i++)
+		dwt_list[i].dirty = true;
+	cortex_m3->comparators_dirty = true;
 
-	/* Restore DWT registers */
-	for (i = 0; i < cortex_m3->dwt_num_comp; i++) {
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 0,
-				dwt_list[i].comp);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 4,
-				dwt_list[i].mask);
-		if (retval != ERROR_OK)
-			return retval;
-		retval = target_write_u32(target, dwt_list[i].dwt_comparator_address + 8,
-				dwt_list[i].function);
-		if (retval != ERROR_OK)
-			return retval;
-	}
-	retval = dap_run(swjdp);
+	retval = cortex_m3_commit_comparators(target);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -512,7 +512,9 @@ static int cortex_m3_poll(struct target *target)
 	if (cortex_m3->dcb_dhcsr & S_LOCKUP) {
 		LOG_ERROR("%s -- clearing lockup after double fault",
 			target_name(target));
-		cortex_m3_write_debug_halt_mask(target, C_HALT, 0);
+		retval = cortex_m3_write_debug_halt_mask(target, C_HALT, 0);
+		if (retval != ERROR_OK)
+			return retval;
 		target->debug_reason = DBG_REASON_DBGRQ;
 
 		/* We have to execute the rest (the "finally" equivalent, but
@@ -592,6 +594,8 @@ static int cortex_m3_poll(struct target *target)
 
 static int cortex_m3_halt(struct target *target)
 {
+	int retval;
+
 	LOG_DEBUG("target->state: %s",
 		target_state_name(target));
 
@@ -618,7 +622,9 @@ static int cortex_m3_halt(struct target *target)
 	}
 
 	/* Write to Debug Halting Control and Status Register */
-	cortex_m3_write_debug_halt_mask(target, C_HALT, 0);
+	retval = cortex_m3_write_debug_halt_mask(target, C_HALT, 0);
+	if (retval != ERROR_OK)
+		return retval;
 
 	target->debug_reason = DBG_REASON_DBGRQ;
 
@@ -695,6 +701,7 @@ static int cortex_m3_resume(struct target *target, int current,
 	struct breakpoint *breakpoint = NULL;
 	uint32_t resume_pc;
 	struct reg *r;
+	int retval;
 
 	if (target->state != TARGET_HALTED) {
 		LOG_WARNING("target not halted");
@@ -767,7 +774,9 @@ static int cortex_m3_resume(struct target *target, int current,
 	}
 
 	/* Restart core */
-	cortex_m3_write_debug_halt_mask(target, 0, C_HALT);
+	retval = cortex_m3_write_debug_halt_mask(target, 0, C_HALT);
+	if (retval != ERROR_OK)
+		return retval;
 
 	target->debug_reason = DBG_REASON_NOTHALTED;
 
@@ -831,9 +840,11 @@ static int cortex_m3_step(struct target *target, int current,
 	 * instruction - as such simulate a step */
 	if (bkpt_inst_found == false) {
 		/* Automatic ISR masking mode off: Just step over the next instruction */
-		if ((cortex_m3->isrmasking_mode != CORTEX_M3_ISRMASK_AUTO))
-			cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
-		else {
+		if ((cortex_m3->isrmasking_mode != CORTEX_M3_ISRMASK_AUTO)) {
+			retval = cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
+			if (retval != ERROR_OK)
+				return retval;
+		} else {
 			/* Process interrupts during stepping in a way they don't interfere
 			 * debugging.
 			 *
@@ -870,10 +881,14 @@ static int cortex_m3_step(struct target *target, int current,
 			 */
 			if ((pc_value & 0x02) && breakpoint_find(target, pc_value & ~0x03)) {
 				LOG_DEBUG("Stepping over next instruction with interrupts disabled");
-				cortex_m3_write_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
-				cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
+				retval = cortex_m3_write_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
+				if (retval == ERROR_OK)
+					retval = cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
 				/* Re-enable interrupts */
-				cortex_m3_write_debug_halt_mask(target, C_HALT, C_MASKINTS);
+				if (retval == ERROR_OK)
+					retval = cortex_m3_write_debug_halt_mask(target, C_HALT, C_MASKINTS);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 			else {
 
@@ -885,13 +900,17 @@ static int cortex_m3_step(struct target *target, int current,
 				bool tmp_bp_set = (retval == ERROR_OK);
 
 				/* No more breakpoints left, just do a step */
-				if (!tmp_bp_set)
-					cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
-				else {
+				if (!tmp_bp_set) {
+					retval = cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
+					if (retval != ERROR_OK)
+						return retval;
+				} else {
 					/* Start the core */
 					LOG_DEBUG("Starting core to serve pending interrupts");
 					int64_t t_start = timeval_ms();
-					cortex_m3_write_debug_halt_mask(target, 0, C_HALT | C_STEP);
+					retval = cortex_m3_write_debug_halt_mask(target, 0, C_HALT | C_STEP);
+					if (retval != ERROR_OK)
+						return retval;
 
 					/* Wait for pending handlers to complete or timeout */
 					do {
@@ -918,12 +937,18 @@ static int cortex_m3_step(struct target *target, int current,
 							"leaving target running");
 					} else {
 						/* Step over next instruction with interrupts disabled */
-						cortex_m3_write_debug_halt_mask(target,
-							C_HALT | C_MASKINTS,
-							0);
-						cortex_m3_write_debug_halt_mask(target, C_STEP, C_HALT);
+						retval = cortex_m3_write_debug_halt_mask(target,
+								C_HALT | C_MASKINTS,
+								0);
+						if (retval == ERROR_OK)
+							retval = cortex_m3_write_debug_halt_mask(target,
+									C_STEP, C_HALT);
 						/* Re-enable interrupts */
-						cortex_m3_write_debug_halt_mask(target, C_HALT, C_MASKINTS);
+						if (retval == ERROR_OK)
+							retval = cortex_m3_write_debug_halt_mask(target,
+									C_HALT, C_MASKINTS);
+						if (retval != ERROR_OK)
+							return retval;
 					}
 				}
 			}
@@ -1030,7 +1055,9 @@ static int cortex_m3_assert_reset(struct target *target)
 		cortex_m3_clear_halt(target);
 
 		/* clear C_HALT in dhcsr reg */
-		cortex_m3_write_debug_halt_mask(target, 0, C_HALT);
+		retval = cortex_m3_write_debug_halt_mask(target, 0, C_HALT);
+		if (retval != ERROR_OK)
+			return retval;
 	} else {
 		/* Halt in debug on reset; endreset_event() restores DEMCR.
 		 *
@@ -1105,6 +1132,98 @@ static int cortex_m3_deassert_reset(struct target *target)
 	return ERROR_OK;
 }
 
+static void cortex_m3_fp_comparator_update(struct target *target,
+	struct cortex_m3_fp_comparator *comparator, uint32_t fpcr_value)
+{
+	struct cortex_m3_common *cortex_m3 = target_to_cm3(target);
+
+	/* e.g. stepping over a breakpoint unsets and sets it again */
+	if (comparator->fpcr_value == fpcr_value)
+		return;
+
+	comparator->fpcr_value = fpcr_value;
+	comparator->dirty = true;
+	cortex_m3->comparators_dirty = true;
+}
+
+static int cortex_m3_queue_write_u32(struct target *target,
+	uint32_t address, uint32_t value)
+{
+	struct adiv5_dap *swjdp = target_to_cm3(target)->armv7m.arm.dap;
+
+	/* debug adapters without a DAP (hla) get plain memory writes */
+	if (swjdp == NULL)
+		return target_write_u32(target, address, value);
+	return mem_ap_write_u32(swjdp, address, value);
+}
+
+/* Write all dirty FPB and DWT comparators to the hardware as one batch. */
+int cortex_m3_commit_comparators(struct target *target)
+{
+	struct cortex_m3_common *cortex_m3 = target_to_cm3(target);
+	struct adiv5_dap *swjdp = cortex_m3->armv7m.arm.dap;
+	struct cortex_m3_fp_comparator *fp_list = cortex_m3->fp_comparator_list;
+	struct cortex_m3_dwt_comparator *dwt_list = cortex_m3->dwt_comparator_list;
+	int retval;
+	int i;
+
+	if (!cortex_m3->comparators_dirty)
+		return ERROR_OK;
+
+	for (i = 0; i < cortex_m3->fp_num_code + cortex_m3->fp_num_lit; i++) {
+		if (!fp_list[i].dirty)
+			continue;
+
+		if (!cortex_m3->fpb_enabled && fp_list[i].fpcr_value) {
+			LOG_DEBUG("FPB wasn't enabled, do it now");
+			retval = cortex_m3_queue_write_u32(target, FP_CTRL, 3);
+			if (retval != ERROR_OK)
+				return retval;
+			cortex_m3->fpb_enabled = 1;
+		}
+
+		retval = cortex_m3_queue_write_u32(target, fp_list[i].fpcr_address,
+				fp_list[i].fpcr_value);
+		if (retval != ERROR_OK)
+			return retval;
+		fp_list[i].dirty = false;
+	}
+
+	for (i = 0; i < cortex_m3->dwt_num_comp; i++) {
+		if (!dwt_list[i].dirty)
+			continue;
+
+		retval = cortex_m3_queue_write_u32(target,
+				dwt_list[i].dwt_comparator_address + 0, dwt_list[i].comp);
+		if (retval == ERROR_OK)
+			retval = cortex_m3_queue_write_u32(target,
+					dwt_list[i].dwt_comparator_address + 4, dwt_list[i].mask);
+		/* function last, it enables the comparator */
+		if (retval == ERROR_OK)
+			retval = cortex_m3_queue_write_u32(target,
+					dwt_list[i].dwt_comparator_address + 8, dwt_list[i].function);
+		if (retval != ERROR_OK)
+			return retval;
+		dwt_list[i].dirty = false;
+	}
+
+	cortex_m3->comparators_dirty = false;
+
+	if (swjdp == NULL)
+		return ERROR_OK;
+	return dap_run(swjdp);
+}
+
+/* The FPB and DWT can be updated while the core runs; there is no resume
+ * to wait for then.
+ */
+static int cortex_m3_commit_if_running(struct target *target)
+{
+	if (target->state == TARGET_HALTED)
+		return ERROR_OK;
+	return cortex_m3_commit_comparators(target);
+}
+
 int cortex_m3_set_breakpoint(struct target *target, struct breakpoint *breakpoint)
 {
 	int retval;
@@ -1131,16 +1250,14 @@ int cortex_m3_set_breakpoint(struct target *target, struct breakpoint *breakpoin
 		breakpoint->set = fp_num + 1;
 		hilo = (breakpoint->address & 0x2) ? FPCR_REPLACE_BKPT_HIGH : FPCR_REPLACE_BKPT_LOW;
 		comparator_list[fp_num].used = 1;
-		comparator_list[fp_num].fpcr_value = (breakpoint->address & 0x1FFFFFFC) | hilo | 1;
-		target_write_u32(target, comparator_list[fp_num].fpcr_address,
-			comparator_list[fp_num].fpcr_value);
+		cortex_m3_fp_comparator_update(target, &comparator_list[fp_num],
+			(breakpoint->address & 0x1FFFFFFC) | hilo | 1);
 		LOG_DEBUG("fpc_num %i fpcr_value 0x%" PRIx32 "",
 			fp_num,
 			comparator_list[fp_num].fpcr_value);
-		if (!cortex_m3->fpb_enabled) {
-			LOG_DEBUG("FPB wasn't enabled, do it now");
-			target_write_u32(target, FP_CTRL, 3);
-		}
+		retval = cortex_m3_commit_if_running(target);
+		if (retval != ERROR_OK)
+			return retval;
 	} else if (breakpoint->type == BKPT_SOFT) {
 		uint8_t code[4];
 
@@ -1199,9 +1316,10 @@ int cortex_m3_unset_breakpoint(struct target *target, struct breakpoint *breakpo
 			return ERROR_OK;
 		}
 		comparator_list[fp_num].used = 0;
-		comparator_list[fp_num].fpcr_value = 0;
-		target_write_u32(target, comparator_list[fp_num].fpcr_address,
-			comparator_list[fp_num].fpcr_value);
+		cortex_m3_fp_comparator_update(target, &comparator_list[fp_num], 0);
+		retval = cortex_m3_commit_if_running(target);
+		if (retval != ERROR_OK)
+			return retval;
 	} else {
 		/* restore original instruction (kept in target endianness) */
 		if (breakpoint->length == 4) {
@@ -1321,12 +1439,7 @@ int cortex_m3_set_watchpoint(struct target *target, struct watchpoint *watchpoin
 	watchpoint->set = dwt_num + 1;
 
 	comparator->comp = watchpoint->address;
-	target_write_u32(target, comparator->dwt_comparator_address + 0,
-		comparator->comp);
-
 	comparator->mask = mask;
-	target_write_u32(target, comparator->dwt_comparator_address + 4,
-		comparator->mask);
 
 	switch (watchpoint->rw) {
 		case WPT_READ:
@@ -1339,15 +1452,16 @@ int cortex_m3_set_watchpoint(struct target *target, struct watchpoint *watchpoin
 			comparator->function = 7;
 			break;
 	}
-	target_write_u32(target, comparator->dwt_comparator_address + 8,
-		comparator->function);
+	comparator->dirty = true;
+	cortex_m3->comparators_dirty = true;
 
 	LOG_DEBUG("Watchpoint (ID %d) DWT%d 0x%08x 0x%x 0x%05x",
 		watchpoint->unique_id, dwt_num,
 		(unsigned) comparator->comp,
 		(unsigned) comparator->mask,
 		(unsigned) comparator->function);
-	return ERROR_OK;
+
+	return cortex_m3_commit_if_running(target);
 }
 
 int cortex_m3_unset_watchpoint(struct target *target, struct watchpoint *watchpoint)
@@ -1376,12 +1490,12 @@ int cortex_m3_unset_watchpoint(struct target *target, struct watchpoint *watchpo
 	comparator = cortex_m3->dwt_comparator_list + dwt_num;
 	comparator->used = 0;
 	comparator->function = 0;
-	target_write_u32(target, comparator->dwt_comparator_address + 8,
-		comparator->function);
+	comparator->dirty = true;
+	cortex_m3->comparators_dirty = true;
 
 	watchpoint->set = false;
 
-	return ERROR_OK;
+	return cortex_m3_commit_if_running(target);
 }
 
 int cortex_m3_add_watchpoint(struct target *target, struct watchpoint *watchpoint)
@@ -1603,6 +1717,76 @@ static int cortex_m3_store_core_reg_u32(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * Bulk variant of cortex_m3_store_core_reg_u32() used by
+ * armv7m_restore_context(): the DCRDR/DCRSR pairs for R0..PSP are queued
+ * back to back and flushed with a single dap_run() instead of costing
+ * three round trips per register.  The special registers packed into
+ * selector 20 need a read-modify-write and go first, one at a time, in
+ * the same order the per-register restore loop uses.
+ */
+static int cortex_m3_store_core_regs(struct target *target, const uint32_t *dirty)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_dap *swjdp = armv7m->arm.dap;
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	struct arm_reg *arm_reg;
+	uint32_t value, dcrdr;
+	int retval, i;
+
+	for (i = cache->num_regs - 1; i > ARMV7M_PSP; i--) {
+		if (!(dirty[i / 32] & (1u << (i % 32))))
+			continue;
+		arm_reg = cache->reg_list[i].arch_info;
+		value = buf_get_u32(cache->reg_list[i].value, 0, 32);
+		retval = cortex_m3_store_core_reg_u32(target, arm_reg->num, value);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	/* DCRDR doubles as the emulated DCC channel, preserve it */
+	retval = mem_ap_read_u32(swjdp, DCB_DCRDR, &dcrdr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (i = ARMV7M_PSP; i >= 0; i--) {
+		if (!(dirty[i / 32] & (1u << (i % 32))))
+			continue;
+		arm_reg = cache->reg_list[i].arch_info;
+		value = buf_get_u32(cache->reg_list[i].value, 0, 32);
+#ifdef ARMV7_GDB_HACKS
+		/* see cortex_m3_store_core_reg_u32() */
+		if (arm_reg->num == ARMV7M_R14)
+			value |= 0x01;
+#endif
+
+		retval = dap_setup_accessport(swjdp, CSW_32BIT | CSW_ADDRINC_OFF, DCB_DCRDR & 0xFFFFFFF0);
+		if (retval != ERROR_OK)
+			return retval;
+		retval = dap_queue_ap_write(swjdp, AP_REG_BD0 | (DCB_DCRDR & 0xC), value);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = dap_setup_accessport(swjdp, CSW_32BIT | CSW_ADDRINC_OFF, DCB_DCRSR & 0xFFFFFFF0);
+		if (retval != ERROR_OK)
+			return retval;
+		retval = dap_queue_ap_write(swjdp, AP_REG_BD0 | (DCB_DCRSR & 0xC),
+				arm_reg->num | DCRSR_WnR);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = dap_run(swjdp);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("JTAG failure");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	/* restore DCB_DCRDR in a separate transaction, as the single
+	 * register path does, otherwise the emulated DCC channel breaks */
+	return mem_ap_write_atomic_u32(swjdp, DCB_DCRDR, dcrdr);
+}
+
 static int cortex_m3_read_memory(struct target *target, uint32_t address,
 	uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -1634,6 +1818,26 @@ static int cortex_m3_read_memory(struct target *target, uint32_t address,
 	return retval;
 }
 
+static int cortex_m3_sample_pc(struct target *target, uint32_t *samples,
+	uint32_t num)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_dap *swjdp = armv7m->arm.dap;
+	int retval = ERROR_OK;
+
+	/* PCSR is optional on ARMv6-M */
+	if (armv7m->arm.is_armv6m)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* queue all reads of PCSR and flush them together */
+	for (uint32_t i = 0; i < num && retval == ERROR_OK; i++)
+		retval = mem_ap_read_u32(swjdp, DWT_PCSR, &samples[i]);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return dap_run(swjdp);
+}
+
 static int cortex_m3_write_memory(struct target *target, uint32_t address,
 	uint32_t size, uint32_t count, const uint8_t *buffer)
 {
@@ -2024,6 +2228,7 @@ static int cortex_m3_init_arch_info(struct target *target,
 
 	armv7m->load_core_reg_u32 = cortex_m3_load_core_reg_u32;
 	armv7m->store_core_reg_u32 = cortex_m3_store_core_reg_u32;
+	armv7m->store_core_regs = cortex_m3_store_core_regs;
 
 	target_register_timer_callback(cortex_m3_handle_target_request, 1, 1, target);
 
@@ -2179,9 +2384,11 @@ COMMAND_HANDLER(handle_cortex_m3_mask_interrupts_command)
 
 
 		if (cortex_m3->isrmasking_mode == CORTEX_M3_ISRMASK_ON)
-			cortex_m3_write_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
+			retval = cortex_m3_write_debug_halt_mask(target, C_HALT | C_MASKINTS, 0);
 		else
-			cortex_m3_write_debug_halt_mask(target, C_HALT, C_MASKINTS);
+			retval = cortex_m3_write_debug_halt_mask(target, C_HALT, C_MASKINTS);
+		if (retval != ERROR_OK)
+			return retval;
 	}
 
 	n = Jim_Nvp_value2name_simple(nvp_maskisr_modes, cortex_m3->isrmasking_mode);
@@ -2288,6 +2495,8 @@ struct target_type cortexm3_target = {
 	.bulk_write_memory = cortex_m3_bulk_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.blank_check_memory_blocks = armv7m_blank_check_memory_blocks,
+	.sample_pc = cortex_m3_sample_pc,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -44,6 +44,7 @@
 
 #define DWT_CTRL	0xE0001000
 #define DWT_CYCCNT	0xE0001004
+#define DWT_PCSR	0xE000101C
 #define DWT_COMP0	0xE0001020
 #define DWT_MASK0	0xE0001024
 #define DWT_FUNCTION0	0xE0001028
@@ -122,11 +123,17 @@
 #define FPCR_REPLACE_BKPT_HIGH  (2 << 30)
 #define FPCR_REPLACE_BKPT_BOTH  (3 << 30)
 
+/* The comparator lists shadow the FPB and DWT comparator banks.  Changes
+ * are only made to the shadow and flagged dirty; they are written to the
+ * hardware in one batch by cortex_m3_commit_comparators() before the core
+ * runs again.
+ */
 struct cortex_m3_fp_comparator {
 	int used;
 	int type;
 	uint32_t fpcr_value;
 	uint32_t fpcr_address;
+	bool dirty;
 };
 
 struct cortex_m3_dwt_comparator {
@@ -135,6 +142,7 @@ struct cortex_m3_dwt_comparator {
 	uint32_t mask;
 	uint32_t function;
 	uint32_t dwt_comparator_address;
+	bool dirty;
 };
 
 enum cortex_m3_soft_reset_config {
@@ -171,6 +179,9 @@ struct cortex_m3_common {
 	struct cortex_m3_dwt_comparator *dwt_comparator_list;
 	struct reg_cache *dwt_cache;
 
+	/* some FPB/DWT comparator shadow differs from the hardware */
+	bool comparators_dirty;
+
 	enum cortex_m3_soft_reset_config soft_reset_config;
 
 	enum cortex_m3_isrmasking_mode isrmasking_mode;
@@ -196,6 +207,7 @@ int cortex_m3_add_watchpoint(struct target *target, struct watchpoint *watchpoin
 int cortex_m3_remove_watchpoint(struct target *target, struct watchpoint *watchpoint);
 void cortex_m3_enable_breakpoints(struct target *target);
 void cortex_m3_enable_watchpoints(struct target *target);
+int cortex_m3_commit_comparators(struct target *target);
 void cortex_m3_dwt_setup(struct cortex_m3_common *cm3, struct target *target);
 
 #endif /* CORTEX_M3_H */
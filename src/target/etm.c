@@ -287,7 +287,7 @@ static void etm_reg_add(unsigned bcd_vers, struct arm_jtag *jtag_info,
 struct reg_cache *etm_build_reg_cache(struct target *target,
 	struct arm_jtag *jtag_info, struct etm_context *etm_ctx)
 {
-	struct reg_cache *reg_cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *reg_cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = NULL;
 	struct etm_reg *arch_info = NULL;
 	unsigned bcd_vers, config;
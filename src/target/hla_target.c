@@ -589,6 +589,10 @@ static int adapter_resume(struct target *target, int current,
 					breakpoint->unique_id);
 			cortex_m3_unset_breakpoint(target, breakpoint);
 
+			res = cortex_m3_commit_comparators(target);
+			if (res != ERROR_OK)
+				return res;
+
 			res = adapter->layout->api->step(adapter->fd);
 
 			if (res != ERROR_OK)
@@ -598,6 +602,10 @@ static int adapter_resume(struct target *target, int current,
 		}
 	}
 
+	res = cortex_m3_commit_comparators(target);
+	if (res != ERROR_OK)
+		return res;
+
 	res = adapter->layout->api->run(adapter->fd);
 
 	if (res != ERROR_OK)
@@ -651,6 +659,10 @@ static int adapter_step(struct target *target, int current,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUMED);
 
+	res = cortex_m3_commit_comparators(target);
+	if (res != ERROR_OK)
+		return res;
+
 	res = adapter->layout->api->step(adapter->fd);
 
 	if (res != ERROR_OK)
@@ -807,6 +819,7 @@ struct target_type hla_target = {
 	.bulk_write_memory = adapter_bulk_write_memory,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
+	.blank_check_memory_blocks = armv7m_blank_check_memory_blocks,
 
 	.run_algorithm = armv7m_run_algorithm,
 	.start_algorithm = armv7m_start_algorithm,
@@ -1001,6 +1001,128 @@ void image_close(struct image *image)
 	}
 }
 
+static int image_symbol_compare(const void *a, const void *b)
+{
+	const struct image_symbol *sa = a;
+	const struct image_symbol *sb = b;
+
+	if (sa->address < sb->address)
+		return -1;
+	return sa->address > sb->address;
+}
+
+int image_read_symbols(struct image *image, struct image_symbol **symbols,
+		int *num_symbols)
+{
+	struct image_elf *elf = image->type_private;
+	Elf32_Shdr *shdr = NULL;
+	Elf32_Sym *syms = NULL;
+	char *strtab = NULL;
+	size_t read_bytes;
+	int retval;
+
+	*symbols = NULL;
+	*num_symbols = 0;
+
+	if (image->type != IMAGE_ELF)
+		return ERROR_IMAGE_TYPE_UNKNOWN;
+
+	uint32_t shnum = field16(elf, elf->header->e_shnum);
+	if (shnum == 0 || field16(elf, elf->header->e_shentsize) != sizeof(Elf32_Shdr)) {
+		LOG_ERROR("invalid ELF file, no section headers");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	shdr = malloc(shnum * sizeof(Elf32_Shdr));
+	if (shdr == NULL)
+		return ERROR_FAIL;
+
+	retval = fileio_seek(&elf->fileio, field32(elf, elf->header->e_shoff));
+	if (retval == ERROR_OK)
+		retval = fileio_read(&elf->fileio, shnum * sizeof(Elf32_Shdr),
+				(uint8_t *)shdr, &read_bytes);
+	if (retval != ERROR_OK || read_bytes != shnum * sizeof(Elf32_Shdr)) {
+		LOG_ERROR("cannot read ELF section headers");
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+		goto done;
+	}
+
+	uint32_t symtab;
+	for (symtab = 0; symtab < shnum; symtab++)
+		if (field32(elf, shdr[symtab].sh_type) == SHT_SYMTAB)
+			break;
+	if (symtab == shnum) {
+		LOG_ERROR("ELF file has no symbol table");
+		retval = ERROR_IMAGE_FORMAT_ERROR;
+		goto done;
+	}
+
+	uint32_t strndx = field32(elf, shdr[symtab].sh_link);
+	if (strndx >= shnum) {
+		retval = ERROR_IMAGE_FORMAT_ERROR;
+		goto done;
+	}
+
+	uint32_t sym_size = field32(elf, shdr[symtab].sh_size);
+	uint32_t str_size = field32(elf, shdr[strndx].sh_size);
+	uint32_t count = sym_size / sizeof(Elf32_Sym);
+
+	syms = malloc(sym_size);
+	strtab = malloc(str_size + 1);
+	*symbols = malloc(count * sizeof(struct image_symbol));
+	if (syms == NULL || strtab == NULL || *symbols == NULL) {
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	retval = fileio_seek(&elf->fileio, field32(elf, shdr[symtab].sh_offset));
+	if (retval == ERROR_OK)
+		retval = fileio_read(&elf->fileio, sym_size, (uint8_t *)syms, &read_bytes);
+	if (retval == ERROR_OK && read_bytes == sym_size)
+		retval = fileio_seek(&elf->fileio, field32(elf, shdr[strndx].sh_offset));
+	if (retval == ERROR_OK)
+		retval = fileio_read(&elf->fileio, str_size, (uint8_t *)strtab, &read_bytes);
+	if (retval != ERROR_OK || read_bytes != str_size) {
+		LOG_ERROR("cannot read ELF symbol table");
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+		goto done;
+	}
+	strtab[str_size] = 0;
+
+	/* keep only functions; the Thumb bit is not part of the address */
+	int n = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t name = field32(elf, syms[i].st_name);
+		if (ELF32_ST_TYPE(syms[i].st_info) != STT_FUNC || name >= str_size)
+			continue;
+		(*symbols)[n].address = field32(elf, syms[i].st_value) & ~1u;
+		(*symbols)[n].size = field32(elf, syms[i].st_size);
+		(*symbols)[n].name = strdup(strtab + name);
+		n++;
+	}
+
+	qsort(*symbols, n, sizeof(struct image_symbol), image_symbol_compare);
+	*num_symbols = n;
+	retval = ERROR_OK;
+
+done:
+	if (retval != ERROR_OK) {
+		free(*symbols);
+		*symbols = NULL;
+	}
+	free(strtab);
+	free(syms);
+	free(shdr);
+	return retval;
+}
+
+void image_free_symbols(struct image_symbol *symbols, int num_symbols)
+{
+	for (int i = 0; i < num_symbols; i++)
+		free(symbols[i].name);
+	free(symbols);
+}
+
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
 {
 	uint32_t crc = 0xffffffff;
@@ -93,6 +93,13 @@ struct image_mot {
 	uint8_t *buffer;
 };
 
+/** A function symbol read from an image's symbol table. */
+struct image_symbol {
+	uint32_t address;
+	uint32_t size;
+	char *name;
+};
+
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, uint32_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
@@ -101,6 +108,14 @@ void image_close(struct image *image);
 int image_add_section(struct image *image, uint32_t base, uint32_t size,
 		int flags, uint8_t *data);
 
+/**
+ * Read the function symbols of an ELF @a image, sorted by address.
+ * Release them with image_free_symbols().
+ */
+int image_read_symbols(struct image *image, struct image_symbol **symbols,
+		int *num_symbols);
+void image_free_symbols(struct image_symbol *symbols, int num_symbols);
+
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
 
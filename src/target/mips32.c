@@ -256,7 +256,7 @@ struct reg_cache *mips32_build_reg_cache(struct target *target)
 
 	int num_regs = MIPS32NUMCOREREGS;
 	struct reg_cache **cache_p = register_get_last_cache_p(&target->reg_cache);
-	struct reg_cache *cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = malloc(sizeof(struct reg) * num_regs);
 	struct mips32_core_reg *arch_info = malloc(sizeof(struct mips32_core_reg) * num_regs);
 	int i;
@@ -573,7 +573,6 @@ int mips32_checksum_memory(struct target *target, uint32_t address,
 	struct reg_param reg_params[2];
 	struct mips32_algorithm mips32_info;
 	int retval;
-	uint32_t i;
 
 	/* see contib/loaders/checksum/mips32.s for src */
 
@@ -607,12 +606,10 @@ int mips32_checksum_memory(struct target *target, uint32_t address,
 	};
 
 	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(mips_crc_code), &crc_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
-	/* convert flash writing code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(mips_crc_code); i++)
-		target_write_u32(target, crc_algorithm->address + i*sizeof(uint32_t), mips_crc_code[i]);
+	retval = target_alloc_algorithm_u32(target, mips_crc_code,
+			ARRAY_SIZE(mips_crc_code), &crc_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
 
 	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
 	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
@@ -653,7 +650,6 @@ int mips32_blank_check_memory(struct target *target,
 	struct reg_param reg_params[3];
 	struct mips32_algorithm mips32_info;
 	int retval;
-	uint32_t i;
 
 	static const uint32_t erase_check_code[] = {
 						/* nbyte: */
@@ -666,14 +662,10 @@ int mips32_blank_check_memory(struct target *target,
 	};
 
 	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(erase_check_code), &erase_check_algorithm) != ERROR_OK)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-
-	/* convert flash writing code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(erase_check_code); i++) {
-		target_write_u32(target, erase_check_algorithm->address + i*sizeof(uint32_t),
-				erase_check_code[i]);
-	}
+	retval = target_alloc_algorithm_u32(target, erase_check_code,
+			ARRAY_SIZE(erase_check_code), &erase_check_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
 
 	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
 	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
@@ -710,6 +702,86 @@ int mips32_blank_check_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/** Checks a table of memory blocks for erased words, setting a bit
+ * in the bitmap for each block holding nothing else. */
+int mips32_blank_check_memory_blocks(struct target *target,
+		uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+		uint32_t erased_word, uint32_t total_size)
+{
+	struct working_area *erase_check_algorithm;
+	struct reg_param reg_params[4];
+	struct mips32_algorithm mips32_info;
+	int retval;
+
+	/* see contrib/loaders/erase_check/mips32_erase_check_blocks.s for src */
+	static const uint32_t erase_check_code[] = {
+		0x240C0001,		/* addiu	$t4, $zero, 1 */
+						/* check_block: */
+		0x8C880000,		/* lw		$t0, 0($a0) */
+		0x8C890004,		/* lw		$t1, 4($a0) */
+		0x24840008,		/* addiu	$a0, $a0, 8 */
+						/* loop: */
+		0x11200007,		/* beq		$t1, $zero, blank */
+		0x00000000,		/* nop */
+		0x8D0A0000,		/* lw		$t2, 0($t0) */
+		0x25080004,		/* addiu	$t0, $t0, 4 */
+		0x1147FFFB,		/* beq		$t2, $a3, loop */
+		0x2529FFFC,		/* addiu	$t1, $t1, -4 */
+		0x10000004,		/* b		next */
+		0x00000000,		/* nop */
+						/* blank: */
+		0x8CCA0000,		/* lw		$t2, 0($a2) */
+		0x014C5025,		/* or		$t2, $t2, $t4 */
+		0xACCA0000,		/* sw		$t2, 0($a2) */
+						/* next: */
+		0x000C6040,		/* sll		$t4, $t4, 1 */
+		0x15800003,		/* bne		$t4, $zero, no_wrap */
+		0x00000000,		/* nop */
+		0x24C60004,		/* addiu	$a2, $a2, 4 */
+		0x240C0001,		/* addiu	$t4, $zero, 1 */
+						/* no_wrap: */
+		0x24A5FFFF,		/* addiu	$a1, $a1, -1 */
+		0x14A0FFEB,		/* bne		$a1, $zero, check_block */
+		0x00000000,		/* nop */
+		0x7000003F		/* sdbbp */
+	};
+
+	/* make sure we have a working area */
+	retval = target_alloc_algorithm_u32(target, erase_check_code,
+			ARRAY_SIZE(erase_check_code), &erase_check_algorithm);
+	if (retval != ERROR_OK)
+		return retval;
+
+	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
+	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
+
+	init_reg_param(&reg_params[0], "a0", 32, PARAM_OUT);
+	buf_set_u32(reg_params[0].value, 0, 32, table);
+
+	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
+	buf_set_u32(reg_params[1].value, 0, 32, num_blocks);
+
+	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);
+	buf_set_u32(reg_params[2].value, 0, 32, bitmap);
+
+	init_reg_param(&reg_params[3], "a3", 32, PARAM_OUT);
+	buf_set_u32(reg_params[3].value, 0, 32, erased_word);
+
+	retval = target_run_algorithm(target, 0, NULL, 4, reg_params,
+			erase_check_algorithm->address,
+			erase_check_algorithm->address + (sizeof(erase_check_code)-4),
+			10000 + total_size / 1024, &mips32_info);
+
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+	destroy_reg_param(&reg_params[3]);
+
+	target_free_working_area(target, erase_check_algorithm);
+
+	return retval;
+}
+
 static int mips32_verify_pointer(struct command_context *cmd_ctx,
 		struct mips32_common *mips32)
 {
@@ -246,5 +246,8 @@ int mips32_checksum_memory(struct target *target, uint32_t address,
 		uint32_t count, uint32_t *checksum);
 int mips32_blank_check_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t *blank);
+int mips32_blank_check_memory_blocks(struct target *target,
+		uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+		uint32_t erased_word, uint32_t total_size);
 
 #endif	/*MIPS32_H*/
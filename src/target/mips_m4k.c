@@ -1345,6 +1345,7 @@ struct target_type mips_m4k_target = {
 	.bulk_write_memory = mips_m4k_bulk_write_memory,
 	.checksum_memory = mips32_checksum_memory,
 	.blank_check_memory = mips32_blank_check_memory,
+	.blank_check_memory_blocks = mips32_blank_check_memory_blocks,
 
 	.run_algorithm = mips32_run_algorithm,
 
@@ -38,16 +38,92 @@
  * may be separate registers associated with debug or trace modules.
  */
 
+/**
+ * Open addressed hash of the register names in one cache.  Caches are
+ * filled in by each architecture and some grow after creation (ETM), so
+ * the index remembers the layout it was built for and is rebuilt when
+ * that changes.
+ */
+struct reg_name_index {
+	struct reg *reg_list;
+	unsigned num_regs;
+	unsigned mask;
+	unsigned slot[];	/* register number + 1, zero when empty */
+};
+
+static unsigned register_name_hash(const char *name)
+{
+	unsigned hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct reg_name_index *register_cache_index(struct reg_cache *cache)
+{
+	struct reg_name_index *index = cache->name_index;
+	unsigned size, i, j;
+
+	if (index && index->reg_list == cache->reg_list
+			&& index->num_regs == cache->num_regs)
+		return index;
+
+	free(index);
+	cache->name_index = NULL;
+
+	/* keep the table at most half full */
+	for (size = 8; size < 2 * cache->num_regs; size <<= 1)
+		;
+
+	index = calloc(1, sizeof(*index) + size * sizeof(index->slot[0]));
+	if (index == NULL)
+		return NULL;
+	index->reg_list = cache->reg_list;
+	index->num_regs = cache->num_regs;
+	index->mask = size - 1;
+
+	for (i = 0; i < cache->num_regs; i++) {
+		const char *name = cache->reg_list[i].name;
+
+		for (j = register_name_hash(name) & index->mask; index->slot[j];
+				j = (j + 1) & index->mask) {
+			/* on duplicate names the first register wins */
+			if (strcmp(cache->reg_list[index->slot[j] - 1].name, name) == 0)
+				break;
+		}
+		if (!index->slot[j])
+			index->slot[j] = i + 1;
+	}
+
+	cache->name_index = index;
+	return index;
+}
+
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all)
 {
-	unsigned i;
+	unsigned i, hash = register_name_hash(name);
 	struct reg_cache *cache = first;
 
 	while (cache) {
-		for (i = 0; i < cache->num_regs; i++) {
-			if (strcmp(cache->reg_list[i].name, name) == 0)
-				return &(cache->reg_list[i]);
+		struct reg_name_index *index = register_cache_index(cache);
+
+		if (index) {
+			for (i = hash & index->mask; index->slot[i]; i = (i + 1) & index->mask) {
+				struct reg *reg = &cache->reg_list[index->slot[i] - 1];
+
+				if (strcmp(reg->name, name) == 0)
+					return reg;
+			}
+		} else {
+			for (i = 0; i < cache->num_regs; i++) {
+				if (strcmp(cache->reg_list[i].name, name) == 0)
+					return &(cache->reg_list[i]);
+			}
 		}
 
 		if (search_all)
@@ -83,6 +159,28 @@ void register_cache_invalidate(struct reg_cache *cache)
 	}
 }
 
+/**
+ * Collects the dirty flags of a whole cache into @a bitmap, which must
+ * hold REG_BITMAP_WORDS(cache->num_regs) words, so write-back code can
+ * batch the registers it has to restore.
+ *
+ * @returns the number of dirty registers.
+ */
+unsigned register_cache_dirty_bitmap(struct reg_cache *cache, uint32_t *bitmap)
+{
+	unsigned count = 0;
+
+	memset(bitmap, 0, REG_BITMAP_WORDS(cache->num_regs) * sizeof(uint32_t));
+	for (unsigned i = 0; i < cache->num_regs; i++) {
+		if (cache->reg_list[i].dirty) {
+			bitmap[i / 32] |= 1u << (i % 32);
+			count++;
+		}
+	}
+
+	return count;
+}
+
 static int register_get_dummy_core_reg(struct reg *reg)
 {
 	return ERROR_OK;
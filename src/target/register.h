@@ -38,13 +38,19 @@ struct reg {
 	const struct reg_arch_type *type;
 };
 
+struct reg_name_index;
+
 struct reg_cache {
 	const char *name;
 	struct reg_cache *next;
 	struct reg *reg_list;
 	unsigned num_regs;
+	struct reg_name_index *name_index;	/* built by register_get_by_name() */
 };
 
+/** Number of 32-bit words in a bitmap covering @a num_regs registers. */
+#define REG_BITMAP_WORDS(num_regs) (((num_regs) + 31) / 32)
+
 struct reg_arch_type {
 	int (*get)(struct reg *reg);
 	int (*set)(struct reg *reg, uint8_t *buf);
@@ -54,6 +60,7 @@ struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all);
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
 void register_cache_invalidate(struct reg_cache *cache);
+unsigned register_cache_dirty_bitmap(struct reg_cache *cache, uint32_t *bitmap);
 
 void register_init_dummy(struct reg *reg);
 
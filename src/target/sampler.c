@@ -0,0 +1,534 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <server/server.h>
+
+#include "target.h"
+#include "sampler.h"
+
+#define SAMPLER_MAX_REGIONS		32
+#define SAMPLER_MAX_CLIENTS		4
+#define SAMPLER_MAX_RATE		1000
+#define SAMPLER_RECORD_HDR_SIZE	12
+#define SAMPLER_MAX_RECORD_SIZE	(64 * 1024)
+
+struct sampler_region {
+	uint32_t address;
+	uint32_t size;
+	unsigned width;
+};
+
+struct sampler {
+	struct target *target;
+	struct sampler_region regions[SAMPLER_MAX_REGIONS];
+	unsigned num_regions;
+	uint32_t payload_size;
+	unsigned rate;
+
+	const char *port;
+	bool service_added;
+	struct connection *clients[SAMPLER_MAX_CLIENTS];
+
+	char *filename;
+	FILE *file;
+
+	bool running;
+	uint8_t *record;
+	struct timeval start;
+	struct timeval next;
+	uint32_t samples;
+	uint32_t late;
+	uint32_t skipped;
+};
+
+static struct sampler sampler = {
+	.rate = 100,
+};
+
+static uint32_t sampler_record_size(void)
+{
+	return SAMPLER_RECORD_HDR_SIZE + sampler.payload_size;
+}
+
+static void sampler_output(struct connection *only, const void *data, uint32_t len)
+{
+	if (only) {
+		connection_write(only, data, len);
+		return;
+	}
+
+	for (unsigned i = 0; i < SAMPLER_MAX_CLIENTS; i++) {
+		if (sampler.clients[i])
+			connection_write(sampler.clients[i], data, len);
+	}
+
+	if (sampler.file && fwrite(data, 1, len, sampler.file) != len) {
+		LOG_ERROR("sampler: writing %s failed: %s, closing it",
+				sampler.filename, strerror(errno));
+		fclose(sampler.file);
+		sampler.file = NULL;
+	}
+}
+
+/* Send the stream header to one client or, if @a only is NULL, to everyone. */
+static void sampler_send_header(struct connection *only)
+{
+	uint32_t len = 16 + 12 * sampler.num_regions;
+	uint8_t *hdr = malloc(len);
+	if (hdr == NULL)
+		return;
+
+	memcpy(hdr, "OCDSMPL", 8);
+	h_u16_to_le(hdr + 8, SAMPLER_STREAM_VERSION);
+	h_u16_to_le(hdr + 10, sampler.num_regions);
+	h_u32_to_le(hdr + 12, sampler.rate);
+	for (unsigned i = 0; i < sampler.num_regions; i++) {
+		uint8_t *p = hdr + 16 + 12 * i;
+		h_u32_to_le(p, sampler.regions[i].address);
+		h_u32_to_le(p + 4, sampler.regions[i].size);
+		h_u32_to_le(p + 8, sampler.regions[i].width);
+	}
+
+	sampler_output(only, hdr, len);
+	free(hdr);
+}
+
+static void sampler_schedule_next(struct timeval *now)
+{
+	long period_us = 1000000 / sampler.rate;
+
+	timeval_add_time(&sampler.next, 0, period_us);
+
+	/* if we fell more than a period behind, resynchronise instead of
+	 * firing a burst of samples to catch up */
+	struct timeval behind;
+	if (timeval_subtract(&behind, now, &sampler.next) == 0 &&
+			(behind.tv_sec > 0 || behind.tv_usec >= period_us)) {
+		sampler.late++;
+		sampler.next = *now;
+		timeval_add_time(&sampler.next, 0, period_us);
+	}
+}
+
+static int sampler_take_sample(struct target *target, struct timeval *now)
+{
+	uint8_t *p = sampler.record + SAMPLER_RECORD_HDR_SIZE;
+
+	for (unsigned i = 0; i < sampler.num_regions; i++) {
+		struct sampler_region *r = &sampler.regions[i];
+		int retval = target_read_memory(target, r->address, r->width,
+				r->size / r->width, p);
+		if (retval != ERROR_OK)
+			return retval;
+		p += r->size;
+	}
+
+	struct timeval elapsed;
+	timeval_subtract(&elapsed, now, &sampler.start);
+	uint64_t us = (uint64_t)elapsed.tv_sec * 1000000 + elapsed.tv_usec;
+
+	h_u32_to_le(sampler.record, sampler.samples);
+	h_u32_to_le(sampler.record + 4, (uint32_t)us);
+	h_u32_to_le(sampler.record + 8, (uint32_t)(us >> 32));
+	sampler_output(NULL, sampler.record, sampler_record_size());
+	sampler.samples++;
+
+	return ERROR_OK;
+}
+
+static void sampler_stop(void)
+{
+	if (!sampler.running)
+		return;
+
+	sampler.running = false;
+	free(sampler.record);
+	sampler.record = NULL;
+	if (sampler.file) {
+		fclose(sampler.file);
+		sampler.file = NULL;
+	}
+}
+
+static int sampler_timer_callback(void *priv)
+{
+	struct target *target = sampler.target;
+
+	if (!sampler.running)
+		return ERROR_OK;
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	if (now.tv_sec < sampler.next.tv_sec || (now.tv_sec == sampler.next.tv_sec &&
+			now.tv_usec < sampler.next.tv_usec))
+		return ERROR_OK;
+
+	sampler_schedule_next(&now);
+
+	/* never touch the target while it is unavailable or busy with one
+	 * of our own algorithms (e.g. flash programming) */
+	if (!target_was_examined(target) || target->running_alg ||
+			(target->state != TARGET_RUNNING && target->state != TARGET_HALTED)) {
+		sampler.skipped++;
+		return ERROR_OK;
+	}
+
+	int retval = sampler_take_sample(target, &now);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("sampler: reading target %s failed (%d), sampling stopped",
+				target_name(target), retval);
+		sampler_stop();
+	}
+
+	/* sampling errors must not be reported back to the server loop */
+	return ERROR_OK;
+}
+
+long sampler_idle_timeout_us(long max_us)
+{
+	if (!sampler.running)
+		return max_us;
+
+	struct timeval now, wait;
+	gettimeofday(&now, NULL);
+	if (timeval_subtract(&wait, &sampler.next, &now))
+		return 0;
+	if (wait.tv_sec > 0)
+		return max_us;
+	return wait.tv_usec < max_us ? wait.tv_usec : max_us;
+}
+
+/* connections */
+static int sampler_new_connection(struct connection *connection)
+{
+	for (unsigned i = 0; i < SAMPLER_MAX_CLIENTS; i++) {
+		if (sampler.clients[i] == NULL) {
+			sampler.clients[i] = connection;
+			if (sampler.running)
+				sampler_send_header(connection);
+			return ERROR_OK;
+		}
+	}
+
+	return ERROR_CONNECTION_REJECTED;
+}
+
+static int sampler_input(struct connection *connection)
+{
+	uint8_t discard[64];
+
+	/* clients only listen; anything they send is dropped */
+	int rlen = connection_read(connection, discard, sizeof(discard));
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("sampler: error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int sampler_connection_closed(struct connection *connection)
+{
+	for (unsigned i = 0; i < SAMPLER_MAX_CLIENTS; i++) {
+		if (sampler.clients[i] == connection)
+			sampler.clients[i] = NULL;
+	}
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_add_command)
+{
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sampler.running) {
+		command_print(CMD_CTX, "stop sampling before changing regions");
+		return ERROR_FAIL;
+	}
+
+	if (sampler.num_regions == SAMPLER_MAX_REGIONS) {
+		command_print(CMD_CTX, "too many regions (max %d)", SAMPLER_MAX_REGIONS);
+		return ERROR_FAIL;
+	}
+
+	struct sampler_region r;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], r.address);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], r.size);
+	r.width = 4;
+	if (CMD_ARGC == 3)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], r.width);
+
+	if ((r.width != 1 && r.width != 2 && r.width != 4) ||
+			r.size == 0 || (r.size % r.width) || (r.address % r.width)) {
+		command_print(CMD_CTX, "region must be a non-empty, aligned multiple of 1, 2 or 4 bytes");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (sampler_record_size() + r.size > SAMPLER_MAX_RECORD_SIZE) {
+		command_print(CMD_CTX, "sample record would exceed %d bytes", SAMPLER_MAX_RECORD_SIZE);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	sampler.regions[sampler.num_regions++] = r;
+	sampler.payload_size += r.size;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_clear_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sampler.running) {
+		command_print(CMD_CTX, "stop sampling before changing regions");
+		return ERROR_FAIL;
+	}
+
+	sampler.num_regions = 0;
+	sampler.payload_size = 0;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_rate_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		unsigned rate;
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], rate);
+		if (rate == 0 || rate > SAMPLER_MAX_RATE) {
+			command_print(CMD_CTX, "rate must be 1..%d Hz", SAMPLER_MAX_RATE);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (sampler.running) {
+			command_print(CMD_CTX, "stop sampling before changing the rate");
+			return ERROR_FAIL;
+		}
+		sampler.rate = rate;
+	}
+
+	command_print(CMD_CTX, "sampler rate: %u Hz", sampler.rate);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_port_command)
+{
+	if (sampler.service_added && CMD_ARGC > 0) {
+		LOG_WARNING("unable to change sampler port after it has been opened");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	return CALL_COMMAND_HANDLER(server_pipe_command, &sampler.port);
+}
+
+COMMAND_HANDLER(handle_sampler_file_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (sampler.running) {
+			command_print(CMD_CTX, "stop sampling before changing the output file");
+			return ERROR_FAIL;
+		}
+		free(sampler.filename);
+		sampler.filename = NULL;
+		if (strcmp(CMD_ARGV[0], "none") != 0)
+			sampler.filename = strdup(CMD_ARGV[0]);
+	}
+
+	command_print(CMD_CTX, "sampler file: %s",
+			sampler.filename ? sampler.filename : "none");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_start_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (sampler.running) {
+		command_print(CMD_CTX, "sampler already running");
+		return ERROR_OK;
+	}
+
+	if (sampler.num_regions == 0) {
+		command_print(CMD_CTX, "no regions configured, use 'sampler add'");
+		return ERROR_FAIL;
+	}
+
+	bool use_port = strcmp(sampler.port, "disabled") != 0;
+	if (!use_port && sampler.filename == NULL) {
+		command_print(CMD_CTX, "neither a sampler port nor a file is configured");
+		return ERROR_FAIL;
+	}
+
+	if (use_port && !sampler.service_added) {
+		int retval = add_service("sampler", sampler.port, SAMPLER_MAX_CLIENTS,
+				&sampler_new_connection, &sampler_input,
+				&sampler_connection_closed, NULL);
+		if (retval != ERROR_OK)
+			return retval;
+		sampler.service_added = true;
+	}
+
+	if (sampler.filename) {
+		sampler.file = fopen(sampler.filename, "wb");
+		if (sampler.file == NULL) {
+			command_print(CMD_CTX, "can't open %s: %s", sampler.filename,
+					strerror(errno));
+			return ERROR_FAIL;
+		}
+	}
+
+	sampler.record = malloc(sampler_record_size());
+	if (sampler.record == NULL) {
+		if (sampler.file) {
+			fclose(sampler.file);
+			sampler.file = NULL;
+		}
+		return ERROR_FAIL;
+	}
+
+	sampler.target = get_current_target(CMD_CTX);
+	sampler.samples = 0;
+	sampler.late = 0;
+	sampler.skipped = 0;
+	gettimeofday(&sampler.start, NULL);
+	sampler.next = sampler.start;
+	sampler.running = true;
+
+	sampler_send_header(NULL);
+
+	command_print(CMD_CTX, "sampling %u region(s), %" PRIu32 " bytes, at %u Hz from %s",
+			sampler.num_regions, sampler.payload_size, sampler.rate,
+			target_name(sampler.target));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_stop_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	sampler_stop();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_sampler_status_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (unsigned i = 0; i < sampler.num_regions; i++)
+		command_print(CMD_CTX, "region %u: 0x%8.8" PRIx32 " %" PRIu32 " bytes, width %u",
+				i, sampler.regions[i].address, sampler.regions[i].size,
+				sampler.regions[i].width);
+
+	command_print(CMD_CTX, "%s at %u Hz, %" PRIu32 " samples, %" PRIu32 " late, %"
+			PRIu32 " skipped",
+			sampler.running ? "running" : "stopped", sampler.rate,
+			sampler.samples, sampler.late, sampler.skipped);
+	return ERROR_OK;
+}
+
+static const struct command_registration sampler_subcommand_handlers[] = {
+	{
+		.name = "add",
+		.handler = handle_sampler_add_command,
+		.mode = COMMAND_ANY,
+		.help = "add a memory region to every sample",
+		.usage = "address size_in_bytes [access_width]",
+	},
+	{
+		.name = "clear",
+		.handler = handle_sampler_clear_command,
+		.mode = COMMAND_ANY,
+		.help = "remove all sampled regions",
+		.usage = "",
+	},
+	{
+		.name = "rate",
+		.handler = handle_sampler_rate_command,
+		.mode = COMMAND_ANY,
+		.help = "display or set the sampling rate",
+		.usage = "[hz]",
+	},
+	{
+		.name = "port",
+		.handler = handle_sampler_port_command,
+		.mode = COMMAND_ANY,
+		.help = "Specify port on which samples are streamed, "
+			"or 'disabled'.  Read help on 'gdb_port'.",
+		.usage = "[port_num]",
+	},
+	{
+		.name = "file",
+		.handler = handle_sampler_file_command,
+		.mode = COMMAND_ANY,
+		.help = "display or set the file samples are written to",
+		.usage = "[filename|'none']",
+	},
+	{
+		.name = "start",
+		.handler = handle_sampler_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start sampling the current target in the background",
+		.usage = "",
+	},
+	{
+		.name = "stop",
+		.handler = handle_sampler_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling",
+		.usage = "",
+	},
+	{
+		.name = "status",
+		.handler = handle_sampler_status_command,
+		.mode = COMMAND_EXEC,
+		.help = "display sampled regions and statistics",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration sampler_command_handlers[] = {
+	{
+		.name = "sampler",
+		.mode = COMMAND_ANY,
+		.help = "background memory sampling command group",
+		.usage = "",
+		.chain = sampler_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int sampler_register_commands(struct command_context *cmd_ctx)
+{
+	sampler.port = strdup("disabled");
+	target_register_timer_callback(sampler_timer_callback, 1, 1, NULL);
+	return register_commands(cmd_ctx, NULL, sampler_command_handlers);
+}
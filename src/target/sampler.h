@@ -0,0 +1,54 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+struct command_context;
+
+/**
+ * @file
+ * Background memory sampler.
+ *
+ * Periodically reads a list of memory regions from a target while it
+ * runs and streams timestamped records to TCP clients and/or a file.
+ * This is only non-intrusive on targets whose memory can be accessed
+ * without halting the core, e.g. Cortex-M through the MEM-AP.
+ *
+ * Stream layout, all fields little endian:
+ *
+ * - header: "OCDSMPL" + NUL, u16 version, u16 region count, u32 rate (Hz),
+ *   then per region u32 address, u32 size (bytes), u32 access width (bytes)
+ * - one record per sample: u32 sequence number, u64 microseconds since
+ *   sampling started, then the contents of all regions in header order
+ *
+ * A header is sent whenever sampling (re)starts and to every new client.
+ */
+
+#define SAMPLER_STREAM_VERSION	1
+
+int sampler_register_commands(struct command_context *cmd_ctx);
+
+/**
+ * Used by server_loop() to shorten its idle sleep while sampling.
+ *
+ * @returns how many microseconds may pass before the next sample is
+ * due, never more than @a max_us.
+ */
+long sampler_idle_timeout_us(long max_us);
+
+#endif /* SAMPLER_H */
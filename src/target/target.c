@@ -54,6 +54,7 @@
 #include "register.h"
 #include "trace.h"
 #include "image.h"
+#include "sampler.h"
 #include "rtos/rtos.h"
 
 static int target_read_buffer_default(struct target *target, uint32_t address,
@@ -65,6 +66,8 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 static int target_mem2array(Jim_Interp *interp, struct target *target,
 		int argc, Jim_Obj * const *argv);
 static int target_register_user_commands(struct command_context *cmd_ctx);
+static void target_working_areas_written(struct target *target,
+		uint32_t address, uint32_t size);
 
 /* targets */
 extern struct target_type arm7tdmi_target;
@@ -121,6 +124,44 @@ static struct target_event_callback *target_event_callbacks;
 static struct target_timer_callback *target_timer_callbacks;
 static const int polling_interval = 100;
 
+/* see target_timing_get(); time is charged to the innermost operation,
+ * so the transfers an algorithm run makes don't count twice */
+static struct target_timing timing;
+static double *timing_slot;
+static struct duration timing_since;
+
+/* charges the time since the last switch to the running operation and
+ * makes @a slot the running one, returning the previous for the way back */
+static double *target_timing_switch(double *slot)
+{
+	double *outer = timing_slot;
+
+	if (outer != NULL && duration_measure(&timing_since) == ERROR_OK)
+		*outer += duration_elapsed(&timing_since);
+	timing_slot = slot;
+	duration_start(&timing_since);
+
+	return outer;
+}
+
+/* enters a transfer, counting its bytes unless within another one */
+static double *target_timing_transfer(uint64_t *bytes, uint32_t count)
+{
+	double *outer = target_timing_switch(&timing.transfer);
+
+	if (outer != &timing.transfer)
+		*bytes += count;
+
+	return outer;
+}
+
+void target_timing_get(struct target_timing *result)
+{
+	/* bring the running operation up to date */
+	target_timing_switch(timing_slot);
+	*result = timing;
+}
+
 static const Jim_Nvp nvp_assert[] = {
 	{ .name = "assert", NVP_ASSERT },
 	{ .name = "deassert", NVP_DEASSERT },
@@ -680,7 +721,10 @@ static int target_write_memory_imp(struct target *target, uint32_t address,
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
-	return target->type->write_memory_imp(target, address, size, count, buffer);
+	double *outer = target_timing_transfer(&timing.bytes_written, size * count);
+	int retval = target->type->write_memory_imp(target, address, size, count, buffer);
+	target_timing_switch(outer);
+	return retval;
 }
 
 static int target_read_memory_imp(struct target *target, uint32_t address,
@@ -690,7 +734,10 @@ static int target_read_memory_imp(struct target *target, uint32_t address,
 		LOG_ERROR("Target not examined yet");
 		return ERROR_FAIL;
 	}
-	return target->type->read_memory_imp(target, address, size, count, buffer);
+	double *outer = target_timing_transfer(&timing.bytes_read, size * count);
+	int retval = target->type->read_memory_imp(target, address, size, count, buffer);
+	target_timing_switch(outer);
+	return retval;
 }
 
 static int target_soft_reset_halt_imp(struct target *target)
@@ -736,6 +783,9 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	double *outer = target_timing_switch(&timing.algorithm);
+	timing.algorithm_runs++;
+
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -743,6 +793,8 @@ int target_run_algorithm(struct target *target,
 			entry_point, exit_point, timeout_ms, arch_info);
 	target->running_alg = false;
 
+	target_timing_switch(outer);
+
 done:
 	return retval;
 }
@@ -830,7 +882,7 @@ done:
  * @param target used to run the algorithm
  */
 
-int target_run_flash_async_algorithm(struct target *target,
+static int target_run_flash_async_algorithm_imp(struct target *target,
 		uint8_t *buffer, uint32_t count, int block_size,
 		int num_mem_params, struct mem_param *mem_params,
 		int num_reg_params, struct reg_param *reg_params,
@@ -888,7 +940,8 @@ int target_run_flash_async_algorithm(struct target *target,
 			break;
 		}
 
-		if ((rp & (block_size - 1)) || rp < fifo_start_addr || rp >= fifo_end_addr) {
+		if (((rp - fifo_start_addr) & (block_size - 1))
+				|| rp < fifo_start_addr || rp >= fifo_end_addr) {
 			LOG_ERROR("corrupted fifo read pointer 0x%" PRIx32, rp);
 			break;
 		}
@@ -964,6 +1017,26 @@ int target_run_flash_async_algorithm(struct target *target,
 	return retval;
 }
 
+int target_run_flash_async_algorithm(struct target *target,
+		uint8_t *buffer, uint32_t count, int block_size,
+		int num_mem_params, struct mem_param *mem_params,
+		int num_reg_params, struct reg_param *reg_params,
+		uint32_t buffer_start, uint32_t buffer_size,
+		uint32_t entry_point, uint32_t exit_point, void *arch_info)
+{
+	/* the time the host spends waiting for FIFO space or polling the
+	 * read pointer is time the target is busy */
+	double *outer = target_timing_switch(&timing.algorithm);
+	timing.algorithm_runs++;
+
+	int retval = target_run_flash_async_algorithm_imp(target, buffer, count,
+			block_size, num_mem_params, mem_params, num_reg_params, reg_params,
+			buffer_start, buffer_size, entry_point, exit_point, arch_info);
+
+	target_timing_switch(outer);
+	return retval;
+}
+
 int target_read_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -979,19 +1052,35 @@ static int target_read_phys_memory(struct target *target,
 int target_write_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t count, const uint8_t *buffer)
 {
+	flash_cache_invalidate_range(target, address, size * count);
+	target_working_areas_written(target, address, size * count);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
 static int target_write_phys_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t count, const uint8_t *buffer)
 {
+	flash_cache_invalidate_range(target, address, size * count);
+	target_working_areas_written(target, address, size * count);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
 int target_bulk_write_memory(struct target *target,
 		uint32_t address, uint32_t count, const uint8_t *buffer)
 {
-	return target->type->bulk_write_memory(target, address, count, buffer);
+	flash_cache_invalidate_range(target, address, count * 4);
+	target_working_areas_written(target, address, count * 4);
+	double *outer = target_timing_transfer(&timing.bytes_written, count * 4);
+	int retval = target->type->bulk_write_memory(target, address, count, buffer);
+	target_timing_switch(outer);
+	return retval;
+}
+
+int target_sample_pc(struct target *target, uint32_t *samples, uint32_t num)
+{
+	if (target->type->sample_pc == NULL)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	return target->type->sample_pc(target, samples, num);
 }
 
 int target_add_breakpoint(struct target *target,
@@ -1409,7 +1498,7 @@ static void print_wa_layout(struct target *target)
 
 	while (c) {
 		LOG_DEBUG("%c%c 0x%08"PRIx32"-0x%08"PRIx32" (%"PRIu32" bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+			c->backup ? 'b' : ' ', c->free ? ' ' : c->resident ? 'r' : '*',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1434,6 +1523,8 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
+		new_wa->code = false;
+		new_wa->resident = false;
 
 		area->next = new_wa;
 		area->size = size;
@@ -1479,7 +1570,54 @@ static void target_merge_working_areas(struct target *target)
 	}
 }
 
-int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
+/* Free all areas only kept for their resident code.
+ * Returns whether there were any. */
+static bool target_drop_resident_working_areas(struct target *target)
+{
+	bool dropped = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (c->resident) {
+			c->resident = false;
+			c->code = false;
+			c->free = true;
+			dropped = true;
+		}
+	}
+
+	if (dropped) {
+		LOG_DEBUG("dropped resident algorithms");
+		target_merge_working_areas(target);
+	}
+
+	return dropped;
+}
+
+/* Memory in @a address .. @a address + @a size - 1 is being written:
+ * code loaded there can't be trusted anymore. */
+static void target_working_areas_written(struct target *target,
+		uint32_t address, uint32_t size)
+{
+	bool dropped = false;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->code || address >= c->address + c->size
+				|| address + size <= c->address)
+			continue;
+		c->code = false;
+		if (c->resident) {
+			c->resident = false;
+			c->free = true;
+			dropped = true;
+		}
+	}
+
+	if (dropped)
+		target_merge_working_areas(target);
+}
+
+static int target_alloc_working_area_try_imp(struct target *target,
+		uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
 	if (target->working_areas == NULL) {
@@ -1523,6 +1661,8 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
+			new_wa->code = false;
+			new_wa->resident = false;
 		}
 
 		target->working_areas = new_wa;
@@ -1532,14 +1672,20 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	if (size % 4)
 		size = (size + 3) & (~3UL);
 
-	struct working_area *c = target->working_areas;
+	struct working_area *c;
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
-	}
+	do {
+		/* Find the free area leaving the least space behind */
+		c = NULL;
+		for (struct working_area *f = target->working_areas; f; f = f->next) {
+			if (!f->free || f->size < size)
+				continue;
+			if (c == NULL || f->size < c->size)
+				c = f;
+			if (c->size == size)
+				break;
+		}
+	} while (c == NULL && target_drop_resident_working_areas(target));
 
 	if (c == NULL)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -1573,6 +1719,21 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	return ERROR_OK;
 }
 
+static int target_alloc_working_area_timed(struct target *target,
+		uint32_t size, struct working_area **area)
+{
+	/* including the MMU checks; backups made count as transfers */
+	double *outer = target_timing_switch(&timing.working_area);
+	int retval = target_alloc_working_area_try_imp(target, size, area);
+	target_timing_switch(outer);
+	return retval;
+}
+
+int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
+{
+	return target_alloc_working_area_timed(target, size, area);
+}
+
 int target_alloc_working_area(struct target *target, uint32_t size, struct working_area **area)
 {
 	int retval;
@@ -1584,6 +1745,72 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
+/* FNV-1a, over the size too */
+static uint64_t target_code_hash(const uint8_t *code, uint32_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (uint32_t i = 0; i < size; i++)
+		hash = (hash ^ code[i]) * 0x100000001b3ULL;
+	for (int i = 0; i < 32; i += 8)
+		hash = (hash ^ ((size >> i) & 0xff)) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+int target_alloc_algorithm(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area)
+{
+	uint64_t hash = target_code_hash(code, size);
+	int retval;
+
+	if (!target->backup_working_area) {
+		for (struct working_area *c = target->working_areas; c; c = c->next) {
+			if (!c->resident || c->code_hash != hash)
+				continue;
+
+			LOG_DEBUG("reusing resident algorithm at 0x%08"PRIx32, c->address);
+			c->resident = false;
+			c->user = area;
+			*area = c;
+			return ERROR_OK;
+		}
+	}
+
+	retval = target_alloc_working_area(target, size, area);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = target_write_buffer(target, (*area)->address, size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, *area);
+		return retval;
+	}
+
+	(*area)->code = true;
+	(*area)->code_hash = hash;
+
+	return ERROR_OK;
+}
+
+int target_alloc_algorithm_u32(struct target *target,
+		const uint32_t *code, unsigned words, struct working_area **area)
+{
+	uint8_t *buf = malloc(words * 4);
+	int retval;
+
+	if (buf == NULL)
+		return ERROR_FAIL;
+
+	for (unsigned i = 0; i < words; i++)
+		target_buffer_set_u32(target, buf + i * 4, code[i]);
+
+	retval = target_alloc_algorithm(target, buf, words * 4, area);
+	free(buf);
+
+	return retval;
+}
+
 static int target_restore_working_area(struct target *target, struct working_area *area)
 {
 	int retval = ERROR_OK;
@@ -1603,9 +1830,18 @@ static int target_free_working_area_restore(struct target *target, struct workin
 {
 	int retval = ERROR_OK;
 
-	if (area->free)
+	if (area->free || area->resident)
 		return retval;
 
+	if (area->code && !target->backup_working_area) {
+		/* keep the code for the next user */
+		area->resident = true;
+		*area->user = NULL;
+		area->user = NULL;
+		print_wa_layout(target);
+		return retval;
+	}
+
 	if (restore) {
 		retval = target_restore_working_area(target, area);
 		/* REVISIT: Perhaps the area should be freed even if restoring fails. */
@@ -1614,6 +1850,7 @@ static int target_free_working_area_restore(struct target *target, struct workin
 	}
 
 	area->free = true;
+	area->code = false;
 
 	LOG_DEBUG("freed %"PRIu32" bytes of working area at address 0x%08"PRIx32,
 			area->size, area->address);
@@ -1648,13 +1885,18 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 
 	/* Loop through all areas, restoring the allocated ones and marking them as free */
 	while (c) {
-		if (!c->free) {
+		if (c->resident) {
+			/* no user, nor a backup */
+			c->resident = false;
+			c->free = true;
+		} else if (!c->free) {
 			if (restore)
 				target_restore_working_area(target, c);
 			c->free = true;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
 		}
+		c->code = false;
 		c = c->next;
 	}
 
@@ -1673,14 +1915,19 @@ void target_free_all_working_areas(struct target *target)
 uint32_t target_get_working_area_avail(struct target *target)
 {
 	struct working_area *c = target->working_areas;
-	uint32_t max_size = 0;
+	uint32_t max_size = 0, size = 0;
 
 	if (c == NULL)
 		return target->working_area_size;
 
+	/* resident code is dropped when the space is needed */
 	while (c) {
-		if (c->free && max_size < c->size)
-			max_size = c->size;
+		if (c->free || c->resident)
+			size += c->size;
+		else
+			size = 0;
+		if (max_size < size)
+			max_size = size;
 
 		c = c->next;
 	}
@@ -1730,7 +1977,12 @@ int target_write_buffer(struct target *target, uint32_t address, uint32_t size,
 		return ERROR_FAIL;
 	}
 
-	return target->type->write_buffer(target, address, size, buffer);
+	flash_cache_invalidate_range(target, address, size);
+	target_working_areas_written(target, address, size);
+	double *outer = target_timing_transfer(&timing.bytes_written, size);
+	int retval = target->type->write_buffer(target, address, size, buffer);
+	target_timing_switch(outer);
+	return retval;
 }
 
 static int target_write_buffer_default(struct target *target, uint32_t address, uint32_t size, const uint8_t *buffer)
@@ -1811,7 +2063,10 @@ int target_read_buffer(struct target *target, uint32_t address, uint32_t size, u
 		return ERROR_FAIL;
 	}
 
-	return target->type->read_buffer(target, address, size, buffer);
+	double *outer = target_timing_transfer(&timing.bytes_read, size);
+	int retval = target->type->read_buffer(target, address, size, buffer);
+	target_timing_switch(outer);
+	return retval;
 }
 
 static int target_read_buffer_default(struct target *target, uint32_t address, uint32_t size, uint8_t *buffer)
@@ -1927,6 +2182,119 @@ int target_blank_check_memory(struct target *target, uint32_t address, uint32_t
 	return retval;
 }
 
+/* fallback for targets without a multi block algorithm */
+static int target_blank_check_blocks_singly(struct target *target,
+		const struct target_memory_check_block *blocks, unsigned num_blocks,
+		uint32_t *blank_bitmap)
+{
+	for (unsigned i = 0; i < num_blocks; i++) {
+		uint32_t blank;
+		int retval = target_blank_check_memory(target,
+				blocks[i].address, blocks[i].size, &blank);
+		if (retval != ERROR_OK)
+			return retval;
+		if (blank == 0xff)
+			blank_bitmap[i / 32] |= 1u << (i % 32);
+	}
+
+	return ERROR_OK;
+}
+
+int target_blank_check_memory_blocks(struct target *target,
+		const struct target_memory_check_block *blocks, unsigned num_blocks,
+		uint8_t erased_value, uint32_t *blank_bitmap)
+{
+	struct working_area *area = NULL;
+	uint32_t erased_word = erased_value * 0x01010101u;
+	unsigned chunk = num_blocks;
+	unsigned first;
+	int retval = ERROR_OK;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	memset(blank_bitmap, 0, DIV_ROUND_UP(num_blocks, 32) * sizeof(uint32_t));
+
+	/* the algorithms compare whole words */
+	bool aligned = true;
+	for (unsigned i = 0; i < num_blocks; i++) {
+		if ((blocks[i].address | blocks[i].size) & 3)
+			aligned = false;
+	}
+
+	if (!target->type->blank_check_memory_blocks || !aligned) {
+		if (erased_value != 0xff)
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		return target_blank_check_blocks_singly(target, blocks, num_blocks, blank_bitmap);
+	}
+
+	/* the block table followed by the result bitmap, as many blocks
+	 * at a time as fit */
+	while (target_alloc_working_area_try(target,
+			chunk * 8 + DIV_ROUND_UP(chunk, 32) * 4, &area) != ERROR_OK) {
+		if (chunk == 1) {
+			LOG_DEBUG("no working area for the blank check table");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+		chunk = DIV_ROUND_UP(chunk, 2);
+	}
+
+	uint8_t *table = malloc(chunk * 8 + DIV_ROUND_UP(chunk, 32) * 4);
+	if (table == NULL) {
+		target_free_working_area(target, area);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (first = 0; first < num_blocks; first += chunk) {
+		unsigned count = num_blocks - first;
+		uint32_t total_size = 0;
+		unsigned i;
+
+		if (count > chunk)
+			count = chunk;
+
+		for (i = 0; i < count; i++) {
+			target_buffer_set_u32(target, table + 8 * i, blocks[first + i].address);
+			target_buffer_set_u32(target, table + 8 * i + 4, blocks[first + i].size);
+			total_size += blocks[first + i].size;
+		}
+
+		/* the algorithm only sets the bits of blank blocks */
+		uint8_t *bitmap = table + count * 8;
+		memset(bitmap, 0, DIV_ROUND_UP(count, 32) * 4);
+
+		retval = target_write_buffer(target, area->address,
+				count * 8 + DIV_ROUND_UP(count, 32) * 4, table);
+		if (retval != ERROR_OK)
+			break;
+
+		retval = target->type->blank_check_memory_blocks(target,
+				area->address, count, area->address + count * 8,
+				erased_word, total_size);
+		if (retval != ERROR_OK)
+			break;
+
+		retval = target_read_buffer(target, area->address + count * 8,
+				DIV_ROUND_UP(count, 32) * 4, bitmap);
+		if (retval != ERROR_OK)
+			break;
+
+		for (i = 0; i < count; i++) {
+			uint32_t word = target_buffer_get_u32(target, bitmap + (i / 32) * 4);
+			if (word & (1u << (i % 32)))
+				blank_bitmap[(first + i) / 32] |= 1u << ((first + i) % 32);
+		}
+	}
+
+	free(table);
+	target_free_working_area(target, area);
+
+	return retval;
+}
+
 int target_read_u32(struct target *target, uint32_t address, uint32_t *value)
 {
 	uint8_t value_buf[4];
@@ -2915,63 +3283,34 @@ COMMAND_HANDLER(handle_load_image_command)
 
 COMMAND_HANDLER(handle_dump_image_command)
 {
-	struct fileio fileio;
-	uint8_t *buffer;
-	int retval, retvaltemp;
+	int retval;
 	uint32_t address, size;
+	bool map = false;
 	struct duration bench;
 	struct target *target = get_current_target(CMD_CTX);
 
+	if (CMD_ARGC == 4 && strcmp(CMD_ARGV[0], "mmap") == 0) {
+		map = true;
+		CMD_ARGV++;
+		CMD_ARGC--;
+	}
+
 	if (CMD_ARGC != 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], address);
 	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
-	buffer = malloc(buf_size);
-	if (!buffer)
-		return ERROR_FAIL;
-
-	retval = fileio_open(&fileio, CMD_ARGV[0], FILEIO_WRITE, FILEIO_BINARY);
-	if (retval != ERROR_OK) {
-		free(buffer);
-		return retval;
-	}
-
 	duration_start(&bench);
 
-	while (size > 0) {
-		size_t size_written;
-		uint32_t this_run_size = (size > buf_size) ? buf_size : size;
-		retval = target_read_buffer(target, address, this_run_size, buffer);
-		if (retval != ERROR_OK)
-			break;
-
-		retval = fileio_write(&fileio, this_run_size, buffer, &size_written);
-		if (retval != ERROR_OK)
-			break;
-
-		size -= this_run_size;
-		address += this_run_size;
-	}
-
-	free(buffer);
+	retval = flash_dump_memory(target, address, size, CMD_ARGV[0], map);
 
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
-		int filesize;
-		retval = fileio_size(&fileio, &filesize);
-		if (retval != ERROR_OK)
-			return retval;
 		command_print(CMD_CTX,
-				"dumped %ld bytes in %fs (%0.3f KiB/s)", (long)filesize,
-				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+				"dumped %" PRIu32 " bytes in %fs (%0.3f KiB/s)", size,
+				duration_elapsed(&bench), duration_kbps(&bench, size));
 	}
 
-	retvaltemp = fileio_close(&fileio);
-	if (retvaltemp != ERROR_OK)
-		return retvaltemp;
-
 	return retval;
 }
 
@@ -3041,7 +3380,13 @@ static COMMAND_HELPER(handle_verify_image_command_internal, int verify)
 				break;
 			}
 
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
+			/* flash the flash core just wrote needn't be read back */
+			if (flash_cache_checksum(target, image.sections[i].base_address,
+					buf_cnt, &mem_checksum))
+				retval = ERROR_OK;
+			else
+				retval = target_checksum_memory(target,
+						image.sections[i].base_address, buf_cnt, &mem_checksum);
 			if (retval != ERROR_OK) {
 				free(buffer);
 				break;
@@ -3376,11 +3721,55 @@ static void writeString(FILE *f, char *s)
 	writeData(f, s, strlen(s));
 }
 
+/* PC samples collected by the profile command.  They are streamed
+ * to a temporary file as they arrive, so runs can be arbitrarily long. */
+struct profile_samples {
+	FILE *raw;
+	uint32_t num;
+	uint32_t idle;		/* samples taken while the core could not be sampled */
+	uint32_t min;
+	uint32_t max;
+};
+
+#define PROFILE_BATCH	256
+
+static int profile_add_samples(struct profile_samples *p, uint32_t *samples, uint32_t n)
+{
+	uint32_t valid = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t pc = samples[i];
+		if (pc == 0xffffffff) {
+			p->idle++;
+			continue;
+		}
+		if (p->num + valid == 0 || pc < p->min)
+			p->min = pc;
+		if (p->num + valid == 0 || pc > p->max)
+			p->max = pc;
+		samples[valid++] = pc;
+	}
+
+	if (fwrite(samples, sizeof(uint32_t), valid, p->raw) != valid) {
+		LOG_ERROR("failed to store profiling samples: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+	p->num += valid;
+
+	return ERROR_OK;
+}
+
+/* Read back the next batch of stored samples; returns how many were read. */
+static size_t profile_read_samples(struct profile_samples *p, uint32_t *samples)
+{
+	return fread(samples, sizeof(uint32_t), PROFILE_BATCH, p->raw);
+}
+
 /* Dump a gmon.out histogram file. */
-static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filename)
+static void writeGmon(struct profile_samples *p, uint32_t rate, const char *filename)
 {
 	uint32_t i;
-	FILE *f = fopen(filename, "w");
+	FILE *f = fopen(filename, "wb");
 	if (f == NULL)
 		return;
 	writeString(f, "gmon");
@@ -3393,17 +3782,12 @@ static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filenam
 	writeData(f, &zero, 1);
 
 	/* figure out bucket size */
-	uint32_t min = samples[0];
-	uint32_t max = samples[0];
-	for (i = 0; i < sampleNum; i++) {
-		if (min > samples[i])
-			min = samples[i];
-		if (max < samples[i])
-			max = samples[i];
-	}
+	uint32_t min = p->min;
+	uint32_t max = p->max;
+	if (max == min)
+		max++;
 
-	int addressSpace = (max - min + 1);
-	assert(addressSpace >= 2);
+	uint32_t addressSpace = (max - min + 1);
 
 	static const uint32_t maxBuckets = 16 * 1024; /* maximum buckets. */
 	uint32_t length = addressSpace;
@@ -3415,20 +3799,25 @@ static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filenam
 		return;
 	}
 	memset(buckets, 0, sizeof(int) * length);
-	for (i = 0; i < sampleNum; i++) {
-		uint32_t address = samples[i];
-		long long a = address - min;
-		long long b = length - 1;
-		long long c = addressSpace - 1;
-		int index_t = (a * b) / c; /* danger!!!! int32 overflows */
-		buckets[index_t]++;
+
+	uint32_t samples[PROFILE_BATCH];
+	size_t n;
+	rewind(p->raw);
+	while ((n = profile_read_samples(p, samples)) > 0) {
+		for (i = 0; i < n; i++) {
+			long long a = samples[i] - min;
+			long long b = length - 1;
+			long long c = addressSpace - 1;
+			int index_t = (a * b) / c;
+			buckets[index_t]++;
+		}
 	}
 
 	/* append binary memory gmon.out &profile_hist_hdr ((char*)&profile_hist_hdr + sizeof(struct gmon_hist_hdr)) */
 	writeLong(f, min);			/* low_pc */
 	writeLong(f, max);			/* high_pc */
 	writeLong(f, length);		/* # of samples */
-	writeLong(f, 100);			/* KLUDGE! We lie, ca. 100Hz best case. */
+	writeLong(f, rate);			/* sampling rate, Hz */
 	writeString(f, "seconds");
 	for (i = 0; i < (15-strlen("seconds")); i++)
 		writeData(f, &zero, 1);
@@ -3455,89 +3844,219 @@ static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filenam
 	fclose(f);
 }
 
+/* Find the function containing @a pc; @a symbols is sorted by address. */
+static int profile_find_symbol(struct image_symbol *symbols, int num_symbols, uint32_t pc)
+{
+	int lo = 0, hi = num_symbols - 1, found = -1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (symbols[mid].address <= pc) {
+			found = mid;
+			lo = mid + 1;
+		} else
+			hi = mid - 1;
+	}
+
+	/* symbols without a size extend up to the next symbol */
+	if (found >= 0 && symbols[found].size != 0 &&
+			pc >= symbols[found].address + symbols[found].size)
+		return -1;
+	return found;
+}
+
+static const uint32_t *profile_counts;
+
+static int profile_count_compare(const void *a, const void *b)
+{
+	uint32_t ca = profile_counts[*(const int *)a];
+	uint32_t cb = profile_counts[*(const int *)b];
+
+	if (ca > cb)
+		return -1;
+	return ca < cb;
+}
+
+/* Print a flat profile: samples attributed to each function. */
+static void profile_print_functions(struct command_context *cmd_ctx,
+		struct profile_samples *p, struct image_symbol *symbols, int num_symbols)
+{
+	uint32_t *counts = calloc(num_symbols, sizeof(uint32_t));
+	int *order = malloc(num_symbols * sizeof(int));
+	uint32_t unknown = 0;
+
+	if (counts == NULL || order == NULL || p->num == 0)
+		goto done;
+
+	uint32_t samples[PROFILE_BATCH];
+	size_t n;
+	rewind(p->raw);
+	while ((n = profile_read_samples(p, samples)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			int sym = profile_find_symbol(symbols, num_symbols, samples[i]);
+			if (sym < 0)
+				unknown++;
+			else
+				counts[sym]++;
+		}
+	}
+
+	for (int i = 0; i < num_symbols; i++)
+		order[i] = i;
+	profile_counts = counts;
+	qsort(order, num_symbols, sizeof(int), profile_count_compare);
+
+	command_print(cmd_ctx, "  %%time   samples  function");
+	for (int i = 0; i < num_symbols && counts[order[i]]; i++)
+		command_print(cmd_ctx, "%7.2f %9" PRIu32 "  %s",
+				100.0 * counts[order[i]] / p->num, counts[order[i]],
+				symbols[order[i]].name);
+	if (unknown)
+		command_print(cmd_ctx, "%7.2f %9" PRIu32 "  <unknown>",
+				100.0 * unknown / p->num, unknown);
+
+done:
+	free(order);
+	free(counts);
+}
+
+static int profile_load_symbols(const char *filename,
+		struct image_symbol **symbols, int *num_symbols)
+{
+	struct image image;
+
+	image.base_address_set = 0;
+	image.start_address_set = 0;
+
+	int retval = image_open(&image, filename, "elf");
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = image_read_symbols(&image, symbols, num_symbols);
+	image_close(&image);
+	return retval;
+}
+
 /* profiling samples the CPU PC as quickly as OpenOCD is able,
  * which will be used as a random sampling of PC */
 COMMAND_HANDLER(handle_profile_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
 	struct timeval timeout, now;
+	struct image_symbol *symbols = NULL;
+	int num_symbols = 0;
 
-	gettimeofday(&timeout, NULL);
-	if (CMD_ARGC != 2)
+	if (CMD_ARGC < 2 || CMD_ARGC > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 	unsigned offset;
 	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], offset);
 
-	timeval_add_time(&timeout, offset, 0);
+	int retval;
+	if (CMD_ARGC == 3) {
+		retval = profile_load_symbols(CMD_ARGV[2], &symbols, &num_symbols);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
-	/**
-	 * @todo: Some cores let us sample the PC without the
-	 * annoying halt/resume step; for example, ARMv7 PCSR.
-	 * Provide a way to use that more efficient mechanism.
-	 */
+	struct profile_samples p;
+	memset(&p, 0, sizeof(p));
+	p.raw = tmpfile();
+	if (p.raw == NULL) {
+		LOG_ERROR("can't create a temporary file: %s", strerror(errno));
+		image_free_symbols(symbols, num_symbols);
+		return ERROR_FAIL;
+	}
 
-	command_print(CMD_CTX, "Starting profiling. Halting and resuming the target as often as we can...");
+	/* Prefer sampling without stopping the target, e.g. ARMv7-M PCSR;
+	 * it needs the target running. */
+	bool halting = false;
+	retval = target_poll(target);
+	if (retval == ERROR_OK && target->state == TARGET_HALTED)
+		retval = target_resume(target, 1, 0, 0, 0);
+	if (retval != ERROR_OK)
+		goto done;
 
-	static const int maxSample = 10000;
-	uint32_t *samples = malloc(sizeof(uint32_t)*maxSample);
-	if (samples == NULL)
-		return ERROR_OK;
+	uint32_t batch[PROFILE_BATCH];
+	retval = target_sample_pc(target, batch, 1);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE) {
+		halting = true;
+		retval = ERROR_OK;
+		command_print(CMD_CTX, "Starting profiling. Halting and resuming the target as often as we can...");
+	} else if (retval == ERROR_OK)
+		command_print(CMD_CTX, "Starting profiling. Sampling the PC without halting...");
+	else
+		goto done;
 
-	int numSamples = 0;
 	/* hopefully it is safe to cache! We want to stop/restart as quickly as possible. */
 	struct reg *reg = register_get_by_name(target->reg_cache, "pc", 1);
 
-	int retval = ERROR_OK;
+	struct duration bench;
+	duration_start(&bench);
+	gettimeofday(&timeout, NULL);
+	timeval_add_time(&timeout, offset, 0);
+
 	for (;;) {
-		target_poll(target);
-		if (target->state == TARGET_HALTED) {
-			uint32_t t = *((uint32_t *)reg->value);
-			samples[numSamples++] = t;
-			/* current pc, addr = 0, do not handle breakpoints, not debugging */
-			retval = target_resume(target, 1, 0, 0, 0);
+		if (!halting) {
+			retval = target_sample_pc(target, batch, PROFILE_BATCH);
+			if (retval == ERROR_OK)
+				retval = profile_add_samples(&p, batch, PROFILE_BATCH);
+			keep_alive();
+		} else {
 			target_poll(target);
-			alive_sleep(10); /* sleep 10ms, i.e. <100 samples/second. */
-		} else if (target->state == TARGET_RUNNING) {
-			/* We want to quickly sample the PC. */
-			retval = target_halt(target);
-			if (retval != ERROR_OK) {
-				free(samples);
-				return retval;
+			if (target->state == TARGET_HALTED) {
+				batch[0] = buf_get_u32(reg->value, 0, 32);
+				retval = profile_add_samples(&p, batch, 1);
+				/* current pc, addr = 0, do not handle breakpoints, not debugging */
+				if (retval == ERROR_OK)
+					retval = target_resume(target, 1, 0, 0, 0);
+				target_poll(target);
+				alive_sleep(10); /* sleep 10ms, i.e. <100 samples/second. */
+			} else if (target->state == TARGET_RUNNING) {
+				/* We want to quickly sample the PC. */
+				retval = target_halt(target);
+			} else {
+				command_print(CMD_CTX, "Target not halted or running");
+				break;
 			}
-		} else {
-			command_print(CMD_CTX, "Target not halted or running");
-			retval = ERROR_OK;
-			break;
 		}
 		if (retval != ERROR_OK)
 			break;
 
 		gettimeofday(&now, NULL);
-		if ((numSamples >= maxSample) || ((now.tv_sec >= timeout.tv_sec)
-				&& (now.tv_usec >= timeout.tv_usec))) {
-			command_print(CMD_CTX, "Profiling completed. %d samples.", numSamples);
-			retval = target_poll(target);
-			if (retval != ERROR_OK) {
-				free(samples);
-				return retval;
-			}
-			if (target->state == TARGET_HALTED) {
-				/* current pc, addr = 0, do not handle
-				 * breakpoints, not debugging */
-				target_resume(target, 1, 0, 0, 0);
-			}
-			retval = target_poll(target);
-			if (retval != ERROR_OK) {
-				free(samples);
-				return retval;
-			}
-			writeGmon(samples, numSamples, CMD_ARGV[1]);
-			command_print(CMD_CTX, "Wrote %s", CMD_ARGV[1]);
+		if (now.tv_sec > timeout.tv_sec || (now.tv_sec == timeout.tv_sec &&
+				now.tv_usec >= timeout.tv_usec))
 			break;
+	}
+	duration_measure(&bench);
+
+	if (halting) {
+		int retval2 = target_poll(target);
+		if (retval2 == ERROR_OK && target->state == TARGET_HALTED) {
+			/* current pc, addr = 0, do not handle
+			 * breakpoints, not debugging */
+			target_resume(target, 1, 0, 0, 0);
 		}
 	}
-	free(samples);
+	if (retval != ERROR_OK)
+		goto done;
+
+	float elapsed = duration_elapsed(&bench);
+	uint32_t rate = elapsed > 0 ? (uint32_t)((p.num + p.idle) / elapsed) : 0;
+	command_print(CMD_CTX, "Profiling completed. %" PRIu32 " samples (%" PRIu32
+			" Hz), %" PRIu32 " taken while the core could not be sampled.",
+			p.num, rate, p.idle);
+	if (p.num == 0)
+		goto done;
 
+	writeGmon(&p, rate, CMD_ARGV[1]);
+	command_print(CMD_CTX, "Wrote %s", CMD_ARGV[1]);
+
+	if (symbols)
+		profile_print_functions(CMD_CTX, &p, symbols, num_symbols);
+
+done:
+	fclose(p.raw);
+	image_free_symbols(symbols, num_symbols);
 	return retval;
 }
 
@@ -5498,9 +6017,19 @@ static const struct command_registration target_command_handlers[] = {
 
 int target_register_commands(struct command_context *cmd_ctx)
 {
+	int retval = sampler_register_commands(cmd_ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return register_commands(cmd_ctx, NULL, target_command_handlers);
 }
 
+void target_quit(void)
+{
+	for (struct target *target = all_targets; target; target = target->next)
+		breakpoint_watchpoint_free_all(target);
+}
+
 static bool target_reset_nag = true;
 
 bool get_target_reset_nag(void)
@@ -5558,7 +6087,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "profile",
 		.handler = handle_profile_command,
 		.mode = COMMAND_EXEC,
-		.usage = "seconds filename",
+		.usage = "seconds filename [elf_file]",
 		.help = "profiling samples the CPU PC",
 	},
 	/** @todo don't register virt2phys() unless target supports it */
@@ -5710,7 +6239,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "dump_image",
 		.handler = handle_dump_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "filename address size",
+		.usage = "['mmap'] filename address size",
 	},
 	{
 		.name = "verify_image",
@@ -104,6 +104,9 @@ struct working_area {
 	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
+	bool code;		/**< holds code loaded by target_alloc_algorithm() */
+	bool resident;		/**< freed, but its code is kept for reuse */
+	uint64_t code_hash;
 };
 
 struct gdb_service {
@@ -160,6 +163,7 @@ struct target {
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
+	struct bpwp_hash *bpwp_hash;		/* address index of both lists, see breakpoints.c */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
 	uint32_t dbg_msg_enabled;			/* debug message status */
@@ -279,6 +283,8 @@ struct target_timer_callback {
 
 int target_register_commands(struct command_context *cmd_ctx);
 int target_examine(void);
+/** Frees the host side state of all targets, on exit. */
+void target_quit(void);
 
 int target_register_event_callback(
 		int (*callback)(struct target *target,
@@ -495,6 +501,15 @@ int target_write_memory(struct target *target,
 int target_bulk_write_memory(struct target *target,
 		uint32_t address, uint32_t count, const uint8_t *buffer);
 
+/**
+ * Take @a num program counter samples from the running @a target
+ * without halting it.
+ *
+ * This routine is a wrapper for target->type->sample_pc; it returns
+ * ERROR_TARGET_RESOURCE_NOT_AVAILABLE if the target can't do that.
+ */
+int target_sample_pc(struct target *target, uint32_t *samples, uint32_t num);
+
 /* Generate a target descriptor file.
  *
  * This routine is wrapper for target->type->generate_tdesc_file.
@@ -533,6 +548,26 @@ int target_checksum_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t *crc);
 int target_blank_check_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t *blank);
+
+/** A memory range checked by target_blank_check_memory_blocks(). */
+struct target_memory_check_block {
+	uint32_t address;
+	uint32_t size;
+};
+
+/**
+ * Checks whether each of @a num_blocks memory blocks holds only bytes
+ * of @a erased_value, running one algorithm over as many blocks as the
+ * working area has room for.  Bit n of @a blank_bitmap, which has
+ * room for @a num_blocks bits, is set if block n is blank.
+ *
+ * @returns ERROR_OK on success, ERROR_TARGET_RESOURCE_NOT_AVAILABLE if
+ * the check can't run on the target, in which case the caller should
+ * read the memory instead.
+ */
+int target_blank_check_memory_blocks(struct target *target,
+		const struct target_memory_check_block *blocks, unsigned num_blocks,
+		uint8_t erased_value, uint32_t *blank_bitmap);
 int target_wait_state(struct target *target, enum target_state state, int ms);
 
 /** Return the *name* of this targets current state */
@@ -559,10 +594,41 @@ int target_alloc_working_area(struct target *target,
  */
 int target_alloc_working_area_try(struct target *target,
 		uint32_t size, struct working_area **area);
+/**
+ * Allocates a working area and loads @a size bytes of algorithm @a code
+ * into it.  Unless working areas are backed up, freeing the area keeps
+ * the code resident, and a later call for the same code returns the
+ * area again without downloading anything.  Resident code is dropped
+ * when memory runs short, when the area is written, and together with
+ * all working areas on reset and resume.  The caller must not modify
+ * the area.
+ */
+int target_alloc_algorithm(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area);
+/** Same as target_alloc_algorithm(), for code given as 32-bit words
+ * that are stored in target endianness. */
+int target_alloc_algorithm_u32(struct target *target,
+		const uint32_t *code, unsigned words, struct working_area **area);
 int target_free_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
 uint32_t target_get_working_area_avail(struct target *target);
 
+/** Host time spent in operations on any target. */
+struct target_timing {
+	double transfer;		/**< seconds reading and writing target memory */
+	double algorithm;	/**< seconds running algorithms, except their transfers */
+	double working_area;	/**< seconds allocating working areas, except backups */
+	unsigned algorithm_runs;
+	uint64_t bytes_written;
+	uint64_t bytes_read;
+};
+
+/**
+ * Returns the totals accumulated since startup; callers interested in
+ * one operation take the difference of two samples.
+ */
+void target_timing_get(struct target_timing *timing);
+
 extern struct target *all_targets;
 
 uint32_t target_buffer_get_u32(struct target *target, const uint8_t *buffer);
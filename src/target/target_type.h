@@ -145,6 +145,17 @@ struct target_type {
 			uint32_t count, uint32_t *checksum);
 	int (*blank_check_memory)(struct target *target, uint32_t address,
 			uint32_t count, uint32_t *blank);
+	/**
+	 * Run an algorithm checking a table of @a num_blocks address/size
+	 * pairs at @a table, both words aligned, for words equal to
+	 * @a erased_word; bit n of the bitmap at @a bitmap is set if block
+	 * n holds nothing else.  @a total_size is the sum of the block
+	 * sizes, for the timeout.  Do @b not call this function directly,
+	 * use target_blank_check_memory_blocks() instead.
+	 */
+	int (*blank_check_memory_blocks)(struct target *target,
+			uint32_t table, uint32_t num_blocks, uint32_t bitmap,
+			uint32_t erased_word, uint32_t total_size);
 
 	/*
 	 * target break-/watchpoint control
@@ -265,6 +276,14 @@ struct target_type {
 
 	/* The target can generate its tdesc file based on the register list */
 	int (*generate_tdesc_file)(struct target *target, const char *filename);
+
+	/**
+	 * Sample the program counter @a num times without halting the
+	 * running target, e.g. from the ARMv7-M DWT PCSR.  Samples taken
+	 * while the core could not be sampled read as 0xffffffff.
+	 * Optional; use target_sample_pc() instead of calling this directly.
+	 */
+	int (*sample_pc)(struct target *target, uint32_t *samples, uint32_t num);
 };
 
 #endif /* TARGET_TYPE_H */
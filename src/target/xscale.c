@@ -2875,7 +2875,7 @@ static void xscale_build_reg_cache(struct target *target)
 
 	(*cache_p) = arm_build_reg_cache(target, arm);
 
-	(*cache_p)->next = malloc(sizeof(struct reg_cache));
+	(*cache_p)->next = calloc(1, sizeof(struct reg_cache));
 	cache_p = &(*cache_p)->next;
 
 	/* fill in values for the xscale reg cache */
@@ -3701,6 +3701,7 @@ struct target_type xscale_target = {
 
 	.checksum_memory = arm_checksum_memory,
 	.blank_check_memory = arm_blank_check_memory,
+	.blank_check_memory_blocks = arm_blank_check_memory_blocks,
 
 	.run_algorithm = armv4_5_run_algorithm,
 
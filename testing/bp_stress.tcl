@@ -0,0 +1,74 @@
+# Breakpoint and watchpoint stress benchmark.
+#
+# Load into a running OpenOCD with a halted target, e.g.
+#
+#	openocd -f board.cfg -c init -c "reset halt" -f testing/bp_stress.tcl \
+#		-c "bp_stress 0x20000000 4000" -c shutdown
+#
+# and read the timings from the log.  The software breakpoints are placed
+# every four bytes from the given address, which must be writable RAM the
+# target is not running from; it is restored when they are removed.
+# Compare builds by running the same command line against each.
+
+proc bp_stress_time {what script} {
+	set start [ms]
+	uplevel 1 $script
+	set elapsed [expr {[ms] - $start}]
+	echo [format "%-36s %6d ms" $what $elapsed]
+	return $elapsed
+}
+
+# bp_stress base count [steps]
+proc bp_stress {base count {steps 20}} {
+	set last [expr {$base + 4 * ($count - 1)}]
+
+	echo "bp_stress: $count software breakpoints from [format 0x%08x $base]"
+
+	bp_stress_time "add in address order" {
+		for {set i 0} {$i < $count} {incr i} {
+			bp [expr {$base + 4 * $i}] 4
+		}
+	}
+
+	# duplicates are looked up and refused
+	bp_stress_time "add again (duplicate lookups)" {
+		for {set i 0} {$i < $count} {incr i} {
+			catch {bp [expr {$base + 4 * $i}] 4}
+		}
+	}
+
+	set listed [llength [split [string trim [capture bp]] "\n"]]
+	if {$listed != $count} {
+		echo "bp_stress: FAILED, $listed breakpoints listed, expected $count"
+	}
+
+	# every stop and resume looks up the breakpoint at the PC
+	bp_stress_time "$steps single steps" {
+		for {set i 0} {$i < $steps} {incr i} {
+			step
+		}
+	}
+
+	# newest first is the worst order for a list walk
+	bp_stress_time "remove in reverse order" {
+		for {set a $last} {$a >= $base} {incr a -4} {
+			rbp $a
+		}
+	}
+
+	bp_stress_time "add $count watchpoints" {
+		for {set i 0} {$i < $count} {incr i} {
+			catch {wp [expr {$base + 4 * $i}] 4}
+		}
+	}
+	bp_stress_time "remove watchpoints in reverse order" {
+		for {set a $last} {$a >= $base} {incr a -4} {
+			catch {rwp $a}
+		}
+	}
+
+	set left [string trim [capture bp]]
+	if {$left ne ""} {
+		echo "bp_stress: FAILED, breakpoints left over:\n$left"
+	}
+}